@@ -0,0 +1,596 @@
+/* exif-bench.c
+ *
+ * Time the main entry points of libexif over the test images and over
+ * EXIF data generated here, and count the memory they allocate.
+ *
+ * Usage: exif-bench [-t seconds] [-f filter] [file ...]
+ *
+ * Each case runs for at least the given time (0.2 s by default) on each
+ * sample and reports nanoseconds, allocations and bytes allocated per
+ * operation. Only cases or samples whose name contains the filter are run.
+ * Files given on the command line replace the test images.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#include <config.h>
+
+#include <libexif/exif-data.h>
+#include <libexif/exif-loader.h>
+#include <libexif/exif-system.h>
+#include <libexif/canon/exif-mnote-data-canon.h>
+#include <libexif/fuji/exif-mnote-data-fuji.h>
+#include <libexif/huawei/exif-mnote-data-huawei.h>
+#include <libexif/olympus/exif-mnote-data-olympus.h>
+#include <libexif/pentax/exif-mnote-data-pentax.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char *files[] = {
+	"canon_makernote_variant_1.jpg",
+	"fuji_makernote_variant_1.jpg",
+	"olympus_makernote_variant_2.jpg",
+	"olympus_makernote_variant_3.jpg",
+	"olympus_makernote_variant_4.jpg",
+	"olympus_makernote_variant_5.jpg",
+	"pentax_makernote_variant_2.jpg",
+	"pentax_makernote_variant_3.jpg",
+	"pentax_makernote_variant_4.jpg"
+};
+
+/*
+ * Memory handed out through the ExifMem of the benchmark. Reallocations
+ * count as allocations of the new size.
+ */
+static unsigned long bench_allocs, bench_bytes;
+
+static void *
+bench_alloc (ExifLong s)
+{
+	bench_allocs++;
+	bench_bytes += s;
+	return calloc (s, 1);
+}
+
+static void *
+bench_realloc (void *p, ExifLong s)
+{
+	bench_allocs++;
+	bench_bytes += s;
+	return realloc (p, s);
+}
+
+static void
+bench_free (void *p)
+{
+	free (p);
+}
+
+/*! \return a monotonic time in nanoseconds */
+static double
+bench_now (void)
+{
+#ifdef CLOCK_MONOTONIC
+	struct timespec ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+#else
+	return (double) clock () * (1e9 / CLOCKS_PER_SEC);
+#endif
+}
+
+typedef struct {
+	char name[64];
+
+	/*! File the sample was read from, NULL for generated data */
+	const char *path;
+
+	/*! EXIF data starting with the EXIF header */
+	unsigned char *d;
+	unsigned int ds;
+} BenchSample;
+
+typedef struct {
+	const BenchSample *sample;
+	ExifMem *mem;
+	ExifData *data;
+	ExifMnoteData *md;
+	unsigned int order;
+} BenchState;
+
+typedef struct {
+	const char *name;
+
+	/*! Prepare the state for a sample, not timed.
+	 *  \return 0 if the case does not apply to the sample */
+	int (* setup) (BenchState *s);
+
+	/*! Prepare one round, not timed */
+	void (* prepare) (BenchState *s);
+
+	/*! One timed round.
+	 *  \return number of operations done */
+	unsigned int (* run) (BenchState *s);
+
+	/*! Clean up after one round, not timed */
+	void (* finish) (BenchState *s);
+} BenchCase;
+
+static ExifData *
+bench_load (BenchState *s)
+{
+	ExifData *data = exif_data_new_mem (s->mem);
+
+	exif_data_load_data (data, s->sample->d, s->sample->ds);
+	return data;
+}
+
+static int
+setup_data (BenchState *s)
+{
+	s->data = bench_load (s);
+	return s->data != NULL;
+}
+
+static int
+setup_saved (BenchState *s)
+{
+	unsigned char *d = NULL;
+	unsigned int ds = 0;
+
+	if (!setup_data (s))
+		return 0;
+	exif_data_save_data (s->data, &d, &ds);
+	exif_mem_free (s->mem, d);
+	return 1;
+}
+
+static int
+setup_mnote (BenchState *s)
+{
+	if (!setup_data (s))
+		return 0;
+	s->md = exif_data_get_mnote_data (s->data);
+	return s->md && exif_mnote_data_count (s->md);
+}
+
+static int
+setup_file (BenchState *s)
+{
+	return s->sample->path != NULL;
+}
+
+static void
+prepare_data (BenchState *s)
+{
+	s->data = bench_load (s);
+}
+
+static void
+finish_data (BenchState *s)
+{
+	exif_data_unref (s->data);
+	s->data = NULL;
+}
+
+/* Same work as exif_data_new_from_data, but with the counting ExifMem */
+static unsigned int
+run_load (BenchState *s)
+{
+	exif_data_unref (bench_load (s));
+	return 1;
+}
+
+static unsigned int
+run_loader (BenchState *s)
+{
+	ExifLoader *l = exif_loader_new_mem (s->mem);
+
+	exif_loader_write_file (l, s->sample->path);
+	exif_loader_unref (l);
+	return 1;
+}
+
+static unsigned int
+run_save (BenchState *s)
+{
+	unsigned char *d = NULL;
+	unsigned int ds = 0;
+
+	exif_data_save_data (s->data, &d, &ds);
+	exif_mem_free (s->mem, d);
+	return 1;
+}
+
+static unsigned int
+run_get_value (BenchState *s)
+{
+	char v[1024];
+	unsigned int i, j, n = 0;
+
+	for (i = 0; i < EXIF_IFD_COUNT; i++)
+		for (j = 0; j < s->data->ifd[i]->count; j++, n++)
+			exif_entry_get_value (s->data->ifd[i]->entries[j], v,
+					      sizeof (v));
+	return n;
+}
+
+static unsigned int
+run_set_byte_order (BenchState *s)
+{
+	s->order = !s->order;
+	exif_data_set_byte_order (s->data, s->order ?
+				  EXIF_BYTE_ORDER_MOTOROLA : EXIF_BYTE_ORDER_INTEL);
+	return 1;
+}
+
+/* The parsers get the data with the EXIF header, as when loading */
+static unsigned int
+run_mnote_load (BenchState *s)
+{
+	exif_mnote_data_load (s->md, s->sample->d, s->sample->ds);
+	return 1;
+}
+
+static unsigned int
+run_mnote_get_value (BenchState *s)
+{
+	char v[1024];
+	unsigned int i, n = exif_mnote_data_count (s->md);
+
+	for (i = 0; i < n; i++)
+		exif_mnote_data_get_value (s->md, i, v, sizeof (v));
+	return n;
+}
+
+static int
+setup_huawei (BenchState *s)
+{
+	return setup_mnote (s) && is_huawei_md (s->md);
+}
+
+/* Look up each tag of the loaded MakerNote again in the raw data */
+static unsigned int
+run_huawei_get_value_from_data (BenchState *s)
+{
+	ExifMnoteDataHuawei *n = (ExifMnoteDataHuawei *) s->md;
+	MnoteHuaweiEntry *e;
+	char v[1024];
+	unsigned int n_ops = 0;
+	int i;
+
+	for (i = 0; (e = exif_mnote_data_huawei_get_entry_by_index (n, i)); i++, n_ops++)
+		exif_mnote_data_huawei_get_value_from_data (s->sample->d,
+				s->sample->ds, e->tag, v, sizeof (v));
+	return n_ops;
+}
+
+static const BenchCase cases[] = {
+	{"exif_data_new_from_data", NULL, NULL, run_load, NULL},
+	{"exif_loader_write_file", setup_file, NULL, run_loader, NULL},
+	{"exif_data_save_data", NULL, prepare_data, run_save, finish_data},
+	{"exif_data_save_data/again", setup_saved, NULL, run_save, NULL},
+	{"exif_entry_get_value", setup_data, NULL, run_get_value, NULL},
+	{"exif_data_set_byte_order", setup_data, NULL, run_set_byte_order, NULL},
+	{"exif_mnote_data_load", setup_mnote, NULL, run_mnote_load, NULL},
+	{"exif_mnote_data_get_value", setup_mnote, NULL, run_mnote_get_value, NULL},
+	{"exif_mnote_data_huawei_get_value_from_data", setup_huawei, NULL,
+	 run_huawei_get_value_from_data, NULL}
+};
+
+static void
+bench_case (const BenchCase *c, const BenchSample *sample, ExifMem *mem,
+	    double min_time)
+{
+	BenchState s;
+	unsigned long allocs = 0, bytes = 0, ops = 0, a, b;
+	double ns = 0, t;
+
+	memset (&s, 0, sizeof (s));
+	s.sample = sample;
+	s.mem = mem;
+	if (c->setup && !c->setup (&s)) {
+		exif_data_unref (s.data);
+		return;
+	}
+	while (!ops || (ns < min_time)) {
+		if (c->prepare)
+			c->prepare (&s);
+		a = bench_allocs;
+		b = bench_bytes;
+		t = bench_now ();
+		ops += c->run (&s);
+		ns += bench_now () - t;
+		allocs += bench_allocs - a;
+		bytes += bench_bytes - b;
+		if (c->finish)
+			c->finish (&s);
+		if (!ops)
+			break;
+	}
+	exif_data_unref (s.data);
+	if (!ops)
+		return;
+
+	printf ("%-44s %-34s %12.1f %10.1f %10.1f\n", c->name, sample->name,
+		ns / ops, (double) allocs / ops, (double) bytes / ops);
+	fflush (stdout);
+}
+
+/*! Read the EXIF data of a file into a sample.
+ *  \return 1 on success, 0 if the file has no EXIF data */
+static int
+sample_from_file (BenchSample *sample, const char *path)
+{
+	ExifLoader *l = exif_loader_new ();
+	const unsigned char *d;
+	unsigned int ds;
+	const char *name = strrchr (path, '/');
+
+	exif_loader_write_file (l, path);
+	exif_loader_get_buf (l, &d, &ds);
+	if (!d || (ds < 6) || memcmp (d, "Exif\0\0", 6)) {
+		exif_loader_unref (l);
+		return 0;
+	}
+	sample->d = malloc (ds);
+	if (sample->d)
+		memcpy (sample->d, d, ds);
+	sample->ds = ds;
+	exif_loader_unref (l);
+
+	snprintf (sample->name, sizeof (sample->name), "%s",
+		  name ? name + 1 : path);
+	sample->path = path;
+	return sample->d != NULL;
+}
+
+static unsigned char *
+huawei_put_entry (unsigned char *p, ExifByteOrder o, ExifShort tag,
+		  ExifShort format, ExifLong components, ExifLong value)
+{
+	exif_set_short (p, o, tag);
+	exif_set_short (p + 2, o, format);
+	exif_set_long (p + 4, o, components);
+	exif_set_long (p + 8, o, value);
+	return p + 12;
+}
+
+#define HUAWEI_NOTE_SIZE 170
+
+/*! Write a Huawei MakerNote with a scene and a face sub-IFD. Offsets in
+ *  it are relative to its byte order mark, so it can go anywhere.
+ *  \param[out] m buffer of HUAWEI_NOTE_SIZE bytes */
+static void
+huawei_note (unsigned char *m, ExifByteOrder o)
+{
+	unsigned char *b = m + 8, *p;
+
+	memset (m, 0, HUAWEI_NOTE_SIZE);
+	memcpy (m, "HUAWEI\0\0", 8);
+	memcpy (b, (o == EXIF_BYTE_ORDER_INTEL) ? "II" : "MM", 2);
+	exif_set_short (b + 2, o, 0x002a);
+	exif_set_long (b + 4, o, 8);
+
+	/* Main IFD at 8, 5 entries */
+	exif_set_short (b + 8, o, 5);
+	p = huawei_put_entry (b + 10, o, MNOTE_HUAWEI_CAPTURE_MODE, EXIF_FORMAT_LONG, 1, 1);
+	p = huawei_put_entry (p, o, MNOTE_HUAWEI_BURST_NUMBER, EXIF_FORMAT_LONG, 1, 4);
+	p = huawei_put_entry (p, o, MNOTE_HUAWEI_FRONT_CAMERA, EXIF_FORMAT_LONG, 1, 0);
+	p = huawei_put_entry (p, o, MNOTE_HUAWEI_SCENE_INFO, EXIF_FORMAT_LONG, 1, 74);
+	huawei_put_entry (p, o, MNOTE_HUAWEI_FACE_INFO, EXIF_FORMAT_LONG, 1, 112);
+
+	/* Scene IFD at 74, 2 entries and 8 bytes of data at 104 */
+	exif_set_short (b + 74, o, 2);
+	p = huawei_put_entry (b + 76, o, MNOTE_HUAWEI_SCENE_VERSION, EXIF_FORMAT_LONG, 1, 1);
+	huawei_put_entry (p, o, MNOTE_HUAWEI_SCENE_FOOD_CONF, EXIF_FORMAT_LONG, 2, 104);
+	exif_set_long (b + 104, o, 80);
+	exif_set_long (b + 108, o, 90);
+
+	/* Face IFD at 112, 3 entries and 8 bytes of data at 154 */
+	exif_set_short (b + 112, o, 3);
+	p = huawei_put_entry (b + 114, o, MNOTE_HUAWEI_FACE_VERSION, EXIF_FORMAT_LONG, 1, 1);
+	p = huawei_put_entry (p, o, MNOTE_HUAWEI_FACE_COUNT, EXIF_FORMAT_LONG, 1, 1);
+	huawei_put_entry (p, o, MNOTE_HUAWEI_FACE_CONF, EXIF_FORMAT_UNDEFINED, 8, 154);
+	memcpy (b + 154, "\x10\x20\x30\x40\x50\x60\x70\x80", 8);
+}
+
+/*! Generate a sample holding every tag libexif can initialize, in each
+ *  IFD the specification records it in.
+ *  \param[in] huawei whether to add a Huawei MakerNote
+ *  \return 1 on success, 0 otherwise */
+static int
+sample_generate (BenchSample *sample, ExifByteOrder o, int huawei)
+{
+	static const ExifIfd ifds[] = {
+		EXIF_IFD_0, EXIF_IFD_EXIF, EXIF_IFD_GPS, EXIF_IFD_INTEROPERABILITY
+	};
+	ExifData *data = exif_data_new ();
+	ExifEntry *e;
+	ExifTag tag;
+	unsigned int i, j, n = exif_tag_table_count ();
+
+	if (!data)
+		return 0;
+	exif_data_set_byte_order (data, o);
+	for (i = 0; i < n; i++) {
+		tag = exif_tag_table_get_tag (i);
+
+		/* Written by libexif itself */
+		if ((tag == EXIF_TAG_EXIF_IFD_POINTER) ||
+		    (tag == EXIF_TAG_GPS_INFO_IFD_POINTER) ||
+		    (tag == EXIF_TAG_INTEROPERABILITY_IFD_POINTER) ||
+		    (tag == EXIF_TAG_JPEG_INTERCHANGE_FORMAT) ||
+		    (tag == EXIF_TAG_JPEG_INTERCHANGE_FORMAT_LENGTH))
+			continue;
+		for (j = 0; j < sizeof (ifds) / sizeof (ifds[0]); j++) {
+			if (exif_tag_get_support_level_in_ifd (tag, ifds[j],
+				EXIF_DATA_TYPE_COMPRESSED) == EXIF_SUPPORT_LEVEL_NOT_RECORDED ||
+			    exif_content_get_entry (data->ifd[ifds[j]], tag))
+				continue;
+			e = exif_entry_new ();
+			if (!e)
+				continue;
+			exif_content_add_entry (data->ifd[ifds[j]], e);
+			exif_entry_initialize (e, tag);
+			if (!e->data)
+				exif_content_remove_entry (data->ifd[ifds[j]], e);
+			exif_entry_unref (e);
+		}
+	}
+	if (huawei) {
+		ExifMem *mem = exif_mem_new_default ();
+
+		e = exif_entry_new_mem (mem);
+		if (e) {
+			e->data = exif_mem_alloc (mem, HUAWEI_NOTE_SIZE);
+			if (e->data) {
+				huawei_note (e->data, o);
+				e->tag = EXIF_TAG_MAKER_NOTE;
+				e->format = EXIF_FORMAT_UNDEFINED;
+				e->components = e->size = HUAWEI_NOTE_SIZE;
+				exif_content_remove_entry (data->ifd[EXIF_IFD_EXIF],
+					exif_content_get_entry (data->ifd[EXIF_IFD_EXIF],
+								EXIF_TAG_MAKER_NOTE));
+				exif_content_add_entry (data->ifd[EXIF_IFD_EXIF], e);
+			}
+			exif_entry_unref (e);
+		}
+		exif_mem_unref (mem);
+	}
+	exif_data_save_data (data, &sample->d, &sample->ds);
+	exif_data_unref (data);
+
+	snprintf (sample->name, sizeof (sample->name), "generated/%s%s",
+		  exif_byte_order_get_name (o), huawei ? "/Huawei" : "");
+	sample->path = NULL;
+	return sample->d != NULL;
+}
+
+static ExifMnoteData *
+mnote_olympus_new (ExifMem *mem, ExifDataOption UNUSED(o))
+{
+	return exif_mnote_data_olympus_new (mem);
+}
+
+static ExifMnoteData *
+mnote_fuji_new (ExifMem *mem, ExifDataOption UNUSED(o))
+{
+	return exif_mnote_data_fuji_new (mem);
+}
+
+static ExifMnoteData *
+mnote_pentax_new (ExifMem *mem, ExifDataOption UNUSED(o))
+{
+	return exif_mnote_data_pentax_new (mem);
+}
+
+/* Built-in parsers only take HUAWEI MakerNotes, so add the others */
+static const ExifMnoteDataVendor vendors[] = {
+	{"Olympus", (const unsigned char *) "OLYMP", 5, NULL,
+	 exif_mnote_data_olympus_identify, mnote_olympus_new},
+	{"Olympus", (const unsigned char *) "Nikon", 5, NULL,
+	 exif_mnote_data_olympus_identify, mnote_olympus_new},
+	{"Canon", NULL, 0, "Canon", NULL, exif_mnote_data_canon_new},
+	{"Fuji", (const unsigned char *) "FUJIFILM", 8, NULL,
+	 exif_mnote_data_fuji_identify, mnote_fuji_new},
+	{"Pentax", (const unsigned char *) "AOC", 4, NULL,
+	 exif_mnote_data_pentax_identify, mnote_pentax_new},
+	{"Pentax", (const unsigned char *) "QVC", 4, NULL,
+	 exif_mnote_data_pentax_identify, mnote_pentax_new},
+	{"Pentax", (const unsigned char *) "\0\x1b", 2, NULL,
+	 exif_mnote_data_pentax_identify, mnote_pentax_new}
+};
+
+#define MAX_SAMPLES 64
+
+int
+main (int argc, char **argv)
+{
+	const char *srcdir = getenv ("srcdir"), *filter = NULL;
+	static char paths[sizeof (files) / sizeof (files[0])][1024];
+	BenchSample samples[MAX_SAMPLES];
+	unsigned int i, j, n = 0;
+	double min_time = 0.2;
+	ExifMem *mem;
+	int a;
+
+	for (a = 1; (a < argc) && (argv[a][0] == '-'); a++) {
+		if (!strcmp (argv[a], "-t") && (a + 1 < argc))
+			min_time = atof (argv[++a]);
+		else if (!strcmp (argv[a], "-f") && (a + 1 < argc))
+			filter = argv[++a];
+		else {
+			fprintf (stderr, "Usage: %s [-t seconds] [-f filter] "
+				 "[file ...]\n", argv[0]);
+			return 1;
+		}
+	}
+	min_time *= 1e9;
+
+	for (i = 0; i < sizeof (vendors) / sizeof (vendors[0]); i++)
+		exif_data_register_mnote_vendor (&vendors[i]);
+
+	if (a < argc) {
+		for (; (a < argc) && (n < MAX_SAMPLES); a++)
+			if (sample_from_file (&samples[n], argv[a]))
+				n++;
+			else
+				fprintf (stderr, "%s: no EXIF data\n", argv[a]);
+	} else {
+		if (!srcdir)
+			srcdir = ".";
+		for (i = 0; i < sizeof (files) / sizeof (files[0]); i++) {
+			snprintf (paths[i], sizeof (paths[i]),
+				  "%s/../test/testdata/%s", srcdir, files[i]);
+			if (sample_from_file (&samples[n], paths[i]))
+				n++;
+			else
+				fprintf (stderr, "%s: no EXIF data\n", paths[i]);
+		}
+		for (i = 0; i < 4; i++)
+			if (sample_generate (&samples[n], (i & 1) ?
+					     EXIF_BYTE_ORDER_MOTOROLA : EXIF_BYTE_ORDER_INTEL,
+					     i >> 1))
+				n++;
+	}
+	if (!n) {
+		fprintf (stderr, "No samples\n");
+		return 1;
+	}
+
+	mem = exif_mem_new (bench_alloc, bench_realloc, bench_free);
+	if (!mem)
+		return 1;
+	printf ("%-44s %-34s %12s %10s %10s\n", "case", "sample", "ns/op",
+		"allocs/op", "bytes/op");
+	for (i = 0; i < sizeof (cases) / sizeof (cases[0]); i++)
+		for (j = 0; j < n; j++)
+			if (!filter || strstr (cases[i].name, filter) ||
+			    strstr (samples[j].name, filter))
+				bench_case (&cases[i], &samples[j], mem, min_time);
+	exif_mem_unref (mem);
+
+	for (j = 0; j < n; j++)
+		free (samples[j].d);
+	return 0;
+}
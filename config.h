@@ -5,6 +5,9 @@
    language is requested. */
 #define ENABLE_NLS 1
 
+/* Define to 1 to update reference counts without atomic operations. */
+/* #undef EXIF_DISABLE_ATOMIC_REFCOUNT */
+
 /* Define if the GNU dcgettext() function is already present or preinstalled.
    */
 #define HAVE_DCGETTEXT 1
@@ -27,6 +30,18 @@
 /* Define to 1 if you have the <memory.h> header file. */
 #define HAVE_MEMORY_H 1
 
+/* Define to 1 if you have the 'pread' function. */
+/* #undef HAVE_PREAD */
+
+/* Define to 1 if you have the <pthread.h> header file. */
+/* #undef HAVE_PTHREAD_H */
+
+/* Define to 1 if you have the 'pthread_once' function. */
+/* #undef HAVE_PTHREAD_ONCE */
+
+/* Define to 1 if you have the 'sendfile' function. */
+/* #undef HAVE_SENDFILE */
+
 /* Define to 1 if you have the <stdint.h> header file. */
 #define HAVE_STDINT_H 1
 
@@ -39,6 +54,9 @@
 /* Define to 1 if you have the <string.h> header file. */
 #define HAVE_STRING_H 1
 
+/* Define to 1 if you have the <sys/sendfile.h> header file. */
+/* #undef HAVE_SYS_SENDFILE_H */
+
 /* Define to 1 if you have the <sys/stat.h> header file. */
 #define HAVE_SYS_STAT_H 1
 
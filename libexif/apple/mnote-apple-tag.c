@@ -21,6 +21,7 @@
 #include <config.h>
 #include "mnote-apple-tag.h"
 
+#include <libexif/exif-library.h>
 #include <libexif/i18n.h>
 #include <libexif/exif-utils.h>
 
@@ -61,7 +62,7 @@ const char *
 mnote_apple_tag_get_title(MnoteAppleTag t) {
     unsigned int i;
 
-    (void) bindtextdomain(GETTEXT_PACKAGE, LOCALEDIR);
+    exif_library_init();
     for (i = 0; i < sizeof (table) / sizeof (table[0]); i++) {
         if (table[i].tag == t) {
             return _(table[i].title);
@@ -80,7 +81,7 @@ mnote_apple_tag_get_description(MnoteAppleTag t) {
             if (!table[i].description || !*table[i].description) {
                 return "";
             }
-            (void) bindtextdomain(GETTEXT_PACKAGE, LOCALEDIR);
+            exif_library_init();
             return _(table[i].description);
         }
     }
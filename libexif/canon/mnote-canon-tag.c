@@ -25,6 +25,7 @@
 
 #include <stdlib.h>
 
+#include <libexif/exif-library.h>
 #include <libexif/i18n.h>
 
 static const struct {
@@ -241,7 +242,7 @@ mnote_canon_tag_get_title (MnoteCanonTag t)
 {
 	unsigned int i;
 
-	(void) bindtextdomain (GETTEXT_PACKAGE, LOCALEDIR);
+	exif_library_init ();
 	for (i = 0; i < sizeof (table) / sizeof (table[0]); i++)
 		if (table[i].tag == t) {
 			if (!table[i].title)
@@ -282,7 +283,7 @@ mnote_canon_tag_get_description (MnoteCanonTag t)
 		if (table[i].tag == t) {
 			if (!table[i].description || !*table[i].description)
 				return "";
-			(void) bindtextdomain (GETTEXT_PACKAGE, LOCALEDIR);
+			exif_library_init ();
 			return _(table[i].description);
 		}
 	return NULL;
@@ -0,0 +1,371 @@
+/* exif-batch.c
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#include <config.h>
+
+#include <libexif/exif-batch.h>
+#include <libexif/exif-data-priv.h>
+#include <libexif/exif-format.h>
+#include <libexif/exif-log.h>
+#include <libexif/exif-mem.h>
+#include <libexif/exif-utils.h>
+
+#include <string.h>
+
+#define CHECKOVERFLOW(offset,datasize,structsize) (( (offset) >= (datasize)) || ((structsize) > (datasize)) || ((offset) > (datasize) - (structsize) ))
+
+/* Tag numbers of GPS and Interoperability tags overlap, so the order of
+ * the IFDs a tag is looked up in matters. */
+static const ExifIfd ExifBatchIfds[] = {
+	EXIF_IFD_0, EXIF_IFD_EXIF, EXIF_IFD_GPS, EXIF_IFD_INTEROPERABILITY,
+	EXIF_IFD_1
+};
+
+typedef struct {
+	ExifMem *mem;
+	ExifColumnOut *out;
+	unsigned int m;
+
+	/* Allocated size of the characters of each column */
+	unsigned int *capacity;
+	int ok;
+
+	/* The image being looked at, starting with the TIFF header */
+	unsigned int row;
+	const unsigned char *d;
+	unsigned int ds;
+	ExifByteOrder order;
+	unsigned int seen;
+} ExifBatch;
+
+static ExifColumnType
+exif_batch_type (ExifFormat f)
+{
+	switch (f) {
+	case EXIF_FORMAT_BYTE:
+	case EXIF_FORMAT_SBYTE:
+	case EXIF_FORMAT_SHORT:
+	case EXIF_FORMAT_SSHORT:
+	case EXIF_FORMAT_LONG:
+	case EXIF_FORMAT_SLONG:
+		return EXIF_COLUMN_TYPE_INT64;
+	case EXIF_FORMAT_RATIONAL:
+	case EXIF_FORMAT_SRATIONAL:
+	case EXIF_FORMAT_FLOAT:
+	case EXIF_FORMAT_DOUBLE:
+		return EXIF_COLUMN_TYPE_DOUBLE;
+	case EXIF_FORMAT_ASCII:
+	case EXIF_FORMAT_UNDEFINED:
+		return EXIF_COLUMN_TYPE_STRING;
+	default:
+		return EXIF_COLUMN_TYPE_NONE;
+	}
+}
+
+/*! Allocate the values of a column once its type is known. All rows so
+ *  far are null, and empty as far as the offsets are concerned. */
+static int
+exif_batch_alloc_values (ExifBatch *b, ExifColumnOut *c, ExifColumnType t)
+{
+	switch (t) {
+	case EXIF_COLUMN_TYPE_INT64:
+		c->ints = exif_mem_alloc (b->mem, sizeof (int64_t) * c->length);
+		if (!c->ints)
+			return 0;
+		break;
+	case EXIF_COLUMN_TYPE_DOUBLE:
+		c->doubles = exif_mem_alloc (b->mem, sizeof (double) * c->length);
+		if (!c->doubles)
+			return 0;
+		break;
+	case EXIF_COLUMN_TYPE_STRING:
+		c->offsets = exif_mem_alloc (b->mem,
+					     sizeof (uint32_t) * (c->length + 1));
+		if (!c->offsets)
+			return 0;
+		break;
+	default:
+		return 0;
+	}
+	c->type = t;
+	return 1;
+}
+
+static int
+exif_batch_append (ExifBatch *b, unsigned int j, const unsigned char *v,
+		   unsigned int size)
+{
+	ExifColumnOut *c = &b->out[j];
+	unsigned int l = b->capacity[j];
+	unsigned char *t;
+
+	if (size > 0xffffffff - c->chars_size)
+		return 0;
+	if (c->chars_size + size > l) {
+		if (!l)
+			l = 256;
+		while (l < c->chars_size + size)
+			l = (l > 0x7fffffff) ? c->chars_size + size : l * 2;
+		t = exif_mem_realloc (b->mem, c->chars, l);
+		if (!t)
+			return 0;
+		c->chars = t;
+		b->capacity[j] = l;
+	}
+	memcpy (c->chars + c->chars_size, v, size);
+	c->chars_size += size;
+	return 1;
+}
+
+/*! Store the first component of a value in row b->row of column j */
+static void
+exif_batch_store (ExifBatch *b, unsigned int j, ExifFormat f,
+		  const unsigned char *v, unsigned int size)
+{
+	ExifColumnOut *c = &b->out[j];
+	ExifColumnType t = exif_batch_type (f);
+	ExifRational r;
+	ExifSRational sr;
+
+	/* The first entry with the tag wins */
+	if (c->validity[b->row / 8] & (1 << (b->row % 8)))
+		return;
+	if (c->type == EXIF_COLUMN_TYPE_NONE && t != EXIF_COLUMN_TYPE_NONE &&
+	    !exif_batch_alloc_values (b, c, t)) {
+		b->ok = 0;
+		return;
+	}
+	if (t != c->type || (t != EXIF_COLUMN_TYPE_STRING && !size))
+		return;
+
+	switch (f) {
+	case EXIF_FORMAT_BYTE:
+		c->ints[b->row] = v[0];
+		break;
+	case EXIF_FORMAT_SBYTE:
+		c->ints[b->row] = (signed char) v[0];
+		break;
+	case EXIF_FORMAT_SHORT:
+		c->ints[b->row] = exif_get_short (v, b->order);
+		break;
+	case EXIF_FORMAT_SSHORT:
+		c->ints[b->row] = exif_get_sshort (v, b->order);
+		break;
+	case EXIF_FORMAT_LONG:
+		c->ints[b->row] = exif_get_long (v, b->order);
+		break;
+	case EXIF_FORMAT_SLONG:
+		c->ints[b->row] = exif_get_slong (v, b->order);
+		break;
+	case EXIF_FORMAT_RATIONAL:
+		r = exif_get_rational (v, b->order);
+		if (!r.denominator)
+			return;
+		c->doubles[b->row] = (double) r.numerator / r.denominator;
+		break;
+	case EXIF_FORMAT_SRATIONAL:
+		sr = exif_get_srational (v, b->order);
+		if (!sr.denominator)
+			return;
+		c->doubles[b->row] = (double) sr.numerator / sr.denominator;
+		break;
+	case EXIF_FORMAT_FLOAT:
+		c->doubles[b->row] = exif_get_float (v, b->order);
+		break;
+	case EXIF_FORMAT_DOUBLE:
+		c->doubles[b->row] = exif_get_double (v, b->order);
+		break;
+	case EXIF_FORMAT_ASCII:
+		if (size && memchr (v, 0, size))
+			size = (const unsigned char *) memchr (v, 0, size) - v;
+		/* fallthrough */
+	default:
+		if (!exif_batch_append (b, j, v, size)) {
+			b->ok = 0;
+			return;
+		}
+		break;
+	}
+	c->validity[b->row / 8] |= 1 << (b->row % 8);
+	c->null_count--;
+}
+
+static void
+exif_batch_load_ifd (ExifBatch *b, ExifIfd ifd, unsigned int offset)
+{
+	const unsigned char *e;
+	unsigned int n, i, j, size, doff;
+	ExifTag tag;
+
+	/* Each IFD is looked at once, which also stops loops */
+	if (b->seen & (1 << ifd))
+		return;
+	b->seen |= 1 << ifd;
+
+	if (CHECKOVERFLOW (offset, b->ds, 2))
+		return;
+	n = exif_get_short (b->d + offset, b->order);
+	offset += 2;
+	if (CHECKOVERFLOW (offset, b->ds, 12 * n))
+		n = (b->ds - offset) / 12;
+
+	for (i = 0; i < n && b->ok; i++) {
+		e = b->d + offset + 12 * i;
+		tag = exif_get_short (e, b->order);
+		switch (tag) {
+		case EXIF_TAG_EXIF_IFD_POINTER:
+			exif_batch_load_ifd (b, EXIF_IFD_EXIF,
+					     exif_get_long (e + 8, b->order));
+			continue;
+		case EXIF_TAG_GPS_INFO_IFD_POINTER:
+			exif_batch_load_ifd (b, EXIF_IFD_GPS,
+					     exif_get_long (e + 8, b->order));
+			continue;
+		case EXIF_TAG_INTEROPERABILITY_IFD_POINTER:
+			exif_batch_load_ifd (b, EXIF_IFD_INTEROPERABILITY,
+					     exif_get_long (e + 8, b->order));
+			continue;
+		default:
+			break;
+		}
+
+		for (j = 0; j < b->m; j++) {
+			if (b->out[j].tag != tag ||
+			    (b->out[j].ifd != EXIF_IFD_COUNT && b->out[j].ifd != ifd))
+				continue;
+			if (!exif_data_get_entry_value (e, b->order,
+					offset + 12 * i, b->ds, &doff, &size))
+				break;
+			exif_batch_store (b, j, exif_get_short (e + 2, b->order),
+					  b->d + doff, size);
+		}
+	}
+
+	/* IFD 1 follows IFD 0 */
+	if (ifd == EXIF_IFD_0 && !CHECKOVERFLOW (offset + 12 * n, b->ds, 4))
+		exif_batch_load_ifd (b, EXIF_IFD_1,
+				     exif_get_long (b->d + offset + 12 * n, b->order));
+}
+
+static void
+exif_batch_load (ExifBatch *b, const unsigned char *d, unsigned int ds)
+{
+	d = exif_data_find_exif_header (NULL, d, &ds);
+	if (!d || ds < 14)
+		return;
+
+	/* Offsets are relative to the TIFF header, which follows the EXIF
+	 * header. As in exif_data_load_data, APP1 can be no longer than
+	 * 64 KiB. */
+	d += 6;
+	ds -= 6;
+	if (ds > 0xfffe)
+		ds = 0xfffe;
+	if (!memcmp (d, "II", 2))
+		b->order = EXIF_BYTE_ORDER_INTEL;
+	else if (!memcmp (d, "MM", 2))
+		b->order = EXIF_BYTE_ORDER_MOTOROLA;
+	else
+		return;
+	if (exif_get_short (d + 2, b->order) != 0x002a)
+		return;
+
+	b->d = d;
+	b->ds = ds;
+	b->seen = 0;
+	exif_batch_load_ifd (b, EXIF_IFD_0, exif_get_long (d + 4, b->order));
+}
+
+int
+exif_batch_extract_columns (const unsigned char * const *buffers,
+			    const unsigned int *sizes, unsigned int n,
+			    const ExifTag *columns, unsigned int m,
+			    ExifColumnOut *out)
+{
+	ExifBatch b;
+	unsigned int i, j, k;
+
+	if (!out || (m && !columns) || (n && (!buffers || !sizes)) ||
+	    n > 0xffffffff / sizeof (double) - 1)
+		return 0;
+	memset (&b, 0, sizeof (b));
+	memset (out, 0, sizeof (ExifColumnOut) * m);
+	b.mem = exif_mem_new_default ();
+	if (!b.mem)
+		return 0;
+	b.out = out;
+	b.m = m;
+	b.ok = 1;
+	b.capacity = exif_mem_alloc (b.mem, sizeof (unsigned int) * (m ? m : 1));
+	if (!b.capacity)
+		b.ok = 0;
+
+	for (j = 0; j < m && b.ok; j++) {
+		out[j].tag = columns[j];
+		out[j].ifd = EXIF_IFD_COUNT;
+		for (k = 0; k < sizeof (ExifBatchIfds) / sizeof (ExifBatchIfds[0]); k++)
+			if (exif_tag_get_name_in_ifd (columns[j], ExifBatchIfds[k])) {
+				out[j].ifd = ExifBatchIfds[k];
+				break;
+			}
+		out[j].length = n;
+		out[j].null_count = n;
+		out[j].validity = exif_mem_alloc (b.mem, (n + 7) / 8 ? (n + 7) / 8 : 1);
+		if (!out[j].validity)
+			b.ok = 0;
+	}
+
+	for (i = 0; i < n && b.ok; i++) {
+		b.row = i;
+		if (buffers[i])
+			exif_batch_load (&b, buffers[i], sizes[i]);
+		for (j = 0; j < m; j++)
+			if (out[j].type == EXIF_COLUMN_TYPE_STRING)
+				out[j].offsets[i + 1] = out[j].chars_size;
+	}
+
+	exif_mem_free (b.mem, b.capacity);
+	exif_mem_unref (b.mem);
+	if (!b.ok) {
+		exif_batch_free_columns (out, m);
+		return 0;
+	}
+	return 1;
+}
+
+void
+exif_batch_free_columns (ExifColumnOut *out, unsigned int m)
+{
+	ExifMem *mem;
+	unsigned int j;
+
+	if (!out)
+		return;
+	mem = exif_mem_new_default ();
+	for (j = 0; j < m; j++) {
+		exif_mem_free (mem, out[j].ints);
+		exif_mem_free (mem, out[j].doubles);
+		exif_mem_free (mem, out[j].offsets);
+		exif_mem_free (mem, out[j].chars);
+		exif_mem_free (mem, out[j].validity);
+		memset (&out[j], 0, sizeof (ExifColumnOut));
+	}
+	exif_mem_unref (mem);
+}
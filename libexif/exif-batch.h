@@ -0,0 +1,124 @@
+/*! \file exif-batch.h
+ * \brief Extract selected tags of many images into columns
+ */
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#ifndef LIBEXIF_EXIF_BATCH_H
+#define LIBEXIF_EXIF_BATCH_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <libexif/exif-ifd.h>
+#include <libexif/exif-tag.h>
+#include <libexif/_stdint.h>
+
+/*! Type of the values of a column */
+typedef enum {
+	/*! No image had a value for the tag; all rows are null */
+	EXIF_COLUMN_TYPE_NONE = 0,
+
+	/*! BYTE, SHORT and LONG values and their signed variants */
+	EXIF_COLUMN_TYPE_INT64,
+
+	/*! RATIONAL, SRATIONAL, FLOAT and DOUBLE values */
+	EXIF_COLUMN_TYPE_DOUBLE,
+
+	/*! ASCII values, up to the first NUL, and UNDEFINED values as
+	 *  they are */
+	EXIF_COLUMN_TYPE_STRING
+} ExifColumnType;
+
+/*! Values of one tag for all images of a batch, one row per image.
+ *
+ * The layout follows the Apache Arrow columnar format, so the arrays can
+ * be handed to Arrow or Parquet writers without copying: one array of
+ * values for numbers, or an array of n + 1 offsets into one array of
+ * characters for strings, and a validity bitmap.
+ */
+typedef struct {
+	/*! Tag and the IFD it was looked for in */
+	ExifTag tag;
+	ExifIfd ifd;
+
+	/*! Type of the values, set by the format of the first value found */
+	ExifColumnType type;
+
+	/*! Number of rows */
+	unsigned int length;
+
+	/*! Values for #EXIF_COLUMN_TYPE_INT64 and #EXIF_COLUMN_TYPE_DOUBLE;
+	 *  null rows hold 0 */
+	int64_t *ints;
+	double *doubles;
+
+	/*! Row i of a #EXIF_COLUMN_TYPE_STRING column is made of the bytes
+	 *  from offsets[i] to offsets[i + 1] of chars, not NUL-terminated */
+	uint32_t *offsets;
+	unsigned char *chars;
+	unsigned int chars_size;
+
+	/*! Bit i (least significant bit first) is set if row i has a value */
+	unsigned char *validity;
+	unsigned int null_count;
+} ExifColumnOut;
+
+/*! Extract the values of some tags from many images into columns.
+ *
+ * Each buffer holds EXIF data as accepted by #exif_data_load_data, the
+ * APP1 segment of a JPEG file or the whole file. The IFDs are walked in
+ * place: no #ExifData is created and nothing is allocated per image.
+ * A tag is looked for in the first of IFD 0, the EXIF, GPS,
+ * Interoperability and IFD 1 that defines it, an unknown tag in all of
+ * them; so GPS tags take precedence over the Interoperability tags with
+ * the same numbers. Of values with several components, only the first is
+ * taken. Values whose format does not fit the type of their column, empty
+ * values, rationals with a denominator of 0 and images without EXIF data
+ * give null rows.
+ *
+ * The arrays are allocated with the default memory allocator and freed
+ * with #exif_batch_free_columns.
+ *
+ * \param[in] buffers n buffers with EXIF data; NULL entries give null rows
+ * \param[in] sizes size of each buffer
+ * \param[in] n number of buffers
+ * \param[in] columns m tags to extract
+ * \param[in] m number of tags
+ * \param[out] out m columns, one per tag
+ * \return 1 on success, 0 on error, in which case nothing is allocated
+ */
+int exif_batch_extract_columns (const unsigned char * const *buffers,
+				const unsigned int *sizes, unsigned int n,
+				const ExifTag *columns, unsigned int m,
+				ExifColumnOut *out);
+
+/*! Free the arrays of columns filled by #exif_batch_extract_columns.
+ *
+ * \param[in] out columns
+ * \param[in] m number of columns
+ */
+void exif_batch_free_columns (ExifColumnOut *out, unsigned int m);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* !defined(LIBEXIF_EXIF_BATCH_H) */
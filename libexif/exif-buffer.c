@@ -0,0 +1,80 @@
+/* exif-buffer.c
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#include <config.h>
+
+#include <libexif/exif-buffer.h>
+
+#include <stdlib.h>
+
+ExifBuffer *
+exif_buffer_new (ExifMem *mem, unsigned char *data, unsigned int size)
+{
+	ExifBuffer *buf;
+
+	if (!data)
+		return NULL;
+	buf = exif_mem_alloc (mem, sizeof (ExifBuffer));
+	if (!buf)
+		return NULL;
+	exif_refcount_init (&buf->ref_count, 1);
+	buf->mem = mem;
+	exif_mem_ref (mem);
+	buf->data = data;
+	buf->size = size;
+
+	return buf;
+}
+
+void
+exif_buffer_ref (ExifBuffer *buf)
+{
+	if (!buf)
+		return;
+
+	exif_refcount_inc (&buf->ref_count);
+}
+
+void
+exif_buffer_unref (ExifBuffer *buf)
+{
+	ExifMem *mem;
+
+	if (!buf)
+		return;
+
+	if (exif_refcount_dec (&buf->ref_count))
+		return;
+
+	mem = buf->mem;
+	exif_mem_free (mem, buf->data);
+	exif_mem_free (mem, buf);
+	exif_mem_unref (mem);
+}
+
+int
+exif_buffer_contains (const ExifBuffer *buf, const void *p)
+{
+	const unsigned char *c = p;
+
+	if (!buf || !c)
+		return 0;
+	return (c >= buf->data) && (c < buf->data + buf->size);
+}
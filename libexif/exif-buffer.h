@@ -0,0 +1,75 @@
+/* exif-buffer.h
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+/*
+ * Reference counted block of raw EXIF data. Entries and the thumbnail of
+ * an ExifData may point into such a block instead of owning a copy of
+ * their bytes. This header is internal to libexif and is not installed.
+ */
+
+#ifndef LIBEXIF_EXIF_BUFFER_H
+#define LIBEXIF_EXIF_BUFFER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <libexif/exif-entry.h>
+#include <libexif/exif-mem.h>
+#include <libexif/exif-refcount.h>
+
+typedef struct _ExifBuffer ExifBuffer;
+struct _ExifBuffer
+{
+	ExifRefCount ref_count;
+
+	ExifMem *mem;
+
+	unsigned char *data;
+	unsigned int size;
+};
+
+/*! Wrap a block of memory. On success the buffer takes ownership of
+ *  \a data, which must have been allocated from \a mem.
+ *
+ * \return new buffer, or NULL if out of memory
+ */
+ExifBuffer *exif_buffer_new   (ExifMem *mem, unsigned char *data,
+			       unsigned int size);
+void        exif_buffer_ref   (ExifBuffer *buf);
+void        exif_buffer_unref (ExifBuffer *buf);
+
+/*! Check whether \a p points into the buffer. NULL buffers contain nothing.
+ *
+ * \return 1 if \a p lies within the buffer, 0 otherwise
+ */
+int         exif_buffer_contains (const ExifBuffer *buf, const void *p);
+
+/*! Keep \a buf alive for as long as the entry may borrow from it. */
+void exif_entry_set_buffer (ExifEntry *e, ExifBuffer *buf);
+
+/*! Release the entry's data unless it is borrowed, and set it to NULL. */
+void exif_entry_free_data  (ExifEntry *e);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* !defined(LIBEXIF_EXIF_BUFFER_H) */
@@ -0,0 +1,44 @@
+/* exif-content-priv.h
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#ifndef LIBEXIF_EXIF_CONTENT_PRIV_H
+#define LIBEXIF_EXIF_CONTENT_PRIV_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <libexif/exif-content.h>
+
+/*! Move an entry of \a c to where its tag belongs, after its tag changed */
+void exif_content_sort_entry (ExifContent *c, ExifEntry *e);
+
+/*! Mark \a c as changed since the last save, or clear the mark after
+ *  saving. Adding, removing and initializing entries marks it. */
+void exif_content_set_dirty (ExifContent *c, int dirty);
+
+/*! \return 0 if \a c is marked as unchanged since the last save */
+int  exif_content_is_dirty  (ExifContent *c);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* !defined(LIBEXIF_EXIF_CONTENT_PRIV_H) */
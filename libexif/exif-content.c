@@ -23,6 +23,9 @@
 #include <config.h>
 
 #include <libexif/exif-content.h>
+#include <libexif/exif-content-priv.h>
+#include <libexif/exif-data-priv.h>
+#include <libexif/exif-refcount.h>
 #include <libexif/exif-system.h>
 
 #include <stdlib.h>
@@ -40,12 +43,19 @@ const static unsigned char FOCUS_MODE_AF_S[] = {'A', 'F', '_', 'S'};
 
 struct _ExifContentPrivate
 {
-	unsigned int ref_count;
+	ExifRefCount ref_count;
 
 	ExifMem *mem;
 	ExifLog *log;
+
+	/* Set when entries were added, removed or initialized since the
+	 * IFD was last saved */
+	int dirty;
 };
 
+/* IFDs of frozen ExifData must not change, see exif_data_freeze() */
+#define EXIF_CONTENT_FROZEN(c) ((c)->parent && exif_data_is_frozen ((c)->parent))
+
 ExifContent *
 exif_content_new (void)
 {
@@ -74,10 +84,11 @@ exif_content_new_mem (ExifMem *mem)
 		return NULL;
 	}
 
-	content->priv->ref_count = 1;
+	exif_refcount_init (&content->priv->ref_count, 1);
 
 	content->priv->mem = mem;
 	exif_mem_ref (mem);
+	content->priv->dirty = 1;
 
 	return content;
 }
@@ -88,7 +99,7 @@ exif_content_ref (ExifContent *content)
 	if (!content)
 		return;
 
-	content->priv->ref_count++;
+	exif_refcount_inc (&content->priv->ref_count);
 }
 
 void
@@ -97,8 +108,7 @@ exif_content_unref (ExifContent *content)
 	if (!content || !content->priv)
 		return;
 
-	content->priv->ref_count--;
-	if (!content->priv->ref_count)
+	if (!exif_refcount_dec (&content->priv->ref_count))
 		exif_content_free (content);
 }
 
@@ -142,11 +152,30 @@ exif_content_dump (ExifContent *content, unsigned int indent)
 		exif_entry_dump (content->entries[i], indent + 1);
 }
 
+/*! \return index of the first entry with a tag greater than \a tag */
+static unsigned int
+exif_content_position (ExifContent *c, ExifTag tag)
+{
+	unsigned int lo = 0, hi = c->count, i;
+
+	while (lo < hi) {
+		i = lo + (hi - lo) / 2;
+		if (c->entries[i]->tag <= tag)
+			lo = i + 1;
+		else
+			hi = i;
+	}
+	return lo;
+}
+
 void
 exif_content_add_entry (ExifContent *c, ExifEntry *entry)
 {
 	ExifEntry **entries;
-	if (!c || !c->priv || !entry || entry->parent) return;
+	unsigned int i;
+
+	if (!c || !c->priv || !entry || entry->parent || EXIF_CONTENT_FROZEN (c))
+		return;
 
 	/* One tag can only be added once to an IFD. */
 	if (exif_content_get_entry (c, entry->tag) && entry->tag != EXIF_TAG_MAKER_NOTE) {
@@ -167,19 +196,50 @@ exif_content_add_entry (ExifContent *c, ExifEntry *entry)
 	}
 
 	if (!entries) return;
+	exif_content_set_dirty (c, 1);
 	entry->parent = c;
-	entries[c->count++] = entry;
 	c->entries = entries;
+
+	/* Keep the entries sorted by tag, after any with the same tag */
+	i = exif_content_position (c, entry->tag);
+	memmove (&entries[i + 1], &entries[i],
+		 sizeof (ExifEntry*) * (c->count - i));
+	entries[i] = entry;
+	c->count++;
 	exif_entry_ref (entry);
 }
 
+void
+exif_content_sort_entry (ExifContent *c, ExifEntry *e)
+{
+	unsigned int i, j;
+
+	if (!c || !e || (e->parent != c))
+		return;
+
+	for (i = 0; (i < c->count) && (c->entries[i] != e); i++);
+	if (i == c->count)
+		return;
+
+	/* Take the entry out, and put it back where its tag belongs */
+	memmove (&c->entries[i], &c->entries[i + 1],
+		 sizeof (ExifEntry*) * (c->count - i - 1));
+	c->count--;
+	j = exif_content_position (c, e->tag);
+	memmove (&c->entries[j + 1], &c->entries[j],
+		 sizeof (ExifEntry*) * (c->count - j));
+	c->entries[j] = e;
+	c->count++;
+}
+
 void
 exif_content_remove_entry (ExifContent *c, ExifEntry *e)
 {
 	unsigned int i;
 	ExifEntry **t, *temp;
 
-	if (!c || !c->priv || !e || (e->parent != c)) return;
+	if (!c || !c->priv || !e || (e->parent != c) || EXIF_CONTENT_FROZEN (c))
+		return;
 
 	/* Search the entry */
 	for (i = 0; i < c->count; i++)
@@ -188,6 +248,7 @@ exif_content_remove_entry (ExifContent *c, ExifEntry *e)
 
 	if (i == c->count)
 			return;
+	exif_content_set_dirty (c, 1);
 
 	/* Remove the entry */
 	temp = c->entries[c->count-1];
@@ -217,9 +278,21 @@ exif_content_get_entry (ExifContent *content, ExifTag tag)
 {
 	unsigned int i;
 
-	if (!content)
+	if (!content || !content->count)
 		return (NULL);
 
+	/* Entries are added in tag order; find the first with this one */
+	i = exif_content_position (content, tag);
+	if (i && (content->entries[i - 1]->tag == tag)) {
+		while (i && (content->entries[i - 1]->tag == tag))
+			i--;
+		return (content->entries[i]);
+	}
+
+	/* The tag of an entry may have been set after it was added, which
+	 * leaves the entries out of order. Look at all of them then; they are
+	 * not sorted again here, as frozen data may be read from several
+	 * threads. */
 	for (i = 0; i < content->count; i++)
 		if (content->entries[i]->tag == tag)
 			return (content->entries[i]);
@@ -284,7 +357,8 @@ exif_content_foreach_entry (ExifContent *content,
 void
 exif_content_log (ExifContent *content, ExifLog *log)
 {
-	if (!content || !content->priv || !log || content->priv->log == log)
+	if (!content || !content->priv || !log || content->priv->log == log ||
+	    EXIF_CONTENT_FROZEN (content))
 		return;
 
 	if (content->priv->log) exif_log_unref (content->priv->log);
@@ -336,6 +410,25 @@ remove_not_recorded (ExifEntry *e, void *UNUSED(data))
 
 }
 
+void
+exif_content_set_dirty (ExifContent *c, int dirty)
+{
+	if (!c || !c->priv)
+		return;
+
+	c->priv->dirty = dirty;
+
+	/* Clones made from now on need the change as well */
+	if (dirty)
+		exif_data_drop_clone_cache (c->parent);
+}
+
+int
+exif_content_is_dirty (ExifContent *c)
+{
+	return !c || !c->priv || c->priv->dirty;
+}
+
 void
 exif_content_fix (ExifContent *c)
 {
@@ -344,7 +437,7 @@ exif_content_fix (ExifContent *c)
 	ExifEntry *e;
 	unsigned int i, num;
 
-	if (!c)
+	if (!c || EXIF_CONTENT_FROZEN (c))
 		return;
 
 	dt = exif_data_get_data_type (c->parent);
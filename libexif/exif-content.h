@@ -95,6 +95,9 @@ void         exif_content_free    (ExifContent *content);
 
 /*! Add an EXIF tag to an IFD.
  * If this tag already exists in the IFD, this function does nothing.
+ * The entry is inserted in tag order, which lets #exif_content_get_entry
+ * search the IFD quickly. Entries whose tag is changed later are still
+ * found, only more slowly, and are saved in tag order anyway.
  * \pre The "tag" member of the entry must be set on entry.
  *
  * \param[out] c IFD
@@ -0,0 +1,71 @@
+/* exif-data-priv.h
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#ifndef LIBEXIF_EXIF_DATA_PRIV_H
+#define LIBEXIF_EXIF_DATA_PRIV_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <libexif/exif-data.h>
+#include <libexif/exif-buffer.h>
+
+/*! Load \a data from \a buf, whose bytes the values of the entries may
+ *  then point into instead of being copied */
+void exif_data_load_buffer (ExifData *data, ExifBuffer *buf);
+
+/*! Forget the bytes serialized for #exif_data_clone, after \a data
+ *  changed */
+void exif_data_drop_clone_cache (ExifData *data);
+
+/*! Append an empty SubIFD to \a data
+ *
+ * \return the new SubIFD, owned by \a data, or NULL on error */
+ExifContent *exif_data_new_sub_ifd (ExifData *data);
+
+/*! Sort the built-in MakerNote parsers into the lookup chains, once
+ *  before any data is loaded. See #exif_library_init. */
+void exif_data_init_mnote_registry (void);
+
+/*! \return the log of \a data, which may be NULL */
+ExifLog *exif_data_get_log (ExifData *data);
+
+/*! Locate the EXIF header in \a d, which either starts with it or holds a
+ *  JPEG stream with an APP1 EXIF segment */
+const unsigned char *exif_data_find_exif_header (ExifLog *log,
+	const unsigned char *d, unsigned int *ds);
+
+/*! Find the value of the 12-byte IFD entry \a e, which starts \a offset
+ *  bytes into the \a ds bytes of the TIFF data, as loading does
+ *
+ * \param[out] doff offset of the value
+ * \param[out] size size of the value in bytes
+ * \return 1 if the value is not empty and lies within the \a ds bytes,
+ *  0 otherwise */
+int exif_data_get_entry_value (const unsigned char *e, ExifByteOrder order,
+			       unsigned int offset, unsigned int ds,
+			       unsigned int *doff, unsigned int *size);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* !defined(LIBEXIF_EXIF_DATA_PRIV_H) */
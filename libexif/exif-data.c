@@ -22,9 +22,17 @@
 
 #include <config.h>
 
+#include <libexif/exif-buffer.h>
+#include <libexif/exif-refcount.h>
+#include <libexif/exif-source-priv.h>
+#include <libexif/exif-content-priv.h>
+#include <libexif/exif-data-priv.h>
+#include <libexif/exif-jpeg-priv.h>
+#include <libexif/exif-entry-priv.h>
 #include <libexif/exif-mnote-data.h>
 #include <libexif/exif-data.h>
 #include <libexif/exif-ifd.h>
+#include <libexif/exif-library.h>
 #include <libexif/exif-mnote-data-priv.h>
 #include <libexif/exif-utils.h>
 #include <libexif/exif-loader.h>
@@ -58,6 +66,22 @@
 
 static const unsigned char ExifHeader[] = {0x45, 0x78, 0x69, 0x66, 0x00, 0x00};
 
+/* Bytes of a previous save, from which IFDs that did not change since are
+ * copied instead of being encoded again. See
+ * exif_data_save_data_content_cached(). */
+typedef struct {
+	ExifBuffer *buf;
+	ExifByteOrder order;
+
+	/* Where each IFD and the values of its entries started and ended,
+	 * relative to the TIFF header. end is 0 if the IFD was not kept. */
+	unsigned int start[EXIF_IFD_COUNT];
+	unsigned int end[EXIF_IFD_COUNT];
+
+	/* Where those bytes are in buf */
+	unsigned int pos[EXIF_IFD_COUNT];
+} ExifDataSaved;
+
 struct _ExifDataPrivate
 {
 	ExifByteOrder order;
@@ -67,15 +91,49 @@ struct _ExifDataPrivate
 	ExifLog *log;
 	ExifMem *mem;
 
-	unsigned int ref_count;
+	ExifRefCount ref_count;
 
 	/* Temporarily used while loading data */
 	unsigned int offset_mnote;
 
 	ExifDataOption options;
 	ExifDataType data_type;
+
+	/* Data handed over by exif_loader_take_data(), borrowed by entries */
+	ExifBuffer *buffer;
+
+	/* SubIFDs of a TIFF file, see exif_data_load_tiff() */
+	ExifContent **sub_ifds;
+	unsigned int sub_ifds_count;
+
+	/* Thumbnail found by the last load, relative to the data passed in.
+	 * thumbnail_base is the offset of the TIFF header in that data. */
+	unsigned int thumbnail_base;
+	unsigned int thumbnail_offset, thumbnail_size;
+
+	/* The last save, and the IFDs of the one going on */
+	ExifDataSaved saved;
+	ExifDataSaved saving;
+
+	/* Serialized copy of this ExifData, made by exif_data_clone() */
+	ExifDataSaved clone_cache;
+
+	/* Read-only since exif_data_freeze(). The values of all entries then
+	 * live in frozen_block. */
+	int frozen;
+	unsigned char *frozen_block;
 };
 
+/* Upper bound for the number of SubIFDs loaded from a TIFF file */
+#define EXIF_DATA_MAX_SUB_IFDS 16
+
+static void
+exif_data_drop_saved (ExifDataSaved *s)
+{
+	exif_buffer_unref (s->buf);
+	memset (s, 0, sizeof (ExifDataSaved));
+}
+
 static void *
 exif_data_alloc (ExifData *data, unsigned int i)
 {
@@ -107,7 +165,7 @@ exif_data_get_priv_mem (ExifData *d)
 void
 exif_data_set_priv_md (ExifData *d, ExifMnoteData *md)
 {
-	if (d && d->priv) {
+	if (d && d->priv && !d->priv->frozen) {
 		d->priv->md = md;
 	}
 }
@@ -140,7 +198,7 @@ exif_data_new_mem (ExifMem *mem)
 	  	exif_mem_free (mem, data); 
 		return (NULL); 
 	}
-	data->priv->ref_count = 1;
+	exif_refcount_init (&data->priv->ref_count, 1);
 
 	data->priv->mem = mem;
 	exif_mem_ref (mem);
@@ -180,57 +238,77 @@ exif_data_new_from_data (const unsigned char *data, unsigned int size)
 	return (edata);
 }
 
-static int
-exif_data_load_data_entry (ExifData *data, ExifEntry *entry,
-			   const unsigned char *d,
-			   unsigned int size, unsigned int offset)
+/* Used internally within libexif */
+int
+exif_data_get_entry_value (const unsigned char *e, ExifByteOrder order,
+			   unsigned int offset, unsigned int ds,
+			   unsigned int *doff, unsigned int *size)
 {
-	unsigned int s, doff;
-
-	entry->tag        = exif_get_short (d + offset + 0, data->priv->order);
-	entry->format     = exif_get_short (d + offset + 2, data->priv->order);
-	entry->components = exif_get_long  (d + offset + 4, data->priv->order);
-
-	/* FIXME: should use exif_tag_get_name_in_ifd here but entry->parent 
-	 * has not been set yet
-	 */
-	exif_log (data->priv->log, EXIF_LOG_CODE_DEBUG, "ExifData",
-		  "Loading entry 0x%x ('%s')...", entry->tag,
-		  exif_tag_get_name (entry->tag));
+	unsigned int fs = exif_format_get_size (exif_get_short (e + 2, order));
+	ExifLong components = exif_get_long (e + 4, order);
 
 	/* {0,1,2,4,8} x { 0x00000000 .. 0xffffffff } 
 	 *   -> { 0x000000000 .. 0x7fffffff8 } */
-	s = exif_format_get_size(entry->format) * entry->components;
-	if ((s < entry->components) || (s == 0)){
+	if (!fs || !components || (components > ds / fs))
 		return 0;
-	}
+	*size = fs * components;
 
 	/*
 	 * Size? If bigger than 4 bytes, the actual data is not
 	 * in the entry but somewhere else (offset).
 	 */
-	if (s > 4)
-		doff = exif_get_long (d + offset + 8, data->priv->order);
+	if (*size > 4)
+		*doff = exif_get_long (e + 8, order);
 	else
-		doff = offset + 8;
+		*doff = offset + 8;
+	return !CHECKOVERFLOW (*doff, ds, *size);
+}
 
-	/* Sanity checks */
-	if (doff >= size) {
-		exif_log (data->priv->log, EXIF_LOG_CODE_DEBUG, "ExifData",
-				  "Tag starts past end of buffer (%u > %u)", doff, size);
+static int
+exif_data_load_data_entry (ExifData *data, ExifEntry *entry,
+			   ExifSource *src, unsigned int offset)
+{
+	const unsigned char *d;
+	unsigned int s, doff, size = exif_source_get_size (src);
+
+	d = exif_source_get (src, offset, 12);
+	if (!d)
 		return 0;
-	}
+	entry->tag        = exif_get_short (d + 0, data->priv->order);
+	entry->format     = exif_get_short (d + 2, data->priv->order);
+	entry->components = exif_get_long  (d + 4, data->priv->order);
+
+	/* FIXME: should use exif_tag_get_name_in_ifd here but entry->parent 
+	 * has not been set yet
+	 */
+	exif_log (data->priv->log, EXIF_LOG_CODE_DEBUG, "ExifData",
+		  "Loading entry 0x%x ('%s')...", entry->tag,
+		  exif_tag_get_name (entry->tag));
 
-	if (s > size - doff) {
+	if (!exif_data_get_entry_value (d, data->priv->order, offset, size,
+					&doff, &s)) {
 		exif_log (data->priv->log, EXIF_LOG_CODE_DEBUG, "ExifData",
-				  "Tag data goes past end of buffer (%u > %u)", doff+s, size);
+			  "Tag data is empty or goes past end of buffer (%u bytes)",
+			  size);
 		return 0;
 	}
 
-	entry->data = exif_data_alloc (data, s);
-	if (entry->data) {
+	d = exif_source_get_data (src);
+	if (d && exif_buffer_contains (data->priv->buffer, d + doff)) {
+		/* The buffer outlives the entry, so no copy is needed */
+		exif_entry_set_buffer (entry, data->priv->buffer);
+		entry->data = (unsigned char *) d + doff;
+		entry->size = s;
+		entry->offset = doff;
+	} else if ((entry->data = exif_data_alloc (data, s))) {
+		if (!exif_source_read (src, doff, entry->data, s)) {
+			exif_log (data->priv->log, EXIF_LOG_CODE_CORRUPT_DATA, "ExifData",
+				  "Could not read tag data at %u.", doff);
+			exif_mem_free (data->priv->mem, entry->data);
+			entry->data = NULL;
+			return 0;
+		}
 		entry->size = s;
-		memcpy (entry->data, d + doff, s);
         entry->offset = doff;
 	} else {
 		EXIF_LOG_NO_MEMORY(data->priv->log, "ExifData", s);
@@ -289,9 +367,7 @@ exif_data_save_data_entry (ExifData *data, ExifEntry *e,
 			if (is_huawei_md(data->priv->md) &&
 				e->data && (e->size >= 8) &&
 				!memcmp(e->data, HUAWEI_HEADER, 8)) {
-					/* TODO: this is using the wrong ExifMem to free e->data */
-					exif_mem_free (data->priv->mem, e->data);
-					e->data = NULL;
+					exif_entry_free_data (e);
 					e->size = 0;
 					exif_mnote_data_set_offset (data->priv->md, *ds - 6);
 					exif_mnote_data_save (data->priv->md, &e->data, &e->size);
@@ -379,9 +455,7 @@ exif_data_save_data_entry_general (ExifData *data, ExifEntry *e,
 			if (is_huawei_md(data->priv->md) &&
 				e->data && (e->size >= 8) &&
 				!memcmp(e->data, HUAWEI_HEADER, 8)) {
-					/* TODO: this is using the wrong ExifMem to free e->data */
-					exif_mem_free(data->priv->mem, e->data);
-					e->data = NULL;
+					exif_entry_free_data (e);
 					e->size = 0;
 					exif_mnote_data_set_offset(data->priv->md, *ds - 6 + JPEG_HEADER_LEN);
 					exif_mnote_data_save(data->priv->md, &e->data, &e->size);
@@ -447,9 +521,22 @@ exif_data_save_data_entry_general (ExifData *data, ExifEntry *e,
 }
 
 static void
-exif_data_load_data_thumbnail (ExifData *data, const unsigned char *d,
-			       unsigned int ds, ExifLong o, ExifLong s)
+exif_data_free_thumbnail (ExifData *data)
 {
+	if (data->data &&
+	    !exif_buffer_contains (data->priv->buffer, data->data))
+		exif_mem_free (data->priv->mem, data->data);
+	data->data = NULL;
+	data->size = 0;
+}
+
+static void
+exif_data_load_data_thumbnail (ExifData *data, ExifSource *src,
+			       ExifLong o, ExifLong s)
+{
+	const unsigned char *d = exif_source_get_data (src);
+	unsigned int ds = exif_source_get_size (src);
+
 	/* Sanity checks */
 	if (o >= ds) {
 		exif_log (data->priv->log, EXIF_LOG_CODE_DEBUG, "ExifData", "Bogus thumbnail offset (%u).", o);
@@ -459,15 +546,29 @@ exif_data_load_data_thumbnail (ExifData *data, const unsigned char *d,
 		exif_log (data->priv->log, EXIF_LOG_CODE_DEBUG, "ExifData", "Bogus thumbnail size (%u), max would be %u.", s, ds-o);
 		return;
 	}
-	if (data->data) 
-		exif_mem_free (data->priv->mem, data->data);
+	exif_data_free_thumbnail (data);
+	if (data->priv->options & EXIF_DATA_OPTION_IGNORE_THUMBNAIL)
+		return;
+	data->priv->thumbnail_offset = data->priv->thumbnail_base + o;
+	data->priv->thumbnail_size = s;
+	if (data->priv->options & EXIF_DATA_OPTION_THUMBNAIL_BY_REFERENCE)
+		return;
+	if (d && exif_buffer_contains (data->priv->buffer, d + o)) {
+		data->data = (unsigned char *) d + o;
+		data->size = s;
+		return;
+	}
 	if (!(data->data = exif_data_alloc (data, s))) {
 		EXIF_LOG_NO_MEMORY (data->priv->log, "ExifData", s);
 		data->size = 0;
 		return;
 	}
 	data->size = s;
-	memcpy (data->data, d + o, s);
+	if (!exif_source_read (src, o, data->data, s)) {
+		exif_log (data->priv->log, EXIF_LOG_CODE_CORRUPT_DATA, "ExifData",
+			  "Could not read thumbnail at %u.", o);
+		exif_data_free_thumbnail (data);
+	}
 }
 
 #undef CHECK_REC
@@ -504,9 +605,10 @@ level_cost(unsigned int n)
 
 static void
 load_thumbnail_entry (ExifData *data, ExifTag tag, ExifIfd ifd,
-					  const unsigned char *d,
-					  unsigned int ds, unsigned int offset, unsigned i)
+					  ExifSource *src, unsigned int offset, unsigned i)
 {
+	const unsigned char *d;
+
 	/*
 		* If we don't know the tag, don't fail. It could be that new
 		* versions of the standard have defined additional tags. Note that
@@ -518,8 +620,8 @@ load_thumbnail_entry (ExifData *data, ExifTag tag, ExifIfd ifd,
 			* Special case: Tag and format 0. That's against specification
 			* (at least up to 2.2). But Photoshop writes it anyways.
 			*/
-		if (!d || CHECKOVERFLOW(offset + 12 * i, ds, 4) ||
-            !memcmp (d + offset + 12 * i, "\0\0\0\0", 4)) {
+		d = exif_source_get (src, offset + 12 * i, 4);
+		if (!d || !memcmp (d, "\0\0\0\0", 4)) {
 			exif_log (data->priv->log, EXIF_LOG_CODE_DEBUG, "ExifData",
 					"Skipping empty entry at position %u in '%s'.", i,
 					exif_ifd_get_name (ifd));
@@ -538,8 +640,7 @@ load_thumbnail_entry (ExifData *data, ExifTag tag, ExifIfd ifd,
 									"Could not allocate memory");
 			return;
 	}
-	if (exif_data_load_data_entry (data, entry, d, ds,
-					offset + 12 * i))
+	if (exif_data_load_data_entry (data, entry, src, offset + 12 * i))
 		exif_content_add_entry (data->ifd[ifd], entry);
 	exif_entry_unref (entry);
 }
@@ -548,21 +649,21 @@ load_thumbnail_entry (ExifData *data, ExifTag tag, ExifIfd ifd,
  *
  * \param[in,out] data #ExifData
  * \param[in] ifd IFD to load
- * \param[in] d pointer to buffer containing raw IFD data
- * \param[in] ds size of raw data in buffer at \c d
- * \param[in] offset offset into buffer at \c d at which IFD starts
+ * \param[in] src raw data, starting at the TIFF header
+ * \param[in] offset offset into \c src at which IFD starts
  * \param[in] recursion_cost factor indicating how expensive this recursive
  * call could be
  */
 static void
 exif_data_load_data_content (ExifData *data, ExifIfd ifd,
-			     const unsigned char *d,
-			     unsigned int ds, unsigned int offset, unsigned int recursion_cost)
+			     ExifSource *src, unsigned int offset,
+			     unsigned int recursion_cost)
 {
 	ExifLong o, thumbnail_offset = 0, thumbnail_length = 0;
 	ExifShort n;
 	ExifEntry *entry;
-	unsigned int i;
+	const unsigned char *d;
+	unsigned int i, ds = exif_source_get_size (src);
 	ExifTag tag;
 
 	if (!data || !data->priv) 
@@ -590,12 +691,13 @@ exif_data_load_data_content (ExifData *data, ExifIfd ifd,
 	}
 
 	/* Read the number of entries */
-	if (CHECKOVERFLOW(offset, ds, 2)) {
+	d = exif_source_get (src, offset, 2);
+	if (!d) {
 		exif_log (data->priv->log, EXIF_LOG_CODE_CORRUPT_DATA, "ExifData",
 			  "Tag data past end of buffer (%u+2 > %u)", offset, ds);
 		return;
 	}
-	n = exif_get_short (d + offset, data->priv->order);
+	n = exif_get_short (d, data->priv->order);
 	exif_log (data->priv->log, EXIF_LOG_CODE_DEBUG, "ExifData",
 	          "Loading %hu entries...", n);
 	offset += 2;
@@ -616,15 +718,20 @@ exif_data_load_data_content (ExifData *data, ExifIfd ifd,
 			return;
 		}
 
-		tag = exif_get_short (d + offset + 12 * i, data->priv->order);
+		d = exif_source_get (src, offset + 12 * i, 12);
+		if (!d) {
+			exif_log (data->priv->log, EXIF_LOG_CODE_CORRUPT_DATA, "ExifData",
+				  "Could not read entry %u.", i);
+			return;
+		}
+		tag = exif_get_short (d, data->priv->order);
 		switch (tag) {
 		case EXIF_TAG_EXIF_IFD_POINTER:
 		case EXIF_TAG_GPS_INFO_IFD_POINTER:
 		case EXIF_TAG_INTEROPERABILITY_IFD_POINTER:
 		case EXIF_TAG_JPEG_INTERCHANGE_FORMAT_LENGTH:
 		case EXIF_TAG_JPEG_INTERCHANGE_FORMAT:
-			o = exif_get_long (d + offset + 12 * i + 8,
-					   data->priv->order);
+			o = exif_get_long (d + 8, data->priv->order);
 			if (o >= ds) {
 				exif_log (data->priv->log, EXIF_LOG_CODE_CORRUPT_DATA, "ExifData",
 					  "Tag data past end of buffer (%u > %u)", offset+2, ds);
@@ -641,34 +748,34 @@ exif_data_load_data_content (ExifData *data, ExifIfd ifd,
 			switch (tag) {
 			case EXIF_TAG_EXIF_IFD_POINTER:
 				CHECK_REC (EXIF_IFD_EXIF)
-				exif_data_load_data_content (data, EXIF_IFD_EXIF, d, ds, o,
+				exif_data_load_data_content (data, EXIF_IFD_EXIF, src, o,
 					recursion_cost + level_cost(n));
 				break;
 			case EXIF_TAG_GPS_INFO_IFD_POINTER:
 				CHECK_REC (EXIF_IFD_GPS)
-				exif_data_load_data_content (data, EXIF_IFD_GPS, d, ds, o,
+				exif_data_load_data_content (data, EXIF_IFD_GPS, src, o,
 					recursion_cost + level_cost(n));
 				break;
 			case EXIF_TAG_INTEROPERABILITY_IFD_POINTER:
 				CHECK_REC (EXIF_IFD_INTEROPERABILITY)
-				exif_data_load_data_content (data, EXIF_IFD_INTEROPERABILITY, d, ds, o,
+				exif_data_load_data_content (data, EXIF_IFD_INTEROPERABILITY, src, o,
 					recursion_cost + level_cost(n));
 				break;
 			case EXIF_TAG_JPEG_INTERCHANGE_FORMAT:
 				thumbnail_offset = o;
 				if (thumbnail_offset && thumbnail_length)
-					exif_data_load_data_thumbnail (data, d,
-								       ds, thumbnail_offset,
+					exif_data_load_data_thumbnail (data, src,
+								       thumbnail_offset,
 								       thumbnail_length);
-				load_thumbnail_entry(data, tag, ifd, d, ds, offset, i);
+				load_thumbnail_entry(data, tag, ifd, src, offset, i);
 				break;
 			case EXIF_TAG_JPEG_INTERCHANGE_FORMAT_LENGTH:
 				thumbnail_length = o;
 				if (thumbnail_offset && thumbnail_length)
-					exif_data_load_data_thumbnail (data, d,
-								       ds, thumbnail_offset,
+					exif_data_load_data_thumbnail (data, src,
+								       thumbnail_offset,
 								       thumbnail_length);
-				load_thumbnail_entry(data, tag, ifd, d, ds, offset, i);
+				load_thumbnail_entry(data, tag, ifd, src, offset, i);
 				break;
 			default:
 				return;
@@ -686,7 +793,7 @@ exif_data_load_data_content (ExifData *data, ExifIfd ifd,
 				 * Special case: Tag and format 0. That's against specification
 				 * (at least up to 2.2). But Photoshop writes it anyways.
 				 */
-				if (!memcmp (d + offset + 12 * i, "\0\0\0\0", 4)) {
+				if (!memcmp (d, "\0\0\0\0", 4)) {
 					exif_log (data->priv->log, EXIF_LOG_CODE_DEBUG, "ExifData",
 						  "Skipping empty entry at position %u in '%s'.", i, 
 						  exif_ifd_get_name (ifd));
@@ -705,7 +812,7 @@ exif_data_load_data_content (ExifData *data, ExifIfd ifd,
                                           "Could not allocate memory");
 				  return;
 			}
-			if (exif_data_load_data_entry (data, entry, d, ds,
+			if (exif_data_load_data_entry (data, entry, src,
 						   offset + 12 * i))
 				exif_content_add_entry (data->ifd[ifd], entry);
 			exif_entry_unref (entry);
@@ -714,27 +821,343 @@ exif_data_load_data_content (ExifData *data, ExifIfd ifd,
 	}
 }
 
-static int
-cmp_func (const unsigned char *p1, const unsigned char *p2, ExifByteOrder o)
+static void
+exif_data_free_sub_ifds (ExifData *data)
+{
+	unsigned int i;
+
+	for (i = 0; i < data->priv->sub_ifds_count; i++)
+		exif_content_unref (data->priv->sub_ifds[i]);
+	exif_mem_free (data->priv->mem, data->priv->sub_ifds);
+	data->priv->sub_ifds = NULL;
+	data->priv->sub_ifds_count = 0;
+}
+
+/* Used internally within libexif */
+ExifContent *
+exif_data_new_sub_ifd (ExifData *data)
+{
+	ExifContent *c, **t;
+
+	if (!data || !data->priv)
+		return NULL;
+	t = exif_mem_realloc (data->priv->mem, data->priv->sub_ifds,
+			      sizeof (ExifContent *) * (data->priv->sub_ifds_count + 1));
+	if (!t) {
+		EXIF_LOG_NO_MEMORY (data->priv->log, "ExifData",
+				    sizeof (ExifContent *) * (data->priv->sub_ifds_count + 1));
+		return NULL;
+	}
+	data->priv->sub_ifds = t;
+	c = exif_content_new_mem (data->priv->mem);
+	if (!c) {
+		EXIF_LOG_NO_MEMORY (data->priv->log, "ExifData", sizeof (ExifContent));
+		return NULL;
+	}
+	c->parent = data;
+	exif_content_log (c, data->priv->log);
+	t[data->priv->sub_ifds_count++] = c;
+	return c;
+}
+
+/*! Load a SubIFD of a TIFF file into an #ExifContent of its own. SubIFDs
+ * describe further images and carry the same tags as IFD 0. Pointers to
+ * other IFDs are not followed from there.
+ */
+static void
+exif_data_load_sub_ifd (ExifData *data, ExifSource *src, unsigned int offset)
+{
+	ExifContent *c;
+	ExifEntry *entry;
+	const unsigned char *d;
+	ExifShort n;
+	ExifTag tag;
+	unsigned int i, ds = exif_source_get_size (src);
+
+	d = exif_source_get (src, offset, 2);
+	if (!d) {
+		exif_log (data->priv->log, EXIF_LOG_CODE_CORRUPT_DATA, "ExifData",
+			  "Bogus offset of SubIFD (%u).", offset);
+		return;
+	}
+	n = exif_get_short (d, data->priv->order);
+	offset += 2;
+	if (CHECKOVERFLOW(offset, ds, 12*n)) {
+		n = (ds - offset) / 12;
+		exif_log (data->priv->log, EXIF_LOG_CODE_DEBUG, "ExifData",
+			  "Short data; only loading %hu entries...", n);
+	}
+
+	c = exif_data_new_sub_ifd (data);
+	if (!c)
+		return;
+
+	for (i = 0; i < n; i++) {
+		d = exif_source_get (src, offset + 12 * i, 2);
+		if (!d)
+			return;
+		tag = exif_get_short (d, data->priv->order);
+		switch (tag) {
+		case EXIF_TAG_EXIF_IFD_POINTER:
+		case EXIF_TAG_GPS_INFO_IFD_POINTER:
+		case EXIF_TAG_INTEROPERABILITY_IFD_POINTER:
+		case EXIF_TAG_SUB_IFDS:
+			break;
+		default:
+			if (!exif_tag_get_name_in_ifd (tag, EXIF_IFD_0) &&
+			    (data->priv->options & EXIF_DATA_OPTION_IGNORE_UNKNOWN_TAGS))
+				break;
+			entry = exif_entry_new_mem (data->priv->mem);
+			if (!entry) {
+				EXIF_LOG_NO_MEMORY (data->priv->log, "ExifData",
+						    sizeof (ExifEntry));
+				return;
+			}
+			if (exif_data_load_data_entry (data, entry, src,
+						       offset + 12 * i))
+				exif_content_add_entry (c, entry);
+			exif_entry_unref (entry);
+			break;
+		}
+	}
+}
+
+/*! Load the SubIFDs that the SubIFDs tag of the IFD at \a offset points
+ * to. The caller has checked that the entry count can be read.
+ */
+static void
+exif_data_load_sub_ifds (ExifData *data, ExifSource *src, unsigned int offset)
+{
+	ExifShort n, format;
+	ExifLong c, o, offsets[EXIF_DATA_MAX_SUB_IFDS];
+	const unsigned char *e;
+	unsigned int i, j, ds = exif_source_get_size (src);
+
+	e = exif_source_get (src, offset, 2);
+	if (!e)
+		return;
+	n = exif_get_short (e, data->priv->order);
+	offset += 2;
+	if (CHECKOVERFLOW(offset, ds, 12*n))
+		n = (ds - offset) / 12;
+
+	for (i = 0; i < n; i++) {
+		e = exif_source_get (src, offset + 12 * i, 12);
+		if (!e)
+			return;
+		if (exif_get_short (e, data->priv->order) != EXIF_TAG_SUB_IFDS)
+			continue;
+
+		/* Offsets are stored as LONG or as IFD (13), which is a LONG too */
+		format = exif_get_short (e + 2, data->priv->order);
+		c = exif_get_long (e + 4, data->priv->order);
+		if (((format != EXIF_FORMAT_LONG) && (format != 13)) || !c)
+			return;
+		if (c > 1) {
+			o = exif_get_long (e + 8, data->priv->order);
+			if (c > EXIF_DATA_MAX_SUB_IFDS) {
+				exif_log (data->priv->log, EXIF_LOG_CODE_DEBUG, "ExifData",
+					  "Only loading %i of %u SubIFDs.",
+					  EXIF_DATA_MAX_SUB_IFDS, c);
+				c = EXIF_DATA_MAX_SUB_IFDS;
+			}
+			e = exif_source_get (src, o, 4 * c);
+			if (!e) {
+				exif_log (data->priv->log, EXIF_LOG_CODE_CORRUPT_DATA,
+					  "ExifData", "Bogus offset of SubIFDs.");
+				return;
+			}
+		} else
+			e += 8;
+
+		/* Loading a SubIFD reuses the source's buffers */
+		for (j = 0; j < c; j++)
+			offsets[j] = exif_get_long (e + 4 * j, data->priv->order);
+		for (j = 0; j < c; j++)
+			exif_data_load_sub_ifd (data, src, offsets[j]);
+		return;
+	}
+}
+
+/*! Sort a directory of \a n entries by tag. The entries of an ExifContent
+ *  are usually sorted already, so mostly the few written after them,
+ *  pointing to other IFDs or to the thumbnail, need to move. Entries whose
+ *  tag was changed after they were added are moved as well.
+ */
+static void
+exif_data_sort_directory (unsigned char *d, unsigned int n, ExifByteOrder o)
+{
+	unsigned char t[12];
+	unsigned int i, j;
+	ExifShort tag;
+
+	for (i = 1; i < n; i++) {
+		tag = exif_get_short (d + 12 * i, o);
+		for (j = i; j && (exif_get_short (d + 12 * (j - 1), o) > tag); j--);
+		if (j == i)
+			continue;
+		memcpy (t, d + 12 * i, 12);
+		memmove (d + 12 * (j + 1), d + 12 * j, 12 * (i - j));
+		memcpy (d + 12 * j, t, 12);
+	}
+}
+
+static void exif_data_save_data_content (ExifData *data, ExifContent *ifd,
+					 unsigned char **d, unsigned int *ds,
+					 unsigned int offset);
+
+/*! Terminate the directory of IFD \a i, whose link to the next IFD is at
+ *  \a offset. IFD 1 follows IFD 0. */
+static void
+exif_data_save_data_next (ExifData *data, ExifIfd i, unsigned char **d,
+			  unsigned int *ds, unsigned int offset)
 {
-	ExifShort tag1 = exif_get_short (p1, o);
-	ExifShort tag2 = exif_get_short (p2, o);
+	if (i == EXIF_IFD_0 && (data->ifd[EXIF_IFD_1]->count ||
+				data->size)) {
 
-	return (tag1 < tag2) ? -1 : (tag1 > tag2) ? 1 : 0;
+		/*
+		 * We are saving IFD 0. Tell where IFD 1 starts and save
+		 * IFD 1.
+		 */
+		exif_set_long (*d + 6 + offset, data->priv->order, *ds - 6);
+		if (data->remove_thumbnail != 1)
+			exif_data_save_data_content (data, data->ifd[EXIF_IFD_1],
+						     d, ds, *ds - 6);
+	} else
+		exif_set_long (*d + 6 + offset, data->priv->order, 0);
 }
 
+/*! Check whether IFD \a i, with \a n_ptr pointers to other IFDs, can be
+ *  copied from the last save. Its entries are not compared: it is enough
+ *  that none was added, removed or initialized since, see
+ *  #EXIF_DATA_OPTION_REUSE_UNCHANGED_IFDS.
+ */
 static int
-cmp_func_intel (const void *elem1, const void *elem2)
+exif_data_ifd_unchanged (ExifData *data, ExifContent *ifd, ExifIfd i,
+			 unsigned int n_ptr)
 {
-	return cmp_func ((const unsigned char *) elem1,
-			 (const unsigned char *) elem2, EXIF_BYTE_ORDER_INTEL);
+	const ExifDataSaved *s = &data->priv->saved;
+	ExifByteOrder o = data->priv->order;
+	const unsigned char *b;
+	unsigned int n, j, k, found = 0;
+
+	if (!(data->priv->options & EXIF_DATA_OPTION_REUSE_UNCHANGED_IFDS) ||
+	    !s->buf || !s->end[i] || (s->order != o) ||
+	    exif_content_is_dirty (ifd))
+		return 0;
+	b = s->buf->data + s->pos[i];
+	n = exif_get_short (b, o);
+	if ((n != ifd->count + n_ptr) ||
+	    (2 + 12 * n + 4 > s->end[i] - s->start[i]))
+		return 0;
+
+	/* The IFDs pointed to may have been emptied or filled since */
+	for (k = 0; k < n; k++) {
+		switch (exif_get_short (b + 2 + 12 * k, o)) {
+		case EXIF_TAG_EXIF_IFD_POINTER:
+			if (!data->ifd[EXIF_IFD_EXIF]->count &&
+			    !data->ifd[EXIF_IFD_INTEROPERABILITY]->count)
+				return 0;
+			found++;
+			break;
+		case EXIF_TAG_GPS_INFO_IFD_POINTER:
+			if (!data->ifd[EXIF_IFD_GPS]->count)
+				return 0;
+			found++;
+			break;
+		case EXIF_TAG_INTEROPERABILITY_IFD_POINTER:
+			if (!data->ifd[EXIF_IFD_INTEROPERABILITY]->count)
+				return 0;
+			found++;
+			break;
+		default:
+			break;
+		}
+	}
+	if (found != n_ptr)
+		return 0;
+
+	for (j = 0; j < ifd->count; j++) {
+		switch (ifd->entries[j]->tag) {
+		case EXIF_TAG_EXIF_IFD_POINTER:
+		case EXIF_TAG_GPS_INFO_IFD_POINTER:
+		case EXIF_TAG_INTEROPERABILITY_IFD_POINTER:
+			return 0;
+		case EXIF_TAG_MAKER_NOTE:
+			/* Saved from the decoded MakerNote each time */
+			if (data->priv->md && !(data->priv->options &
+					EXIF_DATA_OPTION_DONT_CHANGE_MAKER_NOTE))
+				return 0;
+			break;
+		default:
+			break;
+		}
+	}
+	return 1;
 }
 
+/*! Save IFD \a i by copying it from the last save if it did not change,
+ *  moving the offsets of its values along. The IFDs it points to are
+ *  saved after it as usual.
+ *
+ * \return 1 if the IFD was copied, 0 if it needs to be encoded
+ */
 static int
-cmp_func_motorola (const void *elem1, const void *elem2)
+exif_data_save_data_content_cached (ExifData *data, ExifContent *ifd,
+				    ExifIfd i, unsigned int n_ptr,
+				    unsigned char **d, unsigned int *ds,
+				    unsigned int offset)
 {
-	return cmp_func ((const unsigned char *) elem1,
-			 (const unsigned char *) elem2, EXIF_BYTE_ORDER_MOTOROLA);
+	const ExifDataSaved *s = &data->priv->saved;
+	ExifByteOrder o = data->priv->order;
+	unsigned int n, j, l, start;
+	unsigned char *t, *e;
+	ExifIfd child;
+
+	if ((i == EXIF_IFD_1) || !exif_data_ifd_unchanged (data, ifd, i, n_ptr))
+		return 0;
+
+	start = s->start[i];
+	l = s->end[i] - start;
+	t = exif_mem_realloc (data->priv->mem, *d, *ds + l);
+	if (!t) {
+		EXIF_LOG_NO_MEMORY (data->priv->log, "ExifData", *ds + l);
+		return 0;
+	}
+	*d = t;
+	memcpy (*d + *ds, s->buf->data + s->pos[i], l);
+	*ds += l;
+	data->priv->saving.start[i] = offset;
+	data->priv->saving.end[i] = offset + l;
+
+	n = exif_get_short (*d + 6 + offset, o);
+	for (j = 0; j < n; j++) {
+		e = *d + 6 + offset + 2 + 12 * j;
+		switch (exif_get_short (e, o)) {
+		case EXIF_TAG_EXIF_IFD_POINTER:
+			child = EXIF_IFD_EXIF;
+			break;
+		case EXIF_TAG_GPS_INFO_IFD_POINTER:
+			child = EXIF_IFD_GPS;
+			break;
+		case EXIF_TAG_INTEROPERABILITY_IFD_POINTER:
+			child = EXIF_IFD_INTEROPERABILITY;
+			break;
+		default:
+			if (exif_format_get_size (exif_get_short (e + 2, o)) *
+			    exif_get_long (e + 4, o) > 4)
+				exif_set_long (e + 8, o,
+					exif_get_long (e + 8, o) - start + offset);
+			continue;
+		}
+
+		/* Entries are sorted, so this keeps the order of a full save */
+		exif_set_long (e + 8, o, *ds - 6);
+		exif_data_save_data_content (data, data->ifd[child], d, ds,
+					     *ds - 6);
+	}
+	exif_data_save_data_next (data, i, d, ds, offset + 2 + 12 * n);
+	return 1;
 }
 
 static void
@@ -742,7 +1165,7 @@ exif_data_save_data_content (ExifData *data, ExifContent *ifd,
 			     unsigned char **d, unsigned int *ds,
 			     unsigned int offset)
 {
-	unsigned int j, n_ptr = 0, n_thumb = 0;
+	unsigned int j, n_ptr = 0, n_thumb = 0, start = offset;
 	ExifIfd i;
 	unsigned char *t;
 	unsigned int ts;
@@ -794,6 +1217,10 @@ exif_data_save_data_content (ExifData *data, ExifContent *ifd,
 		break;
 	}
 
+	if (exif_data_save_data_content_cached (data, ifd, i, n_ptr, d, ds,
+						offset))
+		return;
+
 	/*
 	 * Allocate enough memory for all entries
 	 * and the number of entries.
@@ -832,6 +1259,12 @@ exif_data_save_data_content (ExifData *data, ExifContent *ifd,
 
 	offset += 12 * ifd->count;
 
+	/* The IFD and its values end here, before the IFDs it points to */
+	if (i != EXIF_IFD_1) {
+		data->priv->saving.start[i] = start;
+		data->priv->saving.end[i] = *ds - 6;
+	}
+
 	/* Now save special entries. */
 	switch (i) {
 	case EXIF_IFD_0:
@@ -942,25 +1375,11 @@ exif_data_save_data_content (ExifData *data, ExifContent *ifd,
 	}
 
 	/* Sort the directory according to TIFF specification */
-	qsort (*d + 6 + offset - (ifd->count + n_ptr + n_thumb) * 12,
-	       (ifd->count + n_ptr + n_thumb), 12,
-	       (data->priv->order == EXIF_BYTE_ORDER_INTEL) ? cmp_func_intel : cmp_func_motorola);
+	exif_data_sort_directory (*d + 6 + offset - (ifd->count + n_ptr + n_thumb) * 12,
+				  ifd->count + n_ptr + n_thumb, data->priv->order);
 
 	/* Correctly terminate the directory */
-	if (i == EXIF_IFD_0 && (data->ifd[EXIF_IFD_1]->count ||
-				data->size)) {
-
-		/*
-		 * We are saving IFD 0. Tell where IFD 1 starts and save
-		 * IFD 1.
-		 */
-		exif_set_long (*d + 6 + offset, data->priv->order, *ds - 6);
-        if (data && data->remove_thumbnail != 1) {
-            exif_data_save_data_content (data, data->ifd[EXIF_IFD_1], d, ds,
-                                         *ds - 6);
-        }
-	} else
-		exif_set_long (*d + 6 + offset, data->priv->order, 0);
+	exif_data_save_data_next (data, i, d, ds, offset);
 }
 
 static void
@@ -1157,9 +1576,8 @@ exif_data_save_data_content_general (ExifData* data, ExifContent* ifd,
 	}
 
 	/* Sort the directory according to TIFF specification */
-	qsort(*d + 6 - JPEG_HEADER_LEN + offset - (ifd->count + n_ptr + n_thumb) * 12,
-		(ifd->count + n_ptr + n_thumb), 12,
-		(data->priv->order == EXIF_BYTE_ORDER_INTEL) ? cmp_func_intel : cmp_func_motorola);
+	exif_data_sort_directory(*d + 6 - JPEG_HEADER_LEN + offset - (ifd->count + n_ptr + n_thumb) * 12,
+		ifd->count + n_ptr + n_thumb, data->priv->order);
 
 	/* Correctly terminate the directory */
 	if (i == EXIF_IFD_0 && (data->ifd[EXIF_IFD_1]->count ||
@@ -1187,63 +1605,203 @@ typedef enum {
 	EXIF_DATA_TYPE_MAKER_NOTE_FUJI 		= 6
 } ExifDataTypeMakerNote;
 
-/*! If MakerNote is recognized, load it.
- *
- * \param[in,out] data #ExifData
- * \param[in] d pointer to raw EXIF data
- * \param[in] ds length of data at d
+static ExifMnoteData *
+mnote_huawei_new (ExifMem *mem, ExifDataOption UNUSED(o))
+{
+	return exif_mnote_data_huawei_new (mem);
+}
+
+/*
+ * Built-in MakerNote parsers. Like the historic code, libexif only hands
+ * a MakerNote that starts with "HUAWEI" to them; the Olympus, Canon, Fuji
+ * and Pentax parsers are compiled in but not used. With this single row,
+ * the table below mostly holds the parsers registered with
+ * exif_data_register_mnote_vendor().
+ */
+static const ExifMnoteDataVendor mnote_builtin_vendors[] = {
+	{"Huawei",  (const unsigned char *) "HUAWEI\0\0", 8, NULL,
+	 exif_mnote_data_huawei_identify, mnote_huawei_new}
+/* Marcus: disabled until apple makernote can also be saved
+	{"Apple",   (const unsigned char *) "Apple iOS", 9, NULL,
+	 exif_mnote_data_apple_identify, mnote_apple_new}
+*/
+};
+
+#define MNOTE_BUILTIN_COUNT \
+	(sizeof (mnote_builtin_vendors) / sizeof (mnote_builtin_vendors[0]))
+#define MNOTE_VENDOR_MAX (MNOTE_BUILTIN_COUNT + 16)
+#define MNOTE_VENDOR_NONE 0xff
+
+/*
+ * All known parsers, built-in ones first. Candidates are chained per
+ * first signature byte, plus one chain for parsers keyed on the Make tag.
+ * Each chain is in ascending table order.
  */
+static struct {
+	ExifMnoteDataVendor vendors[MNOTE_VENDOR_MAX];
+	unsigned int count;
+	unsigned char by_byte[256];
+	unsigned char by_make;
+	unsigned char next[MNOTE_VENDOR_MAX];
+} mnote_registry;
+
 static void
-interpret_maker_note(ExifData *data, const unsigned char *d, unsigned int ds)
+mnote_registry_append (const ExifMnoteDataVendor *v)
 {
-	int mnoteid;
-	ExifEntry* e = exif_content_get_huawei_makenote_entry(data->ifd[EXIF_IFD_EXIF]);
+	unsigned char *link;
+	unsigned int i = mnote_registry.count++;
+
+	mnote_registry.vendors[i] = *v;
+	mnote_registry.next[i] = MNOTE_VENDOR_NONE;
+	link = v->signature ? &mnote_registry.by_byte[v->signature[0]] :
+			      &mnote_registry.by_make;
+	while (*link != MNOTE_VENDOR_NONE)
+		link = &mnote_registry.next[*link];
+	*link = i;
+}
 
-	if (!e)
+/* Used internally within libexif, see exif_library_init() */
+void
+exif_data_init_mnote_registry (void)
+{
+	unsigned int i;
+
+	if (mnote_registry.count)
 		return;
-	
-	if ((mnoteid = exif_mnote_data_huawei_identify (data, e)) != 0) {
-		exif_log (data->priv->log, EXIF_LOG_CODE_DEBUG,
-			"ExifData", "Huawei MakerNote variant type %d", mnoteid);
-		data->priv->md = exif_mnote_data_huawei_new (data->priv->mem);
-	} else if ((mnoteid = exif_mnote_data_olympus_identify (data, e)) != 0) {
-		exif_log (data->priv->log, EXIF_LOG_CODE_DEBUG,
-			"ExifData", "Olympus MakerNote variant type %d", mnoteid);
-		data->priv->md = exif_mnote_data_olympus_new (data->priv->mem);
-
-	} else if ((mnoteid = exif_mnote_data_canon_identify (data, e)) != 0) {
-		exif_log (data->priv->log, EXIF_LOG_CODE_DEBUG,
-			"ExifData", "Canon MakerNote variant type %d", mnoteid);
-		data->priv->md = exif_mnote_data_canon_new (data->priv->mem, data->priv->options);
-
-	} else if ((mnoteid = exif_mnote_data_fuji_identify (data, e)) != 0) {
-		exif_log (data->priv->log, EXIF_LOG_CODE_DEBUG,
-			"ExifData", "Fuji MakerNote variant type %d", mnoteid);
-		data->priv->md = exif_mnote_data_fuji_new (data->priv->mem);
-
-	/* NOTE: Must do Pentax detection last because some of the
-	 * heuristics are pretty general. */
-	} else if ((mnoteid = exif_mnote_data_pentax_identify (data, e)) != 0) {
-		exif_log (data->priv->log, EXIF_LOG_CODE_DEBUG,
-			"ExifData", "Pentax MakerNote variant type %d", mnoteid);
-		data->priv->md = exif_mnote_data_pentax_new (data->priv->mem);
-	}
-/* Marcus: disabled until apple makernote can also be saved
-	else if ((mnoteid = exif_mnote_data_apple_identify (data, e)) != 0) {
-		exif_log (data->priv->log, EXIF_LOG_CODE_DEBUG,
-			"ExifData", "Apple MakerNote variant type %d", mnoteid);
-		data->priv->md = exif_mnote_data_apple_new (data->priv->mem);
-	} else if ((mnoteid = exif_mnote_data_huawei_identify (data, e)) != 0) {
-		exif_log (data->priv->log, EXIF_LOG_CODE_DEBUG,
-			"ExifData", "Huawei MakerNote variant type %d", mnoteid);
-		data->priv->md = exif_mnote_data_huawei_new (data->priv->mem);
-	}
-*/ 
+	memset (mnote_registry.by_byte, MNOTE_VENDOR_NONE,
+		sizeof (mnote_registry.by_byte));
+	mnote_registry.by_make = MNOTE_VENDOR_NONE;
+	for (i = 0; i < MNOTE_BUILTIN_COUNT; i++)
+		mnote_registry_append (&mnote_builtin_vendors[i]);
+}
 
-	/* 
-	 * If we are able to interpret the maker note, do so.
-	 */
-	if (data->priv->md) {
+int
+exif_data_register_mnote_vendor (const ExifMnoteDataVendor *vendor)
+{
+	if (!vendor || !vendor->new_func ||
+	    (!vendor->signature && !vendor->make) ||
+	    (vendor->signature && !vendor->signature_size))
+		return 0;
+	exif_library_init ();
+	if (mnote_registry.count >= MNOTE_VENDOR_MAX)
+		return 0;
+	mnote_registry_append (vendor);
+	return 1;
+}
+
+/*! Find the first parser (at or after table index \c first) accepting
+ * the given MakerNote.
+ *
+ * \param[in] data #ExifData
+ * \param[in] e MakerNote entry
+ * \param[in] make value of the Make tag (not NUL terminated), or NULL
+ * \param[in] make_len number of bytes at make
+ * \param[in] first first table index to consider
+ * \param[out] variant value returned by the identify function
+ * \return parser, or NULL if none recognizes the MakerNote
+ */
+static const ExifMnoteDataVendor *
+mnote_registry_lookup (const ExifData *data, const ExifEntry *e,
+		       const char *make, unsigned int make_len,
+		       unsigned int first, int *variant)
+{
+	unsigned int s, m, i;
+	const ExifMnoteDataVendor *v;
+
+	if (!e || !e->data || !e->size)
+		return NULL;
+
+	/* Merge both chains so that the table order is respected. */
+	s = mnote_registry.by_byte[e->data[0]];
+	m = mnote_registry.by_make;
+	while ((s != MNOTE_VENDOR_NONE) || (m != MNOTE_VENDOR_NONE)) {
+		if (m == MNOTE_VENDOR_NONE || (s != MNOTE_VENDOR_NONE && s < m)) {
+			i = s;
+			s = mnote_registry.next[s];
+			v = &mnote_registry.vendors[i];
+			if ((i < first) || (e->size < v->signature_size) ||
+			    memcmp (e->data, v->signature, v->signature_size))
+				continue;
+		} else {
+			i = m;
+			m = mnote_registry.next[m];
+			v = &mnote_registry.vendors[i];
+			if ((i < first) || !make ||
+			    (strlen (v->make) != make_len) ||
+			    memcmp (make, v->make, make_len))
+				continue;
+		}
+		*variant = v->identify ? v->identify (data, e) : 1;
+		if (*variant)
+			return v;
+	}
+	return NULL;
+}
+
+/*! Find the parser for the MakerNote of data, without reading anything
+ *  but the entries already loaded.
+ *
+ * \param[in] data #ExifData
+ * \param[out] entry MakerNote entry the parser recognized
+ * \param[out] variant as returned by the identify function of the parser
+ * \return parser, or NULL if none recognizes the MakerNote
+ */
+static const ExifMnoteDataVendor *
+exif_data_find_mnote_vendor (ExifData *data, ExifEntry **entry, int *variant)
+{
+	const ExifMnoteDataVendor *v = NULL;
+	const char *make = NULL;
+	unsigned int make_len = 0;
+	ExifEntry *e, *em;
+
+	exif_library_init ();
+
+	/* Look up the Make tag once for all candidates. */
+	em = exif_data_get_entry (data, EXIF_TAG_MAKE);
+	if (em && em->data && (em->format == EXIF_FORMAT_ASCII)) {
+		make = (const char *) em->data;
+		while ((make_len < em->size) && make[make_len])
+			make_len++;
+	}
+
+	/*
+	 * The built-in parsers are only used on a HUAWEI MakerNote. Parsers
+	 * registered at runtime get a chance at any other MakerNote.
+	 */
+	e = exif_content_get_huawei_makenote_entry (data->ifd[EXIF_IFD_EXIF]);
+	if (e)
+		v = mnote_registry_lookup (data, e, make, make_len, 0, variant);
+	if (!v && (mnote_registry.count > MNOTE_BUILTIN_COUNT)) {
+		e = exif_content_get_entry (data->ifd[EXIF_IFD_EXIF],
+					    EXIF_TAG_MAKER_NOTE);
+		v = mnote_registry_lookup (data, e, make, make_len,
+					   MNOTE_BUILTIN_COUNT, variant);
+	}
+	if (v)
+		*entry = e;
+	return v;
+}
+
+/*! Load the MakerNote with the parser found by exif_data_find_mnote_vendor().
+ *
+ * \param[in,out] data #ExifData
+ * \param[in] v parser
+ * \param[in] mnoteid variant of the MakerNote
+ * \param[in] d pointer to raw EXIF data
+ * \param[in] ds length of data at d
+ */
+static void
+load_maker_note (ExifData *data, const ExifMnoteDataVendor *v, int mnoteid,
+		 const unsigned char *d, unsigned int ds)
+{
+	exif_log (data->priv->log, EXIF_LOG_CODE_DEBUG,
+		"ExifData", "%s MakerNote variant type %d", v->name, mnoteid);
+	data->priv->md = v->new_func (data->priv->mem, data->priv->options);
+
+	/* 
+	 * If we are able to interpret the maker note, do so.
+	 */
+	if (data->priv->md) {
 		exif_mnote_data_log (data->priv->md, data->priv->log);
 		exif_mnote_data_set_byte_order (data->priv->md,
 						data->priv->order);
@@ -1253,25 +1811,47 @@ interpret_maker_note(ExifData *data, const unsigned char *d, unsigned int ds)
 	}
 }
 
+/*! If MakerNote is recognized, load it.
+ *
+ * \param[in,out] data #ExifData
+ * \param[in] d pointer to raw EXIF data
+ * \param[in] ds length of data at d
+ */
+static void
+interpret_maker_note(ExifData *data, const unsigned char *d, unsigned int ds)
+{
+	int mnoteid = 0;
+	ExifEntry *e;
+	const ExifMnoteDataVendor *v = exif_data_find_mnote_vendor (data, &e, &mnoteid);
+
+	if (v)
+		load_maker_note (data, v, mnoteid, d, ds);
+}
+
 #define LOG_TOO_SMALL \
-exif_log (data->priv->log, EXIF_LOG_CODE_CORRUPT_DATA, "ExifData", \
+exif_log (log, EXIF_LOG_CODE_CORRUPT_DATA, "ExifData", \
 		_("Size of data too small to allow for EXIF data."))
 
-void
-exif_data_load_data (ExifData *data, const unsigned char *d_orig,
-		     unsigned int ds)
+/*! Locate the EXIF header in a buffer that either starts with it or
+ *  holds a JPEG stream with an APP1 EXIF segment.
+ *
+ *  \param[in] log log for diagnostics, may be NULL
+ *  \param[in] d buffer to search
+ *  \param[in,out] ds size of the buffer on input; on success, number of
+ *                    bytes belonging to the EXIF segment (header included)
+ *  \return pointer to the EXIF header within d, or NULL if none was found
+ */
+const unsigned char *
+exif_data_find_exif_header (ExifLog *log, const unsigned char *d,
+			    unsigned int *dsp)
 {
-	unsigned int l;
-	ExifLong offset;
-	ExifShort n;
-	const unsigned char *d = d_orig;
-	unsigned int len, fullds;
-
-	if (!data || !data->priv || !d || !ds)
-		return;
+	unsigned int l, len;
+	unsigned int ds;
+	const unsigned char *m;
 
-	exif_log (data->priv->log, EXIF_LOG_CODE_DEBUG, "ExifData",
-		  "Parsing %i byte(s) EXIF data...\n", ds);
+	if (!d || !dsp)
+		return NULL;
+	ds = *dsp;
 
 	/*
 	 * It can be that the data starts with the EXIF header. If it does
@@ -1279,17 +1859,16 @@ exif_data_load_data (ExifData *data, const unsigned char *d_orig,
 	 */
 	if (ds < 6) {
 		LOG_TOO_SMALL;
-		return;
+		return NULL;
 	}
 	if (!memcmp (d, ExifHeader, 6)) {
-		exif_log (data->priv->log, EXIF_LOG_CODE_DEBUG, "ExifData",
+		exif_log (log, EXIF_LOG_CODE_DEBUG, "ExifData",
 			  "Found EXIF header at start.");
 	} else {
 		while (ds >= 3) {
-			while (ds && (d[0] == 0xff)) {
-				d++;
-				ds--;
-			}
+			m = exif_jpeg_skip_fill (d, d + ds);
+			ds -= m - d;
+			d = m;
 
 			/* JPEG_MARKER_SOI */
 			if (ds && d[0] == JPEG_MARKER_SOI) {
@@ -1320,35 +1899,35 @@ exif_data_load_data (ExifData *data, const unsigned char *d_orig,
 				ds--;
 				l = (((unsigned int)d[0]) << 8) | d[1];
 				if (l > ds)
-					return;
+					return NULL;
 				d += l;
 				ds -= l;
 				continue;
 			}
 
 			/* Unknown marker or data. Give up. */
-			exif_log (data->priv->log, EXIF_LOG_CODE_CORRUPT_DATA,
+			exif_log (log, EXIF_LOG_CODE_CORRUPT_DATA,
 				  "ExifData", _("EXIF marker not found."));
-			return;
+			return NULL;
 		}
 		if (ds < 3) {
 			LOG_TOO_SMALL;
-			return;
+			return NULL;
 		}
 		d++;
 		ds--;
 		len = (((unsigned int)d[0]) << 8) | d[1];
 		if (len > ds) {
-			exif_log (data->priv->log, EXIF_LOG_CODE_CORRUPT_DATA,
+			exif_log (log, EXIF_LOG_CODE_CORRUPT_DATA,
 				  "ExifData", _("Read length %d is longer than data length %d."), len, ds);
-			return;
+			return NULL;
 		}
 		if (len < 2) {
-			exif_log (data->priv->log, EXIF_LOG_CODE_CORRUPT_DATA,
+			exif_log (log, EXIF_LOG_CODE_CORRUPT_DATA,
 				  "ExifData", _("APP Tag too short."));
-			return;
+			return NULL;
 		}
-		exif_log (data->priv->log, EXIF_LOG_CODE_DEBUG, "ExifData",
+		exif_log (log, EXIF_LOG_CODE_DEBUG, "ExifData",
 			  "We have to deal with %i byte(s) of EXIF data.",
 			  len);
 		d += 2;
@@ -1361,16 +1940,47 @@ exif_data_load_data (ExifData *data, const unsigned char *d_orig,
 	 */
 	if (ds < 6) {
 		LOG_TOO_SMALL;
-		return;
+		return NULL;
 	}
 	if (memcmp (d, ExifHeader, 6)) {
-		exif_log (data->priv->log, EXIF_LOG_CODE_CORRUPT_DATA,
+		exif_log (log, EXIF_LOG_CODE_CORRUPT_DATA,
 			  "ExifData", _("EXIF header not found."));
+		return NULL;
+	}
+
+	exif_log (log, EXIF_LOG_CODE_DEBUG, "ExifData",
+		  "Found EXIF header.");
+
+	*dsp = ds;
+	return d;
+}
+
+void
+exif_data_load_data (ExifData *data, const unsigned char *d_orig,
+		     unsigned int ds)
+{
+	ExifLong offset;
+	ExifShort n;
+	const unsigned char *d;
+	unsigned int fullds;
+	ExifSource src;
+
+	if (!data || !data->priv || data->priv->frozen || !d_orig || !ds)
+		return;
+
+	/* A TIFF-based raw file rather than JPEG or EXIF data */
+	if ((ds >= 8) && (!memcmp (d_orig, "II\x2a\0", 4) ||
+			  !memcmp (d_orig, "MM\0\x2a", 4))) {
+		exif_data_load_tiff (data, d_orig, ds);
 		return;
 	}
 
 	exif_log (data->priv->log, EXIF_LOG_CODE_DEBUG, "ExifData",
-		  "Found EXIF header.");
+		  "Parsing %i byte(s) EXIF data...\n", ds);
+
+	d = exif_data_find_exif_header (data->priv->log, d_orig, &ds);
+	if (!d)
+		return;
 
 	/* Sanity check the data length */
 	if (ds < 14)
@@ -1408,7 +2018,10 @@ exif_data_load_data (ExifData *data, const unsigned char *d_orig,
 		return;
 
 	/* Parse the actual exif data (usually offset 14 from start) */
-	exif_data_load_data_content (data, EXIF_IFD_0, d + 6, ds - 6, offset, 0);
+	exif_source_init_data (&src, d + 6, ds - 6);
+	data->priv->thumbnail_base = d + 6 - d_orig;
+	data->priv->thumbnail_size = 0;
+	exif_data_load_data_content (data, EXIF_IFD_0, &src, offset, 0);
 
 	/* IFD 1 offset */
 	n = exif_get_short (d + 6 + offset, data->priv->order);
@@ -1426,7 +2039,7 @@ exif_data_load_data (ExifData *data, const unsigned char *d_orig,
 			exif_log (data->priv->log, EXIF_LOG_CODE_CORRUPT_DATA,
 				  "ExifData", "Bogus offset of IFD1.");
 		} else {
-			exif_data_load_data_content (data, EXIF_IFD_1, d + 6, ds - 6, offset, 0);
+			exif_data_load_data_content (data, EXIF_IFD_1, &src, offset, 0);
 		}
 	}
 
@@ -1443,6 +2056,693 @@ exif_data_load_data (ExifData *data, const unsigned char *d_orig,
 		exif_data_fix (data);
 }
 
+void
+exif_data_load_tiff (ExifData *data, const unsigned char *d, unsigned int ds)
+{
+	ExifSource src;
+
+	if (!data || !data->priv || !d)
+		return;
+
+	exif_source_init_data (&src, d, ds);
+	exif_data_load_source (data, &src);
+}
+
+/*! Hand the MakerNote of TIFF data that is not in memory to its parser.
+ * The parsers take a buffer and may follow offsets relative to the TIFF
+ * header, so everything up to the end of the MakerNote is read. This is
+ * still far less than the image data that usually follows, and nothing
+ * is read unless a parser recognizes the MakerNote entry already loaded.
+ */
+static void
+exif_data_load_source_mnote (ExifData *data, ExifSource *src)
+{
+	int mnoteid = 0;
+	ExifEntry *e;
+	const ExifMnoteDataVendor *v = exif_data_find_mnote_vendor (data, &e, &mnoteid);
+	unsigned char *d;
+	unsigned int ds;
+
+	if (!v || !data->priv->offset_mnote ||
+	    (e->size > 0xffffffff - data->priv->offset_mnote))
+		return;
+	ds = data->priv->offset_mnote + e->size;
+	d = exif_data_alloc (data, ds);
+	if (!d)
+		return;
+	if (exif_source_read (src, 0, d, ds))
+		load_maker_note (data, v, mnoteid, d, ds);
+	exif_mem_free (data->priv->mem, d);
+}
+
+void
+exif_data_load_source (ExifData *data, ExifSource *src)
+{
+	const unsigned char *d;
+	ExifLong offset;
+	ExifShort n;
+	unsigned int ds = exif_source_get_size (src);
+
+	if (!data || !data->priv || data->priv->frozen || (ds < 8))
+		return;
+
+	exif_log (data->priv->log, EXIF_LOG_CODE_DEBUG, "ExifData",
+		  "Parsing %u byte(s) TIFF data...", ds);
+
+	/* Byte order (offset 0, length 2) */
+	d = exif_source_get (src, 0, 8);
+	if (!d)
+		return;
+	if (!memcmp (d, "II", 2))
+		data->priv->order = EXIF_BYTE_ORDER_INTEL;
+	else if (!memcmp (d, "MM", 2))
+		data->priv->order = EXIF_BYTE_ORDER_MOTOROLA;
+	else {
+		exif_log (data->priv->log, EXIF_LOG_CODE_CORRUPT_DATA,
+			  "ExifData", _("Unknown encoding."));
+		return;
+	}
+
+	/* Fixed value */
+	if (exif_get_short (d + 2, data->priv->order) != 0x002a)
+		return;
+
+	/*
+	 * Unlike in JPEG files, the data is not capped to 64 KiB. Every
+	 * offset below is checked against the full 32-bit size instead.
+	 */
+	offset = exif_get_long (d + 4, data->priv->order);
+	exif_log (data->priv->log, EXIF_LOG_CODE_DEBUG, "ExifData",
+		  "IFD 0 at %u.", offset);
+	d = exif_source_get (src, offset, 2);
+	if (!d) {
+		exif_log (data->priv->log, EXIF_LOG_CODE_CORRUPT_DATA,
+			  "ExifData", "Bogus offset of IFD0.");
+		return;
+	}
+	n = exif_get_short (d, data->priv->order);
+	data->priv->thumbnail_base = 0;
+	data->priv->thumbnail_size = 0;
+	exif_data_load_data_content (data, EXIF_IFD_0, src, offset, 0);
+	exif_data_free_sub_ifds (data);
+	exif_data_load_sub_ifds (data, src, offset);
+
+	/* IFD 1 offset */
+	if (CHECKOVERFLOW(offset + 2, ds, 12u * n + 4))
+		return;
+	d = exif_source_get (src, offset + 2 + 12 * n, 4);
+	if (!d)
+		return;
+	offset = exif_get_long (d, data->priv->order);
+	if (offset) {
+		exif_log (data->priv->log, EXIF_LOG_CODE_DEBUG, "ExifData",
+			  "IFD 1 at %u.", offset);
+		if (CHECKOVERFLOW(offset, ds, 2))
+			exif_log (data->priv->log, EXIF_LOG_CODE_CORRUPT_DATA,
+				  "ExifData", "Bogus offset of IFD1.");
+		else
+			exif_data_load_data_content (data, EXIF_IFD_1, src, offset, 0);
+	}
+
+	/* As for exif_data_load_data_general(), the MakerNote parsers get
+	 * the data without an EXIF header */
+	d = exif_source_get_data (src);
+	if (d)
+		interpret_maker_note (data, d, ds);
+	else
+		exif_data_load_source_mnote (data, src);
+
+	/* Fixup tags if requested */
+	if (data->priv->options & EXIF_DATA_OPTION_FOLLOW_SPECIFICATION)
+		exif_data_fix (data);
+}
+
+unsigned int
+exif_data_get_sub_ifd_count (ExifData *data)
+{
+	return (data && data->priv) ? data->priv->sub_ifds_count : 0;
+}
+
+ExifContent *
+exif_data_get_sub_ifd (ExifData *data, unsigned int i)
+{
+	if (!data || !data->priv || (i >= data->priv->sub_ifds_count))
+		return NULL;
+	return data->priv->sub_ifds[i];
+}
+
+int
+exif_data_get_thumbnail_ref (ExifData *data, unsigned int *offset,
+			     unsigned int *size)
+{
+	if (!data || !data->priv || !data->priv->thumbnail_size)
+		return 0;
+	if (offset)
+		*offset = data->priv->thumbnail_offset;
+	if (size)
+		*size = data->priv->thumbnail_size;
+	return 1;
+}
+
+/* Used internally within libexif */
+void
+exif_data_load_buffer (ExifData *data, ExifBuffer *buf)
+{
+	if (!data || !data->priv || data->priv->frozen || !buf)
+		return;
+
+	/* A thumbnail borrowed from a previous buffer goes first */
+	exif_data_free_thumbnail (data);
+	exif_buffer_ref (buf);
+	exif_buffer_unref (data->priv->buffer);
+	data->priv->buffer = buf;
+
+	exif_data_load_data (data, buf->data, buf->size);
+}
+
+void
+exif_data_drop_clone_cache (ExifData *data)
+{
+	if (!data || !data->priv || data->priv->frozen ||
+	    !data->priv->clone_cache.buf)
+		return;
+
+	exif_data_drop_saved (&data->priv->clone_cache);
+}
+
+/*! Serialize \a data into its clone cache unless it is there already.
+ *
+ * \return 1 on success, 0 on error
+ */
+static int
+exif_data_fill_clone_cache (ExifData *data)
+{
+	ExifMem *mem = data->priv->mem;
+	unsigned char *d = NULL;
+	unsigned int ds = 0, i;
+
+	if (data->priv->clone_cache.buf)
+		return 1;
+
+	exif_data_save_data (data, &d, &ds);
+	if (!d)
+		return 0;
+	data->priv->clone_cache.buf = exif_buffer_new (mem, d, ds);
+	if (!data->priv->clone_cache.buf) {
+		exif_mem_free (mem, d);
+		return 0;
+	}
+	data->priv->clone_cache.order = data->priv->order;
+	memcpy (data->priv->clone_cache.start, data->priv->saving.start,
+		sizeof (data->priv->saving.start));
+	memcpy (data->priv->clone_cache.end, data->priv->saving.end,
+		sizeof (data->priv->saving.end));
+	for (i = 0; i < EXIF_IFD_COUNT; i++)
+		data->priv->clone_cache.pos[i] = 6 + data->priv->saving.start[i];
+	return 1;
+}
+
+ExifData *
+exif_data_clone (ExifData *data)
+{
+	ExifData *clone;
+	ExifBuffer *buf;
+	ExifMem *mem;
+	unsigned char *d;
+	unsigned int ds, i;
+
+	if (!data || !data->priv || !exif_data_fill_clone_cache (data))
+		return NULL;
+	mem = data->priv->mem;
+
+	clone = exif_data_new_mem (mem);
+	if (!clone)
+		return NULL;
+	exif_data_log (clone, data->priv->log);
+	ds = data->priv->clone_cache.buf->size;
+	d = exif_data_alloc (clone, ds);
+	buf = d ? exif_buffer_new (mem, d, ds) : NULL;
+	if (!buf) {
+		exif_mem_free (mem, d);
+		exif_data_unref (clone);
+		return NULL;
+	}
+	memcpy (d, data->priv->clone_cache.buf->data, ds);
+
+	/* Take the entries as they are, without fixing or dropping any */
+	clone->priv->options = 0;
+	exif_data_load_buffer (clone, buf);
+	exif_buffer_unref (buf);
+	clone->priv->options = data->priv->options;
+	clone->priv->data_type = data->priv->data_type;
+
+	/* Saving the clone can start from the template's bytes */
+	clone->priv->saved = data->priv->clone_cache;
+	exif_buffer_ref (clone->priv->saved.buf);
+	for (i = 0; i < EXIF_IFD_COUNT; i++)
+		exif_content_set_dirty (clone->ifd[i], 0);
+	return clone;
+}
+
+/*! \return the IFDs followed by the SubIFDs, NULL past the last one */
+static ExifContent *
+exif_data_get_content (ExifData *data, unsigned int i)
+{
+	if (i < EXIF_IFD_COUNT)
+		return data->ifd[i];
+	i -= EXIF_IFD_COUNT;
+	return (i < data->priv->sub_ifds_count) ? data->priv->sub_ifds[i] : NULL;
+}
+
+/* Values in the frozen block start at multiples of 8 bytes */
+#define EXIF_DATA_FROZEN_ALIGN(s) (((s) + 7) & ~7u)
+
+/*! Move the values of the entries of all IFDs and SubIFDs into one
+ *  block. The entries themselves stay where they are, so pointers to them
+ *  remain valid.
+ *
+ * \return 1 on success, 0 if out of memory (nothing changed then)
+ */
+static int
+exif_data_compact (ExifData *data)
+{
+	ExifContent *c;
+	ExifEntry *e;
+	unsigned char *v;
+	unsigned int size = 0, l, i, j;
+
+	for (i = 0; (c = exif_data_get_content (data, i)); i++)
+		for (j = 0; j < c->count; j++) {
+			e = c->entries[j];
+			l = e->data ? EXIF_DATA_FROZEN_ALIGN (e->size) : 0;
+			if ((l < e->size) || (size + l < size))
+				return 0;
+			size += l;
+		}
+
+	if (size) {
+		data->priv->frozen_block = exif_data_alloc (data, size);
+		if (!data->priv->frozen_block)
+			return 0;
+	}
+
+	v = data->priv->frozen_block;
+	for (i = 0; (c = exif_data_get_content (data, i)); i++)
+		for (j = 0; j < c->count; j++) {
+			e = c->entries[j];
+			if (e->data && e->size) {
+				memcpy (v, e->data, e->size);
+				exif_entry_freeze (e, v);
+				v += EXIF_DATA_FROZEN_ALIGN (e->size);
+			} else
+				exif_entry_freeze (e, NULL);
+		}
+
+	/* Nothing borrows from the loaded data any more but the thumbnail */
+	if (data->priv->buffer &&
+	    !exif_buffer_contains (data->priv->buffer, data->data)) {
+		exif_buffer_unref (data->priv->buffer);
+		data->priv->buffer = NULL;
+	}
+	exif_data_drop_saved (&data->priv->saved);
+	return 1;
+}
+
+int
+exif_data_freeze (ExifData *data)
+{
+	if (!data || !data->priv)
+		return 0;
+	if (data->priv->frozen)
+		return 1;
+
+	/* Saving and cloning must not write into the data from now on, and
+	 * neither must reading the MakerNote */
+	if (!exif_data_fill_clone_cache (data) ||
+	    (data->priv->md && !exif_mnote_data_resolve (data->priv->md)) ||
+	    !exif_data_compact (data))
+		return 0;
+	data->priv->frozen = 1;
+	return 1;
+}
+
+int
+exif_data_is_frozen (ExifData *data)
+{
+	return (data && data->priv) ? data->priv->frozen : 0;
+}
+
+/*! Check one entry the way exif_data_load_data_entry() would load it.
+ *
+ * \return 1 if the entry would be loaded, 0 otherwise
+ */
+static int
+exif_data_validate_entry (ExifValidateReport *r, ExifIfd ifd,
+			  const unsigned char *d, unsigned int size,
+			  unsigned int offset)
+{
+	ExifTag tag = exif_get_short (d + offset + 0, r->order);
+	ExifFormat format = exif_get_short (d + offset + 2, r->order);
+	ExifLong components = exif_get_long (d + offset + 4, r->order);
+	unsigned int s, doff;
+
+	s = exif_format_get_size (format) * components;
+	if ((s < components) || (s == 0)) {
+		r->problems |= EXIF_VALIDATE_ENTRY_BAD_FORMAT;
+		r->bad_entries++;
+		return 0;
+	}
+
+	if (s > 4)
+		doff = exif_get_long (d + offset + 8, r->order);
+	else
+		doff = offset + 8;
+	if ((doff >= size) || (s > size - doff)) {
+		r->problems |= EXIF_VALIDATE_ENTRY_OUT_OF_BOUNDS;
+		r->bad_entries++;
+		return 0;
+	}
+	r->entries[ifd]++;
+
+	/* Same MakerNote selection as exif_data_load_data_entry() */
+	if (tag == EXIF_TAG_MAKER_NOTE && (!r->maker_note_offset ||
+	    ((s >= 8) && !memcmp (d + doff, HUAWEI_HEADER, 8)))) {
+		r->maker_note_offset = doff;
+		r->maker_note_size = s;
+	}
+	return 1;
+}
+
+/*! Check an IFD the way exif_data_load_data_content() would load it,
+ *  including the recursion limits.
+ */
+static void
+exif_data_validate_content (ExifValidateReport *r, ExifIfd ifd,
+			    const unsigned char *d, unsigned int ds,
+			    unsigned int offset, unsigned int recursion_cost)
+{
+	ExifLong o, thumbnail_offset = 0, thumbnail_length = 0;
+	ExifShort n;
+	unsigned int i;
+	ExifTag tag;
+	ExifIfd sub;
+
+	if (recursion_cost > 170) {
+		r->problems |= EXIF_VALIDATE_TOO_DEEP;
+		return;
+	}
+
+	if (CHECKOVERFLOW(offset, ds, 2)) {
+		r->problems |= EXIF_VALIDATE_IFD_OUT_OF_BOUNDS;
+		return;
+	}
+	r->ifd_offset[ifd] = offset;
+	n = exif_get_short (d + offset, r->order);
+	offset += 2;
+
+	if (CHECKOVERFLOW(offset, ds, 12*n)) {
+		r->problems |= EXIF_VALIDATE_IFD_TRUNCATED;
+		n = (ds - offset) / 12;
+	}
+
+	for (i = 0; i < n; i++) {
+		tag = exif_get_short (d + offset + 12 * i, r->order);
+		switch (tag) {
+		case EXIF_TAG_EXIF_IFD_POINTER:
+		case EXIF_TAG_GPS_INFO_IFD_POINTER:
+		case EXIF_TAG_INTEROPERABILITY_IFD_POINTER:
+		case EXIF_TAG_JPEG_INTERCHANGE_FORMAT_LENGTH:
+		case EXIF_TAG_JPEG_INTERCHANGE_FORMAT:
+			o = exif_get_long (d + offset + 12 * i + 8, r->order);
+			if (o >= ds) {
+				if ((tag == EXIF_TAG_JPEG_INTERCHANGE_FORMAT) ||
+				    (tag == EXIF_TAG_JPEG_INTERCHANGE_FORMAT_LENGTH))
+					r->problems |= EXIF_VALIDATE_THUMBNAIL_OUT_OF_BOUNDS;
+				else
+					r->problems |= EXIF_VALIDATE_IFD_OUT_OF_BOUNDS;
+				if (recursion_cost > 0)
+					return;
+				break;
+			}
+			if (tag == EXIF_TAG_JPEG_INTERCHANGE_FORMAT ||
+			    tag == EXIF_TAG_JPEG_INTERCHANGE_FORMAT_LENGTH) {
+				if (tag == EXIF_TAG_JPEG_INTERCHANGE_FORMAT)
+					thumbnail_offset = o;
+				else
+					thumbnail_length = o;
+				if (thumbnail_offset && thumbnail_length) {
+					if (CHECKOVERFLOW(thumbnail_offset, ds, thumbnail_length)) {
+						r->problems |= EXIF_VALIDATE_THUMBNAIL_OUT_OF_BOUNDS;
+					} else {
+						r->thumbnail_offset = thumbnail_offset;
+						r->thumbnail_size = thumbnail_length;
+					}
+				}
+				if (exif_tag_get_name_in_ifd (tag, ifd))
+					exif_data_validate_entry (r, ifd, d, ds, offset + 12 * i);
+				break;
+			}
+			sub = (tag == EXIF_TAG_EXIF_IFD_POINTER) ? EXIF_IFD_EXIF :
+			      (tag == EXIF_TAG_GPS_INFO_IFD_POINTER) ? EXIF_IFD_GPS :
+			      EXIF_IFD_INTEROPERABILITY;
+			if ((sub == ifd) || r->entries[sub]) {
+				r->problems |= EXIF_VALIDATE_IFD_LOOP;
+				break;
+			}
+			exif_data_validate_content (r, sub, d, ds, o,
+				recursion_cost + level_cost(n));
+			break;
+		default:
+			/* Unknown tags are dropped by default, see
+			 * EXIF_DATA_OPTION_IGNORE_UNKNOWN_TAGS */
+			if (!exif_tag_get_name_in_ifd (tag, ifd))
+				break;
+			exif_data_validate_entry (r, ifd, d, ds, offset + 12 * i);
+			break;
+		}
+	}
+}
+
+int
+exif_data_validate (const unsigned char *d, unsigned int size,
+		    ExifValidateReport *report)
+{
+	ExifValidateReport r;
+	ExifLong offset;
+	ExifShort n;
+	unsigned int ds = size, fullds;
+
+	memset (&r, 0, sizeof (r));
+
+	if (d && size)
+		d = exif_data_find_exif_header (NULL, d, &ds);
+	if (!d || !size) {
+		r.problems |= EXIF_VALIDATE_NO_EXIF_HEADER;
+		goto out;
+	}
+	if (ds < 14) {
+		r.problems |= EXIF_VALIDATE_BAD_TIFF_HEADER;
+		goto out;
+	}
+
+	/* Same 64 KiB cap as exif_data_load_data() */
+	fullds = ds;
+	if (ds > 0xfffe)
+		ds = 0xfffe;
+
+	if (!memcmp (d + 6, "II", 2))
+		r.order = EXIF_BYTE_ORDER_INTEL;
+	else if (!memcmp (d + 6, "MM", 2))
+		r.order = EXIF_BYTE_ORDER_MOTOROLA;
+	else {
+		r.problems |= EXIF_VALIDATE_BAD_TIFF_HEADER;
+		goto out;
+	}
+	if (exif_get_short (d + 8, r.order) != 0x002a) {
+		r.problems |= EXIF_VALIDATE_BAD_TIFF_HEADER;
+		goto out;
+	}
+
+	offset = exif_get_long (d + 10, r.order);
+	if (offset > ds || offset + 6 + 2 > ds) {
+		r.problems |= EXIF_VALIDATE_IFD_OUT_OF_BOUNDS;
+		goto out;
+	}
+	exif_data_validate_content (&r, EXIF_IFD_0, d + 6, ds - 6, offset, 0);
+
+	/* exif_data_load_data() gives up here, MakerNote included */
+	n = exif_get_short (d + 6 + offset, r.order);
+	if (offset + 6 + 2 + 12 * n + 4 > ds) {
+		r.problems |= EXIF_VALIDATE_IFD_TRUNCATED;
+		goto out;
+	}
+
+	offset = exif_get_long (d + 6 + offset + 2 + 12 * n, r.order);
+	if (offset) {
+		if (offset > ds - 6)
+			r.problems |= EXIF_VALIDATE_IFD_OUT_OF_BOUNDS;
+		else
+			exif_data_validate_content (&r, EXIF_IFD_1, d + 6, ds - 6, offset, 0);
+	}
+
+	/* Only the Huawei MakerNote is interpreted by default */
+	if (r.maker_note_size &&
+	    !exif_mnote_data_huawei_validate (d + 6, fullds - 6, r.maker_note_offset,
+					      r.maker_note_size, &r.maker_note_entries))
+		r.problems |= EXIF_VALIDATE_MAKER_NOTE_CORRUPT;
+
+out:
+	if (report)
+		*report = r;
+	return !r.problems;
+}
+
+int
+exif_data_patch_entry (ExifData *data, ExifEntry *e, unsigned char *d,
+		       unsigned int size)
+{
+	ExifValidateReport r;
+	const unsigned char *header;
+	unsigned char *t;
+	unsigned int ds = size, ifd_offset, i;
+	ExifIfd ifd;
+	ExifShort n;
+
+	if (!data || !data->priv || !e || !e->data || !e->size || !e->offset ||
+	    !e->parent || (e->parent->parent != data) || !d || !size)
+		return 0;
+	ifd = exif_content_get_ifd (e->parent);
+	if (ifd == EXIF_IFD_COUNT)
+		return 0;
+
+	header = exif_data_find_exif_header (data->priv->log, d, &ds);
+	if (!header)
+		return 0;
+	exif_data_validate (header, ds, &r);
+	if ((r.problems & (EXIF_VALIDATE_NO_EXIF_HEADER | EXIF_VALIDATE_BAD_TIFF_HEADER)) ||
+	    !r.ifd_offset[ifd])
+		return 0;
+	if (r.order != data->priv->order) {
+		exif_log (data->priv->log, EXIF_LOG_CODE_DEBUG, "ExifData",
+			  "Byte order changed since loading, cannot patch in place.");
+		return 0;
+	}
+
+	/* Offsets are relative to the TIFF header, as at load time */
+	t = d + (header - d) + 6;
+	ds -= 6;
+	if (ds > 0xfffe - 6)
+		ds = 0xfffe - 6;
+
+	/*
+	 * Find the directory entry that produced e and make sure the value
+	 * still occupies exactly the same bytes.
+	 */
+	ifd_offset = r.ifd_offset[ifd];
+	n = exif_get_short (t + ifd_offset, r.order);
+	if (CHECKOVERFLOW(ifd_offset + 2, ds, 12*n))
+		n = (ds - ifd_offset - 2) / 12;
+	for (i = 0; i < n; i++) {
+		const unsigned char *entry = t + ifd_offset + 2 + 12 * i;
+		ExifFormat format;
+		ExifLong components, doff;
+		unsigned int s;
+
+		if (exif_get_short (entry, r.order) != e->tag)
+			continue;
+		format = exif_get_short (entry + 2, r.order);
+		components = exif_get_long (entry + 4, r.order);
+		s = exif_format_get_size (format) * components;
+		if ((format != e->format) || (components != e->components) ||
+		    (s != e->size)) {
+			exif_log (data->priv->log, EXIF_LOG_CODE_DEBUG, "ExifData",
+				  "Tag 0x%04x changed size, cannot patch in place.",
+				  e->tag);
+			return 0;
+		}
+		doff = (s > 4) ? exif_get_long (entry + 8, r.order) :
+				 (ExifLong) (entry + 8 - t);
+		if ((doff != e->offset) || CHECKOVERFLOW(doff, ds, s))
+			return 0;
+
+		memcpy (t + doff, e->data, s);
+		return 1;
+	}
+	return 0;
+}
+
+int
+exif_data_patch_thumbnail (ExifData *data, unsigned char **d, unsigned int *ds)
+{
+	ExifValidateReport r;
+	unsigned char *t, *entry;
+	unsigned int end, ifd_offset, i, l;
+	ExifShort n;
+
+	if (!data || !data->priv || !d || !*d || !ds || (*ds < 14) ||
+	    memcmp (*d, ExifHeader, sizeof (ExifHeader)))
+		return 0;
+
+	/* The thumbnail must be there and come last, as saved by
+	 * exif_data_save_data() */
+	exif_data_validate (*d, *ds, &r);
+	if ((r.problems & (EXIF_VALIDATE_NO_EXIF_HEADER | EXIF_VALIDATE_BAD_TIFF_HEADER)) ||
+	    !r.ifd_offset[EXIF_IFD_1] || !r.thumbnail_size ||
+	    (6 + r.thumbnail_offset + r.thumbnail_size != *ds)) {
+		exif_log (data->priv->log, EXIF_LOG_CODE_DEBUG, "ExifData",
+			  "No thumbnail at the end of the data, cannot patch in place.");
+		return 0;
+	}
+	end = 6 + r.thumbnail_offset;
+	t = *d + 6;
+
+	/* Unlink IFD 1, leaving its entries unreferenced, and cut off the
+	 * thumbnail */
+	if (data->remove_thumbnail == 1) {
+		ifd_offset = r.ifd_offset[EXIF_IFD_0];
+		n = exif_get_short (t + ifd_offset, r.order);
+		exif_set_long (t + ifd_offset + 2 + 12 * n, r.order, 0);
+		*ds = end;
+		return 1;
+	}
+
+	/* No thumbnail was loaded, for example because of
+	 * EXIF_DATA_OPTION_IGNORE_THUMBNAIL or THUMBNAIL_BY_REFERENCE. That
+	 * does not mean it is to be removed. */
+	if (!data->data || !data->size) {
+		exif_log (data->priv->log, EXIF_LOG_CODE_DEBUG, "ExifData",
+			  "No thumbnail to patch in.");
+		return 0;
+	}
+
+	/* The thumbnail stays where it is, only its length changes */
+	ifd_offset = r.ifd_offset[EXIF_IFD_1];
+	n = exif_get_short (t + ifd_offset, r.order);
+	if (CHECKOVERFLOW(ifd_offset + 2, *ds - 6, 12*n))
+		n = (*ds - 6 - ifd_offset - 2) / 12;
+	for (i = 0; i < n; i++)
+		if (exif_get_short (t + ifd_offset + 2 + 12 * i, r.order) ==
+		    EXIF_TAG_JPEG_INTERCHANGE_FORMAT_LENGTH)
+			break;
+	if ((i == n) || (data->size > 0xffffffff - end))
+		return 0;
+	entry = t + ifd_offset + 2 + 12 * i;
+	if (exif_get_short (entry + 2, r.order) != EXIF_FORMAT_LONG)
+		return 0;
+	l = entry - *d;
+
+	t = exif_mem_realloc (data->priv->mem, *d, end + data->size);
+	if (!t) {
+		EXIF_LOG_NO_MEMORY (data->priv->log, "ExifData", end + data->size);
+		return 0;
+	}
+	*d = t;
+	*ds = end + data->size;
+	exif_set_long (*d + l + 8, r.order, data->size);
+	memcpy (*d + end, data->data, data->size);
+	return 1;
+}
+
 void
 exif_data_load_data_general (ExifData* data, const unsigned char* d_orig,
 							 unsigned int ds)
@@ -1451,8 +2751,9 @@ exif_data_load_data_general (ExifData* data, const unsigned char* d_orig,
 	ExifShort n;
 	const unsigned char* d = d_orig;
 	unsigned int fullds;
+	ExifSource src;
 
-	if (!data || !data->priv || !d || !ds)
+	if (!data || !data->priv || data->priv->frozen || !d || !ds)
 		return;
 
 	exif_log(data->priv->log, EXIF_LOG_CODE_DEBUG, "ExifData",
@@ -1495,7 +2796,10 @@ exif_data_load_data_general (ExifData* data, const unsigned char* d_orig,
 		return;
 
 	/* Parse the actual exif data (usually offset 14 from start) */
-	exif_data_load_data_content(data, EXIF_IFD_0, d + 6 - 6, ds - 6 + 6, offset, 0);
+	exif_source_init_data(&src, d, ds);
+	data->priv->thumbnail_base = 0;
+	data->priv->thumbnail_size = 0;
+	exif_data_load_data_content(data, EXIF_IFD_0, &src, offset, 0);
 
 	/* IFD 1 offset */
 	n = exif_get_short(d + 6 - 6 + offset, data->priv->order);
@@ -1513,7 +2817,7 @@ exif_data_load_data_general (ExifData* data, const unsigned char* d_orig,
 			exif_log(data->priv->log, EXIF_LOG_CODE_CORRUPT_DATA,
 				"ExifData", "Bogus offset of IFD1.");
 		} else {
-			exif_data_load_data_content(data, EXIF_IFD_1, d + 6 - 6, ds - 6 + 6, offset, 0);
+			exif_data_load_data_content(data, EXIF_IFD_1, &src, offset, 0);
 		}
 	}
 
@@ -1530,15 +2834,73 @@ exif_data_load_data_general (ExifData* data, const unsigned char* d_orig,
 		exif_data_fix(data);
 }
 
+/*! Keep the IFDs just saved to \a d for the next save if they had not
+ *  changed before this one either, \a clean telling which, so that IFDs
+ *  edited before every save are not copied for nothing. All IFDs are
+ *  marked as clean. */
+static void
+exif_data_keep_saved (ExifData *data, const int *clean,
+		      const unsigned char *d, unsigned int ds)
+{
+	ExifDataSaved *s = &data->priv->saved;
+	const ExifDataSaved *saving = &data->priv->saving;
+	unsigned char *t;
+	unsigned int i, l = 0;
+
+	exif_data_drop_saved (s);
+	if (d && (data->priv->options & EXIF_DATA_OPTION_REUSE_UNCHANGED_IFDS)) {
+		for (i = 0; i < EXIF_IFD_COUNT; i++)
+			if (clean[i] && saving->end[i] &&
+			    (saving->end[i] <= ds - 6))
+				l += saving->end[i] - saving->start[i];
+	}
+	for (i = 0; i < EXIF_IFD_COUNT; i++)
+		exif_content_set_dirty (data->ifd[i], 0);
+	if (!l)
+		return;
+
+	t = exif_data_alloc (data, l);
+	if (!t)
+		return;
+	s->buf = exif_buffer_new (data->priv->mem, t, l);
+	if (!s->buf) {
+		exif_mem_free (data->priv->mem, t);
+		return;
+	}
+	s->order = data->priv->order;
+	for (i = 0, l = 0; i < EXIF_IFD_COUNT; i++) {
+		if (!clean[i] || !saving->end[i] || (saving->end[i] > ds - 6))
+			continue;
+		s->start[i] = saving->start[i];
+		s->end[i] = saving->end[i];
+		s->pos[i] = l;
+		memcpy (t + l, d + 6 + s->start[i], s->end[i] - s->start[i]);
+		l += s->end[i] - s->start[i];
+	}
+}
+
 void
 exif_data_save_data (ExifData *data, unsigned char **d, unsigned int *ds)
 {
+	int clean[EXIF_IFD_COUNT];
+	unsigned int i;
+
 	if (ds)
 		*ds = 0;	/* This means something went wrong */
 
 	if (!data || !d || !ds)
 		return;
 
+	/* Frozen data was serialized once by exif_data_freeze() */
+	if (data->priv->frozen) {
+		*d = exif_data_alloc (data, data->priv->clone_cache.buf->size);
+		if (!*d)
+			return;
+		*ds = data->priv->clone_cache.buf->size;
+		memcpy (*d, data->priv->clone_cache.buf->data, *ds);
+		return;
+	}
+
 	/* Header */
 	*ds = 14;
 	*d = exif_data_alloc (data, *ds);
@@ -1569,8 +2931,12 @@ exif_data_save_data (ExifData *data, unsigned char **d, unsigned int *ds)
 	/* Now save IFD 0. IFD 1 will be saved automatically. */
 	exif_log (data->priv->log, EXIF_LOG_CODE_DEBUG, "ExifData",
 		  "Saving IFDs...");
+	for (i = 0; i < EXIF_IFD_COUNT; i++)
+		clean[i] = !exif_content_is_dirty (data->ifd[i]);
+	memset (&data->priv->saving, 0, sizeof (ExifDataSaved));
 	exif_data_save_data_content (data, data->ifd[EXIF_IFD_0], d, ds,
 				     *ds - 6);
+	exif_data_keep_saved (data, clean, *d, *ds);
 	exif_log (data->priv->log, EXIF_LOG_CODE_DEBUG, "ExifData",
 		  "Saved %i byte(s) EXIF data.", *ds);
 }
@@ -1584,6 +2950,16 @@ exif_data_save_data_general(ExifData* data, unsigned char** d, unsigned int* ds)
 	if (!data || !d || !ds)
 		return;
 
+	/* Frozen data: the TIFF part of what exif_data_freeze() serialized */
+	if (data->priv->frozen) {
+		*d = exif_data_alloc (data, data->priv->clone_cache.buf->size - 6);
+		if (!*d)
+			return;
+		*ds = data->priv->clone_cache.buf->size - 6;
+		memcpy (*d, data->priv->clone_cache.buf->data + 6, *ds);
+		return;
+	}
+
 	/* Header 4D 4D 00 2A 00 00 00 08*/
 	*ds = 8;
 	*d = exif_data_alloc(data, *ds);
@@ -1639,7 +3015,7 @@ exif_data_ref (ExifData *data)
 	if (!data)
 		return;
 
-	data->priv->ref_count++;
+	exif_refcount_inc (&data->priv->ref_count);
 }
 
 void
@@ -1648,8 +3024,7 @@ exif_data_unref (ExifData *data)
 	if (!data || !data->priv)
 		return;
 
-	data->priv->ref_count--;
-	if (!data->priv->ref_count) 
+	if (!exif_refcount_dec (&data->priv->ref_count))
 		exif_data_free (data);
 }
 
@@ -1662,6 +3037,18 @@ exif_data_free (ExifData *data)
 	if (!data) 
 		return;
 
+	/* References to frozen entries are references to the data */
+	if (data->priv && data->priv->frozen) {
+		ExifContent *c;
+		unsigned int j;
+
+		for (i = 0; (c = exif_data_get_content (data, i)); i++) {
+			for (j = 0; j < c->count; j++)
+				exif_entry_free_frozen (c->entries[j]);
+			c->count = 0;
+		}
+	}
+
 	for (i = 0; i < EXIF_IFD_COUNT; i++) {
 		if (data->ifd[i]) {
 			exif_content_unref (data->ifd[i]);
@@ -1669,12 +3056,14 @@ exif_data_free (ExifData *data)
 		}
 	}
 
-	if (data->data) {
-		exif_mem_free (mem, data->data);
-		data->data = NULL;
-	}
-
 	if (data->priv) {
+		exif_data_free_sub_ifds (data);
+		exif_data_free_thumbnail (data);
+		exif_buffer_unref (data->priv->buffer);
+		data->priv->buffer = NULL;
+		exif_data_drop_clone_cache (data);
+		exif_data_drop_saved (&data->priv->saved);
+		exif_mem_free (mem, data->priv->frozen_block);
 		if (data->priv->log) {
 			exif_log_unref (data->priv->log);
 			data->priv->log = NULL;
@@ -1765,13 +3154,17 @@ void
 exif_data_set_byte_order (ExifData *data, ExifByteOrder order)
 {
 	ByteOrderChangeData d;
+	unsigned int i;
 
-	if (!data || (order == data->priv->order))
+	if (!data || data->priv->frozen || (order == data->priv->order))
 		return;
 
+	exif_data_drop_clone_cache (data);
 	d.old = data->priv->order;
 	d.new = order;
 	exif_data_foreach_content (data, content_set_byte_order, &d);
+	for (i = 0; i < data->priv->sub_ifds_count; i++)
+		content_set_byte_order (data->priv->sub_ifds[i], &d);
 	data->priv->order = order;
 	if (data->priv->md)
 		exif_mnote_data_set_byte_order (data->priv->md, order);
@@ -1782,7 +3175,7 @@ exif_data_log (ExifData *data, ExifLog *log)
 {
 	unsigned int i;
 
-	if (!data || !data->priv) 
+	if (!data || !data->priv || data->priv->frozen)
 		return;
 	exif_log_unref (data->priv->log);
 	data->priv->log = log;
@@ -1790,6 +3183,8 @@ exif_data_log (ExifData *data, ExifLog *log)
 
 	for (i = 0; i < EXIF_IFD_COUNT; i++)
 		exif_content_log (data->ifd[i], log);
+	for (i = 0; i < data->priv->sub_ifds_count; i++)
+		exif_content_log (data->priv->sub_ifds[i], log);
 }
 
 /* Used internally within libexif */
@@ -1815,6 +3210,14 @@ static const struct {
 	{EXIF_DATA_OPTION_DONT_CHANGE_MAKER_NOTE, N_("Do not change maker note"),
 	 N_("When loading and resaving Exif data, save the maker note unmodified."
 	    " Be aware that the maker note can get corrupted.")},
+	{EXIF_DATA_OPTION_THUMBNAIL_BY_REFERENCE, N_("Thumbnail by reference"),
+	 N_("Only record where the thumbnail lies in the loaded data instead "
+	    "of copying it.")},
+	{EXIF_DATA_OPTION_IGNORE_THUMBNAIL, N_("Ignore thumbnail"),
+	 N_("Do not load the thumbnail.")},
+	{EXIF_DATA_OPTION_REUSE_UNCHANGED_IFDS, N_("Reuse unchanged IFDs"),
+	 N_("Copy IFDs that did not change from the previous save instead "
+	    "of saving them again.")},
 	{0, NULL, NULL}
 };
 
@@ -1843,7 +3246,7 @@ exif_data_option_get_description (ExifDataOption o)
 void
 exif_data_set_option (ExifData *d, ExifDataOption o)
 {
-	if (!d) 
+	if (!d || d->priv->frozen)
 		return;
 
 	d->priv->options |= o;
@@ -1852,10 +3255,14 @@ exif_data_set_option (ExifData *d, ExifDataOption o)
 void
 exif_data_unset_option (ExifData *d, ExifDataOption o)
 {
-	if (!d) 
+	if (!d || d->priv->frozen)
 		return;
 
 	d->priv->options &= ~o;
+
+	/* Entries may be written to directly from now on */
+	if (o & EXIF_DATA_OPTION_REUSE_UNCHANGED_IFDS)
+		exif_data_drop_saved (&d->priv->saved);
 }
 
 static void
@@ -1863,7 +3270,7 @@ fix_func (ExifContent *c, void *UNUSED(data))
 {
 	switch (exif_content_get_ifd (c)) {
 	case EXIF_IFD_1:
-		if (c->parent->data)
+		if (c->parent->data || c->parent->priv->thumbnail_size)
 			exif_content_fix (c);
 		else if (c->count) {
 			exif_log (c->parent->priv->log, EXIF_LOG_CODE_DEBUG, "exif-data",
@@ -1889,13 +3296,16 @@ fix_func (ExifContent *c, void *UNUSED(data))
 void
 exif_data_fix (ExifData *d)
 {
+	if (!d || !d->priv || d->priv->frozen)
+		return;
+	exif_data_drop_clone_cache (d);
 	exif_data_foreach_content (d, fix_func, NULL);
 }
 
 void
 exif_data_set_data_type (ExifData *d, ExifDataType dt)
 {
-	if (!d || !d->priv) 
+	if (!d || !d->priv || d->priv->frozen)
 		return;
 
 	d->priv->data_type = dt;
@@ -42,6 +42,7 @@ typedef struct _ExifDataPrivate ExifDataPrivate;
 #include <libexif/exif-content.h>
 #include <libexif/exif-mnote-data.h>
 #include <libexif/exif-mem.h>
+#include <libexif/exif-source.h>
 
 /*! Represents the entire EXIF data found in an image */
 struct _ExifData
@@ -95,6 +96,51 @@ ExifData *exif_data_new_from_file (const char *path);
 ExifData *exif_data_new_from_data (const unsigned char *data,
 				   unsigned int size);
 
+/*! Allocate a new #ExifData holding the same entries, MakerNote,
+ * thumbnail, byte order, options and data type as \a data, for stamping
+ * a template onto many images.
+ *
+ * The template is serialized once, on its first clone, and the bytes are
+ * kept with it. Each clone gets one copy of those bytes, which its
+ * entries and thumbnail point into instead of owning a copy each. Adding,
+ * removing or initializing entries, loading, fixing or changing the byte
+ * order of the template drops the serialized copy. Values written directly
+ * into the entries of the template after its first clone are only seen by
+ * later clones once marked with #exif_entry_mark_dirty, and those written
+ * into its thumbnail are not seen at all.
+ *
+ * \param[in] data template
+ * \return allocated #ExifData, or NULL on error
+ */
+ExifData *exif_data_clone (ExifData *data);
+
+/*! Make \a data read-only, so that it can be shared between threads.
+ *
+ * Reading frozen data does not change it, so any number of threads may
+ * look up and read entries, read the MakerNote and save or clone the data
+ * at the same time, without locking. Functions that would change the data,
+ * its IFDs or their entries, like loading, fixing, adding or removing
+ * entries, setting options or the byte order, do nothing instead. Writing
+ * into the entries or the thumbnail directly is not allowed. Frozen data
+ * stays frozen; #exif_data_clone gives a writable copy.
+ *
+ * Freezing moves the values of the entries of all IFDs and SubIFDs into
+ * one block. The entries stay where they are, so pointers to them taken
+ * before remain valid. Entries then share the reference count of \a data:
+ * a reference to an entry, including one taken before freezing, keeps the
+ * whole data alive. The data is serialized once, and saving hands out
+ * copies of those bytes. The MakerNote entries are decoded once as well,
+ * in the current locale, and #exif_mnote_data_get_value answers from that
+ * copy, which keeps values of up to 1023 characters.
+ *
+ * \param[in] data EXIF data
+ * \return 1 on success, 0 on error (the data is not frozen then)
+ */
+int exif_data_freeze (ExifData *data);
+
+/*! \return 1 if \a data was frozen by #exif_data_freeze, 0 otherwise */
+int exif_data_is_frozen (ExifData *data);
+
 /*! Load the #ExifData structure from the raw JPEG or EXIF data in the given
  * memory buffer. If the EXIF data contains a recognized MakerNote, it is
  * loaded and stored as well for later retrieval by #exif_data_get_mnote_data.
@@ -111,11 +157,72 @@ void      exif_data_load_data (ExifData *data, const unsigned char *d,
 void      exif_data_load_data_general(ExifData* data, const unsigned char* d,
 				   unsigned int size);
 
+/*! Load the #ExifData structure from a TIFF-based file like DNG, NEF, ARW
+ * or CR2, held in memory. Unlike EXIF data in JPEG files, such files are
+ * not limited to 64 KiB, so offsets are followed across the whole buffer.
+ * Images described by the SubIFDs tag of IFD 0 are loaded as well, see
+ * #exif_data_get_sub_ifd. #exif_data_load_data calls this function for
+ * data starting with a TIFF header.
+ *
+ * \param[in,out] data EXIF data
+ * \param[in] d pointer to the TIFF file, starting with the byte order mark
+ * \param[in] size number of bytes of data at d
+ */
+void      exif_data_load_tiff (ExifData *data, const unsigned char *d,
+			       unsigned int size);
+
+/*! Load the #ExifData structure from a TIFF-based file through an
+ * #ExifSource, as #exif_data_load_tiff does for data in memory. Only the
+ * IFDs, the values they point to and the MakerNote are read, so a source
+ * created with #exif_source_new_from_fd gets the metadata of a large raw
+ * file with a few KiB of I/O. Tag values are copied; the source is not
+ * referenced after this function returns.
+ *
+ * \param[in,out] data EXIF data
+ * \param[in] source TIFF file, starting with the byte order mark
+ */
+void      exif_data_load_source (ExifData *data, ExifSource *source);
+
+/*! Return the number of SubIFDs loaded by #exif_data_load_tiff.
+ *
+ * \param[in] data EXIF data
+ * \return number of SubIFDs
+ */
+unsigned int exif_data_get_sub_ifd_count (ExifData *data);
+
+/*! Return a SubIFD loaded by #exif_data_load_tiff. Its entries use the
+ * same tags as IFD 0 and belong to \a data, but the #ExifContent is not
+ * part of ExifData::ifd and is not saved by #exif_data_save_data.
+ *
+ * \param[in] data EXIF data
+ * \param[in] i index of the SubIFD, in the order of the SubIFDs tag
+ * \return SubIFD, or NULL if there is no such SubIFD
+ */
+ExifContent *exif_data_get_sub_ifd (ExifData *data, unsigned int i);
+
+/*! Return where the thumbnail found by the last load lies, so that it can
+ * be taken from the loaded data when needed. This is useful together with
+ * #EXIF_DATA_OPTION_THUMBNAIL_BY_REFERENCE, which avoids copying it.
+ *
+ * \param[in] data EXIF data
+ * \param[out] offset offset of the thumbnail in the data passed to
+ *   #exif_data_load_data, #exif_data_load_tiff or #exif_data_load_source
+ * \param[out] size size of the thumbnail
+ * \return 1 if a thumbnail was found, 0 otherwise
+ */
+int exif_data_get_thumbnail_ref (ExifData *data, unsigned int *offset,
+				 unsigned int *size);
+
 /*! Store raw EXIF data representing the #ExifData structure into a memory
  * buffer. The buffer is allocated by this function and must subsequently be
  * freed by the caller using the matching free function as used by the #ExifMem
  * in use by this #ExifData.
  *
+ * IFD 0 and the EXIF, GPS and Interoperability IFDs are kept from one save
+ * to the next. An IFD whose entries still have the same values is copied
+ * from the previous save rather than encoded again, so saving after a few
+ * edits costs little more than copying the data.
+ *
  * \param[in] data EXIF data
  * \param[out] d pointer to buffer pointer containing raw EXIF data on return
  * \param[out] ds pointer to variable to hold the number of bytes of
@@ -190,7 +297,21 @@ typedef enum {
 	EXIF_DATA_OPTION_FOLLOW_SPECIFICATION = 1 << 1,
 
 	/*! Leave the MakerNote alone, which could cause it to be corrupted */
-	EXIF_DATA_OPTION_DONT_CHANGE_MAKER_NOTE = 1 << 2
+	EXIF_DATA_OPTION_DONT_CHANGE_MAKER_NOTE = 1 << 2,
+
+	/*! Do not copy the thumbnail into ExifData::data, only record where
+	 *  it lies, see #exif_data_get_thumbnail_ref. The thumbnail is then
+	 *  not saved by #exif_data_save_data. */
+	EXIF_DATA_OPTION_THUMBNAIL_BY_REFERENCE = 1 << 3,
+
+	/*! Do not load the thumbnail at all */
+	EXIF_DATA_OPTION_IGNORE_THUMBNAIL = 1 << 4,
+
+	/*! Copy IFDs that did not change since they were last saved from
+	 *  that save instead of encoding them again in #exif_data_save_data.
+	 *  Entries written to directly must then be marked with
+	 *  #exif_entry_mark_dirty. */
+	EXIF_DATA_OPTION_REUSE_UNCHANGED_IFDS = 1 << 5
 } ExifDataOption;
 
 /*! Return a short textual description of the given #ExifDataOption.
@@ -237,6 +358,174 @@ void         exif_data_set_data_type (ExifData *d, ExifDataType dt);
  */
 ExifDataType exif_data_get_data_type (ExifData *d);
 
+/*! Detect if a MakerNote is one handled by a vendor module.
+ * Same contract as the exif_mnote_data_*_identify functions: return 0 if
+ * not recognized, nonzero (possibly a vendor specific variant) otherwise.
+ */
+typedef int (* ExifMnoteDataIdentifyFunc) (const ExifData *ed,
+					   const ExifEntry *e);
+
+/*! Allocate an empty #ExifMnoteData of a vendor specific type. */
+typedef ExifMnoteData *(* ExifMnoteDataNewFunc) (ExifMem *mem,
+						 ExifDataOption o);
+
+/*! Description of a MakerNote parser used to pick the parser while
+ * loading. A vendor is a candidate when the MakerNote data starts with
+ * \c signature, or (if it has no signature) when the Make tag equals
+ * \c make. A candidate is accepted if it has no \c identify function or
+ * if \c identify returns nonzero.
+ */
+typedef struct _ExifMnoteDataVendor ExifMnoteDataVendor;
+struct _ExifMnoteDataVendor {
+	/*! Name used in log messages */
+	const char *name;
+
+	/*! Leading bytes of the MakerNote data, or NULL */
+	const unsigned char *signature;
+
+	/*! Number of bytes at \c signature */
+	unsigned int signature_size;
+
+	/*! Value of the Make tag, only used if \c signature is NULL */
+	const char *make;
+
+	/*! Optional final check, may be NULL */
+	ExifMnoteDataIdentifyFunc identify;
+
+	/*! Constructor for the #ExifMnoteData */
+	ExifMnoteDataNewFunc new_func;
+};
+
+/*! Register an additional MakerNote parser. Registered parsers are tried
+ * after the built-in ones, in order of registration, for every MakerNote
+ * the built-in parsers do not recognize. The description is copied, but
+ * \c name, \c signature and \c make must stay valid. Up to 16 parsers can
+ * be registered.
+ *
+ * The only built-in parser takes MakerNotes starting with "HUAWEI", so the
+ * lookup by signature mostly serves the parsers registered here. The
+ * Canon, Olympus, Fuji and Pentax parsers of libexif are not exported and
+ * cannot be registered.
+ *
+ * \note Not thread safe; register parsers before loading any data.
+ *
+ * \param[in] vendor parser description
+ * \return 1 on success, 0 if the description is invalid or the
+ *   registry is full
+ */
+int exif_data_register_mnote_vendor (const ExifMnoteDataVendor *vendor);
+
+/*! Structural problems found by #exif_data_validate. */
+typedef enum {
+	EXIF_VALIDATE_NO_EXIF_HEADER		= 1 << 0,
+	EXIF_VALIDATE_BAD_TIFF_HEADER		= 1 << 1,
+	/*! An IFD offset or pointer lies outside the data */
+	EXIF_VALIDATE_IFD_OUT_OF_BOUNDS		= 1 << 2,
+	/*! An IFD announces more entries than the data holds */
+	EXIF_VALIDATE_IFD_TRUNCATED		= 1 << 3,
+	/*! An entry value lies outside the data */
+	EXIF_VALIDATE_ENTRY_OUT_OF_BOUNDS	= 1 << 4,
+	/*! An entry has an unknown format or no components */
+	EXIF_VALIDATE_ENTRY_BAD_FORMAT		= 1 << 5,
+	/*! An IFD points to itself or is referenced more than once */
+	EXIF_VALIDATE_IFD_LOOP			= 1 << 6,
+	/*! IFD nesting exceeds the loader's recursion budget */
+	EXIF_VALIDATE_TOO_DEEP			= 1 << 7,
+	EXIF_VALIDATE_THUMBNAIL_OUT_OF_BOUNDS	= 1 << 8,
+	/*! A recognized MakerNote would be rejected by its parser */
+	EXIF_VALIDATE_MAKER_NOTE_CORRUPT	= 1 << 9
+} ExifValidateProblem;
+
+typedef struct _ExifValidateReport ExifValidateReport;
+struct _ExifValidateReport {
+	/*! Bitwise OR of #ExifValidateProblem */
+	unsigned int problems;
+
+	ExifByteOrder order;
+
+	/*! Offset of each IFD relative to the TIFF header, 0 if absent */
+	unsigned int ifd_offset[EXIF_IFD_COUNT];
+
+	/*! Number of well-formed entries per IFD. Unlike #exif_data_load_data,
+	 *  repeated tags are counted every time. */
+	unsigned int entries[EXIF_IFD_COUNT];
+
+	/*! Number of entries that would be skipped as broken */
+	unsigned int bad_entries;
+
+	/*! Thumbnail location relative to the TIFF header, 0 if absent */
+	unsigned int thumbnail_offset;
+	unsigned int thumbnail_size;
+
+	/*! MakerNote location relative to the TIFF header, 0 if absent */
+	unsigned int maker_note_offset;
+	unsigned int maker_note_size;
+
+	/*! Number of entries in a recognized MakerNote */
+	unsigned int maker_note_entries;
+};
+
+/*! Check the structure of raw JPEG or EXIF data without loading it.
+ *
+ * Walks IFD 0, IFD 1, the EXIF, GPS and Interoperability IFDs and any
+ * recognized MakerNote using the same bounds and recursion limits as
+ * #exif_data_load_data. Nothing is allocated and nothing is logged, so
+ * this is cheap enough to screen untrusted input before parsing it.
+ *
+ * \param[in] d pointer to raw JPEG or EXIF data
+ * \param[in] size number of bytes of data at d
+ * \param[out] report details of what was found, may be NULL
+ * \return 1 if no problems were found, 0 otherwise
+ */
+int exif_data_validate (const unsigned char *d, unsigned int size,
+			ExifValidateReport *report);
+
+/*! Write the value of a loaded entry back into the raw data it was loaded
+ * from, without re-serializing the whole block.
+ *
+ * This only works for edits that keep the entry's format and number of
+ * components, e.g. changing the orientation or a date of the same length.
+ * The raw data must be the buffer the entry was loaded from, or an
+ * identical copy of it, and the byte order must not have been changed
+ * since. In every other case nothing is written and the caller should
+ * fall back to #exif_data_save_data.
+ *
+ * \param[in] data EXIF data containing e
+ * \param[in] e entry to write back
+ * \param[in,out] d raw JPEG or EXIF data passed to #exif_data_load_data
+ * \param[in] size number of bytes of data at d
+ * \return 1 if the value was patched in place, 0 otherwise
+ */
+int exif_data_patch_entry (ExifData *data, ExifEntry *e,
+			   unsigned char *d, unsigned int size);
+
+/*! Replace or remove the thumbnail at the end of raw EXIF data, without
+ * re-serializing the IFDs in front of it.
+ *
+ * If ExifData::remove_thumbnail is set, the thumbnail is cut off and
+ * IFD 1 is unlinked. Otherwise the new thumbnail is taken from
+ * ExifData::data and ExifData::size, the length in IFD 1 is updated and
+ * the new thumbnail written in place of the old one. Everything else is
+ * left byte for byte as it was.
+ *
+ * An empty ExifData::data does not remove the thumbnail, as it is also
+ * what loading with #EXIF_DATA_OPTION_THUMBNAIL_BY_REFERENCE or
+ * #EXIF_DATA_OPTION_IGNORE_THUMBNAIL leaves behind; nothing is changed
+ * then.
+ *
+ * This only works if the raw data already holds a thumbnail as its last
+ * part, as written by #exif_data_save_data. In every other case nothing
+ * is changed and the caller should fall back to #exif_data_save_data.
+ *
+ * \param[in] data EXIF data holding the new thumbnail
+ * \param[in,out] d raw EXIF data starting with the EXIF header, allocated
+ *   with the memory allocator of \a data; may be reallocated
+ * \param[in,out] ds number of bytes of data at *d
+ * \return 1 if the thumbnail was patched in place, 0 otherwise
+ */
+int exif_data_patch_thumbnail (ExifData *data, unsigned char **d,
+			       unsigned int *ds);
+
 /*! Dump all EXIF data to stdout.
  * This is intended for diagnostic purposes only.
  *
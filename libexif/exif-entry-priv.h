@@ -0,0 +1,41 @@
+/* exif-entry-priv.h
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#ifndef LIBEXIF_EXIF_ENTRY_PRIV_H
+#define LIBEXIF_EXIF_ENTRY_PRIV_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <libexif/exif-entry.h>
+
+/*! Let the value of \a e live in \a data, part of the frozen block of its
+ *  ExifData. References to the entry then keep that ExifData alive. */
+void exif_entry_freeze      (ExifEntry *e, unsigned char *data);
+
+/*! Free a frozen entry along with the ExifData holding it */
+void exif_entry_free_frozen (ExifEntry *e);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* !defined(LIBEXIF_EXIF_ENTRY_PRIV_H) */
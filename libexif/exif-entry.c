@@ -22,9 +22,14 @@
 
 #include <config.h>
 
+#include <libexif/exif-buffer.h>
+#include <libexif/exif-content-priv.h>
+#include <libexif/exif-refcount.h>
 #include <libexif/exif-entry.h>
+#include <libexif/exif-entry-priv.h>
 #include <libexif/exif-ifd.h>
 #include <libexif/exif-utils.h>
+#include <libexif/exif-library.h>
 #include <libexif/i18n.h>
 
 #include <libexif/exif-gps-ifd.h>
@@ -43,9 +48,17 @@
 
 struct _ExifEntryPrivate
 {
-	unsigned int ref_count;
+	ExifRefCount ref_count;
 
 	ExifMem *mem;
+
+	/* Set if data may point into a shared load buffer */
+	ExifBuffer *buffer;
+
+	/* Set for the entries of frozen ExifData. Their values live in one
+	 * block owned by the data, and their references keep the data alive.
+	 * See exif_data_freeze(). */
+	int frozen;
 };
 
 /* This function is hidden in exif-data.c */
@@ -99,6 +112,13 @@ exif_entry_realloc (ExifEntry *e, void *d_orig, unsigned int i)
 
 	if (!e || !e->priv) return NULL;
 
+	/* Borrowed data cannot be resized in place, so take a copy */
+	if (exif_buffer_contains (e->priv->buffer, d_orig)) {
+		d = exif_entry_alloc (e, i);
+		if (d) memcpy (d, d_orig, (i < e->size) ? i : e->size);
+		return d;
+	}
+
 	if (!i) { exif_mem_free (e->priv->mem, d_orig); return NULL; }
 
 	d = exif_mem_realloc (e->priv->mem, d_orig, i);
@@ -130,20 +150,56 @@ exif_entry_new_mem (ExifMem *mem)
 	if (!e) return NULL;
 	e->priv = exif_mem_alloc (mem, sizeof (ExifEntryPrivate));
 	if (!e->priv) { exif_mem_free (mem, e); return NULL; }
-	e->priv->ref_count = 1;
+	exif_refcount_init (&e->priv->ref_count, 1);
 
 	e->priv->mem = mem;
 	exif_mem_ref (mem);
+	e->priv->buffer = NULL;
+	e->priv->frozen = 0;
 
 	return e;
 }
 
+/* Used internally within libexif */
+void
+exif_entry_freeze (ExifEntry *e, unsigned char *data)
+{
+	if (!e || !e->priv || e->priv->frozen || !e->parent) return;
+
+	exif_entry_free_data (e);
+	exif_buffer_unref (e->priv->buffer);
+	e->priv->buffer = NULL;
+	e->data = data;
+
+	/* References held besides the one of the IFD now keep the data */
+	while (exif_refcount_dec (&e->priv->ref_count))
+		exif_data_ref (e->parent->parent);
+	e->priv->frozen = 1;
+}
+
+/* Used internally within libexif */
+void
+exif_entry_free_frozen (ExifEntry *e)
+{
+	ExifMem *mem;
+
+	if (!e || !e->priv || !e->priv->frozen) return;
+
+	mem = e->priv->mem;
+	exif_mem_free (mem, e->priv);
+	exif_mem_free (mem, e);
+	exif_mem_unref (mem);
+}
+
 void
 exif_entry_ref (ExifEntry *e)
 {
 	if (!e) return;
 
-	e->priv->ref_count++;
+	if (e->priv->frozen)
+		exif_data_ref (e->parent->parent);
+	else
+		exif_refcount_inc (&e->priv->ref_count);
 }
 
 void
@@ -151,8 +207,9 @@ exif_entry_unref (ExifEntry *e)
 {
 	if (!e || !e->priv) return;
 
-	e->priv->ref_count--;
-	if (!e->priv->ref_count)
+	if (e->priv->frozen)
+		exif_data_unref (e->parent->parent);
+	else if (!exif_refcount_dec (&e->priv->ref_count))
 		exif_entry_free (e);
 }
 
@@ -161,16 +218,47 @@ exif_entry_free (ExifEntry *e)
 {
 	if (!e) return;
 
-	if (e->priv) {
+	if (e->priv && !e->priv->frozen) {
 		ExifMem *mem = e->priv->mem;
-		if (e->data)
-			exif_mem_free (mem, e->data);
+		exif_entry_free_data (e);
+		exif_buffer_unref (e->priv->buffer);
 		exif_mem_free (mem, e->priv);
 		exif_mem_free (mem, e);
 		exif_mem_unref (mem);
 	}
 }
 
+void
+exif_entry_set_buffer (ExifEntry *e, ExifBuffer *buf)
+{
+	if (!e || !e->priv || e->priv->frozen || (e->priv->buffer == buf))
+		return;
+
+	exif_buffer_ref (buf);
+	exif_buffer_unref (e->priv->buffer);
+	e->priv->buffer = buf;
+}
+
+void
+exif_entry_free_data (ExifEntry *e)
+{
+	if (!e || !e->priv || e->priv->frozen)
+		return;
+
+	if (e->data && !exif_buffer_contains (e->priv->buffer, e->data))
+		exif_mem_free (e->priv->mem, e->data);
+	e->data = NULL;
+}
+
+void
+exif_entry_mark_dirty (ExifEntry *e)
+{
+	if (!e || !e->parent)
+		return;
+
+	exif_content_set_dirty (e->parent, 1);
+}
+
 static void
 clear_entry (ExifEntry *e)
 {
@@ -246,6 +334,7 @@ exif_entry_fix (ExifEntry *e)
 	ExifSRational sr;
 
 	if (!e || !e->priv) return;
+	if (e->parent && exif_data_is_frozen (e->parent->parent)) return;
 
 	switch (e->tag) {
 	
@@ -302,10 +391,11 @@ exif_entry_fix (ExifEntry *e)
 					  exif_format_get_size (e->format),
 					  e->format, o));
 
-			exif_mem_free (e->priv->mem, e->data);
+			exif_entry_free_data (e);
 			e->data = newdata;
 			e->size = newsize;
 			e->format = EXIF_FORMAT_SHORT;
+			exif_entry_mark_dirty (e);
 			break;
 		case EXIF_FORMAT_SHORT:
 			/* No conversion necessary */
@@ -343,6 +433,7 @@ exif_entry_fix (ExifEntry *e)
 						EXIF_FORMAT_RATIONAL), o, r);
 			}
 			e->format = EXIF_FORMAT_RATIONAL;
+			exif_entry_mark_dirty (e);
 			exif_entry_log (e, EXIF_LOG_CODE_DEBUG,
 				_("Tag '%s' was of format '%s' (which is "
 				"against specification) and has been "
@@ -376,6 +467,7 @@ exif_entry_fix (ExifEntry *e)
 						EXIF_FORMAT_SRATIONAL), o, sr);
 			}
 			e->format = EXIF_FORMAT_SRATIONAL;
+			exif_entry_mark_dirty (e);
 			exif_entry_log (e, EXIF_LOG_CODE_DEBUG,
 				_("Tag '%s' was of format '%s' (which is "
 				"against specification) and has been "
@@ -398,16 +490,20 @@ exif_entry_fix (ExifEntry *e)
 				"Format has been set to 'undefined'."),
 				exif_format_get_name (e->format));
 			e->format = EXIF_FORMAT_UNDEFINED;
+			exif_entry_mark_dirty (e);
 		}
 
 		/* Some packages like Canon ZoomBrowser EX 4.5 store
 		   only one zero byte followed by 7 bytes of rubbish */
-		if ((e->size >= 8) && (e->data[0] == 0)) {
+		if ((e->size >= 8) && (e->data[0] == 0) &&
+		    memcmp (e->data, "\0\0\0\0\0\0\0\0", 8)) {
 			memcpy(e->data, "\0\0\0\0\0\0\0\0", 8);
+			exif_entry_mark_dirty (e);
 		}
 
 		/* There need to be at least 8 bytes. */
 		if (e->size < 8) {
+			exif_entry_mark_dirty (e);
 			e->data = exif_entry_realloc (e, e->data, 8 + e->size);
 			if (!e->data) {
 				clear_entry(e);
@@ -439,6 +535,7 @@ exif_entry_fix (ExifEntry *e)
 				"start with a format identifier. "
 				"This has been fixed."));
 			memcpy (e->data, "ASCII\0\0\0", 8);
+			exif_entry_mark_dirty (e);
 			break;
 		}
 
@@ -450,6 +547,7 @@ exif_entry_fix (ExifEntry *e)
 		    memcmp (e->data, "UNICODE\0"       , 8) &&
 		    memcmp (e->data, "JIS\0\0\0\0\0"   , 8) &&
 		    memcmp (e->data, "\0\0\0\0\0\0\0\0", 8)) {
+			exif_entry_mark_dirty (e);
 			e->data = exif_entry_realloc (e, e->data, 8 + e->size);
 			if (!e->data) {
 				clear_entry(e);
@@ -912,7 +1010,7 @@ exif_entry_get_value (ExifEntry *e, char *val, unsigned int maxlen)
 		{""    , 0,  0}
 	};
 
-	(void) bindtextdomain (GETTEXT_PACKAGE, LOCALEDIR);
+	exif_library_init ();
 
 	if (!e || !e->parent || !e->parent->parent || !maxlen || !val)
 		return val;
@@ -1547,12 +1645,15 @@ exif_entry_initialize (ExifEntry *e, ExifTag tag)
 	ExifRational r;
 	ExifByteOrder o;
 
-	if (!e || !e->parent || e->data || !e->parent->parent)
+	if (!e || !e->parent || e->data || !e->parent->parent ||
+	    exif_data_is_frozen (e->parent->parent))
 		return;
 	/* We need the byte order */
 	o = exif_data_get_byte_order (e->parent->parent);
+	exif_content_set_dirty (e->parent, 1);
 
 	e->tag = tag;
+	exif_content_sort_entry (e->parent, e);
 
 	if(exif_entry_get_ifd(e) == EXIF_IFD_GPS) {
 	  exif_entry_initialize_gps(e, tag);
@@ -143,6 +143,16 @@ void        exif_entry_initialize (ExifEntry *e, ExifTag tag);
  */
 void        exif_entry_fix        (ExifEntry *entry);
 
+/*! Tell libexif that the tag, format or value of the given EXIF entry was
+ * written to directly. This is only needed with
+ * #EXIF_DATA_OPTION_REUSE_UNCHANGED_IFDS, which otherwise copies the IFD
+ * of the entry from the previous save as it was, and for templates of
+ * #exif_data_clone, whose later clones otherwise miss the change.
+ *
+ * \param[in] entry EXIF entry
+ */
+void        exif_entry_mark_dirty (ExifEntry *entry);
+
 
 /* For your convenience */
 
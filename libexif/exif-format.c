@@ -23,6 +23,7 @@
 #include <config.h>
 
 #include <libexif/exif-format.h>
+#include <libexif/exif-library.h>
 #include <libexif/i18n.h>
 
 #include <stdlib.h>
@@ -56,7 +57,7 @@ exif_format_get_name (ExifFormat format)
 {
 	unsigned int i;
 
-	(void) bindtextdomain (GETTEXT_PACKAGE, LOCALEDIR);
+	exif_library_init ();
 
 	for (i = 0; ExifFormatTable[i].name; i++)
 		if (ExifFormatTable[i].format == format)
@@ -0,0 +1,550 @@
+/* exif-jpeg.c
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#include <config.h>
+
+#if defined(HAVE_COPY_FILE_RANGE) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <libexif/exif-data-priv.h>
+#include <libexif/exif-jpeg-priv.h>
+#include <libexif/exif-log.h>
+#include <libexif/exif-mem.h>
+#include <libexif/exif-source.h>
+#include <libexif/exif-utils.h>
+#include <libexif/i18n.h>
+
+#include <errno.h>
+#include <string.h>
+#include <sys/types.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_SYS_SENDFILE_H
+#include <sys/sendfile.h>
+#endif
+
+#undef JPEG_MARKER_TEM
+#define JPEG_MARKER_TEM  0x01
+#undef JPEG_MARKER_RST0
+#define JPEG_MARKER_RST0 0xd0
+#undef JPEG_MARKER_RST7
+#define JPEG_MARKER_RST7 0xd7
+#undef JPEG_MARKER_SOI
+#define JPEG_MARKER_SOI  0xd8
+#undef JPEG_MARKER_EOI
+#define JPEG_MARKER_EOI  0xd9
+#undef JPEG_MARKER_SOS
+#define JPEG_MARKER_SOS  0xda
+#undef JPEG_MARKER_APP0
+#define JPEG_MARKER_APP0 0xe0
+#undef JPEG_MARKER_APP1
+#define JPEG_MARKER_APP1 0xe1
+
+/* Large enough for any marker segment, and used for the fallback copy */
+#define EXIF_JPEG_BUF_SIZE 65536
+
+/* Upper bound for a single in-kernel copy request */
+#define EXIF_JPEG_COPY_CHUNK 0x40000000
+
+#define CHECKOVERFLOW(offset,datasize,structsize) (( (offset) >= (datasize)) || ((structsize) > (datasize)) || ((offset) > (datasize) - (structsize) ))
+
+static const unsigned char ExifHeader[] = {0x45, 0x78, 0x69, 0x66, 0x00, 0x00};
+
+typedef struct {
+	int fd;
+	unsigned char *buf;
+	unsigned int pos, len;
+} ExifJpegReader;
+
+/*! Skip 0xff fill bytes, a machine word at a time.
+ *
+ * \return first byte that is not 0xff, or \a end
+ */
+const unsigned char *
+exif_jpeg_skip_fill (const unsigned char *d, const unsigned char *end)
+{
+	unsigned long w;
+
+	while ((size_t) (end - d) >= sizeof (w)) {
+		memcpy (&w, d, sizeof (w));
+		if (w != ~0UL)
+			break;
+		d += sizeof (w);
+	}
+	while ((d < end) && (*d == 0xff))
+		d++;
+	return d;
+}
+
+static int
+exif_jpeg_fill (ExifJpegReader *r)
+{
+	for (;;) {
+		ssize_t got = read (r->fd, r->buf, EXIF_JPEG_BUF_SIZE);
+		if (got < 0 && errno == EINTR)
+			continue;
+		if (got <= 0)
+			return 0;
+		r->pos = 0;
+		r->len = (unsigned int) got;
+		return 1;
+	}
+}
+
+/* Read n bytes into d, or skip them if d is NULL */
+static int
+exif_jpeg_read (ExifJpegReader *r, unsigned char *d, unsigned int n)
+{
+	while (n) {
+		unsigned int l;
+
+		if (r->pos == r->len && !exif_jpeg_fill (r))
+			return 0;
+		l = r->len - r->pos;
+		if (l > n)
+			l = n;
+		if (d) {
+			memcpy (d, r->buf + r->pos, l);
+			d += l;
+		}
+		r->pos += l;
+		n -= l;
+	}
+	return 1;
+}
+
+static int
+exif_jpeg_write (int fd, const unsigned char *d, size_t n)
+{
+	while (n) {
+		ssize_t put = write (fd, d, n);
+		if (put < 0 && errno == EINTR)
+			continue;
+		if (put <= 0)
+			return 0;
+		d += put;
+		n -= (size_t) put;
+	}
+	return 1;
+}
+
+/* Copy n bytes of the current segment */
+static int
+exif_jpeg_copy (ExifJpegReader *r, int out_fd, unsigned int n)
+{
+	while (n) {
+		unsigned int l;
+
+		if (r->pos == r->len && !exif_jpeg_fill (r))
+			return 0;
+		l = r->len - r->pos;
+		if (l > n)
+			l = n;
+		if (!exif_jpeg_write (out_fd, r->buf + r->pos, l))
+			return 0;
+		r->pos += l;
+		n -= l;
+	}
+	return 1;
+}
+
+/* Copy everything up to the end of the input */
+static int
+exif_jpeg_copy_rest (ExifJpegReader *r, int out_fd)
+{
+	ssize_t n;
+
+	/* What has already been read must go out first */
+	if (!exif_jpeg_write (out_fd, r->buf + r->pos, r->len - r->pos))
+		return 0;
+	r->pos = r->len;
+
+	/*
+	 * Let the kernel move the image data if it can. Both calls continue
+	 * from the current file offsets and fail up front on descriptors they
+	 * do not support, in which case we fall back to copying ourselves.
+	 */
+#ifdef HAVE_COPY_FILE_RANGE
+	while ((n = copy_file_range (r->fd, NULL, out_fd, NULL,
+				     EXIF_JPEG_COPY_CHUNK, 0)) != 0) {
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+	}
+	if (!n)
+		return 1;
+#endif
+#ifdef HAVE_SENDFILE
+	while ((n = sendfile (out_fd, r->fd, NULL, EXIF_JPEG_COPY_CHUNK)) != 0) {
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+	}
+	if (!n)
+		return 1;
+#endif
+
+	for (;;) {
+		n = read (r->fd, r->buf, EXIF_JPEG_BUF_SIZE);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0)
+			return 0;
+		if (!n)
+			return 1;
+		if (!exif_jpeg_write (out_fd, r->buf, (size_t) n))
+			return 0;
+	}
+}
+
+static int
+exif_jpeg_write_app1 (int out_fd, const unsigned char *d, unsigned int ds)
+{
+	unsigned char m[4];
+
+	if (!d)
+		return 1;
+	m[0] = 0xff;
+	m[1] = JPEG_MARKER_APP1;
+	m[2] = (unsigned char) ((ds + 2) >> 8);
+	m[3] = (unsigned char) (ds + 2);
+	return exif_jpeg_write (out_fd, m, 4) && exif_jpeg_write (out_fd, d, ds);
+}
+
+int
+exif_jpeg_replace_app1 (int in_fd, int out_fd, ExifData *data)
+{
+	ExifJpegReader r;
+	ExifMem *mem;
+	ExifLog *log = NULL;
+	unsigned char *exif = NULL;
+	unsigned int exif_size = 0, l, hl;
+	unsigned char m[4], h[sizeof (ExifHeader)];
+	int inserted = 0, ret = 0;
+
+	if (in_fd < 0 || out_fd < 0)
+		return 0;
+
+	if (data) {
+		log = exif_data_get_log (data);
+		exif_data_save_data (data, &exif, &exif_size);
+		if (!exif || !exif_size)
+			return 0;
+		if (exif_size > 0xffff - 2) {
+			exif_log (log, EXIF_LOG_CODE_CORRUPT_DATA, "ExifJpeg",
+				  _("EXIF data of %u bytes does not fit into APP1."),
+				  exif_size);
+			exif_mem_free (exif_data_get_priv_mem (data), exif);
+			return 0;
+		}
+	}
+
+	mem = exif_mem_new_default ();
+	memset (&r, 0, sizeof (r));
+	r.fd = in_fd;
+	r.buf = exif_mem_alloc (mem, EXIF_JPEG_BUF_SIZE);
+	if (!r.buf) {
+		EXIF_LOG_NO_MEMORY (log, "ExifJpeg", EXIF_JPEG_BUF_SIZE);
+		goto out;
+	}
+
+	if (!exif_jpeg_read (&r, m, 2) || m[0] != 0xff || m[1] != JPEG_MARKER_SOI) {
+		exif_log (log, EXIF_LOG_CODE_CORRUPT_DATA, "ExifJpeg",
+			  _("Input is not a JPEG file."));
+		goto out;
+	}
+	if (!exif_jpeg_write (out_fd, m, 2))
+		goto out;
+
+	for (;;) {
+		/* Markers may be padded with any number of 0xff */
+		if (!exif_jpeg_read (&r, m, 2) || m[0] != 0xff)
+			break;
+		while (m[1] == 0xff)
+			if (!exif_jpeg_read (&r, m + 1, 1))
+				goto corrupt;
+
+		/* Image data follows, which we copy unparsed */
+		if (m[1] == JPEG_MARKER_SOS || m[1] == JPEG_MARKER_EOI) {
+			if (!inserted && !exif_jpeg_write_app1 (out_fd, exif, exif_size))
+				goto out;
+			if (!exif_jpeg_write (out_fd, m, 2))
+				goto out;
+			ret = exif_jpeg_copy_rest (&r, out_fd);
+			goto out;
+		}
+
+		/* Markers without a segment */
+		if (m[1] == JPEG_MARKER_TEM ||
+		    (m[1] >= JPEG_MARKER_RST0 && m[1] <= JPEG_MARKER_RST7)) {
+			if (!exif_jpeg_write (out_fd, m, 2))
+				goto out;
+			continue;
+		}
+
+		if (!exif_jpeg_read (&r, m + 2, 2))
+			break;
+		l = ((unsigned int) m[2] << 8) | m[3];
+		if (l < 2)
+			break;
+		l -= 2;
+		hl = (l < sizeof (h)) ? l : sizeof (h);
+		if (!exif_jpeg_read (&r, h, hl))
+			break;
+
+		/* Drop the old EXIF segment */
+		if (m[1] == JPEG_MARKER_APP1 && hl == sizeof (h) &&
+		    !memcmp (h, ExifHeader, sizeof (h))) {
+			exif_log (log, EXIF_LOG_CODE_DEBUG, "ExifJpeg",
+				  "Dropping EXIF segment of %u bytes.", l);
+			if (!exif_jpeg_read (&r, NULL, l - hl))
+				break;
+			continue;
+		}
+
+		/* EXIF goes right after SOI, or after JFIF if present */
+		if (!inserted && m[1] != JPEG_MARKER_APP0) {
+			if (!exif_jpeg_write_app1 (out_fd, exif, exif_size))
+				goto out;
+			inserted = 1;
+		}
+		if (!exif_jpeg_write (out_fd, m, 4) ||
+		    !exif_jpeg_write (out_fd, h, hl))
+			goto out;
+		if (!exif_jpeg_copy (&r, out_fd, l - hl))
+			break;
+	}
+
+corrupt:
+	exif_log (log, EXIF_LOG_CODE_CORRUPT_DATA, "ExifJpeg",
+		  _("Corrupt or truncated JPEG marker stream."));
+out:
+	exif_mem_free (mem, r.buf);
+	exif_mem_unref (mem);
+	if (exif)
+		exif_mem_free (exif_data_get_priv_mem (data), exif);
+	return ret;
+}
+
+/*! Find the TIFF data in a JPEG file, or a TIFF-based file itself.
+ *
+ * \param[out] tiff offset of the TIFF header
+ * \param[out] size size of the TIFF data
+ * \return 1 if there is TIFF data, 0 otherwise
+ */
+static int
+exif_jpeg_find_tiff (ExifSource *src, unsigned int *tiff, unsigned int *size)
+{
+	unsigned int pos = 2, l, ds = exif_source_get_size (src);
+	const unsigned char *d = exif_source_get (src, 0, 4);
+
+	if (!d)
+		return 0;
+	if (!memcmp (d, "II\x2a\0", 4) || !memcmp (d, "MM\0\x2a", 4)) {
+		*tiff = 0;
+		*size = ds;
+		return 1;
+	}
+	if (d[0] != 0xff || d[1] != JPEG_MARKER_SOI)
+		return 0;
+
+	for (;;) {
+		d = exif_source_get (src, pos, 4);
+		if (!d || d[0] != 0xff)
+			return 0;
+
+		/* Markers may be padded with any number of 0xff */
+		if (d[1] == 0xff) {
+			pos++;
+			continue;
+		}
+		if (d[1] == JPEG_MARKER_SOS || d[1] == JPEG_MARKER_EOI)
+			return 0;
+		if (d[1] == JPEG_MARKER_TEM ||
+		    (d[1] >= JPEG_MARKER_RST0 && d[1] <= JPEG_MARKER_RST7)) {
+			pos += 2;
+			continue;
+		}
+
+		l = ((unsigned int) d[2] << 8) | d[3];
+		if (l < 2 || CHECKOVERFLOW(pos + 2, ds, l))
+			return 0;
+		if (d[1] == JPEG_MARKER_APP1 && l >= 2 + sizeof (ExifHeader)) {
+			d = exif_source_get (src, pos + 4, sizeof (ExifHeader));
+			if (d && !memcmp (d, ExifHeader, sizeof (ExifHeader))) {
+				*tiff = pos + 4 + sizeof (ExifHeader);
+				*size = l - 2 - sizeof (ExifHeader);
+				return 1;
+			}
+		}
+		pos += 2 + l;
+	}
+}
+
+/*! Follow IFD 0 to IFD 1 and read the position of the thumbnail from it.
+ *
+ * \param[out] offset offset of the thumbnail in the source
+ * \param[out] length size of the thumbnail
+ * \return 1 if there is a thumbnail within the TIFF data, 0 otherwise
+ */
+static int
+exif_jpeg_find_thumbnail (ExifSource *src, unsigned int tiff, unsigned int size,
+			  unsigned int *offset, unsigned int *length)
+{
+	const unsigned char *d;
+	ExifByteOrder order;
+	ExifLong o, toff = 0, tlen = 0, v;
+	ExifShort n, i;
+
+	d = exif_source_get (src, tiff, 8);
+	if (!d || (size < 8))
+		return 0;
+	if (!memcmp (d, "II", 2))
+		order = EXIF_BYTE_ORDER_INTEL;
+	else if (!memcmp (d, "MM", 2))
+		order = EXIF_BYTE_ORDER_MOTOROLA;
+	else
+		return 0;
+	if (exif_get_short (d + 2, order) != 0x002a)
+		return 0;
+
+	/* Skip the entries of IFD 0 to get to the offset of IFD 1 */
+	o = exif_get_long (d + 4, order);
+	if (CHECKOVERFLOW(o, size, 2) ||
+	    !(d = exif_source_get (src, tiff + o, 2)))
+		return 0;
+	n = exif_get_short (d, order);
+	if (CHECKOVERFLOW(o + 2, size, 12u * n + 4) ||
+	    !(d = exif_source_get (src, tiff + o + 2 + 12 * n, 4)))
+		return 0;
+	o = exif_get_long (d, order);
+	if (!o || CHECKOVERFLOW(o, size, 2) ||
+	    !(d = exif_source_get (src, tiff + o, 2)))
+		return 0;
+	n = exif_get_short (d, order);
+	if (CHECKOVERFLOW(o + 2, size, 12 * n))
+		n = (size - o - 2) / 12;
+
+	for (i = 0; i < n; i++) {
+		d = exif_source_get (src, tiff + o + 2 + 12 * i, 12);
+		if (!d)
+			return 0;
+		v = (exif_get_short (d + 2, order) == EXIF_FORMAT_SHORT) ?
+			exif_get_short (d + 8, order) : exif_get_long (d + 8, order);
+		switch (exif_get_short (d, order)) {
+		case EXIF_TAG_JPEG_INTERCHANGE_FORMAT:
+			toff = v;
+			break;
+		case EXIF_TAG_JPEG_INTERCHANGE_FORMAT_LENGTH:
+			tlen = v;
+			break;
+		default:
+			break;
+		}
+	}
+	if (!toff || !tlen || CHECKOVERFLOW(toff, size, tlen))
+		return 0;
+	*offset = tiff + toff;
+	*length = tlen;
+	return 1;
+}
+
+/* Copy size bytes at offset of the source to out_fd */
+static int
+exif_jpeg_copy_range (ExifSource *src, int in_fd, unsigned int offset,
+		      unsigned int size, int out_fd)
+{
+	off_t o = offset;
+	ExifMem *mem;
+	unsigned char *buf;
+	unsigned int l;
+	int ret = 1;
+#if defined(HAVE_COPY_FILE_RANGE) || defined(HAVE_SENDFILE)
+	ssize_t n;
+#endif
+
+	/*
+	 * As in exif_jpeg_copy_rest(), let the kernel move the data if it
+	 * can. Both calls take the input offset explicitly here, so a
+	 * partial copy by one of them is simply continued by the next.
+	 */
+#ifdef HAVE_COPY_FILE_RANGE
+	while (size) {
+		n = copy_file_range (in_fd, &o, out_fd, NULL, size, 0);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+		size -= (unsigned int) n;
+	}
+#endif
+#ifdef HAVE_SENDFILE
+	while (size) {
+		n = sendfile (out_fd, in_fd, &o, size);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+		size -= (unsigned int) n;
+	}
+#endif
+	if (!size)
+		return 1;
+
+	mem = exif_mem_new_default ();
+	buf = exif_mem_alloc (mem, EXIF_JPEG_BUF_SIZE);
+	if (!buf)
+		ret = 0;
+	while (ret && size) {
+		l = (size < EXIF_JPEG_BUF_SIZE) ? size : EXIF_JPEG_BUF_SIZE;
+		ret = exif_source_read (src, (unsigned int) o, buf, l) &&
+		      exif_jpeg_write (out_fd, buf, l);
+		o += l;
+		size -= l;
+	}
+	exif_mem_free (mem, buf);
+	exif_mem_unref (mem);
+	return ret;
+}
+
+int
+exif_thumbnail_extract_fd (int in_fd, int out_fd)
+{
+	ExifSource *src;
+	unsigned int tiff, size, offset, length;
+	int ret = 0;
+
+	if (in_fd < 0 || out_fd < 0)
+		return 0;
+	src = exif_source_new_from_fd (in_fd);
+	if (!src)
+		return 0;
+	if (exif_jpeg_find_tiff (src, &tiff, &size) &&
+	    exif_jpeg_find_thumbnail (src, tiff, size, &offset, &length))
+		ret = exif_jpeg_copy_range (src, in_fd, offset, length, out_fd);
+	exif_source_unref (src);
+	return ret;
+}
@@ -0,0 +1,71 @@
+/*! \file exif-jpeg.h
+ * \brief Rewrite the EXIF segment of JPEG files
+ */
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#ifndef LIBEXIF_EXIF_JPEG_H
+#define LIBEXIF_EXIF_JPEG_H
+
+#include <libexif/exif-data.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*! Copy a JPEG file, replacing its EXIF APP1 segment.
+ *
+ * The marker segments in front of the image data are copied one by one,
+ * dropping any existing EXIF APP1 segment and inserting the serialized
+ * data after SOI and any leading APP0 (JFIF) segments. The compressed
+ * image data is then copied in bulk, using sendfile() or
+ * copy_file_range() where available, so the image body is never held in
+ * memory.
+ *
+ * Both descriptors are used from their current file offsets.
+ *
+ * \param[in] in_fd readable descriptor positioned at the start of a JPEG file
+ * \param[in] out_fd writable descriptor receiving the new file
+ * \param[in] data EXIF data to store, or NULL to only strip the EXIF segment
+ * \return 1 on success, 0 on error; on error out_fd may hold partial output
+ */
+int exif_jpeg_replace_app1 (int in_fd, int out_fd, ExifData *data);
+
+/*! Copy the thumbnail embedded in a JPEG or TIFF-based file.
+ *
+ * Only the marker segments up to the EXIF APP1 segment, the TIFF header
+ * and the entry counts of IFD 0 and IFD 1 are read to locate the
+ * thumbnail, which is then copied with copy_file_range() or sendfile()
+ * where available. No #ExifData is built.
+ *
+ * The input is read with pread() from the start of the file, so its file
+ * offset is left alone. The output is written at its current offset.
+ *
+ * \param[in] in_fd readable descriptor of a regular file
+ * \param[in] out_fd writable descriptor receiving the thumbnail
+ * \return 1 on success, 0 if there is no thumbnail or on error; on error
+ *   out_fd may hold partial output
+ */
+int exif_thumbnail_extract_fd (int in_fd, int out_fd);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* !defined(LIBEXIF_EXIF_JPEG_H) */
@@ -0,0 +1,342 @@
+/* exif-json.c
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#include <config.h>
+
+#include <libexif/exif-json.h>
+#include <libexif/exif-utils.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#define EXIF_JSON_BUF_SIZE 4096
+
+typedef struct {
+	ExifJsonWriteFunc write;
+	void *user_data;
+	int ok;
+
+	unsigned int len;
+	char buf[EXIF_JSON_BUF_SIZE];
+} ExifJsonWriter;
+
+static void
+exif_json_flush (ExifJsonWriter *w)
+{
+	if (w->ok && w->len && !w->write (w->user_data, w->buf, w->len))
+		w->ok = 0;
+	w->len = 0;
+}
+
+static void
+exif_json_put (ExifJsonWriter *w, const char *s, unsigned int len)
+{
+	unsigned int l;
+
+	while (len && w->ok) {
+		if (w->len == sizeof (w->buf))
+			exif_json_flush (w);
+		l = sizeof (w->buf) - w->len;
+		if (l > len)
+			l = len;
+		memcpy (w->buf + w->len, s, l);
+		w->len += l;
+		s += l;
+		len -= l;
+	}
+}
+
+static void
+exif_json_puts (ExifJsonWriter *w, const char *s)
+{
+	exif_json_put (w, s, strlen (s));
+}
+
+/*! \return length of the valid UTF-8 sequence at s, 0 if it is not one */
+static unsigned int
+exif_json_utf8_len (const unsigned char *s, unsigned int n)
+{
+	unsigned int l, i;
+
+	if (s[0] < 0x80)
+		return 1;
+	if (s[0] >= 0xc2 && s[0] <= 0xdf)
+		l = 2;
+	else if (s[0] >= 0xe0 && s[0] <= 0xef)
+		l = 3;
+	else if (s[0] >= 0xf0 && s[0] <= 0xf4)
+		l = 4;
+	else
+		return 0;
+	if (l > n)
+		return 0;
+	for (i = 1; i < l; i++)
+		if ((s[i] & 0xc0) != 0x80)
+			return 0;
+
+	/* Overlong forms, surrogates and code points beyond U+10FFFF */
+	if ((s[0] == 0xe0 && s[1] < 0xa0) || (s[0] == 0xed && s[1] > 0x9f) ||
+	    (s[0] == 0xf0 && s[1] < 0x90) || (s[0] == 0xf4 && s[1] > 0x8f))
+		return 0;
+	return l;
+}
+
+/*! Write a string of at most len bytes, up to the first NUL. Bytes that
+ *  are not valid UTF-8 become U+FFFD. */
+static void
+exif_json_string (ExifJsonWriter *w, const unsigned char *s, unsigned int len)
+{
+	char t[8];
+	unsigned int i, start, l;
+
+	exif_json_put (w, "\"", 1);
+	for (i = start = 0; (i < len) && s[i]; i += l) {
+		l = exif_json_utf8_len (s + i, len - i);
+		if (l > 1 || (l == 1 && s[i] >= 0x20 && s[i] != '"' && s[i] != '\\'))
+			continue;
+
+		/* Everything up to here goes out as it is */
+		exif_json_put (w, (const char *) s + start, i - start);
+		if (!l) {
+			exif_json_puts (w, "\\ufffd");
+			l = 1;
+		} else if (s[i] == '"' || s[i] == '\\') {
+			t[0] = '\\';
+			t[1] = s[i];
+			exif_json_put (w, t, 2);
+		} else {
+			snprintf (t, sizeof (t), "\\u%04x", s[i]);
+			exif_json_puts (w, t);
+		}
+		start = i + l;
+	}
+	exif_json_put (w, (const char *) s + start, i - start);
+	exif_json_put (w, "\"", 1);
+}
+
+static void
+exif_json_key (ExifJsonWriter *w, const char *key, int *first)
+{
+	if (!*first)
+		exif_json_put (w, ",", 1);
+	*first = 0;
+	exif_json_string (w, (const unsigned char *) key, strlen (key));
+	exif_json_put (w, ":", 1);
+}
+
+static void
+exif_json_double (ExifJsonWriter *w, double v)
+{
+	char t[32], *c;
+
+	/* Infinity and NaN have no JSON representation */
+	if ((v - v) != 0) {
+		exif_json_puts (w, "null");
+		return;
+	}
+	snprintf (t, sizeof (t), "%.10g", v);
+
+	/* The decimal point depends on the locale */
+	c = strchr (t, ',');
+	if (c)
+		*c = '.';
+	exif_json_puts (w, t);
+}
+
+static void
+exif_json_number (ExifJsonWriter *w, ExifFormat f, const unsigned char *d,
+		  ExifByteOrder o)
+{
+	ExifRational r;
+	ExifSRational sr;
+	char t[32];
+
+	switch (f) {
+	case EXIF_FORMAT_BYTE:
+		snprintf (t, sizeof (t), "%u", d[0]);
+		break;
+	case EXIF_FORMAT_SBYTE:
+		snprintf (t, sizeof (t), "%d", (signed char) d[0]);
+		break;
+	case EXIF_FORMAT_SHORT:
+		snprintf (t, sizeof (t), "%u", exif_get_short (d, o));
+		break;
+	case EXIF_FORMAT_SSHORT:
+		snprintf (t, sizeof (t), "%d", exif_get_sshort (d, o));
+		break;
+	case EXIF_FORMAT_LONG:
+		snprintf (t, sizeof (t), "%lu", (unsigned long) exif_get_long (d, o));
+		break;
+	case EXIF_FORMAT_SLONG:
+		snprintf (t, sizeof (t), "%ld", (long) exif_get_slong (d, o));
+		break;
+	case EXIF_FORMAT_RATIONAL:
+		r = exif_get_rational (d, o);
+		if (!r.denominator)
+			exif_json_puts (w, "null");
+		else
+			exif_json_double (w, (double) r.numerator / r.denominator);
+		return;
+	case EXIF_FORMAT_SRATIONAL:
+		sr = exif_get_srational (d, o);
+		if (!sr.denominator)
+			exif_json_puts (w, "null");
+		else
+			exif_json_double (w, (double) sr.numerator / sr.denominator);
+		return;
+	case EXIF_FORMAT_FLOAT:
+		exif_json_double (w, exif_get_float (d, o));
+		return;
+	case EXIF_FORMAT_DOUBLE:
+		exif_json_double (w, exif_get_double (d, o));
+		return;
+	default:
+		exif_json_puts (w, "null");
+		return;
+	}
+	exif_json_puts (w, t);
+}
+
+static void
+exif_json_entry (ExifJsonWriter *w, ExifEntry *e, ExifByteOrder o)
+{
+	unsigned int fs = exif_format_get_size (e->format), n, i;
+	char v[1024];
+
+	switch (e->format) {
+	case EXIF_FORMAT_ASCII:
+		exif_json_string (w, e->data, e->data ? e->size : 0);
+		return;
+	case EXIF_FORMAT_BYTE:
+	case EXIF_FORMAT_SBYTE:
+	case EXIF_FORMAT_SHORT:
+	case EXIF_FORMAT_SSHORT:
+	case EXIF_FORMAT_LONG:
+	case EXIF_FORMAT_SLONG:
+	case EXIF_FORMAT_RATIONAL:
+	case EXIF_FORMAT_SRATIONAL:
+	case EXIF_FORMAT_FLOAT:
+	case EXIF_FORMAT_DOUBLE:
+		n = (e->data && fs) ? e->size / fs : 0;
+		if (n > e->components)
+			n = e->components;
+		if (n != 1)
+			exif_json_put (w, "[", 1);
+		for (i = 0; i < n; i++) {
+			if (i)
+				exif_json_put (w, ",", 1);
+			exif_json_number (w, e->format, e->data + fs * i, o);
+		}
+		if (n != 1)
+			exif_json_put (w, "]", 1);
+		return;
+	default:
+		exif_entry_get_value (e, v, sizeof (v));
+		exif_json_string (w, (const unsigned char *) v, sizeof (v));
+		return;
+	}
+}
+
+static void
+exif_json_content (ExifJsonWriter *w, ExifContent *c, ExifByteOrder o,
+		   unsigned int options)
+{
+	ExifIfd ifd = exif_content_get_ifd (c);
+	const char *name;
+	char t[8];
+	unsigned int i;
+	int first = 1;
+
+	exif_json_put (w, "{", 1);
+	for (i = 0; i < c->count; i++) {
+		ExifEntry *e = c->entries[i];
+
+		name = (options & EXIF_JSON_OPTION_TAG_IDS) ? NULL :
+			exif_tag_get_name_in_ifd (e->tag, ifd);
+		if (!name) {
+			snprintf (t, sizeof (t), "0x%04x", e->tag);
+			name = t;
+		}
+		exif_json_key (w, name, &first);
+		exif_json_entry (w, e, o);
+	}
+	exif_json_put (w, "}", 1);
+}
+
+static void
+exif_json_mnote (ExifJsonWriter *w, ExifMnoteData *md, unsigned int options)
+{
+	const char *name, *value;
+	char t[16], v[1024];
+	unsigned int i, n = exif_mnote_data_count (md);
+	int first = 1;
+
+	exif_json_put (w, "{", 1);
+	for (i = 0; i < n; i++) {
+		name = (options & EXIF_JSON_OPTION_TAG_IDS) ? NULL :
+			exif_mnote_data_get_name (md, i);
+		if (!name) {
+			snprintf (t, sizeof (t), "0x%04x", exif_mnote_data_get_id (md, i));
+			name = t;
+		}
+		exif_json_key (w, name, &first);
+		value = exif_mnote_data_get_value (md, i, v, sizeof (v));
+		if (value)
+			exif_json_string (w, (const unsigned char *) value, sizeof (v));
+		else
+			exif_json_puts (w, "null");
+	}
+	exif_json_put (w, "}", 1);
+}
+
+int
+exif_data_to_json (ExifData *data, ExifJsonWriteFunc write, void *user_data,
+		   unsigned int options)
+{
+	ExifJsonWriter w;
+	ExifMnoteData *md;
+	ExifByteOrder o;
+	unsigned int i;
+	int first = 1;
+
+	if (!data || !write)
+		return 0;
+	w.write = write;
+	w.user_data = user_data;
+	w.ok = 1;
+	w.len = 0;
+	o = exif_data_get_byte_order (data);
+
+	exif_json_put (&w, "{", 1);
+	for (i = 0; i < EXIF_IFD_COUNT; i++) {
+		if (!data->ifd[i] || !data->ifd[i]->count)
+			continue;
+		exif_json_key (&w, exif_ifd_get_name (i), &first);
+		exif_json_content (&w, data->ifd[i], o, options);
+	}
+	md = exif_data_get_mnote_data (data);
+	if (md && !(options & EXIF_JSON_OPTION_SKIP_MAKER_NOTE)) {
+		exif_json_key (&w, "MakerNote", &first);
+		exif_json_mnote (&w, md, options);
+	}
+	exif_json_put (&w, "}", 1);
+	exif_json_flush (&w);
+	return w.ok;
+}
@@ -0,0 +1,77 @@
+/*! \file exif-json.h
+ * \brief Export EXIF data as JSON
+ */
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#ifndef LIBEXIF_EXIF_JSON_H
+#define LIBEXIF_EXIF_JSON_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <libexif/exif-data.h>
+
+/*! Receive a piece of the JSON output.
+ *
+ * \param[in] user_data data passed to #exif_data_to_json
+ * \param[in] s output, not NUL-terminated
+ * \param[in] len number of bytes at \a s
+ * \return 1 to continue, 0 to stop with an error
+ */
+typedef int (* ExifJsonWriteFunc) (void *user_data, const char *s,
+				   unsigned int len);
+
+/*! Options to configure the output of #exif_data_to_json */
+typedef enum {
+	/*! Leave out the decoded MakerNote */
+	EXIF_JSON_OPTION_SKIP_MAKER_NOTE = 1 << 0,
+
+	/*! Use tag numbers like "0x010f" as keys instead of tag names */
+	EXIF_JSON_OPTION_TAG_IDS = 1 << 1
+} ExifJsonOption;
+
+/*! Write EXIF data as one JSON object.
+ *
+ * There is a member for each IFD that has entries, named as by
+ * #exif_ifd_get_name, holding one member per entry. Integers, rationals
+ * and floating point values are written as numbers, or arrays of numbers
+ * if there are several components, and ASCII values as strings. Values of
+ * other formats are written as the string #exif_entry_get_value gives. The
+ * decoded MakerNote follows as the member "MakerNote", holding the values
+ * of its entries as strings. Unknown tags get their number as key.
+ *
+ * Output is collected in a buffer on the stack and handed to \a write in
+ * pieces of a few KiB; nothing is allocated.
+ *
+ * \param[in] data EXIF data
+ * \param[in] write function receiving the output
+ * \param[in] user_data passed to \a write
+ * \param[in] options bitwise OR of #ExifJsonOption values
+ * \return 1 on success, 0 if \a write failed
+ */
+int exif_data_to_json (ExifData *data, ExifJsonWriteFunc write,
+		       void *user_data, unsigned int options);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* !defined(LIBEXIF_EXIF_JSON_H) */
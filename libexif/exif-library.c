@@ -0,0 +1,68 @@
+/* exif-library.c
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#include <config.h>
+
+#include <libexif/exif-library.h>
+#include <libexif/exif-data-priv.h>
+#include <libexif/i18n.h>
+
+#if defined(HAVE_PTHREAD_H) && defined(HAVE_PTHREAD_ONCE)
+#include <pthread.h>
+#define EXIF_LIBRARY_ONCE 1
+#endif
+
+static void
+exif_library_init_once (void)
+{
+	(void) bindtextdomain (GETTEXT_PACKAGE, LOCALEDIR);
+
+	/* Load the message catalog now rather than on the first lookup */
+	(void) _("Byte");
+
+	exif_data_init_mnote_registry ();
+}
+
+#ifdef EXIF_LIBRARY_ONCE
+
+static pthread_once_t exif_library_once = PTHREAD_ONCE_INIT;
+
+void
+exif_library_init (void)
+{
+	pthread_once (&exif_library_once, exif_library_init_once);
+}
+
+#else
+
+/* Without pthread_once(), concurrent first calls may both do the work.
+ * Each step gives the same result when repeated. */
+static int exif_library_initialized;
+
+void
+exif_library_init (void)
+{
+	if (exif_library_initialized)
+		return;
+	exif_library_init_once ();
+	exif_library_initialized = 1;
+}
+
+#endif
@@ -0,0 +1,47 @@
+/*! \file exif-library.h
+ * \brief One-time initialization of libexif
+ */
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#ifndef LIBEXIF_EXIF_LIBRARY_H
+#define LIBEXIF_EXIF_LIBRARY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*! Set up the global state of libexif: bind the message catalog, load it
+ * for the current locale and build the table of MakerNote parsers.
+ *
+ * Only the first call does anything. With pthread_once() available, any
+ * number of threads may call it at the same time, and the functions that
+ * look up names, titles and values no longer touch global state once it
+ * has returned. libexif calls it itself where needed, so calling it is
+ * optional; doing so at startup moves the work out of the first lookups.
+ * #exif_data_register_mnote_vendor still changes the table of parsers and
+ * must not run while other threads load data.
+ */
+void exif_library_init (void);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* !defined(LIBEXIF_EXIF_LIBRARY_H) */
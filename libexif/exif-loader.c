@@ -22,7 +22,11 @@
 
 #include <config.h>
 
+#include <libexif/exif-buffer.h>
+#include <libexif/exif-data-priv.h>
+#include <libexif/exif-jpeg-priv.h>
 #include <libexif/exif-loader.h>
+#include <libexif/exif-refcount.h>
 #include <libexif/exif-utils.h>
 #include <libexif/i18n.h>
 
@@ -37,6 +41,10 @@
 #define JPEG_MARKER_DHT  0xc4
 #undef JPEG_MARKER_SOI
 #define JPEG_MARKER_SOI  0xd8
+#undef JPEG_MARKER_EOI
+#define JPEG_MARKER_EOI  0xd9
+#undef JPEG_MARKER_SOS
+#define JPEG_MARKER_SOS  0xda
 #undef JPEG_MARKER_DQT
 #define JPEG_MARKER_DQT  0xdb
 #undef JPEG_MARKER_APP0
@@ -67,16 +75,32 @@ typedef enum {
 	EL_READ_SIZE_BYTE_08,
 	EL_READ_SIZE_BYTE_00,
 	EL_SKIP_BYTES,
-	EL_EXIF_FOUND
+	EL_EXIF_FOUND,
+	EL_CAPTURE,
+	EL_DONE,
+	EL_CHUNK_HEADER,
+	EL_BMFF_META,
+	EL_BMFF_EXIF_OFFSET
 } ExifLoaderState;
 
 typedef enum {
 	EL_DATA_FORMAT_UNKNOWN,
 	EL_DATA_FORMAT_EXIF,
 	EL_DATA_FORMAT_JPEG,
-	EL_DATA_FORMAT_FUJI_RAW
+	EL_DATA_FORMAT_FUJI_RAW,
+	EL_DATA_FORMAT_HEIF,
+	EL_DATA_FORMAT_PNG,
+	EL_DATA_FORMAT_WEBP
 } ExifLoaderDataFormat;
 
+/*! Formats made of boxes or chunks that are walked by their lengths */
+#define EL_CHUNKED(eld) (((eld)->data_format == EL_DATA_FORMAT_HEIF) || \
+			 ((eld)->data_format == EL_DATA_FORMAT_PNG) || \
+			 ((eld)->data_format == EL_DATA_FORMAT_WEBP))
+
+/*! Largest 'meta' box or EXIF item or chunk we are willing to buffer */
+#define EL_CHUNK_MAX_SIZE (1024 * 1024)
+
 /*! \internal */
 struct _ExifLoader {
 	ExifLoaderState state;
@@ -92,15 +116,59 @@ struct _ExifLoader {
 	unsigned char *buf;
 	unsigned int bytes_read;
 
-	unsigned int ref_count;
+	ExifRefCount ref_count;
 
 	ExifLog *log;
 	ExifMem *mem;
+
+	/*! Segments to capture, as a mask of #ExifLoaderSegmentType */
+	unsigned int capture;
+
+	/*! Stream offsets of the data written so far and of \c b */
+	unsigned int pos, b_pos;
+
+	/*! Marker of the last segment seen */
+	unsigned char marker;
+
+	/*! Segment currently being captured */
+	unsigned char *seg;
+	unsigned int seg_size, seg_read, seg_offset;
+
+	/*! Captured segments */
+	ExifLoaderSegment *segments;
+	unsigned int segments_count;
+
+	/*! Header of the box or chunk being read */
+	unsigned char hdr[16];
+	unsigned int hdr_len;
+
+	/*! Boxes and chunks: stream offset of the next byte of interest */
+	unsigned int target;
+
+	/*! HEIF: size of the 'Exif' item */
+	unsigned int bmff_len;
 };
 
 /*! Magic number for EXIF header */
 static const unsigned char ExifHeader[] = {0x45, 0x78, 0x69, 0x66, 0x00, 0x00};
 
+/*! Signature of PNG files */
+static const unsigned char PngSignature[] = {0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a};
+
+/*! Signatures of the segments that can be captured */
+static const struct {
+	ExifLoaderSegmentType type;
+	unsigned char marker;
+	const char *signature;
+	unsigned int signature_size;
+} ExifLoaderSegmentTable[] = {
+	{EXIF_LOADER_SEGMENT_XMP, JPEG_MARKER_APP1,
+	 "http://ns.adobe.com/xap/1.0/", sizeof ("http://ns.adobe.com/xap/1.0/")},
+	{EXIF_LOADER_SEGMENT_ICC, JPEG_MARKER_APP2,
+	 "ICC_PROFILE", sizeof ("ICC_PROFILE")},
+	{EXIF_LOADER_SEGMENT_MPF, JPEG_MARKER_APP2, "MPF", sizeof ("MPF")}
+};
+
 static void *
 exif_loader_alloc (ExifLoader *l, unsigned int i)
 {
@@ -117,11 +185,33 @@ exif_loader_alloc (ExifLoader *l, unsigned int i)
 	return NULL;
 }
 
+/*! Number of bytes coming next that the loader is going to skip */
+static unsigned int
+exif_loader_skippable (ExifLoader *eld)
+{
+	if (EL_CHUNKED (eld))
+		return (eld->target > eld->pos) ?
+			eld->target - eld->pos : 0;
+	if (eld->state == EL_SKIP_BYTES)
+		return eld->size;
+	return 0;
+}
+
+/*! Account for bytes skipped without passing them to the loader */
+static void
+exif_loader_skipped (ExifLoader *eld, unsigned int n)
+{
+	eld->pos += n;
+	if (!EL_CHUNKED (eld))
+		eld->size -= n;
+}
+
 void
 exif_loader_write_file (ExifLoader *l, const char *path)
 {
 	FILE *f;
 	int size;
+	unsigned int n;
 	unsigned char data[1024];
 
 	if (!l || !path)
@@ -139,6 +229,11 @@ exif_loader_write_file (ExifLoader *l, const char *path)
 			break;
 		if (!exif_loader_write (l, data, size)) 
 			break;
+
+		/* Seek over large parts we would only read to throw away */
+		n = MIN (exif_loader_skippable (l), 0x7fffffff);
+		if ((n > sizeof (data)) && !fseek (f, (long) n, SEEK_CUR))
+			exif_loader_skipped (l, n);
 	}
 	fclose (f);
 }
@@ -163,18 +258,627 @@ exif_loader_copy (ExifLoader *eld, unsigned char *buf, unsigned int len)
 	return (eld->bytes_read >= eld->size) ? 0 : 1;
 }
 
+/*! Once the EXIF segment of a JPEG file has been read completely, go on
+ * with the segments following it if some of them are to be captured.
+ *
+ * \return 1 if the loader wants more data, 0 if it is done
+ */
+static int
+exif_loader_continue (ExifLoader *eld)
+{
+	if (!eld->capture || (eld->marker != JPEG_MARKER_APP1) ||
+	    !eld->buf || (eld->bytes_read < eld->size))
+		return 0;
+	eld->state = EL_READ;
+	return 1;
+}
+
+/*! Start capturing the segment whose payload of \c eld->size bytes
+ * begins at stream offset \a offset, if it may be one we are looking for.
+ * Otherwise, the segment is skipped.
+ */
+static void
+exif_loader_capture_start (ExifLoader *eld, unsigned int offset)
+{
+	unsigned int i;
+
+	if (!eld->size)
+		return;
+	for (i = 0; i < sizeof (ExifLoaderSegmentTable) /
+			sizeof (ExifLoaderSegmentTable[0]); i++)
+		if ((ExifLoaderSegmentTable[i].marker == eld->marker) &&
+		    (ExifLoaderSegmentTable[i].type & eld->capture))
+			break;
+	if (i == sizeof (ExifLoaderSegmentTable) /
+		 sizeof (ExifLoaderSegmentTable[0]))
+		return;
+
+	eld->seg = exif_loader_alloc (eld, eld->size);
+	if (!eld->seg)
+		return;
+	eld->seg_size = eld->size;
+	eld->seg_read = 0;
+	eld->seg_offset = offset;
+	eld->size = 0;
+	eld->state = EL_CAPTURE;
+}
+
+/*! Keep the segment just read if its signature matches, and go on
+ * reading markers.
+ */
+static void
+exif_loader_capture_done (ExifLoader *eld)
+{
+	ExifLoaderSegment *s;
+	unsigned int i;
+
+	eld->state = EL_READ;
+	for (i = 0; i < sizeof (ExifLoaderSegmentTable) /
+			sizeof (ExifLoaderSegmentTable[0]); i++)
+		if ((ExifLoaderSegmentTable[i].marker == eld->marker) &&
+		    (ExifLoaderSegmentTable[i].type & eld->capture) &&
+		    (eld->seg_size >= ExifLoaderSegmentTable[i].signature_size) &&
+		    !memcmp (eld->seg, ExifLoaderSegmentTable[i].signature,
+			     ExifLoaderSegmentTable[i].signature_size))
+			break;
+	if (i == sizeof (ExifLoaderSegmentTable) /
+		 sizeof (ExifLoaderSegmentTable[0])) {
+		exif_mem_free (eld->mem, eld->seg);
+		eld->seg = NULL;
+		return;
+	}
+
+	s = exif_mem_realloc (eld->mem, eld->segments,
+			      sizeof (ExifLoaderSegment) * (eld->segments_count + 1));
+	if (!s) {
+		EXIF_LOG_NO_MEMORY (eld->log, "ExifLoader",
+				    sizeof (ExifLoaderSegment) * (eld->segments_count + 1));
+		exif_mem_free (eld->mem, eld->seg);
+		eld->seg = NULL;
+		return;
+	}
+	eld->segments = s;
+	s += eld->segments_count++;
+	s->type = ExifLoaderSegmentTable[i].type;
+	s->offset = eld->seg_offset;
+	s->data = eld->seg;
+	s->size = eld->seg_size;
+	eld->seg = NULL;
+	exif_log (eld->log, EXIF_LOG_CODE_DEBUG, "ExifLoader",
+		  "Captured %u byte(s) of '%s' at offset %u.", s->size,
+		  ExifLoaderSegmentTable[i].signature, s->offset);
+}
+
+/*! Check for the 'ftyp' box of a HEIF or AVIF file */
+static int
+exif_loader_is_bmff (const unsigned char *b)
+{
+	static const char *brands[] = {
+		"heic", "heix", "hevc", "hevx", "heim", "heis", "hevm", "hevs",
+		"mif1", "msf1", "avif", "avis"
+	};
+	unsigned int i;
+
+	if (memcmp (b + 4, "ftyp", 4))
+		return 0;
+	for (i = 0; i < sizeof (brands) / sizeof (brands[0]); i++)
+		if (!memcmp (b + 8, brands[i], 4))
+			return 1;
+	return 0;
+}
+
+/*! Step to the next box in d. Boxes with 64-bit sizes are only accepted
+ * if the size fits into 32 bits.
+ *
+ * \return 1 if a box has been found, 0 at the end of the data or on error
+ */
+static int
+exif_loader_bmff_next (const unsigned char **d, unsigned int *ds,
+		       const unsigned char **type,
+		       const unsigned char **payload, unsigned int *size)
+{
+	unsigned int s, h = 8;
+
+	if (*ds < 8)
+		return 0;
+	s = exif_get_long (*d, EXIF_BYTE_ORDER_MOTOROLA);
+	if (s == 1) {
+		if ((*ds < 16) || exif_get_long (*d + 8, EXIF_BYTE_ORDER_MOTOROLA))
+			return 0;
+		s = exif_get_long (*d + 12, EXIF_BYTE_ORDER_MOTOROLA);
+		h = 16;
+	} else if (!s)
+		s = *ds;
+	if ((s < h) || (s > *ds))
+		return 0;
+
+	*type = *d + 4;
+	*payload = *d + h;
+	*size = s - h;
+	*d += s;
+	*ds -= s;
+	return 1;
+}
+
+/*! Find the first child box of the given type */
+static const unsigned char *
+exif_loader_bmff_find (const unsigned char *d, unsigned int ds,
+		       const char *type, unsigned int *size)
+{
+	const unsigned char *t, *p;
+
+	while (exif_loader_bmff_next (&d, &ds, &t, &p, size))
+		if (!memcmp (t, type, 4))
+			return p;
+	return NULL;
+}
+
+/*! Read a big-endian field of 0, 4 or 8 bytes that must fit into 32 bits */
+static int
+exif_loader_bmff_get (const unsigned char **d, const unsigned char *end,
+		      unsigned int n, unsigned int *v)
+{
+	if ((unsigned int) (end - *d) < n)
+		return 0;
+	switch (n) {
+	case 0:
+		*v = 0;
+		break;
+	case 2:
+		*v = exif_get_short (*d, EXIF_BYTE_ORDER_MOTOROLA);
+		break;
+	case 4:
+		*v = exif_get_long (*d, EXIF_BYTE_ORDER_MOTOROLA);
+		break;
+	case 8:
+		if (exif_get_long (*d, EXIF_BYTE_ORDER_MOTOROLA))
+			return 0;
+		*v = exif_get_long (*d + 4, EXIF_BYTE_ORDER_MOTOROLA);
+		break;
+	default:
+		return 0;
+	}
+	*d += n;
+	return 1;
+}
+
+/*! Look up the 'Exif' item in the payload of a 'meta' box.
+ *
+ * \param[in] m payload of the 'meta' box, starting with version and flags
+ * \param[in] ms size of the payload
+ * \param[out] method construction method (0: file offset, 1: 'idat')
+ * \param[out] offset offset of the item
+ * \param[out] length size of the item
+ * \return 1 if the item has been found, 0 otherwise
+ */
+static int
+exif_loader_bmff_find_exif (const unsigned char *m, unsigned int ms,
+			    unsigned int *method, unsigned int *offset,
+			    unsigned int *length)
+{
+	const unsigned char *p, *end, *t, *infe;
+	unsigned int ps, infe_size, v, id = 0, n, i, j, item;
+	unsigned int offset_size, length_size, base_size, index_size, base;
+	unsigned int extents, idx;
+
+	if (ms < 4)
+		return 0;
+	m += 4;
+	ms -= 4;
+
+	/* Item information: which item is the 'Exif' one? */
+	p = exif_loader_bmff_find (m, ms, "iinf", &ps);
+	if (!p || (ps < 4))
+		return 0;
+	v = p[0];
+	p += (v ? 8 : 6);
+	ps = (ps < (v ? 8u : 6u)) ? 0 : ps - (v ? 8 : 6);
+	while (exif_loader_bmff_next (&p, &ps, &t, &infe, &infe_size)) {
+		if (memcmp (t, "infe", 4) || (infe_size < 4) || (infe[0] < 2))
+			continue;
+		v = infe[0];
+		end = infe + infe_size;
+		infe += 4;
+		if (!exif_loader_bmff_get (&infe, end, (v == 2) ? 2 : 4, &item) ||
+		    (end - infe < 6))
+			continue;
+		if (!memcmp (infe + 2, "Exif", 4)) {
+			id = item;
+			break;
+		}
+	}
+	if (!id)
+		return 0;
+
+	/* Item location */
+	p = exif_loader_bmff_find (m, ms, "iloc", &ps);
+	if (!p || (ps < 8))
+		return 0;
+	end = p + ps;
+	v = p[0];
+	offset_size = p[4] >> 4;
+	length_size = p[4] & 0x0f;
+	base_size = p[5] >> 4;
+	index_size = ((v == 1) || (v == 2)) ? (p[5] & 0x0f) : 0;
+	p += 6;
+	if (!exif_loader_bmff_get (&p, end, (v < 2) ? 2 : 4, &n))
+		return 0;
+	for (i = 0; i < n; i++) {
+		*method = 0;
+		if (!exif_loader_bmff_get (&p, end, (v < 2) ? 2 : 4, &item))
+			return 0;
+		if ((v == 1) || (v == 2)) {
+			if (!exif_loader_bmff_get (&p, end, 2, method))
+				return 0;
+			*method &= 0x0f;
+		}
+		/* data_reference_index */
+		if (!exif_loader_bmff_get (&p, end, 2, &j) ||
+		    !exif_loader_bmff_get (&p, end, base_size, &base) ||
+		    !exif_loader_bmff_get (&p, end, 2, &extents))
+			return 0;
+		for (j = 0; j < extents; j++) {
+			if (!exif_loader_bmff_get (&p, end, index_size, &idx) ||
+			    !exif_loader_bmff_get (&p, end, offset_size, offset) ||
+			    !exif_loader_bmff_get (&p, end, length_size, length))
+				return 0;
+		}
+		if (item != id)
+			continue;
+
+		/* Items split into several extents are not supported */
+		if ((extents != 1) || (*method > 1) ||
+		    (*offset > 0xffffffff - base))
+			return 0;
+		*offset += base;
+		return 1;
+	}
+	return 0;
+}
+
+/*! Set up the loader buffer for an 'Exif' item. The item starts with the
+ * offset of the TIFF header, which is preceded by the EXIF header in
+ * practice. We store the EXIF header ourselves and skip everything in
+ * front of the TIFF header, so that the buffer looks the same as for
+ * JPEG files.
+ *
+ * \param[in] p first four bytes of the item
+ * \return number of bytes to skip before the TIFF header, or -1 on error
+ */
+static long
+exif_loader_bmff_start_exif (ExifLoader *eld, const unsigned char *p)
+{
+	ExifLong t = exif_get_long (p, EXIF_BYTE_ORDER_MOTOROLA);
+
+	if ((eld->bmff_len < 4) || (t > eld->bmff_len - 4) ||
+	    (eld->bmff_len > EL_CHUNK_MAX_SIZE)) {
+		exif_log (eld->log, EXIF_LOG_CODE_CORRUPT_DATA, "ExifLoader",
+			  _("Invalid 'Exif' item of %u bytes."), eld->bmff_len);
+		return -1;
+	}
+	eld->size = sizeof (ExifHeader) + eld->bmff_len - 4 - t;
+	eld->buf = exif_loader_alloc (eld, eld->size);
+	if (!eld->buf)
+		return -1;
+	memcpy (eld->buf, ExifHeader, sizeof (ExifHeader));
+	eld->bytes_read = sizeof (ExifHeader);
+	return t;
+}
+
+/*! The 'meta' box has been read. Find out where the EXIF data is. */
+static int
+exif_loader_bmff_meta (ExifLoader *eld, unsigned int pos)
+{
+	unsigned int method, offset, length, idat_size;
+	const unsigned char *idat;
+	long t;
+	int ret = 0;
+
+	eld->state = EL_DONE;
+	if (!exif_loader_bmff_find_exif (eld->seg, eld->seg_size, &method,
+					 &offset, &length)) {
+		exif_log (eld->log, EXIF_LOG_CODE_DEBUG, "ExifLoader",
+			  "No 'Exif' item found.");
+		goto out;
+	}
+	eld->bmff_len = length;
+
+	if (method == 1) {
+		/* The item is stored in the 'meta' box itself */
+		idat = exif_loader_bmff_find (eld->seg + 4, eld->seg_size - 4,
+					      "idat", &idat_size);
+		if (!idat || (offset > idat_size) || (length > idat_size - offset) ||
+		    (length < 4))
+			goto out;
+		t = exif_loader_bmff_start_exif (eld, idat + offset);
+		if (t < 0)
+			goto out;
+		memcpy (eld->buf + eld->bytes_read, idat + offset + 4 + t,
+			eld->size - eld->bytes_read);
+		eld->bytes_read = eld->size;
+		goto out;
+	}
+
+	if (offset < pos) {
+		exif_log (eld->log, EXIF_LOG_CODE_CORRUPT_DATA, "ExifLoader",
+			  _("The 'Exif' item precedes the 'meta' box."));
+		goto out;
+	}
+	exif_log (eld->log, EXIF_LOG_CODE_DEBUG, "ExifLoader",
+		  "'Exif' item of %u bytes at offset %u.", length, offset);
+	eld->target = offset;
+	eld->hdr_len = 0;
+	eld->state = EL_BMFF_EXIF_OFFSET;
+	ret = 1;
+
+out:
+	exif_mem_free (eld->mem, eld->seg);
+	eld->seg = NULL;
+	return ret;
+}
+
+/*! A box header has been read. Buffer 'meta', skip anything else. */
+static int
+exif_loader_bmff_box (ExifLoader *eld, unsigned int pos)
+{
+	unsigned int s = exif_get_long (eld->hdr, EXIF_BYTE_ORDER_MOTOROLA);
+	unsigned int start = pos - eld->hdr_len;
+
+	eld->hdr_len = 0;
+	if (s == 1) {
+		if (exif_get_long (eld->hdr + 8, EXIF_BYTE_ORDER_MOTOROLA))
+			s = 0xffffffff;
+		else
+			s = exif_get_long (eld->hdr + 12, EXIF_BYTE_ORDER_MOTOROLA);
+	}
+	if (!s || (s > 0xffffffff - start) || (s < pos - start)) {
+		/* The box extends to the end of the file, or past 4 GiB */
+		exif_log (eld->log, EXIF_LOG_CODE_DEBUG, "ExifLoader",
+			  "No 'meta' box found.");
+		eld->state = EL_DONE;
+		return 0;
+	}
+
+	if (memcmp (eld->hdr + 4, "meta", 4)) {
+		eld->target = start + s;
+		return 1;
+	}
+
+	eld->seg_size = s - (pos - start);
+	if (eld->seg_size > EL_CHUNK_MAX_SIZE) {
+		exif_log (eld->log, EXIF_LOG_CODE_CORRUPT_DATA, "ExifLoader",
+			  _("The 'meta' box of %u bytes is too large."),
+			  eld->seg_size);
+		eld->state = EL_DONE;
+		return 0;
+	}
+	eld->seg = exif_loader_alloc (eld, eld->seg_size);
+	if (!eld->seg) {
+		eld->state = EL_DONE;
+		return 0;
+	}
+	eld->seg_read = 0;
+	eld->state = EL_BMFF_META;
+	return 1;
+}
+
+/*! Set up the loader buffer for an EXIF chunk of \a len bytes. As for
+ * HEIF, we store the EXIF header in front of the TIFF data.
+ */
+static int
+exif_loader_chunk_start_exif (ExifLoader *eld, unsigned int len)
+{
+	if (!len || (len > EL_CHUNK_MAX_SIZE)) {
+		exif_log (eld->log, EXIF_LOG_CODE_CORRUPT_DATA, "ExifLoader",
+			  _("Invalid EXIF chunk of %u bytes."), len);
+		eld->state = EL_DONE;
+		return 0;
+	}
+	eld->size = sizeof (ExifHeader) + len;
+	eld->buf = exif_loader_alloc (eld, eld->size);
+	if (!eld->buf) {
+		eld->state = EL_DONE;
+		return 0;
+	}
+	memcpy (eld->buf, ExifHeader, sizeof (ExifHeader));
+	eld->bytes_read = sizeof (ExifHeader);
+	eld->state = EL_EXIF_FOUND;
+	return 1;
+}
+
+/*! A PNG or WebP chunk header has been read. Read the chunk if it
+ * carries EXIF data, skip it otherwise.
+ *
+ * \param[in] pos stream offset of the chunk data
+ */
+static int
+exif_loader_chunk (ExifLoader *eld, unsigned int pos)
+{
+	unsigned int s, end;
+
+	eld->hdr_len = 0;
+	if (eld->data_format == EL_DATA_FORMAT_PNG) {
+
+		/* Length, type, data, CRC */
+		s = exif_get_long (eld->hdr, EXIF_BYTE_ORDER_MOTOROLA);
+		if (!memcmp (eld->hdr + 4, "eXIf", 4))
+			return exif_loader_chunk_start_exif (eld, s);
+		if (!memcmp (eld->hdr + 4, "IEND", 4))
+			s = 0xffffffff;
+		else if (s <= 0x7fffffff)
+			s += 4;
+	} else {
+
+		/* FourCC, little-endian size, data padded to even size */
+		s = exif_get_long (eld->hdr + 4, EXIF_BYTE_ORDER_INTEL);
+		if (!memcmp (eld->hdr, "EXIF", 4))
+			return exif_loader_chunk_start_exif (eld, s);
+		if (s < 0xffffffff)
+			s += s & 1;
+	}
+
+	end = pos + s;
+	if ((s > 0x7fffffff) || (end < pos)) {
+		exif_log (eld->log, EXIF_LOG_CODE_DEBUG, "ExifLoader",
+			  "No EXIF chunk found.");
+		eld->state = EL_DONE;
+		return 0;
+	}
+	eld->target = end;
+	return 1;
+}
+
+/*! Once the EXIF data of a box or chunk has been read, we are done.
+ * Some writers put an EXIF header of their own in front of the TIFF data
+ * of PNG and WebP files; drop it so that there is only ours.
+ */
+static void
+exif_loader_chunk_done (ExifLoader *eld)
+{
+	unsigned int h = sizeof (ExifHeader);
+
+	if (!eld->buf || (eld->bytes_read < eld->size))
+		return;
+	eld->state = EL_DONE;
+	if ((eld->size < 2 * h) || memcmp (eld->buf + h, ExifHeader, h))
+		return;
+	memmove (eld->buf + h, eld->buf + 2 * h, eld->size - 2 * h);
+	eld->size -= h;
+	eld->bytes_read -= h;
+}
+
+/*! Walk the boxes of a HEIF or AVIF file, or the chunks of a PNG or
+ * WebP file.
+ *
+ * \param[in] pos stream offset of buf
+ */
+static unsigned char
+exif_loader_write_chunks (ExifLoader *eld, const unsigned char *buf,
+			unsigned int len, unsigned int pos)
+{
+	unsigned int i;
+	long t;
+
+	while (len) {
+		/* Skip whatever lies in front of the next part we need */
+		if (pos < eld->target) {
+			i = MIN (len, eld->target - pos);
+			buf += i;
+			len -= i;
+			pos += i;
+			continue;
+		}
+
+		switch (eld->state) {
+		case EL_CHUNK_HEADER:
+		case EL_BMFF_EXIF_OFFSET:
+			if (eld->state == EL_BMFF_EXIF_OFFSET)
+				i = 4;
+			else if ((eld->data_format == EL_DATA_FORMAT_HEIF) &&
+				 (eld->hdr_len >= 8) &&
+				 (exif_get_long (eld->hdr, EXIF_BYTE_ORDER_MOTOROLA) == 1))
+				i = 16;
+			else
+				i = 8;
+			i = MIN (len, i - eld->hdr_len);
+			memcpy (eld->hdr + eld->hdr_len, buf, i);
+			eld->hdr_len += i;
+			buf += i;
+			len -= i;
+			pos += i;
+			if ((eld->hdr_len < 4) || ((eld->hdr_len < 8) &&
+			    (eld->state == EL_CHUNK_HEADER)))
+				break;
+
+			if (eld->state == EL_BMFF_EXIF_OFFSET) {
+				t = exif_loader_bmff_start_exif (eld, eld->hdr);
+				if (t < 0) {
+					eld->state = EL_DONE;
+					return 0;
+				}
+				eld->target = pos + t;
+				eld->state = EL_EXIF_FOUND;
+				break;
+			}
+			if (eld->data_format != EL_DATA_FORMAT_HEIF) {
+				if (!exif_loader_chunk (eld, pos))
+					return 0;
+				break;
+			}
+			if ((eld->hdr_len == 8) &&
+			    (exif_get_long (eld->hdr, EXIF_BYTE_ORDER_MOTOROLA) == 1))
+				break;
+			if (!exif_loader_bmff_box (eld, pos))
+				return 0;
+			break;
+
+		case EL_BMFF_META:
+			i = MIN (len, eld->seg_size - eld->seg_read);
+			memcpy (eld->seg + eld->seg_read, buf, i);
+			eld->seg_read += i;
+			buf += i;
+			len -= i;
+			pos += i;
+			if ((eld->seg_read == eld->seg_size) &&
+			    !exif_loader_bmff_meta (eld, pos))
+				return 0;
+			break;
+
+		case EL_EXIF_FOUND:
+			if (exif_loader_copy (eld, (unsigned char *) buf, len))
+				return 1;
+			exif_loader_chunk_done (eld);
+			return 0;
+
+		default:
+			return 0;
+		}
+	}
+	return (eld->state == EL_DONE) ? 0 : 1;
+}
+
 unsigned char
 exif_loader_write (ExifLoader *eld, unsigned char *buf, unsigned int len)
 {
 	unsigned int i;
+	unsigned char *start = buf;
+	unsigned int pos;
+
+	if (!eld || (len && !buf))
+		return 0;
+	pos = eld->pos;
+	eld->pos += len;
+	if (EL_CHUNKED (eld))
+		return exif_loader_write_chunks (eld, buf, len, pos);
 
 begin:
 	if (!eld || (len && !buf))
 		return 0;
 
 	switch (eld->state) {
+	case EL_DONE:
+		return 0;
 	case EL_EXIF_FOUND:
-		return exif_loader_copy (eld, buf, len);
+		i = eld->size - eld->bytes_read;
+		if (exif_loader_copy (eld, buf, len))
+			return 1;
+		if (!exif_loader_continue (eld))
+			return 0;
+		buf += i;
+		len -= i;
+		eld->b_len = 0;
+		break;
+	case EL_CAPTURE:
+		i = MIN (len, eld->seg_size - eld->seg_read);
+		memcpy (eld->seg + eld->seg_read, buf, i);
+		eld->seg_read += i;
+		if (eld->seg_read < eld->seg_size)
+			return 1;
+		buf += i;
+		len -= i;
+		eld->b_len = 0;
+		exif_loader_capture_done (eld);
+		break;
 	case EL_SKIP_BYTES:
 		if (eld->size > len) { 
 			eld->size -= len; 
@@ -204,12 +908,28 @@ begin:
 	exif_log (eld->log, EXIF_LOG_CODE_DEBUG, "ExifLoader",
 		  "Scanning %i byte(s) of data...", len);
 
+	/*
+	 * Between two JPEG segments, get over fill bytes in bulk instead
+	 * of feeding them through the small buffer one by one.
+	 */
+	if ((eld->state == EL_READ) && !eld->b_len &&
+	    (eld->data_format == EL_DATA_FORMAT_JPEG)) {
+		const unsigned char *m = exif_jpeg_skip_fill (buf, buf + len);
+
+		len -= m - buf;
+		buf = (unsigned char *) m;
+		if (!len)
+			return 1;
+	}
+
 	/*
 	 * First fill the small buffer. Only continue if the buffer
 	 * is filled. Note that EXIF data contains at least 12 bytes.
 	 */
 	i = MIN (len, sizeof (eld->b) - eld->b_len);
 	if (i) {
+		if (!eld->b_len)
+			eld->b_pos = pos + (buf - start);
 		memcpy (&eld->b[eld->b_len], buf, i);
 		eld->b_len += i;
 		if (eld->b_len < sizeof (eld->b)) 
@@ -235,6 +955,32 @@ begin:
 			/* Read the size (2 bytes). */
 			eld->data_format = EL_DATA_FORMAT_EXIF;
 			eld->state = EL_READ_SIZE_BYTE_08;
+
+		} else if (exif_loader_is_bmff (eld->b)) {
+			eld->data_format = EL_DATA_FORMAT_HEIF;
+		} else if (!memcmp (eld->b, PngSignature, sizeof (PngSignature))) {
+
+			/* The first chunk follows the signature */
+			eld->data_format = EL_DATA_FORMAT_PNG;
+			eld->target = eld->b_pos + sizeof (PngSignature);
+
+		} else if (!memcmp (eld->b, "RIFF", 4) &&
+			   !memcmp (eld->b + 8, "WEBP", 4)) {
+
+			/* The first chunk follows the RIFF header */
+			eld->data_format = EL_DATA_FORMAT_WEBP;
+			eld->target = eld->b_pos + 12;
+		}
+
+		if (EL_CHUNKED (eld)) {
+
+			/* Walk the boxes or chunks, starting with the small buffer */
+			eld->state = EL_CHUNK_HEADER;
+			if (!exif_loader_write_chunks (eld, eld->b, sizeof (eld->b),
+						     eld->b_pos))
+				return 0;
+			return exif_loader_write_chunks (eld, buf, len,
+						       pos + (buf - start));
 		}
 	default:
 		break;
@@ -243,10 +989,23 @@ begin:
 	for (i = 0; i < sizeof (eld->b); i++) {
 		switch (eld->state) {
 		case EL_EXIF_FOUND:
-			if (!exif_loader_copy (eld, eld->b + i,
-					sizeof (eld->b) - i)) 
+			if (!eld->capture || (eld->marker != JPEG_MARKER_APP1)) {
+				if (!exif_loader_copy (eld, eld->b + i,
+						sizeof (eld->b) - i)) 
+					return 0;
+				return exif_loader_copy (eld, buf, len);
+			}
+
+			/* Byte by byte, so that scanning can go on from here */
+			if (!exif_loader_copy (eld, eld->b + i, 1) &&
+			    !exif_loader_continue (eld))
 				return 0;
-			return exif_loader_copy (eld, buf, len);
+			break;
+		case EL_CAPTURE:
+			eld->seg[eld->seg_read++] = eld->b[i];
+			if (eld->seg_read >= eld->seg_size)
+				exif_loader_capture_done (eld);
+			break;
 		case EL_SKIP_BYTES:
 			switch (eld->size) {
                             case 0:
@@ -285,6 +1044,8 @@ begin:
 				    eld->size = 0;
 				} else
 				    eld->size -= 2;
+				if (eld->capture)
+					exif_loader_capture_start (eld, eld->b_pos + i + 1);
 				break;
 			case EL_DATA_FORMAT_FUJI_RAW:
 				eld->data_format = EL_DATA_FORMAT_EXIF;
@@ -297,6 +1058,14 @@ begin:
 				break;
 			case EL_DATA_FORMAT_EXIF:
 				eld->state = EL_EXIF_FOUND;
+				/*
+				 * The length includes its own two bytes. Reading
+				 * them again does no harm when we stop after the
+				 * EXIF data, but it would eat the next marker.
+				 */
+				if (eld->capture && (eld->marker == JPEG_MARKER_APP1) &&
+				    (eld->size >= 2))
+					eld->size -= 2;
 				break;
 			default:
 				break;
@@ -306,7 +1075,8 @@ begin:
 		default:
 			switch (eld->b[i]) {
 			case JPEG_MARKER_APP1:
-			  if (!memcmp (eld->b + i + 3, ExifHeader, MIN((ssize_t)(sizeof(ExifHeader)), MAX(0, ((ssize_t)(sizeof(eld->b))) - ((ssize_t)i) - 3)))) {
+			  eld->marker = eld->b[i];
+			  if (!eld->buf && !memcmp (eld->b + i + 3, ExifHeader, MIN((ssize_t)(sizeof(ExifHeader)), MAX(0, ((ssize_t)(sizeof(eld->b))) - ((ssize_t)i) - 3)))) {
 					eld->data_format = EL_DATA_FORMAT_EXIF;
 				} else {
 					eld->data_format = EL_DATA_FORMAT_JPEG; /* Probably JFIF - keep searching for APP1 EXIF*/
@@ -326,6 +1096,7 @@ begin:
 			case JPEG_MARKER_APP13:
 			case JPEG_MARKER_APP14:
 			case JPEG_MARKER_COM:
+				eld->marker = eld->b[i];
 				eld->data_format = EL_DATA_FORMAT_JPEG;
 				eld->size = 0;
 				eld->state = EL_READ_SIZE_BYTE_08;
@@ -334,6 +1105,20 @@ begin:
 			case JPEG_MARKER_SOI:
 				break;
 			default:
+				/*
+				 * When capturing, the image data or anything
+				 * unexpected after the EXIF data ends the scan
+				 * and keeps what has been found.
+				 */
+				if (eld->capture && (eld->buf ||
+				    (eld->b[i] == JPEG_MARKER_SOS) ||
+				    (eld->b[i] == JPEG_MARKER_EOI))) {
+					exif_log (eld->log, EXIF_LOG_CODE_DEBUG,
+						"ExifLoader", "Scan stopped at 0x%02x.",
+						eld->b[i]);
+					eld->state = EL_DONE;
+					return 0;
+				}
 				exif_log (eld->log,
 					EXIF_LOG_CODE_CORRUPT_DATA,
 					"ExifLoader", _("The data supplied "
@@ -375,7 +1160,7 @@ exif_loader_new_mem (ExifMem *mem)
 	loader = exif_mem_alloc (mem, sizeof (ExifLoader));
 	if (!loader) 
 		return NULL;
-	loader->ref_count = 1;
+	exif_refcount_init (&loader->ref_count, 1);
 
 	loader->mem = mem;
 	exif_mem_ref (mem);
@@ -387,7 +1172,7 @@ void
 exif_loader_ref (ExifLoader *loader)
 {
 	if (loader) 
-		loader->ref_count++;
+		exif_refcount_inc (&loader->ref_count);
 }
 
 static void
@@ -410,7 +1195,7 @@ exif_loader_unref (ExifLoader *loader)
 {
 	if (!loader) 
 		return;
-	if (!--loader->ref_count)
+	if (!exif_refcount_dec (&loader->ref_count))
 		exif_loader_free (loader);
 }
 
@@ -420,6 +1205,15 @@ exif_loader_reset (ExifLoader *loader)
 	if (!loader) 
 		return;
 	exif_mem_free (loader->mem, loader->buf); loader->buf = NULL;
+	exif_mem_free (loader->mem, loader->seg); loader->seg = NULL;
+	while (loader->segments_count)
+		exif_mem_free (loader->mem,
+			(unsigned char *) loader->segments[--loader->segments_count].data);
+	exif_mem_free (loader->mem, loader->segments); loader->segments = NULL;
+	loader->pos = 0;
+	loader->marker = 0;
+	loader->hdr_len = 0;
+	loader->target = 0;
 	loader->size = 0;
 	loader->bytes_read = 0;
 	loader->state = 0;
@@ -443,6 +1237,37 @@ exif_loader_get_data (ExifLoader *loader)
 	return ed;
 }
 
+ExifData *
+exif_loader_take_data (ExifLoader *loader)
+{
+	ExifData *ed;
+	ExifBuffer *buf;
+
+	if (!loader || (loader->data_format == EL_DATA_FORMAT_UNKNOWN) ||
+	    !loader->bytes_read)
+		return NULL;
+
+	ed = exif_data_new_mem (loader->mem);
+	if (!ed)
+		return NULL;
+	buf = exif_buffer_new (loader->mem, loader->buf, loader->bytes_read);
+	if (!buf) {
+		EXIF_LOG_NO_MEMORY (loader->log, "ExifLoader", sizeof (ExifBuffer));
+		exif_data_unref (ed);
+		return NULL;
+	}
+
+	/* The buffer belongs to the ExifData from now on */
+	loader->buf = NULL;
+	exif_loader_reset (loader);
+
+	exif_data_log (ed, loader->log);
+	exif_data_load_buffer (ed, buf);
+	exif_buffer_unref (buf);
+
+	return ed;
+}
+
 void
 exif_loader_get_buf (ExifLoader *loader, const unsigned char **buf,
 						  unsigned int *buf_size)
@@ -466,6 +1291,27 @@ exif_loader_get_buf (ExifLoader *loader, const unsigned char **buf,
 		*buf_size = s;
 }
 
+void
+exif_loader_set_capture (ExifLoader *loader, unsigned int types)
+{
+	if (loader)
+		loader->capture = types;
+}
+
+unsigned int
+exif_loader_get_segment_count (ExifLoader *loader)
+{
+	return loader ? loader->segments_count : 0;
+}
+
+const ExifLoaderSegment *
+exif_loader_get_segment (ExifLoader *loader, unsigned int i)
+{
+	if (!loader || (i >= loader->segments_count))
+		return NULL;
+	return &loader->segments[i];
+}
+
 void
 exif_loader_log (ExifLoader *loader, ExifLog *log)
 {
@@ -36,6 +36,25 @@ extern "C" {
 /*! Data used by the loader interface */
 typedef struct _ExifLoader ExifLoader;
 
+/*! JPEG segments the loader can collect besides the EXIF data */
+typedef enum {
+	EXIF_LOADER_SEGMENT_XMP = 1 << 0, /*!< APP1 XMP packet */
+	EXIF_LOADER_SEGMENT_ICC = 1 << 1, /*!< APP2 ICC profile chunk */
+	EXIF_LOADER_SEGMENT_MPF = 1 << 2  /*!< APP2 Multi-Picture Format index */
+} ExifLoaderSegmentType;
+
+/*! A segment collected by the loader */
+typedef struct {
+	ExifLoaderSegmentType type;
+
+	/*! Offset of the payload from the start of the written data */
+	unsigned int offset;
+
+	/*! Payload following the length field, starting with the signature */
+	const unsigned char *data;
+	unsigned int size;
+} ExifLoaderSegment;
+
 /*! Allocate a new #ExifLoader.
  *
  *  \return allocated ExifLoader
@@ -63,7 +82,10 @@ void        exif_loader_ref     (ExifLoader *loader);
 void        exif_loader_unref   (ExifLoader *loader);
 
 /*! Load a file into the given #ExifLoader from the filesystem.
- * The relevant data is copied in raw form into the #ExifLoader.
+ * The relevant data is copied in raw form into the #ExifLoader. Large
+ * parts of the file that the loader has no use for, like the image data
+ * in front of the EXIF item of a HEIF file or the EXIF chunk of a PNG
+ * or WebP file, are skipped with fseek().
  *
  * \param[in] loader loader to write to
  * \param[in] fname path to the file to read
@@ -72,6 +94,12 @@ void        exif_loader_write_file (ExifLoader *loader, const char *fname);
 
 /*! Load a buffer into the #ExifLoader from a memory buffer.
  * The relevant data is copied in raw form into the #ExifLoader.
+ * The data may be a JPEG file, a FUJIFILM RAF file, a HEIF or AVIF file,
+ * a PNG or WebP file or raw EXIF data, and is passed in as it comes, in
+ * any number of calls. For HEIF and AVIF files, the 'Exif' item must be
+ * stored after the 'meta' box, as is the case with all common writers.
+ * For PNG and WebP files, the 'eXIf' or 'EXIF' chunk is found behind
+ * image data of any size.
  *
  * \param[in] loader loader to write to
  * \param[in] buf buffer to read from
@@ -104,6 +132,27 @@ void          exif_loader_reset (ExifLoader *loader);
  */
 ExifData     *exif_loader_get_data (ExifLoader *loader);
 
+/*! Create an #ExifData from the data in the loader and hand the loader's
+ * buffer over to it, instead of copying every tag value out of it.
+ *
+ * The tag values and the thumbnail of the returned #ExifData point
+ * directly into the buffer, which is released together with the last
+ * entry or #ExifData referring to it. The loader is reset and may be
+ * reused. This saves one allocation and copy per tag, which matters when
+ * scanning many files.
+ *
+ * \note Entry data and ExifData::data obtained this way are not separate
+ * allocations. Do not free or reallocate them directly; assign a new
+ * block allocated by yourself instead. Tag values that overlap in the
+ * file also share storage.
+ *
+ * \param[in] loader the loader
+ * \return allocated ExifData, or NULL if no data has been loaded
+ *
+ * \see exif_loader_get_data
+ */
+ExifData     *exif_loader_take_data (ExifLoader *loader);
+
 /*! Return the raw data read by the loader.  The returned pointer is only
  * guaranteed to be valid until the next call to a function modifying
  * this #ExifLoader.  Either or both of buf and buf_size may be NULL on
@@ -117,6 +166,40 @@ ExifData     *exif_loader_get_data (ExifLoader *loader);
 void exif_loader_get_buf (ExifLoader *loader, const unsigned char **buf,
 						  unsigned int *buf_size);
 
+/*! Make the loader collect other metadata segments in the same pass.
+ *
+ * By default, the loader stops as soon as it has read the EXIF data. With
+ * segment types set, it keeps scanning the JPEG markers until the image
+ * data starts and keeps a copy of every segment of the requested types,
+ * so that XMP, ICC profiles and MPF do not need another pass over the
+ * file. The setting survives #exif_loader_reset.
+ *
+ * \param[in] loader the loader
+ * \param[in] types mask of #ExifLoaderSegmentType values, 0 to disable
+ */
+void exif_loader_set_capture (ExifLoader *loader, unsigned int types);
+
+/*! Return the number of segments collected so far.
+ *
+ * \param[in] loader the loader
+ * \return number of segments
+ *
+ * \see exif_loader_set_capture
+ */
+unsigned int exif_loader_get_segment_count (ExifLoader *loader);
+
+/*! Return a segment collected by the loader, in file order. ICC profiles
+ * larger than one segment come as several #EXIF_LOADER_SEGMENT_ICC
+ * chunks. The segment is valid until the loader is reset or freed, which
+ * includes calls to #exif_loader_take_data.
+ *
+ * \param[in] loader the loader
+ * \param[in] i index of the segment
+ * \return the segment, or NULL if \a i is out of range
+ */
+const ExifLoaderSegment *exif_loader_get_segment (ExifLoader *loader,
+						  unsigned int i);
+
 /*! Set the log message object used by this #ExifLoader.
  * \param[in] loader the loader
  * \param[in] log #ExifLog
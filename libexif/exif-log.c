@@ -23,13 +23,14 @@
 #include <config.h>
 
 #include <libexif/exif-log.h>
+#include <libexif/exif-refcount.h>
 #include <libexif/i18n.h>
 
 #include <stdlib.h>
 #include <string.h>
 
 struct _ExifLog {
-	unsigned int ref_count;
+	ExifRefCount ref_count;
 
 	ExifLogFunc func;
 	void *data;
@@ -76,7 +77,7 @@ exif_log_new_mem (ExifMem *mem)
 
 	log = exif_mem_alloc (mem, sizeof (ExifLog));
 	if (!log) return NULL;
-	log->ref_count = 1;
+	exif_refcount_init (&log->ref_count, 1);
 
 	log->mem = mem;
 	exif_mem_ref (mem);
@@ -99,15 +100,14 @@ void
 exif_log_ref (ExifLog *log)
 {
 	if (!log) return;
-	log->ref_count++;
+	exif_refcount_inc (&log->ref_count);
 }
 
 void
 exif_log_unref (ExifLog *log)
 {
 	if (!log) return;
-	if (log->ref_count > 0) log->ref_count--;
-	if (!log->ref_count) exif_log_free (log);
+	if (!exif_refcount_dec (&log->ref_count)) exif_log_free (log);
 }
 
 void
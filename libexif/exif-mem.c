@@ -20,12 +20,15 @@
  * SPDX-License-Identifier: LGPL-2.0-or-later
  */
 
+#include <config.h>
+
 #include <libexif/exif-mem.h>
+#include <libexif/exif-refcount.h>
 
 #include <stdlib.h>
 
 struct _ExifMem {
-	unsigned int ref_count;
+	ExifRefCount ref_count;
 	ExifMemAllocFunc alloc_func;
 	ExifMemReallocFunc realloc_func;
 	ExifMemFreeFunc free_func;
@@ -63,7 +66,7 @@ exif_mem_new (ExifMemAllocFunc alloc_func, ExifMemReallocFunc realloc_func,
 	mem = alloc_func ? alloc_func (sizeof (ExifMem)) :
 		           realloc_func (NULL, sizeof (ExifMem));
 	if (!mem) return NULL;
-	mem->ref_count = 1;
+	exif_refcount_init (&mem->ref_count, 1);
 
 	mem->alloc_func   = alloc_func;
 	mem->realloc_func = realloc_func;
@@ -76,14 +79,14 @@ void
 exif_mem_ref (ExifMem *mem)
 {
 	if (!mem) return;
-	mem->ref_count++;
+	exif_refcount_inc (&mem->ref_count);
 }
 
 void
 exif_mem_unref (ExifMem *mem)
 {
 	if (!mem) return;
-	if (!--mem->ref_count)
+	if (!exif_refcount_dec (&mem->ref_count))
 		exif_mem_free (mem, mem);
 }
 
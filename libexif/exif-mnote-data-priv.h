@@ -81,6 +81,10 @@ void exif_mnote_data_set_byte_order (ExifMnoteData *, ExifByteOrder);
 /*! \internal */
 void exif_mnote_data_set_offset     (ExifMnoteData *, unsigned int);
 
+/*! \internal Decode all entries once, so that reading them no longer
+ *  writes into the MakerNote. Returns 1 on success, 0 otherwise. */
+int  exif_mnote_data_resolve        (ExifMnoteData *);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -24,13 +24,30 @@
 
 #include <libexif/exif-mnote-data.h>
 #include <libexif/exif-mnote-data-priv.h>
+#include <libexif/exif-refcount.h>
 
 #include <stdlib.h>
 #include <string.h>
 
+/* Longest value kept by exif_mnote_data_resolve(), including the NUL */
+#define EXIF_MNOTE_DATA_VALUE_SIZE 1024
+
+/* One entry decoded by exif_mnote_data_resolve() */
+typedef struct {
+	unsigned int id;
+	const char *name;
+	const char *title;
+	const char *description;
+	const char *value;
+} ExifMnoteDataResolved;
+
 struct _ExifMnoteDataPriv
 {
-	unsigned int ref_count;
+	ExifRefCount ref_count;
+
+	/* All entries decoded, followed by their strings in the same block */
+	ExifMnoteDataResolved *resolved;
+	unsigned int resolved_count;
 };
 
 void
@@ -41,7 +58,9 @@ exif_mnote_data_construct (ExifMnoteData *d, ExifMem *mem)
 	d->priv = exif_mem_alloc (mem, sizeof (ExifMnoteDataPriv));
 	if (!d->priv) return;
 
-	d->priv->ref_count = 1;
+	exif_refcount_init (&d->priv->ref_count, 1);
+	d->priv->resolved = NULL;
+	d->priv->resolved_count = 0;
 
 	d->mem = mem;
 	exif_mem_ref (mem);
@@ -50,7 +69,16 @@ exif_mnote_data_construct (ExifMnoteData *d, ExifMem *mem)
 void
 exif_mnote_data_ref (ExifMnoteData *d)
 {
-	if (d && d->priv) d->priv->ref_count++;
+	if (d && d->priv) exif_refcount_inc (&d->priv->ref_count);
+}
+
+static void
+exif_mnote_data_drop_resolved (ExifMnoteData *d)
+{
+	if (!d->priv || !d->priv->resolved) return;
+	exif_mem_free (d->mem, d->priv->resolved);
+	d->priv->resolved = NULL;
+	d->priv->resolved_count = 0;
 }
 
 static void
@@ -60,6 +88,8 @@ exif_mnote_data_free (ExifMnoteData *d)
 
 	if (!d) return;
 	if (d->priv) {
+		/* The free method of some parsers releases d->priv */
+		exif_mnote_data_drop_resolved (d);
 		if (d->methods.free) d->methods.free (d);
 		exif_mem_free (mem, d->priv);
 		d->priv = NULL;
@@ -73,16 +103,78 @@ void
 exif_mnote_data_unref (ExifMnoteData *d)
 {
 	if (!d || !d->priv) return;
-	if (d->priv->ref_count > 0) d->priv->ref_count--;
-	if (!d->priv->ref_count)
+	if (!exif_refcount_dec (&d->priv->ref_count))
 		exif_mnote_data_free (d);
 }
 
+/*! \return bytes needed to keep a copy of s */
+static unsigned int
+exif_mnote_data_string_size (const char *s)
+{
+	return s ? strlen (s) + 1 : 0;
+}
+
+static const char *
+exif_mnote_data_keep_string (char **p, const char *s)
+{
+	const char *r = *p;
+
+	if (!s) return NULL;
+	strcpy (*p, s);
+	*p += strlen (s) + 1;
+	return r;
+}
+
+/* Used internally within libexif */
+int
+exif_mnote_data_resolve (ExifMnoteData *d)
+{
+	ExifMnoteDataResolved *r;
+	char value[EXIF_MNOTE_DATA_VALUE_SIZE], *p;
+	unsigned int n, size, l, i;
+
+	if (!d || !d->priv) return 0;
+	if (d->priv->resolved) return 1;
+
+	/* Sizes first, so that a single allocation does */
+	n = exif_mnote_data_count (d);
+	if (!n) return 1;
+	size = n * sizeof (ExifMnoteDataResolved);
+	for (i = 0; i < n; i++) {
+		l = exif_mnote_data_string_size (exif_mnote_data_get_name (d, i)) +
+		    exif_mnote_data_string_size (exif_mnote_data_get_title (d, i)) +
+		    exif_mnote_data_string_size (exif_mnote_data_get_description (d, i)) +
+		    exif_mnote_data_string_size (exif_mnote_data_get_value (d, i,
+						 value, sizeof (value)));
+		if (size + l < size) return 0;
+		size += l;
+	}
+
+	r = exif_mem_alloc (d->mem, size);
+	if (!r) return 0;
+	p = (char *) (r + n);
+	for (i = 0; i < n; i++) {
+		r[i].id = exif_mnote_data_get_id (d, i);
+		r[i].name = exif_mnote_data_keep_string (&p,
+				exif_mnote_data_get_name (d, i));
+		r[i].title = exif_mnote_data_keep_string (&p,
+				exif_mnote_data_get_title (d, i));
+		r[i].description = exif_mnote_data_keep_string (&p,
+				exif_mnote_data_get_description (d, i));
+		r[i].value = exif_mnote_data_keep_string (&p,
+				exif_mnote_data_get_value (d, i, value, sizeof (value)));
+	}
+	d->priv->resolved = r;
+	d->priv->resolved_count = n;
+	return 1;
+}
+
 void
 exif_mnote_data_load (ExifMnoteData *d, const unsigned char *buf,
 		      unsigned int buf_size)
 {
 	if (!d || !d->methods.load) return;
+	exif_mnote_data_drop_resolved (d);
 	d->methods.load (d, buf, buf_size);
 }
 
@@ -98,6 +190,7 @@ void
 exif_mnote_data_set_byte_order (ExifMnoteData *d, ExifByteOrder o)
 {
 	if (!d || !d->methods.set_byte_order) return;
+	exif_mnote_data_drop_resolved (d);
 	d->methods.set_byte_order (d, o);
 }
 
@@ -108,9 +201,19 @@ exif_mnote_data_set_offset (ExifMnoteData *d, unsigned int o)
 	d->methods.set_offset (d, o);
 }
 
+/* Is there a decoded copy of the entries to answer from? */
+#define RESOLVED(d) ((d) && (d)->priv && (d)->priv->resolved)
+
+static const ExifMnoteDataResolved *
+exif_mnote_data_get_resolved (ExifMnoteData *d, unsigned int n)
+{
+	return (n < d->priv->resolved_count) ? &d->priv->resolved[n] : NULL;
+}
+
 unsigned int
 exif_mnote_data_count (ExifMnoteData *d)
 {
+	if (RESOLVED (d)) return d->priv->resolved_count;
 	if (!d || !d->methods.count) return 0;
 	return d->methods.count (d);
 }
@@ -118,6 +221,12 @@ exif_mnote_data_count (ExifMnoteData *d)
 unsigned int
 exif_mnote_data_get_id (ExifMnoteData *d, unsigned int n)
 {
+	const ExifMnoteDataResolved *r;
+
+	if (RESOLVED (d)) {
+		r = exif_mnote_data_get_resolved (d, n);
+		return r ? r->id : 0;
+	}
 	if (!d || !d->methods.get_id) return 0;
 	return d->methods.get_id (d, n);
 }
@@ -125,6 +234,12 @@ exif_mnote_data_get_id (ExifMnoteData *d, unsigned int n)
 const char *
 exif_mnote_data_get_name (ExifMnoteData *d, unsigned int n)
 {
+	const ExifMnoteDataResolved *r;
+
+	if (RESOLVED (d)) {
+		r = exif_mnote_data_get_resolved (d, n);
+		return r ? r->name : NULL;
+	}
 	if (!d || !d->methods.get_name) return NULL;
 	return d->methods.get_name (d, n);
 }
@@ -132,6 +247,12 @@ exif_mnote_data_get_name (ExifMnoteData *d, unsigned int n)
 const char *
 exif_mnote_data_get_title (ExifMnoteData *d, unsigned int n)
 {
+	const ExifMnoteDataResolved *r;
+
+	if (RESOLVED (d)) {
+		r = exif_mnote_data_get_resolved (d, n);
+		return r ? r->title : NULL;
+	}
 	if (!d || !d->methods.get_title) return NULL;
 	return d->methods.get_title (d, n);
 }
@@ -139,6 +260,12 @@ exif_mnote_data_get_title (ExifMnoteData *d, unsigned int n)
 const char *
 exif_mnote_data_get_description (ExifMnoteData *d, unsigned int n)
 {
+	const ExifMnoteDataResolved *r;
+
+	if (RESOLVED (d)) {
+		r = exif_mnote_data_get_resolved (d, n);
+		return r ? r->description : NULL;
+	}
 	if (!d || !d->methods.get_description) return NULL;
 	return d->methods.get_description (d, n);
 }
@@ -146,6 +273,15 @@ exif_mnote_data_get_description (ExifMnoteData *d, unsigned int n)
 char *
 exif_mnote_data_get_value (ExifMnoteData *d, unsigned int n, char *val, unsigned int maxlen)
 {
+	const ExifMnoteDataResolved *r;
+
+	if (RESOLVED (d)) {
+		r = exif_mnote_data_get_resolved (d, n);
+		if (!r || !r->value || !val || !maxlen) return NULL;
+		strncpy (val, r->value, maxlen - 1);
+		val[maxlen - 1] = '\0';
+		return val;
+	}
 	if (!d || !d->methods.get_value) return NULL;
 	return d->methods.get_value (d, n, val, maxlen);
 }
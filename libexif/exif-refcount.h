@@ -0,0 +1,63 @@
+/* exif-refcount.h
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+/*
+ * Reference counts of the libexif objects. They are updated atomically,
+ * so that objects may be referenced and released from several threads,
+ * unless EXIF_DISABLE_ATOMIC_REFCOUNT is defined (configure
+ * --disable-atomic-refcount). This header is internal to libexif and is
+ * not installed.
+ */
+
+#ifndef LIBEXIF_EXIF_REFCOUNT_H
+#define LIBEXIF_EXIF_REFCOUNT_H
+
+#if !defined(EXIF_DISABLE_ATOMIC_REFCOUNT) && defined(__ATOMIC_ACQ_REL)
+
+/* The GCC and Clang builtins follow the C11 memory model and, unlike
+ * <stdatomic.h>, are available in -ansi builds as well. */
+typedef unsigned int ExifRefCount;
+#define exif_refcount_init(r,v) (*(r) = (v))
+#define exif_refcount_inc(r) ((void) __atomic_add_fetch ((r), 1, __ATOMIC_RELAXED))
+#define exif_refcount_dec(r) __atomic_sub_fetch ((r), 1, __ATOMIC_ACQ_REL)
+
+#elif !defined(EXIF_DISABLE_ATOMIC_REFCOUNT) && \
+	defined(__STDC_VERSION__) && (__STDC_VERSION__ >= 201112L) && \
+	!defined(__STDC_NO_ATOMICS__)
+
+#include <stdatomic.h>
+
+typedef atomic_uint ExifRefCount;
+#define exif_refcount_init(r,v) atomic_init ((r), (v))
+#define exif_refcount_inc(r) \
+	((void) atomic_fetch_add_explicit ((r), 1, memory_order_relaxed))
+#define exif_refcount_dec(r) \
+	(atomic_fetch_sub_explicit ((r), 1, memory_order_acq_rel) - 1)
+
+#else
+
+typedef unsigned int ExifRefCount;
+#define exif_refcount_init(r,v) (*(r) = (v))
+#define exif_refcount_inc(r) ((void) ++*(r))
+#define exif_refcount_dec(r) (--*(r))
+
+#endif
+
+#endif /* !defined(LIBEXIF_EXIF_REFCOUNT_H) */
@@ -0,0 +1,466 @@
+/* exif-snapshot.c
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#include <config.h>
+
+#include <libexif/exif-snapshot.h>
+#include <libexif/exif-data-priv.h>
+#include <libexif/exif-utils.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Layout, all numbers in Intel byte order:
+ *
+ *  0  magic and version (8 bytes)
+ *  8  size of the snapshot
+ * 12  byte order of the values (2 bytes), number of IFD tables (2 bytes)
+ * 16  offset and size of the thumbnail
+ * 24  offset and count of the MakerNote table
+ * 32  offset and count of the table of each IFD, then of each SubIFD
+ *
+ * IFD table records: tag (2 bytes), format (2 bytes), components, offset
+ * and size of the value. MakerNote table records: id and the offsets of
+ * the name, title and value strings, 0 for none. Everything else is heap.
+ */
+#define SNAPSHOT_HEADER_SIZE(n) (32 + 8 * (n))
+#define SNAPSHOT_RECORD_SIZE 16
+
+#define CHECKOVERFLOW(offset,datasize,structsize) (( (offset) >= (datasize)) || ((structsize) > (datasize)) || ((offset) > (datasize) - (structsize) ))
+
+static const unsigned char SnapshotMagic[] = {'E', 'x', 'i', 'f', 'S', 'n', 'p', 1};
+
+#define GET_SHORT(d) exif_get_short ((d), EXIF_BYTE_ORDER_INTEL)
+#define GET_LONG(d)  exif_get_long  ((d), EXIF_BYTE_ORDER_INTEL)
+#define SET_SHORT(d,v) exif_set_short ((d), EXIF_BYTE_ORDER_INTEL, (v))
+#define SET_LONG(d,v)  exif_set_long  ((d), EXIF_BYTE_ORDER_INTEL, (v))
+
+/* Add l to *total, failing on overflow */
+static int
+exif_snapshot_add (unsigned int *total, unsigned int l)
+{
+	if (l > 0xffffffff - *total)
+		return 0;
+	*total += l;
+	return 1;
+}
+
+/* Add a NUL-terminated string, or nothing for NULL */
+static int
+exif_snapshot_add_string (unsigned int *total, const char *s)
+{
+	return !s || exif_snapshot_add (total, strlen (s) + 1);
+}
+
+/* Copy l bytes to the heap and return their offset, 0 for none */
+static unsigned int
+exif_snapshot_put (unsigned char *d, unsigned int *heap, const void *p,
+		   unsigned int l)
+{
+	unsigned int o = *heap;
+
+	if (!p || !l)
+		return 0;
+	memcpy (d + o, p, l);
+	*heap += l;
+	return o;
+}
+
+static unsigned int
+exif_snapshot_put_string (unsigned char *d, unsigned int *heap, const char *s)
+{
+	return s ? exif_snapshot_put (d, heap, s, strlen (s) + 1) : 0;
+}
+
+static int
+exif_snapshot_cmp (const void *a, const void *b)
+{
+	return (int) GET_SHORT (a) - (int) GET_SHORT (b);
+}
+
+/* Table i of the snapshot: the IFDs, then the SubIFDs */
+static ExifContent *
+exif_snapshot_content (ExifData *data, unsigned int i)
+{
+	return (i < EXIF_IFD_COUNT) ? data->ifd[i] :
+		exif_data_get_sub_ifd (data, i - EXIF_IFD_COUNT);
+}
+
+int
+exif_data_snapshot_save (ExifData *data, unsigned char **d, unsigned int *ds)
+{
+	ExifMnoteData *md;
+	ExifContent *c;
+	ExifEntry *e;
+	char value[1024];
+	unsigned int total, heap, table, tables, mcount = 0, i, j;
+	unsigned char *p, *r;
+
+	if (ds)
+		*ds = 0;
+	if (!data || !d || !ds)
+		return 0;
+	*d = NULL;
+
+	/* Sizes first, so that a single allocation does */
+	tables = EXIF_IFD_COUNT + exif_data_get_sub_ifd_count (data);
+	if (tables > 0xffff)
+		return 0;
+	total = SNAPSHOT_HEADER_SIZE (tables);
+	for (i = 0; i < tables; i++) {
+		c = exif_snapshot_content (data, i);
+		for (j = 0; c && (j < c->count); j++)
+			if (!exif_snapshot_add (&total, SNAPSHOT_RECORD_SIZE) ||
+			    !exif_snapshot_add (&total, c->entries[j]->data ?
+						c->entries[j]->size : 0))
+				return 0;
+	}
+	if (data->data && !exif_snapshot_add (&total, data->size))
+		return 0;
+	md = exif_data_get_mnote_data (data);
+	if (md)
+		mcount = exif_mnote_data_count (md);
+	for (i = 0; i < mcount; i++)
+		if (!exif_snapshot_add (&total, SNAPSHOT_RECORD_SIZE) ||
+		    !exif_snapshot_add_string (&total, exif_mnote_data_get_name (md, i)) ||
+		    !exif_snapshot_add_string (&total, exif_mnote_data_get_title (md, i)) ||
+		    !exif_snapshot_add_string (&total, exif_mnote_data_get_value (md, i,
+						value, sizeof (value))))
+			return 0;
+
+	p = exif_mem_alloc (exif_data_get_priv_mem (data), total);
+	if (!p) {
+		EXIF_LOG_NO_MEMORY (exif_data_get_log (data), "ExifSnapshot", total);
+		return 0;
+	}
+	memcpy (p, SnapshotMagic, sizeof (SnapshotMagic));
+	SET_LONG (p + 8, total);
+	SET_SHORT (p + 12, exif_data_get_byte_order (data));
+	SET_SHORT (p + 14, tables);
+
+	/* Tables right after the header, then the heap */
+	table = SNAPSHOT_HEADER_SIZE (tables);
+	heap = table;
+	for (i = 0; i < tables; i++) {
+		c = exif_snapshot_content (data, i);
+		heap += SNAPSHOT_RECORD_SIZE * (c ? c->count : 0);
+	}
+	heap += SNAPSHOT_RECORD_SIZE * mcount;
+
+	for (i = 0; i < tables; i++) {
+		c = exif_snapshot_content (data, i);
+		SET_LONG (p + 32 + 8 * i, table);
+		SET_LONG (p + 36 + 8 * i, c ? c->count : 0);
+		for (j = 0; c && (j < c->count); j++) {
+			e = c->entries[j];
+			r = p + table + SNAPSHOT_RECORD_SIZE * j;
+			SET_SHORT (r, e->tag);
+			SET_SHORT (r + 2, e->format);
+			SET_LONG (r + 4, e->components);
+			SET_LONG (r + 8, exif_snapshot_put (p, &heap, e->data, e->size));
+			SET_LONG (r + 12, e->data ? e->size : 0);
+		}
+		if (c && c->count) {
+			qsort (p + table, c->count, SNAPSHOT_RECORD_SIZE,
+			       exif_snapshot_cmp);
+			table += SNAPSHOT_RECORD_SIZE * c->count;
+		}
+	}
+
+	SET_LONG (p + 24, table);
+	SET_LONG (p + 28, mcount);
+	for (i = 0; i < mcount; i++) {
+		r = p + table + SNAPSHOT_RECORD_SIZE * i;
+		SET_LONG (r, exif_mnote_data_get_id (md, i));
+		SET_LONG (r + 4, exif_snapshot_put_string (p, &heap,
+			exif_mnote_data_get_name (md, i)));
+		SET_LONG (r + 8, exif_snapshot_put_string (p, &heap,
+			exif_mnote_data_get_title (md, i)));
+		SET_LONG (r + 12, exif_snapshot_put_string (p, &heap,
+			exif_mnote_data_get_value (md, i, value, sizeof (value))));
+	}
+
+	SET_LONG (p + 16, exif_snapshot_put (p, &heap, data->data, data->size));
+	SET_LONG (p + 20, data->data ? data->size : 0);
+
+	*d = p;
+	*ds = total;
+	return 1;
+}
+
+/* Check that a table of count records at offset lies within the snapshot */
+static int
+exif_snapshot_check_table (const ExifSnapshot *s, unsigned int offset,
+			   unsigned int count)
+{
+	if (!count)
+		return 1;
+	if (count > s->size / SNAPSHOT_RECORD_SIZE)
+		return 0;
+	return !CHECKOVERFLOW(offset, s->size, SNAPSHOT_RECORD_SIZE * count);
+}
+
+int
+exif_data_snapshot_view (ExifSnapshot *s, const unsigned char *d,
+			 unsigned int size)
+{
+	unsigned int i, tables;
+
+	if (!s)
+		return 0;
+	s->d = NULL;
+	s->size = 0;
+	if (!d || (size < SNAPSHOT_HEADER_SIZE (EXIF_IFD_COUNT)) ||
+	    memcmp (d, SnapshotMagic, sizeof (SnapshotMagic)))
+		return 0;
+	tables = GET_SHORT (d + 14);
+	if ((tables < EXIF_IFD_COUNT) ||
+	    (GET_LONG (d + 8) < SNAPSHOT_HEADER_SIZE (tables)) ||
+	    (GET_LONG (d + 8) > size))
+		return 0;
+
+	s->d = d;
+	s->size = GET_LONG (d + 8);
+	for (i = 0; i < tables; i++)
+		if (!exif_snapshot_check_table (s, GET_LONG (d + 32 + 8 * i),
+						GET_LONG (d + 36 + 8 * i)))
+			break;
+	if ((i < tables) ||
+	    !exif_snapshot_check_table (s, GET_LONG (d + 24), GET_LONG (d + 28)) ||
+	    (GET_LONG (d + 20) && CHECKOVERFLOW(GET_LONG (d + 16), s->size,
+						GET_LONG (d + 20)))) {
+		s->d = NULL;
+		s->size = 0;
+		return 0;
+	}
+	return 1;
+}
+
+ExifByteOrder
+exif_snapshot_get_byte_order (const ExifSnapshot *s)
+{
+	if (!s || !s->d)
+		return EXIF_BYTE_ORDER_MOTOROLA;
+	return (ExifByteOrder) GET_SHORT (s->d + 12);
+}
+
+/* Number of entries in table i: the IFDs, then the SubIFDs */
+static unsigned int
+exif_snapshot_table_count (const ExifSnapshot *s, unsigned int i)
+{
+	if (!s || !s->d || (i >= GET_SHORT (s->d + 14)))
+		return 0;
+	return GET_LONG (s->d + 36 + 8 * i);
+}
+
+static int
+exif_snapshot_table_entry (const ExifSnapshot *s, unsigned int i,
+			   unsigned int n, ExifSnapshotEntry *e)
+{
+	const unsigned char *r;
+	unsigned int o, l;
+
+	if (!e || (n >= exif_snapshot_table_count (s, i)))
+		return 0;
+	r = s->d + GET_LONG (s->d + 32 + 8 * i) + SNAPSHOT_RECORD_SIZE * n;
+	o = GET_LONG (r + 8);
+	l = GET_LONG (r + 12);
+	if (l && CHECKOVERFLOW(o, s->size, l))
+		return 0;
+	e->tag = GET_SHORT (r);
+	e->format = GET_SHORT (r + 2);
+	e->components = GET_LONG (r + 4);
+	e->data = l ? s->d + o : NULL;
+	e->size = l;
+	return 1;
+}
+
+static int
+exif_snapshot_table_find (const ExifSnapshot *s, unsigned int i, ExifTag tag,
+			  ExifSnapshotEntry *e)
+{
+	const unsigned char *t;
+	unsigned int lo = 0, hi, mid;
+	ExifTag found;
+
+	hi = exif_snapshot_table_count (s, i);
+	if (!hi)
+		return 0;
+	t = s->d + GET_LONG (s->d + 32 + 8 * i);
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		found = GET_SHORT (t + SNAPSHOT_RECORD_SIZE * mid);
+		if (found == tag)
+			return exif_snapshot_table_entry (s, i, mid, e);
+		if (found < tag)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return 0;
+}
+
+unsigned int
+exif_snapshot_get_count (const ExifSnapshot *s, ExifIfd ifd)
+{
+	return (ifd < EXIF_IFD_COUNT) ? exif_snapshot_table_count (s, ifd) : 0;
+}
+
+int
+exif_snapshot_get_entry (const ExifSnapshot *s, ExifIfd ifd, unsigned int n,
+			 ExifSnapshotEntry *e)
+{
+	return (ifd < EXIF_IFD_COUNT) && exif_snapshot_table_entry (s, ifd, n, e);
+}
+
+int
+exif_snapshot_find_entry (const ExifSnapshot *s, ExifIfd ifd, ExifTag tag,
+			  ExifSnapshotEntry *e)
+{
+	return (ifd < EXIF_IFD_COUNT) && exif_snapshot_table_find (s, ifd, tag, e);
+}
+
+unsigned int
+exif_snapshot_get_sub_ifd_count (const ExifSnapshot *s)
+{
+	return (s && s->d) ? GET_SHORT (s->d + 14) - EXIF_IFD_COUNT : 0;
+}
+
+unsigned int
+exif_snapshot_get_sub_ifd_entry_count (const ExifSnapshot *s, unsigned int i)
+{
+	return (i < exif_snapshot_get_sub_ifd_count (s)) ?
+		exif_snapshot_table_count (s, EXIF_IFD_COUNT + i) : 0;
+}
+
+int
+exif_snapshot_get_sub_ifd_entry (const ExifSnapshot *s, unsigned int i,
+				 unsigned int n, ExifSnapshotEntry *e)
+{
+	return (i < exif_snapshot_get_sub_ifd_count (s)) &&
+		exif_snapshot_table_entry (s, EXIF_IFD_COUNT + i, n, e);
+}
+
+int
+exif_snapshot_find_sub_ifd_entry (const ExifSnapshot *s, unsigned int i,
+				  ExifTag tag, ExifSnapshotEntry *e)
+{
+	return (i < exif_snapshot_get_sub_ifd_count (s)) &&
+		exif_snapshot_table_find (s, EXIF_IFD_COUNT + i, tag, e);
+}
+
+const unsigned char *
+exif_snapshot_get_thumbnail (const ExifSnapshot *s, unsigned int *size)
+{
+	unsigned int l;
+
+	if (size)
+		*size = 0;
+	if (!s || !s->d)
+		return NULL;
+	l = GET_LONG (s->d + 20);
+	if (!l)
+		return NULL;
+	if (size)
+		*size = l;
+	return s->d + GET_LONG (s->d + 16);
+}
+
+unsigned int
+exif_snapshot_get_mnote_count (const ExifSnapshot *s)
+{
+	return (s && s->d) ? GET_LONG (s->d + 28) : 0;
+}
+
+/* String at offset o, NULL if there is none or it is not terminated */
+static const char *
+exif_snapshot_string (const ExifSnapshot *s, unsigned int o)
+{
+	if (!o || (o >= s->size) || !memchr (s->d + o, 0, s->size - o))
+		return NULL;
+	return (const char *) s->d + o;
+}
+
+int
+exif_snapshot_get_mnote_entry (const ExifSnapshot *s, unsigned int n,
+			       ExifSnapshotMnoteEntry *e)
+{
+	const unsigned char *r;
+
+	if (!e || (n >= exif_snapshot_get_mnote_count (s)))
+		return 0;
+	r = s->d + GET_LONG (s->d + 24) + SNAPSHOT_RECORD_SIZE * n;
+	e->id = GET_LONG (r);
+	e->name = exif_snapshot_string (s, GET_LONG (r + 4));
+	e->title = exif_snapshot_string (s, GET_LONG (r + 8));
+	e->value = exif_snapshot_string (s, GET_LONG (r + 12));
+	return 1;
+}
+
+ExifData *
+exif_data_new_from_snapshot (const unsigned char *d, unsigned int size)
+{
+	ExifSnapshot s;
+	ExifSnapshotEntry se;
+	ExifData *data;
+	ExifContent *c;
+	ExifEntry *e;
+	ExifMem *mem;
+	const unsigned char *t;
+	unsigned int i, j, ts;
+
+	if (!exif_data_snapshot_view (&s, d, size))
+		return NULL;
+	data = exif_data_new ();
+	if (!data)
+		return NULL;
+	mem = exif_data_get_priv_mem (data);
+
+	/* Nothing is loaded yet, so this only sets the byte order */
+	exif_data_set_byte_order (data, exif_snapshot_get_byte_order (&s));
+
+	for (i = 0; i < GET_SHORT (s.d + 14); i++) {
+		c = (i < EXIF_IFD_COUNT) ? data->ifd[i] : exif_data_new_sub_ifd (data);
+		if (!c)
+			break;
+		for (j = 0; exif_snapshot_table_entry (&s, i, j, &se); j++) {
+			e = exif_entry_new_mem (mem);
+			if (!e)
+				break;
+			e->tag = se.tag;
+			e->format = se.format;
+			e->components = se.components;
+			if (se.size && (e->data = exif_mem_alloc (mem, se.size))) {
+				memcpy (e->data, se.data, se.size);
+				e->size = se.size;
+			}
+			exif_content_add_entry (c, e);
+			exif_entry_unref (e);
+		}
+	}
+
+	t = exif_snapshot_get_thumbnail (&s, &ts);
+	if (t && (data->data = exif_mem_alloc (mem, ts))) {
+		memcpy (data->data, t, ts);
+		data->size = ts;
+	}
+	return data;
+}
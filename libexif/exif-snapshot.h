@@ -0,0 +1,181 @@
+/*! \file exif-snapshot.h
+ * \brief Flat, relocatable snapshots of parsed EXIF data
+ */
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#ifndef LIBEXIF_EXIF_SNAPSHOT_H
+#define LIBEXIF_EXIF_SNAPSHOT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <libexif/exif-data.h>
+
+/*! A snapshot holds, in one buffer, a table of entries per IFD and per
+ * SubIFD sorted by tag, the decoded MakerNote entries as strings, and a
+ * heap with the values and the thumbnail. All references are offsets from
+ * the start of the buffer, so it can be stored, copied or mapped from a
+ * file and queried where it lies, without parsing and without allocating.
+ *
+ * An #ExifSnapshot is only a view on such a buffer. It does not own the
+ * buffer, which must stay valid for as long as the view is used.
+ */
+typedef struct {
+	const unsigned char *d;
+	unsigned int size;
+} ExifSnapshot;
+
+/*! One entry of an IFD, pointing into the snapshot */
+typedef struct {
+	ExifTag tag;
+	ExifFormat format;
+	unsigned long components;
+
+	/*! Value in the byte order of #exif_snapshot_get_byte_order */
+	const unsigned char *data;
+	unsigned int size;
+} ExifSnapshotEntry;
+
+/*! One decoded MakerNote entry, pointing into the snapshot */
+typedef struct {
+	unsigned int id;
+
+	/*! Strings as returned by the #ExifMnoteData functions, NULL if
+	 *  there was none */
+	const char *name;
+	const char *title;
+	const char *value;
+} ExifSnapshotMnoteEntry;
+
+/*! Store the entries of the IFDs and SubIFDs, the thumbnail and the
+ * decoded MakerNote of #ExifData in a snapshot. The buffer is allocated
+ * with the memory allocator of \a data.
+ *
+ * \param[in] data EXIF data
+ * \param[out] d pointer to the new buffer
+ * \param[out] ds size of the buffer
+ * \return 1 on success, 0 on error
+ */
+int exif_data_snapshot_save (ExifData *data, unsigned char **d,
+			     unsigned int *ds);
+
+/*! Set up a view on a snapshot. The header and the tables are checked;
+ * the values they point to are checked as they are accessed.
+ *
+ * \param[out] s view to set up
+ * \param[in] d snapshot as written by #exif_data_snapshot_save
+ * \param[in] size number of bytes at \a d
+ * \return 1 if \a d holds a snapshot, 0 otherwise
+ */
+int exif_data_snapshot_view (ExifSnapshot *s, const unsigned char *d,
+			     unsigned int size);
+
+/*! Allocate a new #ExifData holding the entries, the SubIFDs and the
+ * thumbnail of a snapshot. The decoded MakerNote entries are only
+ * available from the snapshot itself.
+ *
+ * \param[in] d snapshot as written by #exif_data_snapshot_save
+ * \param[in] size number of bytes at \a d
+ * \return allocated #ExifData, or NULL on error
+ */
+ExifData *exif_data_new_from_snapshot (const unsigned char *d,
+				       unsigned int size);
+
+/*! \return byte order of the values in the snapshot */
+ExifByteOrder exif_snapshot_get_byte_order (const ExifSnapshot *s);
+
+/*! \return number of entries of the given IFD */
+unsigned int exif_snapshot_get_count (const ExifSnapshot *s, ExifIfd ifd);
+
+/*! Get an entry of an IFD by index, in the order of their tags.
+ *
+ * \param[in] s view on a snapshot
+ * \param[in] ifd IFD
+ * \param[in] n index of the entry
+ * \param[out] e entry
+ * \return 1 on success, 0 if there is no such entry or it is corrupt
+ */
+int exif_snapshot_get_entry (const ExifSnapshot *s, ExifIfd ifd,
+			     unsigned int n, ExifSnapshotEntry *e);
+
+/*! Find the entry with the given tag in an IFD, by binary search.
+ *
+ * \param[in] s view on a snapshot
+ * \param[in] ifd IFD
+ * \param[in] tag tag to look for
+ * \param[out] e entry
+ * \return 1 if the entry was found, 0 otherwise
+ */
+int exif_snapshot_find_entry (const ExifSnapshot *s, ExifIfd ifd,
+			      ExifTag tag, ExifSnapshotEntry *e);
+
+/*! \return the thumbnail, or NULL if there is none */
+const unsigned char *exif_snapshot_get_thumbnail (const ExifSnapshot *s,
+						  unsigned int *size);
+
+/*! \return number of SubIFDs, see #exif_data_get_sub_ifd */
+unsigned int exif_snapshot_get_sub_ifd_count (const ExifSnapshot *s);
+
+/*! \return number of entries of the given SubIFD */
+unsigned int exif_snapshot_get_sub_ifd_entry_count (const ExifSnapshot *s,
+						    unsigned int i);
+
+/*! Get an entry of a SubIFD by index, as #exif_snapshot_get_entry does
+ * for an IFD.
+ *
+ * \param[in] s view on a snapshot
+ * \param[in] i index of the SubIFD
+ * \param[in] n index of the entry
+ * \param[out] e entry
+ * \return 1 on success, 0 if there is no such entry or it is corrupt
+ */
+int exif_snapshot_get_sub_ifd_entry (const ExifSnapshot *s, unsigned int i,
+				     unsigned int n, ExifSnapshotEntry *e);
+
+/*! Find the entry with the given tag in a SubIFD, by binary search.
+ *
+ * \param[in] s view on a snapshot
+ * \param[in] i index of the SubIFD
+ * \param[in] tag tag to look for
+ * \param[out] e entry
+ * \return 1 if the entry was found, 0 otherwise
+ */
+int exif_snapshot_find_sub_ifd_entry (const ExifSnapshot *s, unsigned int i,
+				      ExifTag tag, ExifSnapshotEntry *e);
+
+/*! \return number of decoded MakerNote entries */
+unsigned int exif_snapshot_get_mnote_count (const ExifSnapshot *s);
+
+/*! Get a decoded MakerNote entry.
+ *
+ * \param[in] s view on a snapshot
+ * \param[in] n index of the entry
+ * \param[out] e entry
+ * \return 1 on success, 0 if there is no such entry or it is corrupt
+ */
+int exif_snapshot_get_mnote_entry (const ExifSnapshot *s, unsigned int n,
+				   ExifSnapshotMnoteEntry *e);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* !defined(LIBEXIF_EXIF_SNAPSHOT_H) */
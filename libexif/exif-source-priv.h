@@ -0,0 +1,73 @@
+/* exif-source-priv.h
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#ifndef LIBEXIF_EXIF_SOURCE_PRIV_H
+#define LIBEXIF_EXIF_SOURCE_PRIV_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <libexif/exif-source.h>
+#include <libexif/exif-refcount.h>
+
+#define EXIF_SOURCE_PAGE_SIZE 4096
+#define EXIF_SOURCE_PAGES     8
+
+struct _ExifSource
+{
+	ExifRefCount ref_count;
+
+	ExifMem *mem;
+
+	unsigned int size;
+
+	/* Sources in memory */
+	const unsigned char *data;
+
+	/* Other sources */
+	ExifSourceReadFunc read_at;
+	void *user_data;
+	int fd;
+
+	/* Page cache, allocated on first use */
+	unsigned char *pages;
+	unsigned int page_index[EXIF_SOURCE_PAGES];
+	unsigned int pages_used, page_next;
+
+	/* Reads that cross a page boundary */
+	unsigned char *scratch;
+	unsigned int scratch_size;
+};
+
+/*! Set up a source for data in memory without allocating anything, for
+ *  use on the stack. Such a source must not be referenced or unreferenced.
+ */
+void exif_source_init_data (ExifSource *source, const unsigned char *d,
+			    unsigned int size);
+
+/*! \return the data of sources in memory, NULL for all others */
+const unsigned char *exif_source_get_data (ExifSource *source);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* !defined(LIBEXIF_EXIF_SOURCE_PRIV_H) */
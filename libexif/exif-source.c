@@ -0,0 +1,294 @@
+/* exif-source.c
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#include <config.h>
+
+#include <libexif/exif-source-priv.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+/* Is the range of size bytes at offset outside the source? */
+#define EXIF_SOURCE_OUTSIDE(s,offset,size) \
+	(((offset) >= (s)->size) || ((size) > (s)->size - (offset)))
+
+void
+exif_source_init_data (ExifSource *source, const unsigned char *d,
+		       unsigned int size)
+{
+	memset (source, 0, sizeof (ExifSource));
+	source->data = d;
+	source->size = d ? size : 0;
+	source->fd = -1;
+}
+
+const unsigned char *
+exif_source_get_data (ExifSource *source)
+{
+	return source ? source->data : NULL;
+}
+
+static ExifSource *
+exif_source_alloc (ExifMem *mem)
+{
+	ExifSource *source;
+
+	if (!mem)
+		return NULL;
+	source = exif_mem_alloc (mem, sizeof (ExifSource));
+	if (!source)
+		return NULL;
+	exif_refcount_init (&source->ref_count, 1);
+	source->mem = mem;
+	exif_mem_ref (mem);
+	source->fd = -1;
+	return source;
+}
+
+ExifSource *
+exif_source_new_mem (ExifMem *mem, ExifSourceReadFunc read_at,
+		     void *user_data, unsigned int size)
+{
+	ExifSource *source;
+
+	if (!read_at)
+		return NULL;
+	source = exif_source_alloc (mem);
+	if (!source)
+		return NULL;
+	source->read_at = read_at;
+	source->user_data = user_data;
+	source->size = size;
+	return source;
+}
+
+ExifSource *
+exif_source_new (ExifSourceReadFunc read_at, void *user_data,
+		 unsigned int size)
+{
+	ExifMem *mem = exif_mem_new_default ();
+	ExifSource *source = exif_source_new_mem (mem, read_at, user_data, size);
+
+	exif_mem_unref (mem);
+	return source;
+}
+
+ExifSource *
+exif_source_new_from_data (const unsigned char *d, unsigned int size)
+{
+	ExifMem *mem;
+	ExifSource *source;
+
+	if (!d)
+		return NULL;
+	mem = exif_mem_new_default ();
+	source = exif_source_alloc (mem);
+	exif_mem_unref (mem);
+	if (!source)
+		return NULL;
+	source->data = d;
+	source->size = size;
+	return source;
+}
+
+static unsigned int
+exif_source_fd_read (void *user_data, unsigned int offset,
+		     unsigned char *buf, unsigned int size)
+{
+	ExifSource *source = user_data;
+	unsigned int done = 0;
+	ssize_t got;
+
+	while (done < size) {
+#ifdef HAVE_PREAD
+		got = pread (source->fd, buf + done, size - done,
+			     (off_t) offset + done);
+#else
+		if (lseek (source->fd, (off_t) offset + done, SEEK_SET) < 0)
+			break;
+		got = read (source->fd, buf + done, size - done);
+#endif
+		if (got < 0 && errno == EINTR)
+			continue;
+		if (got <= 0)
+			break;
+		done += (unsigned int) got;
+	}
+	return done;
+}
+
+ExifSource *
+exif_source_new_from_fd (int fd)
+{
+	struct stat st;
+	ExifSource *source;
+
+	if ((fd < 0) || fstat (fd, &st) || (st.st_size < 0))
+		return NULL;
+	source = exif_source_new (exif_source_fd_read, NULL,
+		(st.st_size > 0xffffffff) ? 0xffffffff : (unsigned int) st.st_size);
+	if (!source)
+		return NULL;
+	source->user_data = source;
+	source->fd = fd;
+	return source;
+}
+
+void
+exif_source_ref (ExifSource *source)
+{
+	if (!source)
+		return;
+
+	exif_refcount_inc (&source->ref_count);
+}
+
+void
+exif_source_unref (ExifSource *source)
+{
+	ExifMem *mem;
+
+	if (!source || !source->mem)
+		return;
+
+	if (exif_refcount_dec (&source->ref_count))
+		return;
+	mem = source->mem;
+	exif_mem_free (mem, source->pages);
+	exif_mem_free (mem, source->scratch);
+	exif_mem_free (mem, source);
+	exif_mem_unref (mem);
+}
+
+unsigned int
+exif_source_get_size (ExifSource *source)
+{
+	return source ? source->size : 0;
+}
+
+/*! Return the cached page with the given index, reading it if needed. */
+static const unsigned char *
+exif_source_page (ExifSource *source, unsigned int index)
+{
+	unsigned int i, offset, size;
+	unsigned char *p;
+
+	for (i = 0; i < source->pages_used; i++)
+		if (source->page_index[i] == index)
+			return source->pages + i * EXIF_SOURCE_PAGE_SIZE;
+
+	if (!source->pages) {
+		source->pages = exif_mem_alloc (source->mem,
+			EXIF_SOURCE_PAGES * EXIF_SOURCE_PAGE_SIZE);
+		if (!source->pages)
+			return NULL;
+	}
+
+	/* Take a free slot, or replace the oldest page */
+	if (source->pages_used < EXIF_SOURCE_PAGES)
+		i = source->pages_used;
+	else
+		i = source->page_next;
+	source->page_next = (i + 1) % EXIF_SOURCE_PAGES;
+
+	offset = index * EXIF_SOURCE_PAGE_SIZE;
+	size = source->size - offset;
+	if (size > EXIF_SOURCE_PAGE_SIZE)
+		size = EXIF_SOURCE_PAGE_SIZE;
+	p = source->pages + i * EXIF_SOURCE_PAGE_SIZE;
+	if (i == source->pages_used)
+		source->pages_used++;
+	if (source->read_at (source->user_data, offset, p, size) != size) {
+		/* Forget whatever was in the slot; no page has this index */
+		source->page_index[i] = 0xffffffff;
+		return NULL;
+	}
+	source->page_index[i] = index;
+	return p;
+}
+
+int
+exif_source_read (ExifSource *source, unsigned int offset,
+		  unsigned char *buf, unsigned int size)
+{
+	const unsigned char *p;
+	unsigned int l;
+
+	if (!source || !buf || EXIF_SOURCE_OUTSIDE (source, offset, size))
+		return 0;
+	if (source->data) {
+		memcpy (buf, source->data + offset, size);
+		return 1;
+	}
+
+	/* Large values like thumbnails bypass the cache */
+	if (size >= EXIF_SOURCE_PAGE_SIZE)
+		return source->read_at (source->user_data, offset, buf, size) == size;
+
+	while (size) {
+		p = exif_source_page (source, offset / EXIF_SOURCE_PAGE_SIZE);
+		if (!p)
+			return 0;
+		l = EXIF_SOURCE_PAGE_SIZE - offset % EXIF_SOURCE_PAGE_SIZE;
+		if (l > size)
+			l = size;
+		memcpy (buf, p + offset % EXIF_SOURCE_PAGE_SIZE, l);
+		buf += l;
+		offset += l;
+		size -= l;
+	}
+	return 1;
+}
+
+const unsigned char *
+exif_source_get (ExifSource *source, unsigned int offset, unsigned int size)
+{
+	const unsigned char *p;
+	unsigned char *t;
+
+	if (!source || !size || EXIF_SOURCE_OUTSIDE (source, offset, size))
+		return NULL;
+	if (source->data)
+		return source->data + offset;
+
+	/* Within a single page */
+	if (offset / EXIF_SOURCE_PAGE_SIZE ==
+	    (offset + size - 1) / EXIF_SOURCE_PAGE_SIZE) {
+		p = exif_source_page (source, offset / EXIF_SOURCE_PAGE_SIZE);
+		return p ? p + offset % EXIF_SOURCE_PAGE_SIZE : NULL;
+	}
+
+	if (size > source->scratch_size) {
+		t = exif_mem_realloc (source->mem, source->scratch, size);
+		if (!t)
+			return NULL;
+		source->scratch = t;
+		source->scratch_size = size;
+	}
+	if (!exif_source_read (source, offset, source->scratch, size))
+		return NULL;
+	return source->scratch;
+}
@@ -0,0 +1,116 @@
+/*! \file exif-source.h
+ * \brief Random access to the data EXIF information is loaded from
+ */
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#ifndef LIBEXIF_EXIF_SOURCE_H
+#define LIBEXIF_EXIF_SOURCE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+#include <libexif/exif-mem.h>
+
+/*! Data that can be read at any offset, without holding all of it in
+ * memory. Small reads are served from a cache of a few pages, so that
+ * parsing the IFDs of a large file touches little more than the pages
+ * they live on.
+ */
+typedef struct _ExifSource ExifSource;
+
+/*! Read data at the given offset.
+ *
+ * \param[in] user_data data passed to #exif_source_new
+ * \param[in] offset offset of the first byte to read
+ * \param[out] buf buffer to read into
+ * \param[in] size number of bytes to read
+ * \return number of bytes read, less than \a size only on error
+ */
+typedef unsigned int (* ExifSourceReadFunc) (void *user_data,
+					     unsigned int offset,
+					     unsigned char *buf,
+					     unsigned int size);
+
+/*! Create a source reading through a callback.
+ *
+ * \param[in] read_at function to read data with
+ * \param[in] user_data passed to \a read_at
+ * \param[in] size total number of bytes available
+ * \return new source, or NULL on error
+ */
+ExifSource *exif_source_new     (ExifSourceReadFunc read_at, void *user_data,
+				 unsigned int size);
+ExifSource *exif_source_new_mem (ExifMem *mem, ExifSourceReadFunc read_at,
+				 void *user_data, unsigned int size);
+
+/*! Create a source for data already in memory. The data is accessed
+ * directly and must stay valid for as long as the source is used.
+ *
+ * \param[in] d data
+ * \param[in] size number of bytes at \a d
+ * \return new source, or NULL on error
+ */
+ExifSource *exif_source_new_from_data (const unsigned char *d,
+				       unsigned int size);
+
+/*! Create a source reading from a file descriptor with pread(). The
+ * descriptor is neither closed nor moved. Only the first 4 GiB of the
+ * file are available.
+ *
+ * \param[in] fd descriptor of a regular file
+ * \return new source, or NULL on error
+ */
+ExifSource *exif_source_new_from_fd (int fd);
+
+void exif_source_ref   (ExifSource *source);
+void exif_source_unref (ExifSource *source);
+
+/*! \return total number of bytes available */
+unsigned int exif_source_get_size (ExifSource *source);
+
+/*! Copy data out of the source.
+ *
+ * \param[in] source the source
+ * \param[in] offset offset of the first byte
+ * \param[out] buf buffer to copy to
+ * \param[in] size number of bytes to copy
+ * \return 1 if all \a size bytes were copied, 0 otherwise
+ */
+int exif_source_read (ExifSource *source, unsigned int offset,
+		      unsigned char *buf, unsigned int size);
+
+/*! Access data in place. For sources created from memory, this is a
+ * pointer into that memory. Otherwise, it points into the page cache or a
+ * scratch buffer and stays valid until the next call on the source.
+ *
+ * \param[in] source the source
+ * \param[in] offset offset of the first byte
+ * \param[in] size number of bytes needed
+ * \return pointer to \a size bytes, or NULL if they cannot be read
+ */
+const unsigned char *exif_source_get (ExifSource *source, unsigned int offset,
+				      unsigned int size);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* !defined(LIBEXIF_EXIF_SOURCE_H) */
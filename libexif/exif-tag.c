@@ -23,6 +23,7 @@
 #include <config.h>
 
 #include <libexif/exif-tag.h>
+#include <libexif/exif-library.h>
 #include <libexif/i18n.h>
 #include <stdbool.h>
 
@@ -1114,7 +1115,7 @@ exif_tag_get_title_in_ifd (ExifTag tag, ExifIfd ifd)
 		} else
 			return NULL; /* Recorded tag not found in the table */
 	}
-	(void) bindtextdomain (GETTEXT_PACKAGE, LOCALEDIR);
+	exif_library_init ();
 	return _(ExifTagTable[i].title);
 }
 
@@ -1148,7 +1149,7 @@ exif_tag_get_description_in_ifd (ExifTag tag, ExifIfd ifd)
 	 * 
 	 * bind_textdomain_codeset (GETTEXT_PACKAGE, "UTF-8");
 	 */
-	(void) bindtextdomain (GETTEXT_PACKAGE, LOCALEDIR);
+	exif_library_init ();
 	return _(ExifTagTable[i].description);
 }
 
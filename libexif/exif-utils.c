@@ -24,6 +24,8 @@
 
 #include <libexif/exif-utils.h>
 
+#include <string.h>
+
 void
 exif_array_set_byte_order (ExifFormat f, unsigned char *b, unsigned int n,
 		ExifByteOrder o_orig, ExifByteOrder o_new)
@@ -197,6 +199,37 @@ exif_get_rational (const unsigned char *buf, ExifByteOrder order)
 	return (r);
 }
 
+float
+exif_get_float (const unsigned char *buf, ExifByteOrder order)
+{
+	ExifLong l;
+	float f;
+
+	if (!buf) return 0;
+	l = exif_get_long (buf, order);
+	memcpy (&f, &l, sizeof (f));
+	return f;
+}
+
+double
+exif_get_double (const unsigned char *buf, ExifByteOrder order)
+{
+	uint64_t u;
+	double d;
+
+	if (!buf) return 0;
+
+	/* The halves come in the byte order of the data as well */
+	if (order == EXIF_BYTE_ORDER_MOTOROLA)
+		u = ((uint64_t) exif_get_long (buf, order) << 32) |
+		    exif_get_long (buf + 4, order);
+	else
+		u = ((uint64_t) exif_get_long (buf + 4, order) << 32) |
+		    exif_get_long (buf, order);
+	memcpy (&d, &u, sizeof (d));
+	return d;
+}
+
 void
 exif_set_rational (unsigned char *buf, ExifByteOrder order,
 		   ExifRational value)
@@ -215,6 +248,16 @@ exif_set_srational (unsigned char *buf, ExifByteOrder order,
 	exif_set_slong (buf + 4, order, value.denominator);
 }
 
+void
+exif_set_float (unsigned char *buf, ExifByteOrder order, float value)
+{
+	ExifLong l;
+
+	if (!buf) return;
+	memcpy (&l, &value, sizeof (l));
+	exif_set_long (buf, order, l);
+}
+
 /*! This function converts rather UCS-2LE than UTF-16 to UTF-8.
  * It should really be replaced by iconv().
  */
@@ -115,6 +115,24 @@ ExifRational  exif_get_rational  (const unsigned char *b, ExifByteOrder order);
  */
 ExifSRational exif_get_srational (const unsigned char *b, ExifByteOrder order);
 
+/*! Retrieve a single precision value, as stored for #EXIF_FORMAT_FLOAT,
+ * from memory.
+ *
+ * \param[in] b pointer to raw EXIF value in memory
+ * \param[in] order byte order of raw value
+ * \return value
+ */
+float         exif_get_float     (const unsigned char *b, ExifByteOrder order);
+
+/*! Retrieve a double precision value, as stored for #EXIF_FORMAT_DOUBLE,
+ * from memory.
+ *
+ * \param[in] b pointer to raw EXIF value in memory
+ * \param[in] order byte order of raw value
+ * \return value
+ */
+double        exif_get_double    (const unsigned char *b, ExifByteOrder order);
+
 /*! Store an ExifShort value into memory in EXIF format.
  *
  * \param[out] b buffer in which to write raw value
@@ -169,6 +187,15 @@ void exif_set_rational  (unsigned char *b, ExifByteOrder order,
 void exif_set_srational (unsigned char *b, ExifByteOrder order,
 			 ExifSRational value);
 
+/*! Store a single precision value into memory in EXIF format.
+ *
+ * \param[out] b buffer in which to write raw value
+ * \param[in] order byte order to use
+ * \param[in] value data value to store
+ */
+void exif_set_float     (unsigned char *b, ExifByteOrder order,
+			 float value);
+
 /*! \internal */
 void exif_convert_utf16_to_utf8 (char *out, const unsigned char *in, int maxlen);
 
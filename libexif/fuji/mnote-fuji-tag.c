@@ -23,6 +23,7 @@
 #include <stdlib.h>
 
 #include <config.h>
+#include <libexif/exif-library.h>
 #include <libexif/i18n.h>
 
 #include "mnote-fuji-tag.h"
@@ -85,7 +86,7 @@ mnote_fuji_tag_get_title (MnoteFujiTag t)
 {
 	unsigned int i;
 
-	(void) bindtextdomain (GETTEXT_PACKAGE, LOCALEDIR);
+	exif_library_init ();
 	for (i = 0; i < sizeof (table) / sizeof (table[0]); i++)
 		if (table[i].tag == t) {
 			if (!table[i].title)
@@ -104,7 +105,7 @@ mnote_fuji_tag_get_description (MnoteFujiTag t)
 		if (table[i].tag == t) {
 			if (!table[i].description || !*table[i].description)
 				return "";
-			(void) bindtextdomain (GETTEXT_PACKAGE, LOCALEDIR);
+			exif_library_init ();
 			return _(table[i].description);
 		}
 	return NULL;
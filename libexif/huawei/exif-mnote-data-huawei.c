@@ -25,6 +25,7 @@
 #include <libexif/exif-byte-order.h>
 #include <libexif/exif-utils.h>
 #include <libexif/exif-data.h>
+#include <libexif/exif-data-priv.h>
 
 #define CHECKOVERFLOW(offset, datasize, structsize) \
     (((offset) >= (datasize)) || ((structsize) > (datasize)) || ((offset) > (datasize) - (structsize)))
@@ -508,6 +509,238 @@ exif_mnote_data_huawei_get_entry_by_index (ExifMnoteDataHuawei *n, const int des
 	return exif_mnote_data_huawei_get_entry_by_index_data(n, &i, dest_idx);
 }
 
+/*
+ * Look up tag in one IFD of raw TIFF data and return the offset of its
+ * value within buf, or 0 if the tag is absent or its value does not fit.
+ * Entries the full loader would drop are skipped. Like
+ * exif_content_get_huawei_makenote_entry(), only a MakerNote starting
+ * with the Huawei header is taken, as there may be several.
+ */
+static unsigned int
+exif_mnote_data_huawei_find_tiff_tag (const unsigned char *buf, unsigned int buf_size,
+				      unsigned int tiff_offset, unsigned int ifd_offset,
+				      ExifByteOrder order, ExifTag tag, unsigned int *size)
+{
+	if (ifd_offset > buf_size - tiff_offset ||
+	    CHECKOVERFLOW(tiff_offset + ifd_offset, buf_size, 2))
+		return 0;
+
+	unsigned int entry_offset = tiff_offset + ifd_offset + 2;
+	ExifShort count = exif_get_short (buf + tiff_offset + ifd_offset, order);
+	for (ExifShort i = 0; i < count; i++, entry_offset += 12) {
+		if (CHECKOVERFLOW(entry_offset, buf_size, 12))
+			return 0;
+		if (exif_get_short (buf + entry_offset, order) != tag)
+			continue;
+
+		ExifFormat format = exif_get_short (buf + entry_offset + 2, order);
+		ExifLong components = exif_get_long (buf + entry_offset + 4, order);
+		unsigned char format_size = exif_format_get_size (format);
+		if (!format_size || components > buf_size / format_size)
+			continue;
+		unsigned int components_size = format_size * components;
+		unsigned int data_offset = entry_offset + 8;
+		if (components_size > 4) {
+			ExifLong value_offset = exif_get_long (buf + entry_offset + 8, order);
+			if (value_offset > buf_size - tiff_offset)
+				continue;
+			data_offset = tiff_offset + value_offset;
+		}
+		if (CHECKOVERFLOW(data_offset, buf_size, components_size))
+			continue;
+		if (tag == EXIF_TAG_MAKER_NOTE &&
+		    (components_size < 8 || memcmp (buf + data_offset, HUAWEI_HEADER, 8)))
+			continue;
+		*size = components_size;
+		return data_offset;
+	}
+	return 0;
+}
+
+/*
+ * Depth-first walk of a Huawei MakerNote IFD with the same checks and in
+ * the same order as exif_mnote_data_huawei_load_data(), so that the entry
+ * found is the one exif_mnote_data_huawei_get_entry_by_tag() returns after
+ * a full load. A negative tag never matches. Every entry the full loader
+ * would keep is added to *count if count is not NULL. The walk does not
+ * stop at a match, because the loader rejects the whole MakerNote if any
+ * sub-IFD is broken. Returns 1 if found, 0 if not and -1 where the full
+ * loader would reject the MakerNote.
+ */
+static int
+exif_mnote_data_huawei_find_entry_data (const unsigned char *buf, unsigned int buf_size,
+					unsigned int ifd_offset, const unsigned int order_offset,
+					ExifByteOrder order, int tag, MnoteHuaweiEntry *entry,
+					unsigned int *count, unsigned int load_times)
+{
+	int found = 0;
+
+	if (CHECKOVERFLOW(ifd_offset, buf_size, 2) || load_times > MAX_DATA_LOAD_TIMES)
+		return -1;
+
+	const unsigned char *ifd_data = buf + ifd_offset;
+	ExifShort n = exif_get_short (ifd_data, order);
+	if (n > 100)
+		return -1;
+
+	size_t offset = 2;
+	for (int i = 0; i < n; i++, offset += 12) {
+		if (CHECKOVERFLOW(ifd_offset + offset, buf_size, 12))
+			break;
+
+		MnoteHuaweiTag t = exif_get_short (ifd_data + offset, order);
+		ExifFormat format = exif_get_short (ifd_data + offset + 2, order);
+		ExifLong components = exif_get_long (ifd_data + offset + 4, order);
+		size_t components_size = exif_format_get_size (format) * components;
+		if (!components_size)
+			continue;
+
+		size_t data_offset = ifd_offset + offset + HUAWEI_HEADER_OFFSET;
+		if (components_size > 4)
+			data_offset = (size_t) order_offset + exif_get_long (ifd_data + offset + HUAWEI_HEADER_OFFSET, order);
+		if (data_offset > buf_size || CHECKOVERFLOW(data_offset, buf_size, components_size))
+			continue;
+
+		/* The loader drops a sub-IFD entry whose IFD lies outside */
+		int sub = (t == MNOTE_HUAWEI_SCENE_INFO || t == MNOTE_HUAWEI_FACE_INFO) && components_size >= 4;
+		size_t sub_offset = 0;
+		if (sub) {
+			sub_offset = (size_t) order_offset + exif_get_long (buf + data_offset, order);
+			if (sub_offset > buf_size || CHECKOVERFLOW(sub_offset, buf_size, 2))
+				continue;
+		}
+		if (count)
+			(*count)++;
+
+		if (!found && (int) t == tag) {
+			memset (entry, 0, sizeof (MnoteHuaweiEntry));
+			entry->tag        = t;
+			entry->format     = format;
+			entry->components = components;
+			entry->size       = components_size;
+			entry->order      = order;
+			entry->data       = (unsigned char *) buf + data_offset;
+			found = 1;
+		}
+
+		/* Like the loader, count sub-IFDs on across siblings */
+		if (sub) {
+			int ret = exif_mnote_data_huawei_find_entry_data (buf, buf_size, sub_offset, order_offset,
+									  order, found ? -1 : tag, entry, count,
+									  ++load_times);
+			if (ret == -1)
+				return -1;
+			if (ret == 1)
+				found = 1;
+		}
+	}
+	return found;
+}
+
+/*
+ * Walk the Huawei MakerNote whose data starts at mnote within buf. Offsets
+ * inside the MakerNote are relative to its byte order mark, so the whole
+ * buffer is passed down rather than just the MakerNote bytes.
+ */
+static int
+exif_mnote_data_huawei_walk (const unsigned char *buf, unsigned int buf_size,
+			     unsigned int mnote, unsigned int mnote_size, int tag,
+			     MnoteHuaweiEntry *entry, unsigned int *count)
+{
+	ExifByteOrder order;
+
+	if (mnote_size < sizeof (HUAWEI_HEADER) || memcmp (buf + mnote, HUAWEI_HEADER, 8))
+		return -1;
+
+	unsigned int order_offset = mnote + HUAWEI_HEADER_OFFSET;
+	if (!memcmp (buf + order_offset, "II", 2))
+		order = EXIF_BYTE_ORDER_INTEL;
+	else if (!memcmp (buf + order_offset, "MM", 2))
+		order = EXIF_BYTE_ORDER_MOTOROLA;
+	else
+		return -1;
+
+	return exif_mnote_data_huawei_find_entry_data (buf, buf_size, mnote + sizeof (HUAWEI_HEADER),
+						       order_offset, order, tag, entry, count, 1);
+}
+
+int
+exif_mnote_data_huawei_find_entry (const unsigned char *buf, unsigned int buf_size,
+				   const MnoteHuaweiTag tag, MnoteHuaweiEntry *entry)
+{
+	ExifByteOrder order;
+	unsigned int tiff_offset = 0, size = 0;
+
+	if (!buf || !buf_size || !entry)
+		return 0;
+
+	/* Accept raw TIFF data as well as APP1 segments and JPEG streams */
+	if (buf_size < 2 || (memcmp (buf, "II", 2) && memcmp (buf, "MM", 2))) {
+		const unsigned char *header = exif_data_find_exif_header (NULL, buf, &buf_size);
+		if (!header)
+			return 0;
+		buf = header;
+		tiff_offset = 6;
+	}
+	if (CHECKOVERFLOW(tiff_offset, buf_size, 8))
+		return 0;
+
+	if (!memcmp (buf + tiff_offset, "II", 2))
+		order = EXIF_BYTE_ORDER_INTEL;
+	else if (!memcmp (buf + tiff_offset, "MM", 2))
+		order = EXIF_BYTE_ORDER_MOTOROLA;
+	else
+		return 0;
+	if (exif_get_short (buf + tiff_offset + 2, order) != 0x002a)
+		return 0;
+
+	/* IFD 0 -> EXIF IFD -> MakerNote */
+	unsigned int pointer = exif_mnote_data_huawei_find_tiff_tag (buf, buf_size, tiff_offset,
+			exif_get_long (buf + tiff_offset + 4, order), order, EXIF_TAG_EXIF_IFD_POINTER, &size);
+	if (!pointer || size < 4)
+		return 0;
+	unsigned int mnote = exif_mnote_data_huawei_find_tiff_tag (buf, buf_size, tiff_offset,
+			exif_get_long (buf + pointer, order), order, EXIF_TAG_MAKER_NOTE, &size);
+	if (!mnote)
+		return 0;
+
+	return exif_mnote_data_huawei_walk (buf, buf_size, mnote, size, tag, entry, NULL) == 1;
+}
+
+int
+exif_mnote_data_huawei_validate (const unsigned char *buf, unsigned int buf_size,
+				 unsigned int mnote_offset, unsigned int mnote_size,
+				 unsigned int *count)
+{
+	unsigned int n = 0;
+	int ret;
+
+	if (count)
+		*count = 0;
+	if (!buf || CHECKOVERFLOW(mnote_offset, buf_size, mnote_size))
+		return 0;
+	/* Not ours, see exif_mnote_data_huawei_identify() */
+	if (mnote_size < sizeof (HUAWEI_HEADER) || memcmp (buf + mnote_offset, HUAWEI_HEADER, 8))
+		return 1;
+	ret = exif_mnote_data_huawei_walk (buf, buf_size, mnote_offset, mnote_size, -1, NULL, &n);
+	if (count)
+		*count = n;
+	return ret == 0;
+}
+
+char *
+exif_mnote_data_huawei_get_value_from_data (const unsigned char *buf, unsigned int buf_size,
+					    const MnoteHuaweiTag tag, char *val, unsigned int maxlen)
+{
+	MnoteHuaweiEntry entry;
+
+	if (!val || !maxlen)
+		return NULL;
+	if (!exif_mnote_data_huawei_find_entry (buf, buf_size, tag, &entry))
+		return NULL;
+	return mnote_huawei_entry_get_value (&entry, val, maxlen);
+}
+
 void
 mnote_huawei_get_entry_count (const ExifMnoteDataHuawei* n, MnoteHuaweiEntryCount** entry_count)
 {
@@ -801,6 +1034,12 @@ exif_mnote_data_huawei_new (ExifMem *mem)
 	memset(ne, 0, sizeof (ExifMnoteDataHuawei));
 	exif_mnote_data_construct (ne, mem);
 
+	/*
+	 * Only sub-IFDs release their own memory in exif_mnote_data_huawei_clear();
+	 * a MakerNote that is never loaded is freed by exif_mnote_data_free().
+	 */
+	((ExifMnoteDataHuawei *) ne)->ifd_tag = MNOTE_HUAWEI_INFO;
+
 	/* Set up function pointers */
 	ne->methods.free            = exif_mnote_data_huawei_free;
 	ne->methods.set_byte_order  = exif_mnote_data_huawei_set_byte_order;
@@ -76,6 +76,48 @@ void exif_mnote_data_remove_entry (ExifMnoteData *ne, MnoteHuaweiEntry *e);
 MnoteHuaweiEntry* exif_mnote_data_huawei_get_entry_by_tag (ExifMnoteDataHuawei *n, const MnoteHuaweiTag tag);
 MnoteHuaweiEntry* exif_mnote_data_huawei_get_entry_by_index (ExifMnoteDataHuawei *n, const int dest_idx);
 ExifMnoteData *exif_mnote_data_huawei_new (ExifMem *mem);
+
+/*! Look up a single Huawei MakerNote tag directly in raw EXIF data,
+ *  without building an #ExifData or allocating any memory.
+ *
+ * \param[in] buf JPEG stream, APP1 segment starting with "Exif\0\0" or raw TIFF data
+ * \param[in] buf_size size of buf
+ * \param[in] tag tag to look up, searched in the same order as
+ *   #exif_mnote_data_huawei_get_entry_by_tag
+ * \param[out] entry on success, describes the tag; entry->data points into buf
+ *   and stays valid only as long as buf does. Do not pass it to
+ *   #mnote_huawei_entry_free.
+ * \return 1 if the tag was found, 0 otherwise
+ */
+int exif_mnote_data_huawei_find_entry (const unsigned char *buf, unsigned int buf_size,
+				       const MnoteHuaweiTag tag, MnoteHuaweiEntry *entry);
+
+/*! Format the value of a single Huawei MakerNote tag found in raw EXIF data.
+ *
+ * \param[in] buf JPEG stream, APP1 segment or raw TIFF data
+ * \param[in] buf_size size of buf
+ * \param[in] tag tag to look up
+ * \param[out] val buffer receiving the value
+ * \param[in] maxlen size of val
+ * \return val, or NULL if the tag was not found
+ */
+char *exif_mnote_data_huawei_get_value_from_data (const unsigned char *buf, unsigned int buf_size,
+						  const MnoteHuaweiTag tag, char *val, unsigned int maxlen);
+
+/*! Check the structure of a Huawei MakerNote in place, without allocating.
+ *
+ * \param[in] buf buffer the MakerNote value offsets are relative to,
+ *   i.e. the TIFF data starting at the byte order mark
+ * \param[in] buf_size size of buf
+ * \param[in] mnote_offset offset of the MakerNote data within buf
+ * \param[in] mnote_size size of the MakerNote data
+ * \param[out] count number of entries the full loader would keep, may be NULL
+ * \return 0 if this is a Huawei MakerNote the full loader would reject,
+ *   1 otherwise
+ */
+int exif_mnote_data_huawei_validate (const unsigned char *buf, unsigned int buf_size,
+				     unsigned int mnote_offset, unsigned int mnote_size,
+				     unsigned int *count);
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -37,9 +37,6 @@
 #define TIMESTAMP_LENGTH 10
 #define THREE_COMPONENTS 3
 #define SHORT_INCREMENT 2
-#define SHIFT_ONE_BYTE 8
-#define SHIFT_TWO_BYTE 16
-#define SHIFT_THREE_BYTE 24
 
 /* Get length of number for value in unsigned integer */
 uint32_t get_unsigned_int_length(uint32_t value)
@@ -69,65 +66,6 @@ uint32_t get_unsigned_char_length(uint32_t value) {
     return (uint32_t)log10(value) + 1;
 }
 
-float exif_get_float (const unsigned char *buf, ExifByteOrder order)
-{
-    if (!buf) {
-		return 0.0f;
-	}
-
-    uint32_t u = 0;
-
-    switch (order) {
-    case EXIF_BYTE_ORDER_MOTOROLA: /* big-endian */
-        u = ((uint32_t)buf[0] << SHIFT_THREE_BYTE) |
-            ((uint32_t)buf[1] << SHIFT_TWO_BYTE) |
-            ((uint32_t)buf[2] <<  SHIFT_ONE_BYTE) |
-            ((uint32_t)buf[3]      );
-        break;
-    case EXIF_BYTE_ORDER_INTEL:    /* little-endian */
-        u = ((uint32_t)buf[3] << SHIFT_THREE_BYTE) |
-            ((uint32_t)buf[2] << SHIFT_TWO_BYTE) |
-            ((uint32_t)buf[1] <<  SHIFT_ONE_BYTE) |
-            ((uint32_t)buf[0]      );
-        break;
-    default:
-        return 0.0f;
-    }
-
-    float f = 0.0f;
-    if (memcpy_s(&f, sizeof(f), &u, sizeof(u)) != 0) {
-        return 0.0f;
-    }
-    return f;
-}
-
-void exif_set_float (unsigned char *buf, ExifByteOrder order, float value)
-{
-    if (!buf) return;
-
-    uint32_t u = 0;
-    if (memcpy_s(&u, sizeof(u), &value, sizeof(value)) != 0) {
-        return; // 拷贝失败就不写 buf
-    }
-
-    switch (order) {
-    case EXIF_BYTE_ORDER_MOTOROLA: /* big-endian */
-        buf[0] = (unsigned char)((u >> SHIFT_THREE_BYTE) & 0xFF);
-        buf[1] = (unsigned char)((u >> SHIFT_TWO_BYTE) & 0xFF);
-        buf[2] = (unsigned char)((u >>  SHIFT_ONE_BYTE) & 0xFF);
-        buf[3] = (unsigned char)( u        & 0xFF);
-        break;
-    case EXIF_BYTE_ORDER_INTEL:    /* little-endian */
-        buf[0] = (unsigned char)( u        & 0xFF);
-        buf[1] = (unsigned char)((u >>  SHIFT_ONE_BYTE) & 0xFF);
-        buf[2] = (unsigned char)((u >> SHIFT_TWO_BYTE) & 0xFF);
-        buf[3] = (unsigned char)((u >> SHIFT_THREE_BYTE) & 0xFF);
-        break;
-    default:
-        break;
-    }
-}
-
 /* Get components from exif */
 char *
 format_exif_components(MnoteHuaweiEntry *e, char *v, unsigned int maxlen, unsigned int write_pos)
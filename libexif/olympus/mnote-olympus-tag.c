@@ -23,6 +23,7 @@
 #include <config.h>
 #include "mnote-olympus-tag.h"
 
+#include <libexif/exif-library.h>
 #include <libexif/i18n.h>
 #include <libexif/exif-utils.h>
 
@@ -242,7 +243,7 @@ mnote_olympus_tag_get_title (MnoteOlympusTag t)
 {
 	unsigned int i;
 
-	(void) bindtextdomain (GETTEXT_PACKAGE, LOCALEDIR);
+	exif_library_init ();
 	for (i = 0; i < sizeof (table) / sizeof (table[0]); i++)
 		if (table[i].tag == t) {
 			if (!table[i].title)
@@ -261,7 +262,7 @@ mnote_olympus_tag_get_description (MnoteOlympusTag t)
 		if (table[i].tag == t) {
 			if (!table[i].description || !*table[i].description)
 				return "";
-			(void) bindtextdomain (GETTEXT_PACKAGE, LOCALEDIR);
+			exif_library_init ();
 			return _(table[i].description);
 		}
 	return NULL;
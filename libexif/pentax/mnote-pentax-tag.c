@@ -25,6 +25,7 @@
 
 #include <stdlib.h>
 
+#include <libexif/exif-library.h>
 #include <libexif/i18n.h>
 
 static const struct {
@@ -155,7 +156,7 @@ mnote_pentax_tag_get_title (MnotePentaxTag t)
 {
 	unsigned int i;
 
-	(void) bindtextdomain (GETTEXT_PACKAGE, LOCALEDIR);
+	exif_library_init ();
 	for (i = 0; i < sizeof (table) / sizeof (table[0]); i++)
 		if (table[i].tag == t) {
 			if (!table[i].title)
@@ -174,7 +175,7 @@ mnote_pentax_tag_get_description (MnotePentaxTag t)
 		if (table[i].tag == t) {
 			if (!table[i].description || !*table[i].description)
 				return "";
-			(void) bindtextdomain (GETTEXT_PACKAGE, LOCALEDIR);
+			exif_library_init ();
 			return _(table[i].description);
 		}
 	return NULL;
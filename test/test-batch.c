@@ -0,0 +1,236 @@
+/* test-batch.c
+ *
+ * Check the columns written by exif_batch_extract_columns against the
+ * entries exif_data_load_data finds in the same images.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#include <libexif/exif-batch.h>
+#include <libexif/exif-data.h>
+#include <libexif/exif-utils.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *files[] = {
+	"canon_makernote_variant_1.jpg",
+	"fuji_makernote_variant_1.jpg",
+	"olympus_makernote_variant_2.jpg",
+	"pentax_makernote_variant_2.jpg"
+};
+
+#define N_FILES (sizeof (files) / sizeof (files[0]))
+
+/* Images, then a missing one and one without EXIF data */
+#define N_ROWS (N_FILES + 2)
+
+static const ExifTag columns[] = {
+	EXIF_TAG_MAKE,
+	EXIF_TAG_MODEL,
+	EXIF_TAG_EXPOSURE_TIME,
+	EXIF_TAG_ISO_SPEED_RATINGS,
+	EXIF_TAG_PIXEL_X_DIMENSION,
+	EXIF_TAG_INTEROPERABILITY_INDEX,
+	EXIF_TAG_USER_COMMENT,
+	0xbeef
+};
+
+#define N_COLUMNS (sizeof (columns) / sizeof (columns[0]))
+
+static unsigned char *
+read_file (const char *path, unsigned int *size)
+{
+	FILE *f = fopen (path, "rb");
+	unsigned char *d;
+	long l;
+
+	if (!f)
+		return NULL;
+	fseek (f, 0, SEEK_END);
+	l = ftell (f);
+	fseek (f, 0, SEEK_SET);
+	d = malloc (l);
+	if (d && fread (d, 1, l, f) != (size_t) l) {
+		free (d);
+		d = NULL;
+	}
+	fclose (f);
+	*size = (unsigned int) l;
+	return d;
+}
+
+static int
+is_valid (const ExifColumnOut *c, unsigned int row)
+{
+	return (c->validity[row / 8] >> (row % 8)) & 1;
+}
+
+/*! Compare a row of a column with the entry an ExifData holds for it */
+static int
+check_cell (const char *name, const ExifColumnOut *c, unsigned int row,
+	    ExifData *ed)
+{
+	ExifEntry *e = NULL;
+	ExifByteOrder o;
+	ExifRational r;
+	unsigned int l;
+
+	if (ed && c->ifd < EXIF_IFD_COUNT)
+		e = exif_content_get_entry (ed->ifd[c->ifd], c->tag);
+	if (!e || !e->size) {
+		if (is_valid (c, row)) {
+			fprintf (stderr, "%s: tag 0x%04x should be null\n", name, c->tag);
+			return 1;
+		}
+		return 0;
+	}
+	if (!is_valid (c, row)) {
+		fprintf (stderr, "%s: tag 0x%04x missing\n", name, c->tag);
+		return 1;
+	}
+
+	o = exif_data_get_byte_order (ed);
+	switch (e->format) {
+	case EXIF_FORMAT_ASCII:
+	case EXIF_FORMAT_UNDEFINED:
+		l = e->size;
+		if (e->format == EXIF_FORMAT_ASCII && memchr (e->data, 0, l))
+			l = (unsigned char *) memchr (e->data, 0, l) - e->data;
+		if (c->type != EXIF_COLUMN_TYPE_STRING ||
+		    c->offsets[row + 1] - c->offsets[row] != l ||
+		    memcmp (c->chars + c->offsets[row], e->data, l)) {
+			fprintf (stderr, "%s: tag 0x%04x differs\n", name, c->tag);
+			return 1;
+		}
+		return 0;
+	case EXIF_FORMAT_SHORT:
+		if (c->type != EXIF_COLUMN_TYPE_INT64 ||
+		    c->ints[row] != exif_get_short (e->data, o)) {
+			fprintf (stderr, "%s: tag 0x%04x differs\n", name, c->tag);
+			return 1;
+		}
+		return 0;
+	case EXIF_FORMAT_LONG:
+		if (c->type != EXIF_COLUMN_TYPE_INT64 ||
+		    c->ints[row] != exif_get_long (e->data, o)) {
+			fprintf (stderr, "%s: tag 0x%04x differs\n", name, c->tag);
+			return 1;
+		}
+		return 0;
+	case EXIF_FORMAT_RATIONAL:
+		r = exif_get_rational (e->data, o);
+		if (c->type != EXIF_COLUMN_TYPE_DOUBLE || !r.denominator ||
+		    fabs (c->doubles[row] - (double) r.numerator / r.denominator) > 1e-12) {
+			fprintf (stderr, "%s: tag 0x%04x differs\n", name, c->tag);
+			return 1;
+		}
+		return 0;
+	default:
+		fprintf (stderr, "%s: unexpected format %i\n", name, e->format);
+		return 1;
+	}
+}
+
+int
+main (void)
+{
+	const char *srcdir = getenv ("srcdir");
+	static const unsigned char garbage[] = "\xff\xd8\xff\xe1\x00\x10no EXIF here";
+	const unsigned char *buffers[N_ROWS];
+	unsigned int sizes[N_ROWS];
+	ExifData *eds[N_ROWS];
+	ExifColumnOut out[N_COLUMNS];
+	char path[1024];
+	unsigned int i, j, nulls;
+	int ret = 0;
+
+	if (!srcdir)
+		srcdir = ".";
+
+	memset (eds, 0, sizeof (eds));
+	for (i = 0; i < N_FILES; i++) {
+		snprintf (path, sizeof (path), "%s/testdata/%s", srcdir, files[i]);
+		buffers[i] = read_file (path, &sizes[i]);
+		if (!buffers[i]) {
+			fprintf (stderr, "could not read %s\n", path);
+			return 1;
+		}
+
+		/* Compare with the entries as they are in the file */
+		eds[i] = exif_data_new ();
+		exif_data_unset_option (eds[i], EXIF_DATA_OPTION_IGNORE_UNKNOWN_TAGS);
+		exif_data_unset_option (eds[i], EXIF_DATA_OPTION_FOLLOW_SPECIFICATION);
+		exif_data_load_data (eds[i], buffers[i], sizes[i]);
+	}
+	buffers[N_FILES] = NULL;
+	sizes[N_FILES] = 0;
+	buffers[N_FILES + 1] = garbage;
+	sizes[N_FILES + 1] = sizeof (garbage) - 1;
+
+	if (!exif_batch_extract_columns (buffers, sizes, N_ROWS, columns,
+					 N_COLUMNS, out)) {
+		fprintf (stderr, "exif_batch_extract_columns failed\n");
+		return 1;
+	}
+
+	for (j = 0; j < N_COLUMNS; j++) {
+		if (out[j].tag != columns[j] || out[j].length != N_ROWS) {
+			fprintf (stderr, "column %u not set up\n", j);
+			ret = 1;
+			continue;
+		}
+		nulls = 0;
+		for (i = 0; i < N_ROWS; i++) {
+			ret |= check_cell (i < N_FILES ? files[i] : "no data",
+					   &out[j], i, eds[i]);
+			nulls += !is_valid (&out[j], i);
+		}
+		if (nulls != out[j].null_count) {
+			fprintf (stderr, "column %u: null count %u, expected %u\n",
+				 j, out[j].null_count, nulls);
+			ret = 1;
+		}
+		if (out[j].type == EXIF_COLUMN_TYPE_STRING &&
+		    out[j].offsets[N_ROWS] != out[j].chars_size) {
+			fprintf (stderr, "column %u: offsets do not end at %u\n",
+				 j, out[j].chars_size);
+			ret = 1;
+		}
+	}
+
+	/* Make is in all images, the made up tag in none */
+	if (out[0].null_count != 2 || out[0].type != EXIF_COLUMN_TYPE_STRING) {
+		fprintf (stderr, "Make not extracted\n");
+		ret = 1;
+	}
+	if (out[N_COLUMNS - 1].type != EXIF_COLUMN_TYPE_NONE ||
+	    out[N_COLUMNS - 1].null_count != N_ROWS) {
+		fprintf (stderr, "unknown tag has values\n");
+		ret = 1;
+	}
+
+	exif_batch_free_columns (out, N_COLUMNS);
+	for (i = 0; i < N_FILES; i++) {
+		exif_data_unref (eds[i]);
+		free ((void *) buffers[i]);
+	}
+	return ret;
+}
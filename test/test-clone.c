@@ -0,0 +1,266 @@
+/* test-clone.c
+ *
+ * Check that exif_data_clone copies a template, that clones do not share
+ * values with each other or with the template, and that changing the
+ * template shows in later clones.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#include <libexif/exif-data.h>
+#include <libexif/exif-utils.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *files[] = {
+	"canon_makernote_variant_1.jpg",
+	"fuji_makernote_variant_1.jpg",
+	"olympus_makernote_variant_2.jpg",
+	"pentax_makernote_variant_2.jpg"
+};
+
+static int
+compare_saved (const char *fn, ExifData *a, ExifData *b)
+{
+	unsigned char *da = NULL, *db = NULL;
+	unsigned int sa = 0, sb = 0;
+	int ret = 0;
+
+	exif_data_save_data (a, &da, &sa);
+	exif_data_save_data (b, &db, &sb);
+	if (!da || sa != sb || memcmp (da, db, sa)) {
+		fprintf (stderr, "%s: saved data differs (%u vs %u bytes)\n",
+			 fn, sa, sb);
+		ret = 1;
+	}
+	free (da);
+	free (db);
+	return ret;
+}
+
+/*! Entries of the template may be saved in another order than they are
+ *  in the clone, so look them up by tag. Like any saved and loaded data,
+ *  the clone also has entries pointing to the thumbnail. */
+static int
+compare_entries (const char *fn, ExifData *a, ExifData *b)
+{
+	unsigned int i, j;
+	ExifEntry *ea, *eb;
+
+	for (i = 0; i < EXIF_IFD_COUNT; i++) {
+		for (j = 0; j < a->ifd[i]->count; j++) {
+			ea = a->ifd[i]->entries[j];
+			eb = exif_content_get_entry (b->ifd[i], ea->tag);
+			if (!eb || ea->format != eb->format ||
+			    ea->components != eb->components ||
+			    ea->size != eb->size ||
+			    memcmp (ea->data, eb->data, ea->size)) {
+				fprintf (stderr, "%s: tag 0x%04x differs\n",
+					 fn, ea->tag);
+				return 1;
+			}
+		}
+	}
+	if (a->size != b->size || (a->size && memcmp (a->data, b->data, a->size))) {
+		fprintf (stderr, "%s: thumbnail differs\n", fn);
+		return 1;
+	}
+	return 0;
+}
+
+static ExifEntry *
+add_entry (ExifData *ed, ExifIfd ifd, ExifTag tag)
+{
+	ExifEntry *e = exif_entry_new ();
+
+	exif_content_add_entry (ed->ifd[ifd], e);
+	exif_entry_initialize (e, tag);
+	exif_entry_unref (e);
+	return e;
+}
+
+static ExifData *
+make_template (void)
+{
+	static const char make[] = "Template camera";
+	ExifData *ed = exif_data_new ();
+	ExifEntry *e;
+
+	exif_data_set_byte_order (ed, EXIF_BYTE_ORDER_INTEL);
+	add_entry (ed, EXIF_IFD_0, EXIF_TAG_X_RESOLUTION);
+	add_entry (ed, EXIF_IFD_0, EXIF_TAG_Y_RESOLUTION);
+	add_entry (ed, EXIF_IFD_0, EXIF_TAG_RESOLUTION_UNIT);
+	add_entry (ed, EXIF_IFD_EXIF, EXIF_TAG_COLOR_SPACE);
+	add_entry (ed, EXIF_IFD_EXIF, EXIF_TAG_EXIF_VERSION);
+
+	e = exif_entry_new ();
+	exif_content_add_entry (ed->ifd[EXIF_IFD_0], e);
+	e->tag = EXIF_TAG_MAKE;
+	e->format = EXIF_FORMAT_ASCII;
+	e->components = sizeof (make);
+	e->size = sizeof (make);
+	e->data = malloc (e->size);
+	memcpy (e->data, make, e->size);
+	exif_entry_unref (e);
+
+	ed->size = 64;
+	ed->data = malloc (ed->size);
+	memset (ed->data, 0xab, ed->size);
+	return ed;
+}
+
+/*! Entries whose tag is set after they were added, as make_template()
+ *  does, are still found, and their tag cannot be added again */
+static int
+check_late_tag (void)
+{
+	ExifContent *c = exif_content_new ();
+	ExifEntry *e = exif_entry_new (), *artist = exif_entry_new ();
+	int ret = 0;
+
+	e->tag = EXIF_TAG_MAKE;
+	exif_content_add_entry (c, e);
+	exif_content_add_entry (c, artist);
+	artist->tag = EXIF_TAG_ARTIST;
+	exif_entry_unref (e);
+
+	e = exif_entry_new ();
+	e->tag = EXIF_TAG_ARTIST;
+	exif_content_add_entry (c, e);
+	if ((exif_content_get_entry (c, EXIF_TAG_ARTIST) != artist) ||
+	    !exif_content_get_entry (c, EXIF_TAG_MAKE) || e->parent) {
+		fprintf (stderr, "Entry with a late tag not found\n");
+		ret = 1;
+	}
+	exif_entry_unref (e);
+	exif_entry_unref (artist);
+	exif_content_unref (c);
+	return ret;
+}
+
+static int
+check_template (void)
+{
+	ExifData *t = make_template (), *a, *b, *c;
+	ExifEntry *e;
+	unsigned char *d = NULL;
+	unsigned int ds = 0;
+	int ret = 0;
+
+	a = exif_data_clone (t);
+	b = exif_data_clone (t);
+	if (!a || !b) {
+		fprintf (stderr, "template: no clone\n");
+		return 1;
+	}
+	ret |= compare_entries ("template", t, a);
+	ret |= compare_entries ("template", t, b);
+	if (exif_data_get_byte_order (a) != EXIF_BYTE_ORDER_INTEL) {
+		fprintf (stderr, "template: byte order differs\n");
+		ret = 1;
+	}
+
+	/* Values written into one clone stay there */
+	e = exif_content_get_entry (a->ifd[EXIF_IFD_EXIF], EXIF_TAG_COLOR_SPACE);
+	if (!e) {
+		fprintf (stderr, "template: ColorSpace missing\n");
+		exif_data_unref (t);
+		return 1;
+	}
+	exif_set_short (e->data, EXIF_BYTE_ORDER_INTEL, 2);
+	a->data[0] = 0;
+	ret |= compare_entries ("template", t, b);
+
+	/* The template outlives none of its clones' data */
+	exif_data_unref (t);
+	t = NULL;
+	c = exif_data_clone (b);
+	if (!c) {
+		fprintf (stderr, "template: no clone of a clone\n");
+		ret = 1;
+	} else {
+		ret |= compare_saved ("clone", b, c);
+		exif_data_unref (c);
+	}
+	exif_data_unref (a);
+	exif_data_unref (b);
+
+	/* Entries added to the template show in later clones */
+	t = make_template ();
+	a = exif_data_clone (t);
+	add_entry (t, EXIF_IFD_0, EXIF_TAG_ORIENTATION);
+	b = exif_data_clone (t);
+	if (!a || !b ||
+	    exif_content_get_entry (a->ifd[EXIF_IFD_0], EXIF_TAG_ORIENTATION) ||
+	    !exif_content_get_entry (b->ifd[EXIF_IFD_0], EXIF_TAG_ORIENTATION)) {
+		fprintf (stderr, "template: change not picked up\n");
+		ret = 1;
+	}
+	exif_data_unref (a);
+	exif_data_unref (b);
+
+	/* So do values written into it and marked, even if it was saved
+	 * before the next clone */
+	a = exif_data_clone (t);
+	e = exif_content_get_entry (t->ifd[EXIF_IFD_EXIF], EXIF_TAG_COLOR_SPACE);
+	exif_set_short (e->data, EXIF_BYTE_ORDER_INTEL, 2);
+	exif_entry_mark_dirty (e);
+	exif_data_save_data (t, &d, &ds);
+	free (d);
+	b = exif_data_clone (t);
+	if (!a || !b) {
+		fprintf (stderr, "template: no clone\n");
+		ret = 1;
+	} else
+		ret |= compare_entries ("marked template", t, b);
+	exif_data_unref (a);
+	exif_data_unref (b);
+	exif_data_unref (t);
+	return ret;
+}
+
+int
+main (void)
+{
+	const char *srcdir = getenv ("srcdir");
+	char path[1024];
+	unsigned int i;
+	ExifData *ed, *clone;
+	int ret = check_template ();
+
+	ret |= check_late_tag ();
+
+	if (!srcdir)
+		srcdir = ".";
+
+	for (i = 0; i < sizeof (files) / sizeof (files[0]); i++) {
+		snprintf (path, sizeof (path), "%s/testdata/%s", srcdir, files[i]);
+		ed = exif_data_new_from_file (path);
+		clone = exif_data_clone (ed);
+		if (!ed || !clone) {
+			fprintf (stderr, "%s: no clone\n", path);
+			ret = 1;
+		} else
+			ret |= compare_saved (path, ed, clone);
+		exif_data_unref (clone);
+		exif_data_unref (ed);
+	}
+	return ret;
+}
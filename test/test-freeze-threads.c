@@ -0,0 +1,183 @@
+/* test-freeze-threads.c
+ *
+ * Check that several threads can read, save and clone the same frozen
+ * ExifData at once and all get the results of a single thread.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#include <config.h>
+
+#include <libexif/exif-data.h>
+#include <libexif/exif-library.h>
+#include <libexif/canon/exif-mnote-data-canon.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#define THREADS 8
+#define ROUNDS 50
+
+static ExifData *frozen;
+
+/* Results of a single thread */
+static unsigned char *saved;
+static unsigned int saved_size;
+static char values[4096];
+static char mnote_values[4096];
+
+/*! Append the values of all entries, then of all MakerNote entries */
+static void
+read_values (ExifData *ed, char *v, unsigned int vs, char *m, unsigned int ms)
+{
+	ExifMnoteData *md = exif_data_get_mnote_data (ed);
+	ExifEntry *e;
+	char b[1024];
+	unsigned int i, j, l;
+
+	v[0] = m[0] = '\0';
+	for (i = 0; i < EXIF_IFD_COUNT; i++)
+		for (j = 0; j < ed->ifd[i]->count; j++) {
+			e = ed->ifd[i]->entries[j];
+			exif_entry_ref (e);
+			l = strlen (v);
+			snprintf (v + l, vs - l, "%04x=%s;", e->tag,
+				  exif_entry_get_value (e, b, sizeof (b)));
+			exif_entry_unref (e);
+		}
+	for (i = 0; i < exif_mnote_data_count (md); i++) {
+		const char *r = exif_mnote_data_get_value (md, i, b, sizeof (b));
+
+		l = strlen (m);
+		snprintf (m + l, ms - l, "%s;", r ? r : "(null)");
+	}
+}
+
+/*! Read, save and clone the frozen data the way a reader thread would.
+ *
+ * \return 0 if all went as expected, 1 otherwise
+ */
+static int
+reader (void)
+{
+	char v[sizeof (values)], m[sizeof (mnote_values)];
+	unsigned char *d;
+	unsigned int ds, i;
+	ExifData *clone;
+	int ret = 0;
+
+	exif_data_ref (frozen);
+	for (i = 0; (i < ROUNDS) && !ret; i++) {
+		read_values (frozen, v, sizeof (v), m, sizeof (m));
+		if (strcmp (v, values) || strcmp (m, mnote_values))
+			ret = 1;
+
+		d = NULL;
+		ds = 0;
+		exif_data_save_data (frozen, &d, &ds);
+		if (!d || (ds != saved_size) || memcmp (d, saved, ds))
+			ret = 1;
+		free (d);
+
+		clone = exif_data_clone (frozen);
+		if (!clone || exif_data_is_frozen (clone) ||
+		    (clone->ifd[EXIF_IFD_0]->count != frozen->ifd[EXIF_IFD_0]->count))
+			ret = 1;
+		exif_data_unref (clone);
+	}
+	exif_data_unref (frozen);
+	return ret;
+}
+
+#ifdef HAVE_PTHREAD_H
+static void *
+run (void *p)
+{
+	*(int *) p = reader ();
+	return NULL;
+}
+#endif
+
+static const ExifMnoteDataVendor canon = {
+	"Canon", NULL, 0, "Canon", NULL, exif_mnote_data_canon_new
+};
+
+int
+main (void)
+{
+	const char *srcdir = getenv ("srcdir");
+	char path[1024];
+	unsigned int i;
+	int ret = 0;
+#ifdef HAVE_PTHREAD_H
+	pthread_t t[THREADS];
+	int r[THREADS];
+#endif
+
+	if (!srcdir)
+		srcdir = ".";
+	snprintf (path, sizeof (path), "%s/testdata/canon_makernote_variant_1.jpg",
+		  srcdir);
+
+	/* Built-in parsers only take HUAWEI MakerNotes, so add one for the
+	 * Canon test file */
+	exif_library_init ();
+	exif_data_register_mnote_vendor (&canon);
+
+	frozen = exif_data_new_from_file (path);
+	if (!frozen || !exif_data_freeze (frozen)) {
+		fprintf (stderr, "Could not load and freeze %s\n", path);
+		exif_data_unref (frozen);
+		return 1;
+	}
+	read_values (frozen, values, sizeof (values), mnote_values,
+		     sizeof (mnote_values));
+	exif_data_save_data (frozen, &saved, &saved_size);
+	if (!saved || !exif_mnote_data_count (exif_data_get_mnote_data (frozen))) {
+		fprintf (stderr, "Nothing to compare with\n");
+		exif_data_unref (frozen);
+		free (saved);
+		return 1;
+	}
+
+#ifdef HAVE_PTHREAD_H
+	for (i = 0; i < THREADS; i++)
+		if (pthread_create (&t[i], NULL, run, &r[i])) {
+			fprintf (stderr, "Could not start thread %u\n", i);
+			return 1;
+		}
+	for (i = 0; i < THREADS; i++) {
+		pthread_join (t[i], NULL);
+		if (r[i]) {
+			fprintf (stderr, "Thread %u read different data\n", i);
+			ret = 1;
+		}
+	}
+#else
+	for (i = 0; i < THREADS; i++)
+		ret |= reader ();
+#endif
+
+	exif_data_unref (frozen);
+	free (saved);
+	return ret;
+}
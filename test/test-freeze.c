@@ -0,0 +1,272 @@
+/* test-freeze.c
+ *
+ * Check that frozen ExifData rejects changes, that it holds the same
+ * entries and MakerNote values as before with the values in one block,
+ * that entries looked up before freezing stay valid, that saving it
+ * always gives the same bytes, and that clones of it can be changed again.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#include <libexif/exif-data.h>
+#include <libexif/canon/exif-mnote-data-canon.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *files[] = {
+	"canon_makernote_variant_1.jpg",
+	"fuji_makernote_variant_1.jpg",
+	"olympus_makernote_variant_2.jpg",
+	"pentax_makernote_variant_2.jpg"
+};
+
+static int
+same_string (const char *a, const char *b)
+{
+	return (!a && !b) || (a && b && !strcmp (a, b));
+}
+
+/* Entries, their values and the MakerNote must be as before freezing */
+static int
+compare_frozen (const char *fn, ExifData *ed, ExifData *frozen)
+{
+	ExifMnoteData *md = exif_data_get_mnote_data (ed),
+		*fmd = exif_data_get_mnote_data (frozen);
+	ExifEntry *e, *f;
+	const unsigned char *first = NULL, *last = NULL;
+	char v[1024], fv[1024];
+	unsigned int i, j, size = 0;
+
+	for (i = 0; i < EXIF_IFD_COUNT; i++) {
+		if (ed->ifd[i]->count != frozen->ifd[i]->count) {
+			fprintf (stderr, "%s: IFD %u has %u entries instead of %u\n",
+				 fn, i, frozen->ifd[i]->count, ed->ifd[i]->count);
+			return 1;
+		}
+		for (j = 0; j < ed->ifd[i]->count; j++) {
+			e = ed->ifd[i]->entries[j];
+			f = frozen->ifd[i]->entries[j];
+			if ((f != exif_content_get_entry (frozen->ifd[i], e->tag)) ||
+			    (f->parent != frozen->ifd[i]) || (e->tag != f->tag) ||
+			    (e->format != f->format) || (e->size != f->size) ||
+			    (e->components != f->components) ||
+			    (e->data && memcmp (e->data, f->data, e->size)) ||
+			    strcmp (exif_entry_get_value (e, v, sizeof (v)),
+				    exif_entry_get_value (f, fv, sizeof (fv)))) {
+				fprintf (stderr, "%s: tag 0x%04x differs\n", fn, e->tag);
+				return 1;
+			}
+			if (!f->data)
+				continue;
+			size += (f->size + 7) & ~7u;
+			if (!first || (f->data < first))
+				first = f->data;
+			if (!last || (f->data + f->size > last))
+				last = f->data + f->size;
+		}
+	}
+	if (size && (last - first > (long) size)) {
+		fprintf (stderr, "%s: values are not in one block\n", fn);
+		return 1;
+	}
+
+	if (!md != !fmd ||
+	    exif_mnote_data_count (md) != exif_mnote_data_count (fmd)) {
+		fprintf (stderr, "%s: MakerNote differs\n", fn);
+		return 1;
+	}
+	for (i = 0; i < exif_mnote_data_count (md); i++) {
+		if ((exif_mnote_data_get_id (md, i) != exif_mnote_data_get_id (fmd, i)) ||
+		    !same_string (exif_mnote_data_get_name (md, i),
+				  exif_mnote_data_get_name (fmd, i)) ||
+		    !same_string (exif_mnote_data_get_title (md, i),
+				  exif_mnote_data_get_title (fmd, i)) ||
+		    !same_string (exif_mnote_data_get_value (md, i, v, sizeof (v)),
+				  exif_mnote_data_get_value (fmd, i, fv, sizeof (fv)))) {
+			fprintf (stderr, "%s: MakerNote entry %u differs\n", fn, i);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int
+check_file (const char *fn)
+{
+	ExifData *ed = exif_data_new_from_file (fn), *clone, *ref;
+	ExifEntry *e, *first, *make, *held;
+	ExifByteOrder o;
+	char v[1024], rv[1024];
+	unsigned char *d1 = NULL, *d2 = NULL, *dg = NULL;
+	unsigned int s1 = 0, s2 = 0, sg = 0, count[EXIF_IFD_COUNT], i;
+	int ret = 0;
+
+	if (!ed) {
+		fprintf (stderr, "%s: could not load\n", fn);
+		return 1;
+	}
+	/* Compare with data that went through the same save */
+	ref = exif_data_new_from_file (fn);
+	exif_data_save_data (ref, &d1, &s1);
+	free (d1);
+	d1 = NULL;
+
+	/* Entries looked up or held before freezing stay valid */
+	make = exif_data_get_entry (ed, EXIF_TAG_MAKE);
+	held = exif_content_get_entry (ed->ifd[EXIF_IFD_0], EXIF_TAG_X_RESOLUTION);
+	exif_entry_ref (held);
+	if (exif_data_is_frozen (ed) || !exif_data_freeze (ed) ||
+	    !exif_data_is_frozen (ed) || !exif_data_freeze (ed)) {
+		fprintf (stderr, "%s: could not freeze\n", fn);
+		exif_data_unref (ref);
+		exif_data_unref (ed);
+		return 1;
+	}
+	ret |= compare_frozen (fn, ref, ed);
+	if ((make != exif_data_get_entry (ed, EXIF_TAG_MAKE)) ||
+	    (held != exif_content_get_entry (ed->ifd[EXIF_IFD_0], EXIF_TAG_X_RESOLUTION)) ||
+	    (make && strcmp (exif_entry_get_value (make, v, sizeof (v)),
+			     exif_entry_get_value (exif_data_get_entry (ref, EXIF_TAG_MAKE),
+						   rv, sizeof (rv))))) {
+		fprintf (stderr, "%s: entries moved by freezing\n", fn);
+		ret = 1;
+	}
+	exif_data_unref (ref);
+
+	/* The reference held from before now keeps the data alive */
+	if (held) {
+		exif_data_unref (ed);
+		if (!exif_data_is_frozen (ed) || (held->parent != ed->ifd[EXIF_IFD_0])) {
+			fprintf (stderr, "%s: data gone with an entry held before\n", fn);
+			ret = 1;
+		}
+		exif_data_ref (ed);
+		exif_entry_unref (held);
+	}
+	for (i = 0; i < EXIF_IFD_COUNT; i++)
+		count[i] = ed->ifd[i]->count;
+	o = exif_data_get_byte_order (ed);
+
+	/* None of these may change anything */
+	first = ed->ifd[EXIF_IFD_0]->entries[0];
+	exif_content_remove_entry (ed->ifd[EXIF_IFD_0], first);
+	e = exif_entry_new ();
+	e->tag = EXIF_TAG_IMAGE_DESCRIPTION;
+	exif_content_add_entry (ed->ifd[EXIF_IFD_0], e);
+	if (e->parent) {
+		fprintf (stderr, "%s: entry added\n", fn);
+		ret = 1;
+	}
+	exif_entry_unref (e);
+	exif_data_set_byte_order (ed, (o == EXIF_BYTE_ORDER_INTEL) ?
+				  EXIF_BYTE_ORDER_MOTOROLA : EXIF_BYTE_ORDER_INTEL);
+	exif_data_fix (ed);
+	exif_data_load_data (ed, (const unsigned char *) "Exif\0\0", 6);
+	if (exif_data_get_byte_order (ed) != o) {
+		fprintf (stderr, "%s: byte order changed\n", fn);
+		ret = 1;
+	}
+	for (i = 0; i < EXIF_IFD_COUNT; i++)
+		if (ed->ifd[i]->count != count[i]) {
+			fprintf (stderr, "%s: IFD %u changed\n", fn, i);
+			ret = 1;
+		}
+	if (ed->ifd[EXIF_IFD_0]->entries[0] != first) {
+		fprintf (stderr, "%s: entry removed\n", fn);
+		ret = 1;
+	}
+
+	/* A reference to an entry keeps the data alive */
+	exif_entry_ref (first);
+	exif_data_unref (ed);
+	if (!exif_data_is_frozen (ed) || (first->parent != ed->ifd[EXIF_IFD_0])) {
+		fprintf (stderr, "%s: data gone with its entry\n", fn);
+		ret = 1;
+	}
+	exif_data_ref (ed);
+	exif_entry_unref (first);
+
+	/* Saving does not change the data either */
+	exif_data_ref (ed);
+	exif_data_save_data (ed, &d1, &s1);
+	exif_data_save_data (ed, &d2, &s2);
+	exif_data_save_data_general (ed, &dg, &sg);
+	exif_data_unref (ed);
+	if (!d1 || (s1 != s2) || memcmp (d1, d2, s1) ||
+	    !dg || (sg + 6 != s1) || memcmp (d1 + 6, dg, sg)) {
+		fprintf (stderr, "%s: saved data differs\n", fn);
+		ret = 1;
+	}
+	for (i = 0; i < EXIF_IFD_COUNT; i++)
+		if (ed->ifd[i]->count != count[i]) {
+			fprintf (stderr, "%s: IFD %u changed by saving\n", fn, i);
+			ret = 1;
+		}
+
+	/* A clone can be changed again */
+	clone = exif_data_clone (ed);
+	if (!clone || exif_data_is_frozen (clone)) {
+		fprintf (stderr, "%s: no writable clone\n", fn);
+		ret = 1;
+	} else {
+		e = exif_entry_new ();
+		exif_content_add_entry (clone->ifd[EXIF_IFD_0], e);
+		exif_entry_initialize (e, EXIF_TAG_IMAGE_DESCRIPTION);
+		if (!exif_content_get_entry (clone->ifd[EXIF_IFD_0],
+					     EXIF_TAG_IMAGE_DESCRIPTION)) {
+			fprintf (stderr, "%s: clone not writable\n", fn);
+			ret = 1;
+		}
+		exif_entry_unref (e);
+	}
+	exif_data_unref (clone);
+
+	free (d1);
+	free (d2);
+	free (dg);
+	exif_data_unref (ed);
+	return ret;
+}
+
+static const ExifMnoteDataVendor canon = {
+	"Canon", NULL, 0, "Canon", NULL, exif_mnote_data_canon_new
+};
+
+int
+main (void)
+{
+	const char *srcdir = getenv ("srcdir");
+	char path[1024];
+	unsigned int i;
+	int ret = 0;
+
+	if (!srcdir)
+		srcdir = ".";
+
+	/* Built-in parsers only take HUAWEI MakerNotes, so add one for the
+	 * Canon test file */
+	exif_data_register_mnote_vendor (&canon);
+
+	for (i = 0; i < sizeof (files) / sizeof (files[0]); i++) {
+		snprintf (path, sizeof (path), "%s/testdata/%s", srcdir, files[i]);
+		ret |= check_file (path);
+	}
+	return ret;
+}
@@ -0,0 +1,261 @@
+/* test-heif.c
+ *
+ * Check that ExifLoader finds the 'Exif' item of HEIF files, whether it
+ * is stored in the 'mdat' or the 'idat' box.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#include <libexif/exif-data.h>
+#include <libexif/exif-loader.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define IMAGE_SIZE 50000
+
+typedef struct {
+	unsigned char *d;
+	unsigned int size;
+} Buf;
+
+static void
+put (Buf *b, const void *p, unsigned int size)
+{
+	b->d = realloc (b->d, b->size + size);
+	memcpy (b->d + b->size, p, size);
+	b->size += size;
+}
+
+static void
+put_long (Buf *b, unsigned int v)
+{
+	unsigned char c[4];
+
+	c[0] = v >> 24;
+	c[1] = v >> 16;
+	c[2] = v >> 8;
+	c[3] = v;
+	put (b, c, 4);
+}
+
+static void
+put_short (Buf *b, unsigned int v)
+{
+	unsigned char c[2];
+
+	c[0] = v >> 8;
+	c[1] = v;
+	put (b, c, 2);
+}
+
+static void
+put_box (Buf *b, const char *type, const Buf *payload)
+{
+	put_long (b, 8 + payload->size);
+	put (b, type, 4);
+	put (b, payload->d, payload->size);
+}
+
+/* EXIF item payload: TIFF header offset, EXIF header, TIFF data */
+static void
+make_exif (Buf *item, Buf *app1)
+{
+	ExifData *ed = exif_data_new ();
+	ExifEntry *e = exif_entry_new ();
+	unsigned char *d = NULL;
+	unsigned int ds = 0;
+
+	exif_content_add_entry (ed->ifd[EXIF_IFD_0], e);
+	exif_entry_initialize (e, EXIF_TAG_MAKE);
+	e->format = EXIF_FORMAT_ASCII;
+	e->components = 5;
+	e->size = 5;
+	e->data = realloc (e->data, 5);
+	memcpy (e->data, "HEIF", 5);
+	exif_entry_unref (e);
+	exif_data_save_data (ed, &d, &ds);
+	exif_data_unref (ed);
+
+	put_long (item, 6);
+	put (item, d, ds);
+	put (app1, d, ds);
+	free (d);
+}
+
+/*
+ * ftyp, meta (hdlr, iinf, iloc[, idat]), mdat (image[, exif]).
+ * The mdat box uses a 64-bit size.
+ */
+static void
+make_heif (Buf *f, Buf *app1, int in_idat)
+{
+	Buf ftyp = {NULL, 0}, meta = {NULL, 0}, box = {NULL, 0};
+	Buf iinf = {NULL, 0}, iloc = {NULL, 0}, exif = {NULL, 0};
+	unsigned char *image = calloc (1, IMAGE_SIZE);
+	unsigned int image_offset, exif_offset;
+
+	make_exif (&exif, app1);
+
+	put (&ftyp, "heic\0\0\0\0mif1heic", 16);
+	put_box (f, "ftyp", &ftyp);
+
+	put_long (&meta, 0);
+	put_long (&box, 0);
+	put_long (&box, 0);
+	put (&box, "pict", 4);
+	put (&box, "\0\0\0\0\0\0\0\0\0\0\0\0\0", 13);
+	put_box (&meta, "hdlr", &box);
+	box.size = 0;
+
+	put_long (&iinf, 0);
+	put_short (&iinf, 2);
+	put_long (&box, 2 << 24);
+	put_short (&box, 1);
+	put_short (&box, 0);
+	put (&box, "hvc1\0", 5);
+	put_box (&iinf, "infe", &box);
+	box.size = 0;
+	put_long (&box, 2 << 24);
+	put_short (&box, 2);
+	put_short (&box, 0);
+	put (&box, "Exif\0", 5);
+	put_box (&iinf, "infe", &box);
+	box.size = 0;
+	put_box (&meta, "iinf", &iinf);
+
+	/* iloc version 1 with 4-byte offsets and lengths; size known up front */
+	image_offset = f->size + 8 + meta.size + 8 + 8 + 2 * 16 +
+		(in_idat ? 8 + exif.size : 0) + 16;
+	exif_offset = in_idat ? 0 : image_offset + IMAGE_SIZE;
+	put_long (&iloc, 1 << 24);
+	put (&iloc, "\x44\x00", 2);
+	put_short (&iloc, 2);
+	put_short (&iloc, 1);
+	put_short (&iloc, 0);
+	put_short (&iloc, 0);
+	put_short (&iloc, 1);
+	put_long (&iloc, image_offset);
+	put_long (&iloc, IMAGE_SIZE);
+	put_short (&iloc, 2);
+	put_short (&iloc, in_idat ? 1 : 0);
+	put_short (&iloc, 0);
+	put_short (&iloc, 1);
+	put_long (&iloc, exif_offset);
+	put_long (&iloc, exif.size);
+	put_box (&meta, "iloc", &iloc);
+	if (in_idat)
+		put_box (&meta, "idat", &exif);
+	put_box (f, "meta", &meta);
+
+	put_long (f, 1);
+	put (f, "mdat", 4);
+	put_long (f, 0);
+	put_long (f, 16 + IMAGE_SIZE + (in_idat ? 0 : exif.size));
+	if (f->size != image_offset)
+		fprintf (stderr, "Test file layout is off\n");
+	put (f, image, IMAGE_SIZE);
+	if (!in_idat)
+		put (f, exif.d, exif.size);
+
+	free (image);
+	free (ftyp.d);
+	free (meta.d);
+	free (box.d);
+	free (iinf.d);
+	free (iloc.d);
+	free (exif.d);
+}
+
+static int
+check_loader (ExifLoader *l, const Buf *app1, const char *what)
+{
+	const unsigned char *d;
+	unsigned int ds;
+	ExifData *ed;
+	ExifEntry *e;
+	int ret = 0;
+
+	exif_loader_get_buf (l, &d, &ds);
+	if (ds != app1->size || memcmp (d, app1->d, ds)) {
+		fprintf (stderr, "%s: loader holds %u bytes instead of %u\n",
+			 what, ds, app1->size);
+		ret = 1;
+	}
+	ed = exif_loader_get_data (l);
+	e = ed ? exif_content_get_entry (ed->ifd[EXIF_IFD_0], EXIF_TAG_MAKE) : NULL;
+	if (!e || strcmp ((const char *) e->data, "HEIF")) {
+		fprintf (stderr, "%s: EXIF data not loaded\n", what);
+		ret = 1;
+	}
+	exif_data_unref (ed);
+	return ret;
+}
+
+static int
+check (int in_idat)
+{
+	Buf f = {NULL, 0}, app1 = {NULL, 0};
+	char name[] = "/tmp/test-heif-XXXXXX";
+	char what[64];
+	unsigned int chunk, pos;
+	ExifLoader *l;
+	FILE *fp;
+	int fd, ret = 0;
+
+	make_heif (&f, &app1, in_idat);
+
+	for (chunk = 1; chunk < 2 * f.size; chunk = chunk * 5 + 2) {
+		l = exif_loader_new ();
+		for (pos = 0; pos < f.size; pos += chunk)
+			if (!exif_loader_write (l, f.d + pos,
+						(f.size - pos < chunk) ? f.size - pos : chunk))
+				break;
+		sprintf (what, "%s, chunk %u", in_idat ? "idat" : "mdat", chunk);
+		ret |= check_loader (l, &app1, what);
+		exif_loader_unref (l);
+	}
+
+	/* Through a file, seeking over the image data */
+	fd = mkstemp (name);
+	fp = (fd < 0) ? NULL : fdopen (fd, "wb");
+	if (!fp || fwrite (f.d, f.size, 1, fp) != 1) {
+		fprintf (stderr, "Could not write %s\n", name);
+		ret = 1;
+	} else {
+		fclose (fp);
+		l = exif_loader_new ();
+		exif_loader_write_file (l, name);
+		sprintf (what, "%s, file", in_idat ? "idat" : "mdat");
+		ret |= check_loader (l, &app1, what);
+		exif_loader_unref (l);
+	}
+	unlink (name);
+
+	free (f.d);
+	free (app1.d);
+	return ret;
+}
+
+int
+main (void)
+{
+	return check (0) | check (1);
+}
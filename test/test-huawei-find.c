@@ -0,0 +1,220 @@
+/* test-huawei-find.c
+ *
+ * Check that looking up Huawei MakerNote tags in raw data gives the same
+ * entries and values as loading the MakerNote in full.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#include <libexif/exif-data.h>
+#include <libexif/exif-utils.h>
+#include <libexif/huawei/exif-mnote-data-huawei.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ORDER EXIF_BYTE_ORDER_INTEL
+
+/* Offsets within the TIFF data, which follows the 6 byte EXIF header */
+#define IFD0		8
+#define EXIF_IFD	26
+#define OTHER_MNOTE	56
+#define MNOTE		68
+
+/* Offsets within the Huawei MakerNote, relative to its byte order mark */
+#define MAIN_IFD	8
+#define SCENE_IFD	62
+#define SCENE_DATA	92
+#define FACE_IFD	100
+#define FACE_DATA	142
+#define MNOTE_SIZE	(8 + 148)
+
+static unsigned char buf[6 + MNOTE + MNOTE_SIZE];
+
+static unsigned char *
+put_entry (unsigned char *p, ExifShort tag, ExifShort format,
+	   ExifLong components, ExifLong value)
+{
+	exif_set_short (p, ORDER, tag);
+	exif_set_short (p + 2, ORDER, format);
+	exif_set_long (p + 4, ORDER, components);
+	exif_set_long (p + 8, ORDER, value);
+	return p + 12;
+}
+
+/*! Build EXIF data with a foreign MakerNote followed by a Huawei one. The
+ * Huawei MakerNote has two sub-IFDs, and the second one repeats a tag of
+ * the main IFD that comes after it.
+ *
+ * \param[in] face_count number of entries claimed by the second sub-IFD
+ */
+static void
+build (ExifShort face_count)
+{
+	unsigned char *t = buf + 6, *m = t + MNOTE, *o = m + 8, *p;
+	unsigned int i;
+
+	memset (buf, 0, sizeof (buf));
+	memcpy (buf, "Exif\0\0", 6);
+	memcpy (t, "II", 2);
+	exif_set_short (t + 2, ORDER, 0x002a);
+	exif_set_long (t + 4, ORDER, IFD0);
+
+	exif_set_short (t + IFD0, ORDER, 1);
+	put_entry (t + IFD0 + 2, EXIF_TAG_EXIF_IFD_POINTER, EXIF_FORMAT_LONG, 1, EXIF_IFD);
+
+	exif_set_short (t + EXIF_IFD, ORDER, 2);
+	p = put_entry (t + EXIF_IFD + 2, EXIF_TAG_MAKER_NOTE, EXIF_FORMAT_UNDEFINED,
+		       MNOTE - OTHER_MNOTE, OTHER_MNOTE);
+	put_entry (p, EXIF_TAG_MAKER_NOTE, EXIF_FORMAT_UNDEFINED, MNOTE_SIZE, MNOTE);
+	memcpy (t + OTHER_MNOTE, "NOTHUAWEI\0\0", MNOTE - OTHER_MNOTE);
+
+	memcpy (m, "HUAWEI\0\0", 8);
+	memcpy (o, "II", 2);
+	exif_set_short (o + 2, ORDER, 0x002a);
+	exif_set_long (o + 4, ORDER, MAIN_IFD);
+
+	exif_set_short (o + MAIN_IFD, ORDER, 4);
+	p = put_entry (o + MAIN_IFD + 2, MNOTE_HUAWEI_CAPTURE_MODE, EXIF_FORMAT_LONG, 1, 1);
+	p = put_entry (p, MNOTE_HUAWEI_SCENE_INFO, EXIF_FORMAT_LONG, 1, SCENE_IFD);
+	p = put_entry (p, MNOTE_HUAWEI_FACE_INFO, EXIF_FORMAT_LONG, 1, FACE_IFD);
+	put_entry (p, MNOTE_HUAWEI_BURST_NUMBER, EXIF_FORMAT_LONG, 1, 5);
+
+	exif_set_short (o + SCENE_IFD, ORDER, 2);
+	p = put_entry (o + SCENE_IFD + 2, MNOTE_HUAWEI_SCENE_VERSION, EXIF_FORMAT_LONG, 1, 3);
+	put_entry (p, MNOTE_HUAWEI_SCENE_FOOD_CONF, EXIF_FORMAT_LONG, 2, SCENE_DATA);
+	exif_set_long (o + SCENE_DATA, ORDER, 80);
+	exif_set_long (o + SCENE_DATA + 4, ORDER, 90);
+
+	exif_set_short (o + FACE_IFD, ORDER, face_count);
+	p = put_entry (o + FACE_IFD + 2, MNOTE_HUAWEI_FACE_VERSION, EXIF_FORMAT_LONG, 1, 1);
+	p = put_entry (p, MNOTE_HUAWEI_FACE_CONF, EXIF_FORMAT_BYTE, 6, FACE_DATA);
+	put_entry (p, MNOTE_HUAWEI_BURST_NUMBER, EXIF_FORMAT_LONG, 1, 7);
+	for (i = 0; i < 6; i++)
+		o[FACE_DATA + i] = i + 1;
+}
+
+/*! Compare the raw lookups with the loaded MakerNote for one tag.
+ *
+ * \return 0 if they agree, 1 otherwise
+ */
+static int
+check_tag (ExifMnoteDataHuawei *n, MnoteHuaweiTag tag)
+{
+	MnoteHuaweiEntry *e = n ? exif_mnote_data_huawei_get_entry_by_tag (n, tag) : NULL;
+	MnoteHuaweiEntry f;
+	char v1[256], v2[256];
+	const char *r1, *r2;
+	int found;
+
+	found = exif_mnote_data_huawei_find_entry (buf, sizeof (buf), tag, &f);
+	if (found != !!e) {
+		fprintf (stderr, "Tag 0x%04x: find_entry returned %i\n", tag, found);
+		return 1;
+	}
+	r2 = exif_mnote_data_huawei_get_value_from_data (buf, sizeof (buf), tag, v2, sizeof (v2));
+	if (!e) {
+		if (r2) {
+			fprintf (stderr, "Tag 0x%04x: unexpected value '%s'\n", tag, r2);
+			return 1;
+		}
+		return 0;
+	}
+
+	if (f.tag != e->tag || f.format != e->format ||
+	    f.components != e->components || f.size != e->size ||
+	    memcmp (f.data, e->data, e->size)) {
+		fprintf (stderr, "Tag 0x%04x: entries differ\n", tag);
+		return 1;
+	}
+	r1 = mnote_huawei_entry_get_value (e, v1, sizeof (v1));
+	if (!r1 != !r2 || (r1 && strcmp (r1, r2))) {
+		fprintf (stderr, "Tag 0x%04x: values '%s' and '%s' differ\n", tag,
+			 r1 ? r1 : "(null)", r2 ? r2 : "(null)");
+		return 1;
+	}
+	return 0;
+}
+
+/*! Load buf in full and compare every tag with the raw lookups.
+ *
+ * \param[in] loaded whether the MakerNote is expected to load
+ * \return 0 if all went as expected, 1 otherwise
+ */
+static int
+check (int loaded)
+{
+	static const MnoteHuaweiTag tags[] = {
+		MNOTE_HUAWEI_CAPTURE_MODE, MNOTE_HUAWEI_SCENE_INFO,
+		MNOTE_HUAWEI_SCENE_VERSION, MNOTE_HUAWEI_SCENE_FOOD_CONF,
+		MNOTE_HUAWEI_FACE_INFO, MNOTE_HUAWEI_FACE_VERSION,
+		MNOTE_HUAWEI_FACE_CONF, MNOTE_HUAWEI_BURST_NUMBER,
+		MNOTE_HUAWEI_FRONT_CAMERA
+	};
+	ExifData *ed = exif_data_new_from_data (buf, sizeof (buf));
+	ExifMnoteDataHuawei *n;
+	MnoteHuaweiEntry *e;
+	unsigned int i;
+	int ret = 0;
+
+	if (!ed) {
+		fprintf (stderr, "Could not load the EXIF data\n");
+		return 1;
+	}
+	n = (ExifMnoteDataHuawei *) exif_data_get_mnote_data (ed);
+	if (!is_huawei_md ((ExifMnoteData *) n))
+		n = NULL;
+	if (loaded != !!n) {
+		fprintf (stderr, "Huawei MakerNote %s\n", n ? "loaded" : "not loaded");
+		exif_data_unref (ed);
+		return 1;
+	}
+
+	/* The burst number of the second sub-IFD comes first */
+	e = n ? exif_mnote_data_huawei_get_entry_by_tag (n, MNOTE_HUAWEI_BURST_NUMBER) : NULL;
+	if (loaded != !!e || (e && exif_get_long (e->data, e->order) != 7)) {
+		fprintf (stderr, "Unexpected burst number in the loaded MakerNote\n");
+		ret = 1;
+	}
+
+	for (i = 0; i < sizeof (tags) / sizeof (tags[0]); i++)
+		ret |= check_tag (n, tags[i]);
+	exif_data_unref (ed);
+	return ret;
+}
+
+int
+main (void)
+{
+	ExifMem *mem = exif_mem_new_default ();
+	int ret = 0;
+
+	/* A MakerNote that was never loaded holds one reference to mem */
+	exif_mnote_data_unref (exif_mnote_data_huawei_new (mem));
+	exif_mem_unref (mem);
+
+	build (3);
+	ret |= check (1);
+
+	/* A broken sub-IFD rejects the whole MakerNote, even earlier tags */
+	build (101);
+	ret |= check (0);
+
+	return ret;
+}
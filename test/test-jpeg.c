@@ -0,0 +1,330 @@
+/* test-jpeg.c
+ *
+ * Check that exif_jpeg_replace_app1 swaps the EXIF segment of a JPEG file
+ * and passes everything else through unchanged, that the EXIF segment
+ * is found behind fill bytes and, by ExifLoader, behind other segments,
+ * and that exif_thumbnail_extract_fd copies the embedded thumbnail.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#include <libexif/exif-data.h>
+#include <libexif/exif-jpeg.h>
+#include <libexif/exif-loader.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define BODY_SIZE 200000
+#define FILL_SIZE 5000
+#define THUMBNAIL_SIZE 20000
+
+static const unsigned char jfif[] = {
+	0xff, 0xe0, 0x00, 0x10, 'J', 'F', 'I', 'F', 0x00, 0x01, 0x01,
+	0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00
+};
+static const unsigned char dqt[] = {
+	0xff, 0xdb, 0x00, 0x06, 0x00, 0x01, 0x02, 0x03
+};
+
+static ExifData *
+create_data (const char *make)
+{
+	ExifData *ed = exif_data_new ();
+	ExifEntry *e = exif_entry_new ();
+
+	exif_content_add_entry (ed->ifd[EXIF_IFD_0], e);
+	exif_entry_initialize (e, EXIF_TAG_MAKE);
+	e->format = EXIF_FORMAT_ASCII;
+	e->components = strlen (make) + 1;
+	e->size = e->components;
+	e->data = realloc (e->data, e->size);
+	memcpy (e->data, make, e->size);
+	exif_entry_unref (e);
+	return ed;
+}
+
+static FILE *
+write_jpeg_thumbnail (const unsigned char *body, unsigned int thumbnail_size)
+{
+	FILE *f = tmpfile ();
+	ExifData *ed = create_data ("Old");
+	unsigned char *exif = NULL, app1[4];
+	unsigned int exif_size = 0;
+
+	if (thumbnail_size) {
+		ed->data = malloc (thumbnail_size);
+		memcpy (ed->data, body, thumbnail_size);
+		ed->size = thumbnail_size;
+	}
+	exif_data_save_data (ed, &exif, &exif_size);
+	exif_data_unref (ed);
+	app1[0] = 0xff;
+	app1[1] = 0xe1;
+	app1[2] = (exif_size + 2) >> 8;
+	app1[3] = (exif_size + 2) & 0xff;
+
+	fwrite ("\xff\xd8", 2, 1, f);
+	fwrite (jfif, sizeof (jfif), 1, f);
+	fwrite (app1, 4, 1, f);
+	fwrite (exif, exif_size, 1, f);
+	fwrite (dqt, sizeof (dqt), 1, f);
+	fwrite ("\xff\xda", 2, 1, f);
+	fwrite (body, BODY_SIZE, 1, f);
+	fwrite ("\xff\xd9", 2, 1, f);
+	fflush (f);
+	rewind (f);
+	free (exif);
+	return f;
+}
+
+static FILE *
+write_jpeg (const unsigned char *body)
+{
+	return write_jpeg_thumbnail (body, 0);
+}
+
+static unsigned char *
+read_all (FILE *f, long *size)
+{
+	unsigned char *d;
+
+	fseek (f, 0, SEEK_END);
+	*size = ftell (f);
+	rewind (f);
+	d = malloc (*size);
+	if (fread (d, *size, 1, f) != 1) {
+		free (d);
+		return NULL;
+	}
+	return d;
+}
+
+/* Check the layout of the output and return the Make it carries */
+static int
+check_output (FILE *out, const unsigned char *body, const char *make)
+{
+	unsigned char *d;
+	long size, pos;
+	int exif_segments = 0, ret = 0;
+
+	d = read_all (out, &size);
+	if (!d || size < 4 || memcmp (d, "\xff\xd8", 2) ||
+	    memcmp (d + 2, jfif, sizeof (jfif))) {
+		fprintf (stderr, "Output does not start with SOI and JFIF\n");
+		free (d);
+		return 1;
+	}
+	for (pos = 2; pos + 4 <= size && d[pos + 1] != 0xda; ) {
+		long l = (d[pos + 2] << 8) | d[pos + 3];
+		if (d[pos + 1] == 0xe1 && !memcmp (d + pos + 4, "Exif\0\0", 6)) {
+			ExifData *ed = exif_data_new_from_data (d + pos, l + 2);
+			ExifEntry *e = exif_content_get_entry (ed->ifd[EXIF_IFD_0],
+							       EXIF_TAG_MAKE);
+			if (!make || !e || strcmp ((const char *) e->data, make)) {
+				fprintf (stderr, "Unexpected EXIF segment\n");
+				ret = 1;
+			}
+			exif_data_unref (ed);
+			exif_segments++;
+		}
+		pos += 2 + l;
+	}
+	if (exif_segments != (make ? 1 : 0)) {
+		fprintf (stderr, "Found %i EXIF segments\n", exif_segments);
+		ret = 1;
+	}
+	if (pos + 2 + BODY_SIZE + 2 != size ||
+	    memcmp (d + pos + 2, body, BODY_SIZE)) {
+		fprintf (stderr, "Image data was not copied unchanged\n");
+		ret = 1;
+	}
+	free (d);
+	return ret;
+}
+
+static int
+check_make (ExifData *ed, const char *what, int expected)
+{
+	ExifEntry *e = ed ? exif_content_get_entry (ed->ifd[EXIF_IFD_0],
+						    EXIF_TAG_MAKE) : NULL;
+
+	if (expected && (!e || strcmp ((const char *) e->data, "Old"))) {
+		fprintf (stderr, "EXIF data not found by %s\n", what);
+		return 1;
+	}
+	if (!expected && e) {
+		fprintf (stderr, "EXIF data behind another segment found by %s\n",
+			 what);
+		return 1;
+	}
+	return 0;
+}
+
+/* Padded JPEG, optionally with a DQT segment in front of the EXIF segment.
+ * exif_data_load_data only walks over APPn segments, like it always did,
+ * so that it does not pick up an EXIF header from somewhere else. */
+static int
+check_scan (const unsigned char *body, int with_dqt)
+{
+	FILE *f = write_jpeg (body);
+	unsigned char *d, *p;
+	long size, extra = with_dqt ? FILL_SIZE + sizeof (dqt) : 0;
+	unsigned int chunk;
+	ExifData *ed;
+	int ret = 0;
+
+	d = read_all (f, &size);
+	fclose (f);
+	p = malloc (size + FILL_SIZE + extra);
+	if (!d || !p) {
+		free (d);
+		free (p);
+		return 1;
+	}
+	memcpy (p, d, 2 + sizeof (jfif));
+	memset (p + 2 + sizeof (jfif), 0xff, FILL_SIZE);
+	if (with_dqt) {
+		memcpy (p + 2 + sizeof (jfif) + FILL_SIZE, dqt, sizeof (dqt));
+		memset (p + 2 + sizeof (jfif) + FILL_SIZE + sizeof (dqt), 0xff,
+			FILL_SIZE);
+	}
+	memcpy (p + 2 + sizeof (jfif) + FILL_SIZE + extra,
+		d + 2 + sizeof (jfif), size - 2 - sizeof (jfif));
+	size += FILL_SIZE + extra;
+
+	ed = exif_data_new_from_data (p, size);
+	ret |= check_make (ed, "exif_data_load_data", !with_dqt);
+	exif_data_unref (ed);
+
+	/* Any split between writes must give the same result */
+	for (chunk = 1; chunk <= 4096; chunk *= 8) {
+		ExifLoader *l = exif_loader_new ();
+		long pos;
+
+		for (pos = 0; pos < size; pos += chunk)
+			if (!exif_loader_write (l, p + pos,
+						(size - pos < chunk) ? size - pos : chunk))
+				break;
+		ed = exif_loader_get_data (l);
+		ret |= check_make (ed, "ExifLoader", 1);
+		exif_data_unref (ed);
+		exif_loader_unref (l);
+	}
+
+	free (p);
+	free (d);
+	return ret;
+}
+
+static int
+check_thumbnail (const unsigned char *body)
+{
+	FILE *in, *out;
+	unsigned char *d;
+	long size;
+	int ret = 0;
+
+	in = write_jpeg_thumbnail (body, THUMBNAIL_SIZE);
+	out = tmpfile ();
+	if (!exif_thumbnail_extract_fd (fileno (in), fileno (out))) {
+		fprintf (stderr, "Extracting the thumbnail failed\n");
+		ret = 1;
+	} else {
+		d = read_all (out, &size);
+		if (!d || size != THUMBNAIL_SIZE ||
+		    memcmp (d, body, THUMBNAIL_SIZE)) {
+			fprintf (stderr, "Wrong thumbnail of %li bytes\n", size);
+			ret = 1;
+		}
+		free (d);
+	}
+	fclose (out);
+	fclose (in);
+
+	in = write_jpeg (body);
+	out = tmpfile ();
+	if (exif_thumbnail_extract_fd (fileno (in), fileno (out))) {
+		fprintf (stderr, "Thumbnail extracted from a file without one\n");
+		ret = 1;
+	}
+	fclose (out);
+	fclose (in);
+	return ret;
+}
+
+int
+main (void)
+{
+	unsigned char *body = malloc (BODY_SIZE);
+	ExifData *ed;
+	FILE *in, *out;
+	unsigned int i;
+	int ret = 0;
+
+	srand (1);
+	for (i = 0; i < BODY_SIZE; i++)
+		body[i] = rand () & 0xff;
+
+	/* Replace */
+	in = write_jpeg (body);
+	out = tmpfile ();
+	ed = create_data ("New");
+	if (!exif_jpeg_replace_app1 (fileno (in), fileno (out), ed)) {
+		fprintf (stderr, "Replacing EXIF failed\n");
+		ret = 1;
+	} else
+		ret |= check_output (out, body, "New");
+	exif_data_unref (ed);
+	fclose (out);
+	fclose (in);
+
+	/* Strip */
+	in = write_jpeg (body);
+	out = tmpfile ();
+	if (!exif_jpeg_replace_app1 (fileno (in), fileno (out), NULL)) {
+		fprintf (stderr, "Stripping EXIF failed\n");
+		ret = 1;
+	} else
+		ret |= check_output (out, body, NULL);
+	fclose (out);
+	fclose (in);
+
+	/* Not a JPEG */
+	in = tmpfile ();
+	out = tmpfile ();
+	fwrite (body, 64, 1, in);
+	rewind (in);
+	ed = create_data ("New");
+	if (exif_jpeg_replace_app1 (fileno (in), fileno (out), ed)) {
+		fprintf (stderr, "Garbage accepted as JPEG\n");
+		ret = 1;
+	}
+	exif_data_unref (ed);
+	fclose (out);
+	fclose (in);
+
+	ret |= check_scan (body, 0);
+	ret |= check_scan (body, 1);
+	ret |= check_thumbnail (body);
+
+	free (body);
+	return ret;
+}
@@ -0,0 +1,220 @@
+/* test-json.c
+ *
+ * Check the JSON written by exif_data_to_json: typed values, escaping,
+ * unknown tags, and well-formed output for the test images.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#include <libexif/exif-data.h>
+#include <libexif/exif-json.h>
+#include <libexif/exif-system.h>
+#include <libexif/exif-utils.h>
+#include <libexif/canon/exif-mnote-data-canon.h>
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *files[] = {
+	"canon_makernote_variant_1.jpg",
+	"fuji_makernote_variant_1.jpg",
+	"olympus_makernote_variant_2.jpg",
+	"pentax_makernote_variant_2.jpg"
+};
+
+static const ExifMnoteDataVendor canon = {
+	"Canon", NULL, 0, "Canon", NULL, exif_mnote_data_canon_new
+};
+
+typedef struct {
+	char *d;
+	unsigned int size;
+	unsigned int calls;
+} Output;
+
+static int
+collect (void *user_data, const char *s, unsigned int len)
+{
+	Output *o = user_data;
+
+	o->d = realloc (o->d, o->size + len + 1);
+	memcpy (o->d + o->size, s, len);
+	o->size += len;
+	o->d[o->size] = '\0';
+	o->calls++;
+	return 1;
+}
+
+static int
+fail (void *UNUSED(user_data), const char *UNUSED(s),
+      unsigned int UNUSED(len))
+{
+	return 0;
+}
+
+/* Minimal JSON syntax check: skip one value and return what follows */
+static const char *
+skip_value (const char *s)
+{
+	if (*s == '{' || *s == '[') {
+		char close = (*s == '{') ? '}' : ']';
+
+		s++;
+		if (*s == close)
+			return s + 1;
+		for (;;) {
+			if (close == '}') {
+				if (*s != '"' || !(s = skip_value (s)) || *s != ':')
+					return NULL;
+				s++;
+			}
+			if (!(s = skip_value (s)))
+				return NULL;
+			if (*s == close)
+				return s + 1;
+			if (*s != ',')
+				return NULL;
+			s++;
+		}
+	}
+	if (*s == '"') {
+		for (s++; *s != '"'; s++) {
+			if ((unsigned char) *s < 0x20 || !*s)
+				return NULL;
+			if (*s == '\\' && !*++s)
+				return NULL;
+		}
+		return s + 1;
+	}
+	if (!strncmp (s, "null", 4))
+		return s + 4;
+	if (*s == '-' || isdigit ((unsigned char) *s)) {
+		char *end;
+
+		strtod (s, &end);
+		return end;
+	}
+	return NULL;
+}
+
+static int
+valid (const char *s)
+{
+	s = skip_value (s);
+	return s && !*s;
+}
+
+static void
+add (ExifData *ed, ExifIfd ifd, ExifTag tag, ExifFormat f,
+     unsigned int components, const void *data, unsigned int size)
+{
+	ExifEntry *e = exif_entry_new ();
+
+	e->tag = tag;
+	e->format = f;
+	e->components = components;
+	e->size = size;
+	e->data = malloc (size);
+	memcpy (e->data, data, size);
+	exif_content_add_entry (ed->ifd[ifd], e);
+	exif_entry_unref (e);
+}
+
+static int
+check_values (void)
+{
+	static const char expected[] =
+		"{\"0\":{\"Make\":\"a\\\"b\\\\c\\u0001\\ufffd\xc3\xa9\","
+		"\"Orientation\":6,\"XResolution\":72.5,\"0xfffe\":[1,-2]},"
+		"\"GPS\":{\"GPSLatitude\":[52,30,null]}}";
+	ExifData *ed = exif_data_new ();
+	ExifByteOrder o = exif_data_get_byte_order (ed);
+	unsigned char d[24];
+	Output out = {NULL, 0, 0};
+	int ret = 0;
+
+	add (ed, EXIF_IFD_0, EXIF_TAG_MAKE, EXIF_FORMAT_ASCII, 10,
+	     "a\"b\\c\x01\xff\xc3\xa9", 10);
+	exif_set_short (d, o, 6);
+	add (ed, EXIF_IFD_0, EXIF_TAG_ORIENTATION, EXIF_FORMAT_SHORT, 1, d, 2);
+	exif_set_rational (d, o, (ExifRational) {145, 2});
+	add (ed, EXIF_IFD_0, EXIF_TAG_X_RESOLUTION, EXIF_FORMAT_RATIONAL, 1, d, 8);
+	exif_set_sshort (d, o, 1);
+	exif_set_sshort (d + 2, o, -2);
+	add (ed, EXIF_IFD_0, 0xfffe, EXIF_FORMAT_SSHORT, 2, d, 4);
+	exif_set_rational (d, o, (ExifRational) {52, 1});
+	exif_set_rational (d + 8, o, (ExifRational) {30, 1});
+	exif_set_rational (d + 16, o, (ExifRational) {1, 0});
+	add (ed, EXIF_IFD_GPS, EXIF_TAG_GPS_LATITUDE, EXIF_FORMAT_RATIONAL, 3, d, 24);
+
+	if (!exif_data_to_json (ed, collect, &out, 0) ||
+	    !out.d || strcmp (out.d, expected)) {
+		fprintf (stderr, "Unexpected JSON:\n%s\n", out.d ? out.d : "");
+		ret = 1;
+	}
+	if (exif_data_to_json (ed, fail, NULL, 0)) {
+		fprintf (stderr, "Writer failure not reported\n");
+		ret = 1;
+	}
+	free (out.d);
+	exif_data_unref (ed);
+	return ret;
+}
+
+int
+main (void)
+{
+	const char *srcdir = getenv ("srcdir");
+	char path[1024];
+	unsigned int i;
+	ExifData *ed;
+	int ret = check_values ();
+
+	if (!srcdir)
+		srcdir = ".";
+	exif_data_register_mnote_vendor (&canon);
+
+	for (i = 0; i < sizeof (files) / sizeof (files[0]); i++) {
+		Output out = {NULL, 0, 0}, ids = {NULL, 0, 0};
+
+		snprintf (path, sizeof (path), "%s/testdata/%s", srcdir, files[i]);
+		ed = exif_data_new_from_file (path);
+		if (!ed ||
+		    !exif_data_to_json (ed, collect, &out, 0) ||
+		    !exif_data_to_json (ed, collect, &ids, EXIF_JSON_OPTION_TAG_IDS |
+					EXIF_JSON_OPTION_SKIP_MAKER_NOTE)) {
+			fprintf (stderr, "%s: no JSON written\n", path);
+			ret = 1;
+		} else if (!valid (out.d) || !valid (ids.d)) {
+			fprintf (stderr, "%s: invalid JSON:\n%s\n", path, out.d);
+			ret = 1;
+		} else if (!i && !strstr (out.d, "\"MakerNote\":{\"")) {
+			fprintf (stderr, "%s: MakerNote missing\n", path);
+			ret = 1;
+		} else if (strstr (ids.d, "\"Make\"") || strstr (ids.d, "\"MakerNote\":{")) {
+			fprintf (stderr, "%s: options ignored\n", path);
+			ret = 1;
+		}
+		free (out.d);
+		free (ids.d);
+		exif_data_unref (ed);
+	}
+	return ret;
+}
@@ -0,0 +1,119 @@
+/* test-library-init.c
+ *
+ * Check that exif_library_init can be called any number of times, from
+ * several threads at once, and that lookups give the same results
+ * before and after it.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#include <config.h>
+
+#include <libexif/exif-data.h>
+#include <libexif/exif-library.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#define THREADS 8
+
+static const char *title, *format;
+static char path[1024];
+
+/*! Look things up the way a reader thread would.
+ *
+ * \return 0 if all went as expected, 1 otherwise
+ */
+static int
+lookup (void)
+{
+	ExifData *ed;
+	ExifEntry *e;
+	char v[256];
+	int ret = 0;
+
+	exif_library_init ();
+	if (strcmp (exif_tag_get_title_in_ifd (EXIF_TAG_MAKE, EXIF_IFD_0), title) ||
+	    strcmp (exif_format_get_name (EXIF_FORMAT_RATIONAL), format))
+		ret = 1;
+
+	ed = exif_data_new_from_file (path);
+	e = ed ? exif_content_get_entry (ed->ifd[EXIF_IFD_0], EXIF_TAG_MAKE) : NULL;
+	if (!e || strcmp (exif_entry_get_value (e, v, sizeof (v)), "Canon"))
+		ret = 1;
+	exif_data_unref (ed);
+	return ret;
+}
+
+#ifdef HAVE_PTHREAD_H
+static void *
+run (void *p)
+{
+	*(int *) p = lookup ();
+	return NULL;
+}
+#endif
+
+int
+main (void)
+{
+	const char *srcdir = getenv ("srcdir");
+	unsigned int i;
+	int ret = 0;
+#ifdef HAVE_PTHREAD_H
+	pthread_t t[THREADS];
+	int r[THREADS];
+#endif
+
+	if (!srcdir)
+		srcdir = ".";
+	snprintf (path, sizeof (path), "%s/testdata/canon_makernote_variant_1.jpg",
+		  srcdir);
+	title = exif_tag_get_title_in_ifd (EXIF_TAG_MAKE, EXIF_IFD_0);
+	format = exif_format_get_name (EXIF_FORMAT_RATIONAL);
+	if (!title || !format) {
+		fprintf (stderr, "No title or format name\n");
+		return 1;
+	}
+
+#ifdef HAVE_PTHREAD_H
+	for (i = 0; i < THREADS; i++)
+		if (pthread_create (&t[i], NULL, run, &r[i])) {
+			fprintf (stderr, "Could not start thread %u\n", i);
+			return 1;
+		}
+	for (i = 0; i < THREADS; i++) {
+		pthread_join (t[i], NULL);
+		if (r[i]) {
+			fprintf (stderr, "Lookups in thread %u differ\n", i);
+			ret = 1;
+		}
+	}
+#else
+	for (i = 0; i < THREADS; i++)
+		ret |= lookup ();
+#endif
+
+	exif_library_init ();
+	ret |= lookup ();
+	return ret;
+}
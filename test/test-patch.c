@@ -0,0 +1,268 @@
+/* test-patch.c
+ *
+ * Check that exif_data_patch_entry writes same-size edits back into the
+ * original buffer and refuses everything else, and that
+ * exif_data_patch_thumbnail only touches the thumbnail and its length.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#include <libexif/exif-data.h>
+#include <libexif/exif-utils.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NEW_DATE "2001:02:03 04:05:06"
+
+static ExifEntry *
+add_entry (ExifData *ed, ExifIfd ifd, ExifTag tag)
+{
+	ExifEntry *e = exif_entry_new ();
+	exif_content_add_entry (ed->ifd[ifd], e);
+	exif_entry_initialize (e, tag);
+	exif_entry_unref (e);
+	return e;
+}
+
+/* Load raw data and check the Orientation and the thumbnail */
+static int
+check_thumbnail_data (const unsigned char *d, unsigned int size,
+		      const unsigned char *thumbnail, unsigned int thumbnail_size,
+		      const char *what)
+{
+	ExifData *ed = exif_data_new_from_data (d, size);
+	int ret = 0;
+
+	if (!exif_content_get_entry (ed->ifd[EXIF_IFD_0], EXIF_TAG_ORIENTATION)) {
+		fprintf (stderr, "%s: Orientation lost\n", what);
+		ret = 1;
+	}
+	if (ed->size != thumbnail_size ||
+	    (thumbnail_size && memcmp (ed->data, thumbnail, thumbnail_size))) {
+		fprintf (stderr, "%s: thumbnail of %u bytes instead of %u\n",
+			 what, ed->size, thumbnail_size);
+		ret = 1;
+	}
+	exif_data_unref (ed);
+	return ret;
+}
+
+/* Load raw data without its thumbnail and patch it, which must leave it
+ * unchanged */
+static int
+check_by_reference (const unsigned char *d, unsigned int size,
+		    ExifDataOption o)
+{
+	ExifData *ed = exif_data_new ();
+	unsigned char *buf = malloc (size);
+	unsigned int buf_size = size;
+	int ret = 0;
+
+	if (!ed || !buf) {
+		fprintf (stderr, "Out of memory\n");
+		exif_data_unref (ed);
+		free (buf);
+		return 1;
+	}
+	memcpy (buf, d, size);
+	exif_data_set_option (ed, o);
+	exif_data_load_data (ed, d, size);
+	if (exif_data_patch_thumbnail (ed, &buf, &buf_size) ||
+	    (buf_size != size) || memcmp (buf, d, size)) {
+		fprintf (stderr, "%s: thumbnail changed\n",
+			 exif_data_option_get_name (o));
+		ret = 1;
+	}
+	free (buf);
+	exif_data_unref (ed);
+	return ret;
+}
+
+static int
+check_thumbnail (void)
+{
+	static unsigned char small[100], large[3000];
+	ExifData *ed = exif_data_new ();
+	unsigned char *buf = NULL;
+	unsigned int size = 0, old_size;
+	int ret = 0;
+
+	memset (small, 1, sizeof (small));
+	memset (large, 2, sizeof (large));
+	add_entry (ed, EXIF_IFD_0, EXIF_TAG_ORIENTATION);
+
+	/* Without a thumbnail there is nothing to patch */
+	exif_data_save_data (ed, &buf, &size);
+	ed->data = small;
+	ed->size = sizeof (small);
+	if (exif_data_patch_thumbnail (ed, &buf, &size)) {
+		fprintf (stderr, "Thumbnail patched into data without one\n");
+		ret = 1;
+	}
+	free (buf);
+	buf = NULL;
+
+	exif_data_save_data (ed, &buf, &size);
+	old_size = size;
+
+	/* Grow */
+	ed->data = large;
+	ed->size = sizeof (large);
+	if (!exif_data_patch_thumbnail (ed, &buf, &size) ||
+	    size != old_size + sizeof (large) - sizeof (small)) {
+		fprintf (stderr, "Larger thumbnail not patched\n");
+		ret = 1;
+	} else
+		ret |= check_thumbnail_data (buf, size, large, sizeof (large),
+					     "larger thumbnail");
+
+	/* Shrink */
+	ed->data = small;
+	ed->size = sizeof (small);
+	if (!exif_data_patch_thumbnail (ed, &buf, &size) || size != old_size) {
+		fprintf (stderr, "Smaller thumbnail not patched\n");
+		ret = 1;
+	} else
+		ret |= check_thumbnail_data (buf, size, small, sizeof (small),
+					     "smaller thumbnail");
+
+	/* No thumbnail loaded is not the same as removing it */
+	ret |= check_by_reference (buf, size, EXIF_DATA_OPTION_THUMBNAIL_BY_REFERENCE);
+	ret |= check_by_reference (buf, size, EXIF_DATA_OPTION_IGNORE_THUMBNAIL);
+	ed->data = NULL;
+	ed->size = 0;
+	if (exif_data_patch_thumbnail (ed, &buf, &size) || size != old_size) {
+		fprintf (stderr, "Thumbnail removed without remove_thumbnail\n");
+		ret = 1;
+	}
+
+	/* Remove */
+	ed->remove_thumbnail = 1;
+	if (!exif_data_patch_thumbnail (ed, &buf, &size) ||
+	    size != old_size - sizeof (small)) {
+		fprintf (stderr, "Thumbnail not removed\n");
+		ret = 1;
+	} else
+		ret |= check_thumbnail_data (buf, size, NULL, 0, "no thumbnail");
+
+	free (buf);
+	exif_data_unref (ed);
+	return ret;
+}
+
+int
+main (void)
+{
+	ExifData *ed, *loaded;
+	ExifEntry *e;
+	unsigned char *buf = NULL, *copy;
+	unsigned int size = 0;
+	int ret = 0;
+
+	ed = exif_data_new ();
+	if (!ed) {
+		fprintf (stderr, "Out of memory\n");
+		return 1;
+	}
+	add_entry (ed, EXIF_IFD_0, EXIF_TAG_ORIENTATION);
+	add_entry (ed, EXIF_IFD_0, EXIF_TAG_X_RESOLUTION);
+	add_entry (ed, EXIF_IFD_EXIF, EXIF_TAG_DATE_TIME_ORIGINAL);
+	exif_data_save_data (ed, &buf, &size);
+	exif_data_unref (ed);
+	if (!buf || !size) {
+		fprintf (stderr, "Could not save EXIF data\n");
+		return 1;
+	}
+	copy = malloc (size);
+	memcpy (copy, buf, size);
+
+	loaded = exif_data_new_from_data (buf, size);
+
+	/* Inline value */
+	e = exif_content_get_entry (loaded->ifd[EXIF_IFD_0], EXIF_TAG_ORIENTATION);
+	exif_set_short (e->data, exif_data_get_byte_order (loaded), 6);
+	if (!exif_data_patch_entry (loaded, e, buf, size)) {
+		fprintf (stderr, "Orientation not patched\n");
+		ret = 1;
+	}
+
+	/* Value stored outside the directory */
+	e = exif_content_get_entry (loaded->ifd[EXIF_IFD_EXIF], EXIF_TAG_DATE_TIME_ORIGINAL);
+	if (!e || e->size != sizeof (NEW_DATE)) {
+		fprintf (stderr, "Unexpected DateTimeOriginal\n");
+		ret = 1;
+	} else {
+		memcpy (e->data, NEW_DATE, sizeof (NEW_DATE));
+		if (!exif_data_patch_entry (loaded, e, buf, size)) {
+			fprintf (stderr, "DateTimeOriginal not patched\n");
+			ret = 1;
+		}
+	}
+
+	/* Size changes must be refused and leave the buffer alone */
+	e = exif_content_get_entry (loaded->ifd[EXIF_IFD_0], EXIF_TAG_X_RESOLUTION);
+	e->components = 2;
+	if (exif_data_patch_entry (loaded, e, buf, size)) {
+		fprintf (stderr, "Size change was patched\n");
+		ret = 1;
+	}
+	e->components = 1;
+
+	/* Reloading the patched buffer must show the new values */
+	ed = exif_data_new_from_data (buf, size);
+	e = exif_content_get_entry (ed->ifd[EXIF_IFD_0], EXIF_TAG_ORIENTATION);
+	if (!e || exif_get_short (e->data, exif_data_get_byte_order (ed)) != 6) {
+		fprintf (stderr, "Patched orientation not found\n");
+		ret = 1;
+	}
+	e = exif_content_get_entry (ed->ifd[EXIF_IFD_EXIF], EXIF_TAG_DATE_TIME_ORIGINAL);
+	if (!e || memcmp (e->data, NEW_DATE, sizeof (NEW_DATE))) {
+		fprintf (stderr, "Patched date not found\n");
+		ret = 1;
+	}
+	exif_data_unref (ed);
+
+	/* Nothing but the two values may have changed */
+	{
+		unsigned int i, changed = 0;
+		for (i = 0; i < size; i++)
+			changed += (buf[i] != copy[i]);
+		if (!changed || changed > 2 + sizeof (NEW_DATE)) {
+			fprintf (stderr, "%u bytes changed\n", changed);
+			ret = 1;
+		}
+	}
+
+	/* A byte order change invalidates the recorded offsets */
+	e = exif_content_get_entry (loaded->ifd[EXIF_IFD_0], EXIF_TAG_ORIENTATION);
+	exif_data_set_byte_order (loaded, exif_data_get_byte_order (loaded) ==
+		EXIF_BYTE_ORDER_INTEL ? EXIF_BYTE_ORDER_MOTOROLA : EXIF_BYTE_ORDER_INTEL);
+	if (exif_data_patch_entry (loaded, e, buf, size)) {
+		fprintf (stderr, "Patched after byte order change\n");
+		ret = 1;
+	}
+
+	exif_data_unref (loaded);
+	free (copy);
+	free (buf);
+
+	ret |= check_thumbnail ();
+	return ret;
+}
@@ -0,0 +1,236 @@
+/* test-png-webp.c
+ *
+ * Check that ExifLoader finds the EXIF chunk of PNG and WebP files behind
+ * the image data, with or without an EXIF header in front of the TIFF
+ * data.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#include <libexif/exif-data.h>
+#include <libexif/exif-loader.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define IMAGE_SIZE 50001
+
+typedef struct {
+	unsigned char *d;
+	unsigned int size;
+} Buf;
+
+static void
+put (Buf *b, const void *p, unsigned int size)
+{
+	if (!size)
+		return;
+	b->d = realloc (b->d, b->size + size);
+	memcpy (b->d + b->size, p, size);
+	b->size += size;
+}
+
+static void
+put_long (Buf *b, unsigned int v, int big_endian)
+{
+	unsigned char c[4];
+	unsigned int i;
+
+	for (i = 0; i < 4; i++)
+		c[big_endian ? 3 - i : i] = (v >> (8 * i)) & 0xff;
+	put (b, c, 4);
+}
+
+/* PNG: length, type, data, CRC (not checked by the loader) */
+static void
+put_png_chunk (Buf *b, const char *type, const void *p, unsigned int size)
+{
+	put_long (b, size, 1);
+	put (b, type, 4);
+	put (b, p, size);
+	put_long (b, 0, 1);
+}
+
+/* WebP: FourCC, size, data padded to even size */
+static void
+put_webp_chunk (Buf *b, const char *type, const void *p, unsigned int size)
+{
+	put (b, type, 4);
+	put_long (b, size, 0);
+	put (b, p, size);
+	if (size & 1)
+		put (b, "", 1);
+}
+
+/* EXIF header and TIFF data, as the loader is expected to hold them */
+static void
+make_exif (Buf *app1)
+{
+	ExifData *ed = exif_data_new ();
+	ExifEntry *e = exif_entry_new ();
+	unsigned char *d = NULL;
+	unsigned int ds = 0;
+
+	exif_content_add_entry (ed->ifd[EXIF_IFD_0], e);
+	exif_entry_initialize (e, EXIF_TAG_MAKE);
+	e->format = EXIF_FORMAT_ASCII;
+	e->components = 5;
+	e->size = 5;
+	e->data = realloc (e->data, 5);
+	memcpy (e->data, "PNG", 4);
+	exif_entry_unref (e);
+	exif_data_save_data (ed, &d, &ds);
+	exif_data_unref (ed);
+
+	put (app1, d, ds);
+	free (d);
+}
+
+static void
+make_file (Buf *f, const Buf *app1, int webp, int with_header)
+{
+	unsigned char *image = calloc (1, IMAGE_SIZE);
+	const unsigned char *exif = app1->d + (with_header ? 0 : 6);
+	unsigned int exif_size = app1->size - (with_header ? 0 : 6);
+
+	if (webp) {
+		put (f, "RIFF\0\0\0\0WEBP", 12);
+		put_webp_chunk (f, "VP8X", "\x08\0\0\0\0\0\0\0\0\0", 10);
+		put_webp_chunk (f, "VP8 ", image, IMAGE_SIZE);
+		put_webp_chunk (f, "EXIF", exif, exif_size);
+		f->d[4] = (f->size - 8) & 0xff;
+		f->d[5] = ((f->size - 8) >> 8) & 0xff;
+		f->d[6] = ((f->size - 8) >> 16) & 0xff;
+	} else {
+		put (f, "\x89PNG\r\n\x1a\n", 8);
+		put_png_chunk (f, "IHDR", "\0\0\0\1\0\0\0\1\x08\0\0\0\0", 13);
+		put_png_chunk (f, "IDAT", image, IMAGE_SIZE);
+		put_png_chunk (f, "eXIf", exif, exif_size);
+		put_png_chunk (f, "IEND", NULL, 0);
+	}
+	free (image);
+}
+
+static int
+check_loader (ExifLoader *l, const Buf *app1, const char *what)
+{
+	const unsigned char *d;
+	unsigned int ds;
+	ExifData *ed;
+	ExifEntry *e;
+	int ret = 0;
+
+	exif_loader_get_buf (l, &d, &ds);
+	if (ds != app1->size || memcmp (d, app1->d, ds)) {
+		fprintf (stderr, "%s: loader holds %u bytes instead of %u\n",
+			 what, ds, app1->size);
+		ret = 1;
+	}
+	ed = exif_loader_get_data (l);
+	e = ed ? exif_content_get_entry (ed->ifd[EXIF_IFD_0], EXIF_TAG_MAKE) : NULL;
+	if (!e || strcmp ((const char *) e->data, "PNG")) {
+		fprintf (stderr, "%s: EXIF data not loaded\n", what);
+		ret = 1;
+	}
+	exif_data_unref (ed);
+	return ret;
+}
+
+static int
+check (int webp, int with_header)
+{
+	Buf f = {NULL, 0}, app1 = {NULL, 0};
+	char name[] = "/tmp/test-png-webp-XXXXXX";
+	char what[64];
+	unsigned int chunk, pos;
+	ExifLoader *l;
+	FILE *fp;
+	int fd, ret = 0;
+
+	make_exif (&app1);
+	make_file (&f, &app1, webp, with_header);
+
+	for (chunk = 1; chunk < 2 * f.size; chunk = chunk * 5 + 2) {
+		l = exif_loader_new ();
+		for (pos = 0; pos < f.size; pos += chunk)
+			if (!exif_loader_write (l, f.d + pos,
+						(f.size - pos < chunk) ? f.size - pos : chunk))
+				break;
+		sprintf (what, "%s%s, chunk %u", webp ? "WebP" : "PNG",
+			 with_header ? " with header" : "", chunk);
+		ret |= check_loader (l, &app1, what);
+		exif_loader_unref (l);
+	}
+
+	/* Through a file, seeking over the image data */
+	fd = mkstemp (name);
+	fp = (fd < 0) ? NULL : fdopen (fd, "wb");
+	if (!fp || fwrite (f.d, f.size, 1, fp) != 1) {
+		fprintf (stderr, "Could not write %s\n", name);
+		ret = 1;
+	} else {
+		fclose (fp);
+		l = exif_loader_new ();
+		exif_loader_write_file (l, name);
+		sprintf (what, "%s%s, file", webp ? "WebP" : "PNG",
+			 with_header ? " with header" : "");
+		ret |= check_loader (l, &app1, what);
+		exif_loader_unref (l);
+	}
+	unlink (name);
+
+	free (f.d);
+	free (app1.d);
+	return ret;
+}
+
+/* A PNG file without EXIF data ends at IEND */
+static int
+check_none (void)
+{
+	Buf f = {NULL, 0};
+	const unsigned char *d;
+	unsigned int ds;
+	ExifLoader *l = exif_loader_new ();
+	int ret = 0;
+
+	put (&f, "\x89PNG\r\n\x1a\n", 8);
+	put_png_chunk (&f, "IHDR", "\0\0\0\1\0\0\0\1\x08\0\0\0\0", 13);
+	put_png_chunk (&f, "IEND", NULL, 0);
+	if (exif_loader_write (l, f.d, f.size)) {
+		fprintf (stderr, "Loader wants data after IEND\n");
+		ret = 1;
+	}
+	exif_loader_get_buf (l, &d, &ds);
+	if (d || ds) {
+		fprintf (stderr, "Loader holds data of a PNG file without EXIF\n");
+		ret = 1;
+	}
+	exif_loader_unref (l);
+	free (f.d);
+	return ret;
+}
+
+int
+main (void)
+{
+	return check (0, 0) | check (0, 1) | check (1, 0) | check (1, 1) |
+		check_none ();
+}
@@ -0,0 +1,253 @@
+/* test-save-dirty.c
+ *
+ * Check that saving again after small changes, which copies the IFDs that
+ * did not change from the previous save with
+ * EXIF_DATA_OPTION_REUSE_UNCHANGED_IFDS, gives the same bytes as saving
+ * the changed data from scratch.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#include <libexif/exif-data.h>
+#include <libexif/exif-loader.h>
+#include <libexif/exif-utils.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *files[] = {
+	"canon_makernote_variant_1.jpg",
+	"fuji_makernote_variant_1.jpg",
+	"olympus_makernote_variant_2.jpg",
+	"pentax_makernote_variant_2.jpg"
+};
+
+static unsigned int reallocs;
+
+static void *
+count_alloc (ExifLong s)
+{
+	return calloc (s, 1);
+}
+
+static void *
+count_realloc (void *p, ExifLong s)
+{
+	reallocs++;
+	return realloc (p, s);
+}
+
+static ExifData *
+load (ExifMem *mem, const char *path)
+{
+	ExifLoader *l = exif_loader_new_mem (mem);
+	ExifData *ed;
+
+	exif_loader_write_file (l, path);
+	ed = exif_loader_get_data (l);
+	exif_loader_unref (l);
+	return ed;
+}
+
+/*! Save \a ed and throw the bytes away
+ *
+ * \return the number of reallocations needed
+ */
+static unsigned int
+save (ExifData *ed)
+{
+	unsigned char *d = NULL;
+	unsigned int ds = 0;
+
+	reallocs = 0;
+	exif_data_save_data (ed, &d, &ds);
+	free (d);
+	return reallocs;
+}
+
+typedef enum {
+	CHANGE_NONE,
+	CHANGE_IN_PLACE,
+	CHANGE_ADD,
+	CHANGE_REMOVE,
+	CHANGE_BYTE_ORDER,
+	CHANGE_COUNT
+} Change;
+
+static void
+change (ExifData *ed, Change c)
+{
+	ExifEntry *e;
+
+	switch (c) {
+	case CHANGE_IN_PLACE:
+		e = exif_content_get_entry (ed->ifd[EXIF_IFD_0], EXIF_TAG_MAKE);
+		if (e && e->size > 1) {
+			e->data[0] = 'X';
+			exif_entry_mark_dirty (e);
+		}
+		break;
+	case CHANGE_ADD:
+		e = exif_entry_new ();
+		exif_content_add_entry (ed->ifd[EXIF_IFD_GPS], e);
+		exif_entry_initialize (e, EXIF_TAG_GPS_VERSION_ID);
+		exif_entry_unref (e);
+		break;
+	case CHANGE_REMOVE:
+		e = exif_content_get_entry (ed->ifd[EXIF_IFD_EXIF],
+					    EXIF_TAG_EXIF_VERSION);
+		if (e)
+			exif_content_remove_entry (ed->ifd[EXIF_IFD_EXIF], e);
+		break;
+	case CHANGE_BYTE_ORDER:
+		exif_data_set_byte_order (ed,
+			exif_data_get_byte_order (ed) == EXIF_BYTE_ORDER_INTEL ?
+			EXIF_BYTE_ORDER_MOTOROLA : EXIF_BYTE_ORDER_INTEL);
+		break;
+	default:
+		break;
+	}
+}
+
+static int
+check (ExifMem *mem, const char *path, Change c)
+{
+	ExifData *ed = load (mem, path), *ref = load (mem, path);
+	unsigned char *d = NULL, *d_ref = NULL;
+	unsigned int ds = 0, ds_ref = 0, first, again;
+	int ret = 0;
+
+	if (!ed || !ref) {
+		fprintf (stderr, "%s: could not load\n", path);
+		return 1;
+	}
+
+	/* The IFDs of the first save changed since loading, so they are
+	 * kept from the second one on */
+	exif_data_set_option (ed, EXIF_DATA_OPTION_REUSE_UNCHANGED_IFDS);
+	save (ed);
+	first = save (ed);
+	change (ed, c);
+	reallocs = 0;
+	exif_data_save_data (ed, &d, &ds);
+	again = reallocs;
+
+	/* The same change, saved from scratch. Saving hides the thumbnail
+	 * entries of IFD 1, so save once here as well. */
+	save (ref);
+	change (ref, c);
+	exif_data_save_data (ref, &d_ref, &ds_ref);
+
+	if (!d || ds != ds_ref || memcmp (d, d_ref, ds)) {
+		fprintf (stderr, "%s: change %i saved differently (%u vs %u bytes)\n",
+			 path, c, ds, ds_ref);
+		ret = 1;
+	}
+	if (c == CHANGE_NONE && again >= first) {
+		fprintf (stderr, "%s: nothing kept from the first save "
+			 "(%u reallocations, %u before)\n", path, again, first);
+		ret = 1;
+	}
+	free (d);
+	free (d_ref);
+	exif_data_unref (ed);
+	exif_data_unref (ref);
+	return ret;
+}
+
+/*! Check that formatting values keeps the IFDs from the previous save,
+ *  and that initializing an entry does not.
+ *
+ * \return 0 if all went as expected, 1 otherwise
+ */
+static int
+check_entry_calls (ExifMem *mem, const char *path)
+{
+	ExifData *ed = load (mem, path), *ref = load (mem, path);
+	unsigned char *d = NULL, *d_ref = NULL;
+	unsigned int ds = 0, ds_ref = 0, first, again, i, j;
+	ExifEntry *e = exif_entry_new (), *e_ref = exif_entry_new ();
+	char v[1024];
+	int ret = 0;
+
+	if (!ed || !ref || !e || !e_ref) {
+		fprintf (stderr, "%s: could not load\n", path);
+		return 1;
+	}
+
+	/* An entry without a value yet, to be initialized later */
+	exif_content_add_entry (ed->ifd[EXIF_IFD_GPS], e);
+	exif_content_add_entry (ref->ifd[EXIF_IFD_GPS], e_ref);
+
+	exif_data_set_option (ed, EXIF_DATA_OPTION_REUSE_UNCHANGED_IFDS);
+	save (ed);
+	first = save (ed);
+	for (i = 0; i < EXIF_IFD_COUNT; i++)
+		for (j = 0; j < ed->ifd[i]->count; j++)
+			exif_entry_get_value (ed->ifd[i]->entries[j], v, sizeof (v));
+	again = save (ed);
+	if (again >= first) {
+		fprintf (stderr, "%s: formatting values changed the IFDs "
+			 "(%u reallocations, %u before)\n", path, again, first);
+		ret = 1;
+	}
+
+	exif_entry_initialize (e, EXIF_TAG_GPS_VERSION_ID);
+	exif_data_save_data (ed, &d, &ds);
+
+	save (ref);
+	exif_entry_initialize (e_ref, EXIF_TAG_GPS_VERSION_ID);
+	exif_data_save_data (ref, &d_ref, &ds_ref);
+
+	if (!d || ds != ds_ref || memcmp (d, d_ref, ds)) {
+		fprintf (stderr, "%s: initialized entry saved differently "
+			 "(%u vs %u bytes)\n", path, ds, ds_ref);
+		ret = 1;
+	}
+	free (d);
+	free (d_ref);
+	exif_entry_unref (e);
+	exif_entry_unref (e_ref);
+	exif_data_unref (ed);
+	exif_data_unref (ref);
+	return ret;
+}
+
+int
+main (void)
+{
+	const char *srcdir = getenv ("srcdir");
+	ExifMem *mem = exif_mem_new (count_alloc, count_realloc, free);
+	char path[1024];
+	unsigned int i;
+	Change c;
+	int ret = 0;
+
+	if (!srcdir)
+		srcdir = ".";
+
+	for (i = 0; i < sizeof (files) / sizeof (files[0]); i++) {
+		snprintf (path, sizeof (path), "%s/testdata/%s", srcdir, files[i]);
+		for (c = CHANGE_NONE; c < CHANGE_COUNT; c++)
+			ret |= check (mem, path, c);
+		ret |= check_entry_calls (mem, path);
+	}
+	exif_mem_unref (mem);
+	return ret;
+}
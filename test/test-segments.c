@@ -0,0 +1,205 @@
+/* test-segments.c
+ *
+ * Check that ExifLoader collects XMP, ICC and MPF segments alongside the
+ * EXIF data, however the input is split up.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#include <libexif/exif-data.h>
+#include <libexif/exif-loader.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BODY_SIZE 10000
+
+static const char xmp[] = "http://ns.adobe.com/xap/1.0/\0<x:xmpmeta/>";
+static const char icc1[] = "ICC_PROFILE\0\1\2first chunk";
+static const char icc2[] = "ICC_PROFILE\0\2\2second chunk";
+static const char mpf[] = "MPF\0MM\0\x2a\0\0\0\x08";
+static const char fpxr[] = "FPXR\0not captured";
+
+typedef struct {
+	ExifLoaderSegmentType type;
+	const char *data;
+	unsigned int size;
+	unsigned int offset;
+} Expected;
+
+static unsigned char *d;
+static unsigned int d_size;
+
+static void
+put (const void *p, unsigned int size)
+{
+	d = realloc (d, d_size + size);
+	memcpy (d + d_size, p, size);
+	d_size += size;
+}
+
+/* Append a segment and return the offset of its payload */
+static unsigned int
+put_segment (unsigned char marker, const void *p, unsigned int size)
+{
+	unsigned char m[4];
+
+	m[0] = 0xff;
+	m[1] = marker;
+	m[2] = (size + 2) >> 8;
+	m[3] = (size + 2) & 0xff;
+	put (m, 4);
+	put (p, size);
+	return d_size - size;
+}
+
+static void
+put_exif (void)
+{
+	ExifData *ed = exif_data_new ();
+	ExifEntry *e = exif_entry_new ();
+	unsigned char *exif = NULL;
+	unsigned int exif_size = 0;
+
+	exif_content_add_entry (ed->ifd[EXIF_IFD_0], e);
+	exif_entry_initialize (e, EXIF_TAG_MAKE);
+	e->format = EXIF_FORMAT_ASCII;
+	e->components = 5;
+	e->size = 5;
+	e->data = realloc (e->data, 5);
+	memcpy (e->data, "Make", 5);
+	exif_entry_unref (e);
+	exif_data_save_data (ed, &exif, &exif_size);
+	exif_data_unref (ed);
+	put_segment (0xe1, exif, exif_size);
+	free (exif);
+}
+
+static int
+check (unsigned int chunk, const Expected *exp, unsigned int n)
+{
+	ExifLoader *l = exif_loader_new ();
+	ExifData *ed;
+	ExifEntry *e;
+	unsigned int pos, i;
+	int ret = 0;
+
+	exif_loader_set_capture (l, EXIF_LOADER_SEGMENT_XMP |
+				 EXIF_LOADER_SEGMENT_ICC | EXIF_LOADER_SEGMENT_MPF);
+	for (pos = 0; pos < d_size; pos += chunk)
+		if (!exif_loader_write (l, d + pos,
+					(d_size - pos < chunk) ? d_size - pos : chunk))
+			break;
+	if (pos >= d_size - BODY_SIZE / 2) {
+		fprintf (stderr, "Chunk %u: loader read into the image data\n", chunk);
+		ret = 1;
+	}
+
+	ed = exif_loader_get_data (l);
+	e = ed ? exif_content_get_entry (ed->ifd[EXIF_IFD_0], EXIF_TAG_MAKE) : NULL;
+	if (!e || strcmp ((const char *) e->data, "Make")) {
+		fprintf (stderr, "Chunk %u: EXIF data not loaded\n", chunk);
+		ret = 1;
+	}
+	exif_data_unref (ed);
+
+	if (exif_loader_get_segment_count (l) != n) {
+		fprintf (stderr, "Chunk %u: %u segments instead of %u\n", chunk,
+			 exif_loader_get_segment_count (l), n);
+		ret = 1;
+	}
+	for (i = 0; i < n; i++) {
+		const ExifLoaderSegment *s = exif_loader_get_segment (l, i);
+
+		if (!s || s->type != exp[i].type || s->size != exp[i].size ||
+		    s->offset != exp[i].offset ||
+		    memcmp (s->data, exp[i].data, s->size)) {
+			fprintf (stderr, "Chunk %u: segment %u differs\n", chunk, i);
+			ret = 1;
+		}
+	}
+	if (exif_loader_get_segment (l, n)) {
+		fprintf (stderr, "Chunk %u: segment past the end returned\n", chunk);
+		ret = 1;
+	}
+
+	exif_loader_reset (l);
+	if (exif_loader_get_segment_count (l)) {
+		fprintf (stderr, "Chunk %u: segments survived reset\n", chunk);
+		ret = 1;
+	}
+	exif_loader_unref (l);
+	return ret;
+}
+
+int
+main (void)
+{
+	static const unsigned char jfif[] = {
+		'J', 'F', 'I', 'F', 0x00, 0x01, 0x01, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00
+	};
+	static const unsigned char dqt[] = { 0x00, 0x01, 0x02, 0x03 };
+	unsigned char *body = calloc (1, BODY_SIZE);
+	Expected exp[4];
+	unsigned int chunk;
+	ExifLoader *l;
+	int ret = 0;
+
+	put ("\xff\xd8", 2);
+	put_segment (0xe0, jfif, sizeof (jfif));
+	exp[0].offset = put_segment (0xe1, xmp, sizeof (xmp));
+	put_exif ();
+	exp[1].offset = put_segment (0xe2, icc1, sizeof (icc1));
+	put_segment (0xe2, fpxr, sizeof (fpxr));
+	exp[2].offset = put_segment (0xe2, icc2, sizeof (icc2));
+	exp[3].offset = put_segment (0xe2, mpf, sizeof (mpf));
+	put_segment (0xdb, dqt, sizeof (dqt));
+	put ("\xff\xda", 2);
+	put (body, BODY_SIZE);
+	put ("\xff\xd9", 2);
+
+	exp[0].type = EXIF_LOADER_SEGMENT_XMP;
+	exp[0].data = xmp;
+	exp[0].size = sizeof (xmp);
+	exp[1].type = EXIF_LOADER_SEGMENT_ICC;
+	exp[1].data = icc1;
+	exp[1].size = sizeof (icc1);
+	exp[2].type = EXIF_LOADER_SEGMENT_ICC;
+	exp[2].data = icc2;
+	exp[2].size = sizeof (icc2);
+	exp[3].type = EXIF_LOADER_SEGMENT_MPF;
+	exp[3].data = mpf;
+	exp[3].size = sizeof (mpf);
+
+	for (chunk = 1; chunk < 2 * d_size; chunk = chunk * 3 + 1)
+		ret |= check (chunk, exp, 4);
+
+	/* Without capturing, nothing is collected */
+	l = exif_loader_new ();
+	exif_loader_write (l, d, d_size);
+	if (exif_loader_get_segment_count (l)) {
+		fprintf (stderr, "Segments collected without being asked for\n");
+		ret = 1;
+	}
+	exif_loader_unref (l);
+
+	free (body);
+	free (d);
+	return ret;
+}
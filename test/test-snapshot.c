@@ -0,0 +1,285 @@
+/* test-snapshot.c
+ *
+ * Check that a snapshot of ExifData can be queried in place, including
+ * the decoded MakerNote, and turned back into the same ExifData.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#include <libexif/exif-data.h>
+#include <libexif/exif-snapshot.h>
+#include <libexif/exif-utils.h>
+#include <libexif/canon/exif-mnote-data-canon.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *files[] = {
+	"canon_makernote_variant_1.jpg",
+	"fuji_makernote_variant_1.jpg",
+	"olympus_makernote_variant_2.jpg",
+	"pentax_makernote_variant_2.jpg"
+};
+
+/* Every entry of ed must be found in the snapshot with the same value */
+static int
+check_view (const char *fn, ExifData *ed, const ExifSnapshot *s)
+{
+	ExifSnapshotEntry se;
+	ExifSnapshotMnoteEntry sm;
+	ExifMnoteData *md = exif_data_get_mnote_data (ed);
+	const unsigned char *t;
+	char value[1024];
+	const char *v;
+	unsigned int i, j, ts;
+
+	if (exif_snapshot_get_byte_order (s) != exif_data_get_byte_order (ed)) {
+		fprintf (stderr, "%s: wrong byte order\n", fn);
+		return 1;
+	}
+	for (i = 0; i < EXIF_IFD_COUNT; i++) {
+		if (exif_snapshot_get_count (s, i) != ed->ifd[i]->count) {
+			fprintf (stderr, "%s: IFD '%s' has %u entries instead of %u\n",
+				 fn, exif_ifd_get_name (i),
+				 exif_snapshot_get_count (s, i), ed->ifd[i]->count);
+			return 1;
+		}
+		for (j = 0; j < ed->ifd[i]->count; j++) {
+			ExifEntry *e = ed->ifd[i]->entries[j];
+
+			if (!exif_snapshot_find_entry (s, i, e->tag, &se) ||
+			    se.format != e->format || se.components != e->components ||
+			    se.size != e->size || memcmp (se.data, e->data, e->size)) {
+				fprintf (stderr, "%s: tag 0x%04x differs\n", fn, e->tag);
+				return 1;
+			}
+		}
+	}
+	if (exif_snapshot_find_entry (s, EXIF_IFD_0, 0xfffe, &se)) {
+		fprintf (stderr, "%s: found a tag that is not there\n", fn);
+		return 1;
+	}
+
+	t = exif_snapshot_get_thumbnail (s, &ts);
+	if (ts != ed->size || (ts && memcmp (t, ed->data, ts))) {
+		fprintf (stderr, "%s: thumbnail differs\n", fn);
+		return 1;
+	}
+
+	if (exif_snapshot_get_mnote_count (s) != (md ? exif_mnote_data_count (md) : 0)) {
+		fprintf (stderr, "%s: MakerNote not in snapshot\n", fn);
+		return 1;
+	}
+	for (i = 0; i < exif_snapshot_get_mnote_count (s); i++) {
+		v = exif_mnote_data_get_value (md, i, value, sizeof (value));
+		if (!exif_snapshot_get_mnote_entry (s, i, &sm) ||
+		    sm.id != exif_mnote_data_get_id (md, i) ||
+		    (!v != !sm.value) || (v && strcmp (v, sm.value))) {
+			fprintf (stderr, "%s: MakerNote entry %u differs\n", fn, i);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int
+compare_saved (const char *fn, ExifData *a, ExifData *b)
+{
+	unsigned char *da = NULL, *db = NULL;
+	unsigned int sa = 0, sb = 0;
+	int ret = 0;
+
+	exif_data_save_data (a, &da, &sa);
+	exif_data_save_data (b, &db, &sb);
+	if (!da || sa != sb || memcmp (da, db, sa)) {
+		fprintf (stderr, "%s: saved data differs (%u vs %u bytes)\n",
+			 fn, sa, sb);
+		ret = 1;
+	}
+	free (da);
+	free (db);
+	return ret;
+}
+
+/* TIFF with one entry in IFD 0, pointing to two SubIFDs */
+static unsigned int
+build_tiff (unsigned char *t)
+{
+	static const ExifShort tags[] = {
+		EXIF_TAG_IMAGE_WIDTH, EXIF_TAG_IMAGE_LENGTH
+	};
+	const ExifByteOrder o = EXIF_BYTE_ORDER_MOTOROLA;
+	unsigned int i, j, p = 34;
+
+	memcpy (t, "MM", 2);
+	exif_set_short (t + 2, o, 0x002a);
+	exif_set_long (t + 4, o, 8);
+	exif_set_short (t + 8, o, 1);
+	exif_set_short (t + 10, o, EXIF_TAG_SUB_IFDS);
+	exif_set_short (t + 12, o, EXIF_FORMAT_LONG);
+	exif_set_long (t + 14, o, 2);
+	exif_set_long (t + 18, o, 26);
+	exif_set_long (t + 22, o, 0);
+	for (i = 0; i < 2; i++) {
+		exif_set_long (t + 26 + 4 * i, o, p);
+		exif_set_short (t + p, o, i + 1);
+		for (j = 0; j <= i; j++) {
+			exif_set_short (t + p + 2 + 12 * j, o, tags[j]);
+			exif_set_short (t + p + 4 + 12 * j, o, EXIF_FORMAT_LONG);
+			exif_set_long (t + p + 6 + 12 * j, o, 1);
+			exif_set_long (t + p + 10 + 12 * j, o, 100 * (i + 1) + j);
+		}
+		p += 2 + 12 * (i + 1);
+		exif_set_long (t + p, o, 0);
+		p += 4;
+	}
+	return p;
+}
+
+/* SubIFDs are kept in the snapshot and restored from it */
+static int
+check_sub_ifds (void)
+{
+	unsigned char t[128], *d = NULL;
+	unsigned int size = 0, i, j;
+	ExifData *ed = exif_data_new (), *back = NULL;
+	ExifSnapshotEntry se;
+	ExifSnapshot s;
+	ExifContent *c;
+	ExifEntry *e;
+	int ret = 0;
+
+	exif_data_load_tiff (ed, t, build_tiff (t));
+	if ((exif_data_get_sub_ifd_count (ed) != 2) ||
+	    !exif_data_snapshot_save (ed, &d, &size) ||
+	    !exif_data_snapshot_view (&s, d, size) ||
+	    (exif_snapshot_get_sub_ifd_count (&s) != 2)) {
+		fprintf (stderr, "SubIFDs not in snapshot\n");
+		exif_data_unref (ed);
+		free (d);
+		return 1;
+	}
+	back = exif_data_new_from_snapshot (d, size);
+	if (!back || (exif_data_get_sub_ifd_count (back) != 2)) {
+		fprintf (stderr, "SubIFDs not restored from snapshot\n");
+		ret = 1;
+	}
+	for (i = 0; !ret && (i < 2); i++) {
+		c = exif_data_get_sub_ifd (ed, i);
+		if ((exif_snapshot_get_sub_ifd_entry_count (&s, i) != c->count) ||
+		    (exif_data_get_sub_ifd (back, i)->count != c->count)) {
+			fprintf (stderr, "SubIFD %u has other entries\n", i);
+			ret = 1;
+		}
+		for (j = 0; j < c->count; j++) {
+			e = c->entries[j];
+			if (!exif_snapshot_find_sub_ifd_entry (&s, i, e->tag, &se) ||
+			    (se.size != e->size) || memcmp (se.data, e->data, e->size) ||
+			    !(e = exif_content_get_entry (exif_data_get_sub_ifd (back, i),
+							  e->tag)) ||
+			    (e->size != se.size) || memcmp (e->data, se.data, se.size)) {
+				fprintf (stderr, "SubIFD %u: entry %u differs\n", i, j);
+				ret = 1;
+			}
+		}
+	}
+	if (exif_snapshot_get_sub_ifd_entry (&s, 2, 0, &se) ||
+	    exif_snapshot_get_entry (&s, EXIF_IFD_COUNT, 0, &se)) {
+		fprintf (stderr, "Entry found past the last SubIFD\n");
+		ret = 1;
+	}
+	exif_data_unref (back);
+	exif_data_unref (ed);
+	free (d);
+	return ret;
+}
+
+static const ExifMnoteDataVendor canon = {
+	"Canon", NULL, 0, "Canon", NULL, exif_mnote_data_canon_new
+};
+
+int
+main (void)
+{
+	const char *srcdir = getenv ("srcdir");
+	char path[1024];
+	unsigned int i, size;
+	unsigned char *d, *moved;
+	ExifData *ed, *back;
+	ExifSnapshot s;
+	int ret = 0;
+
+	if (!srcdir)
+		srcdir = ".";
+
+	/* Built-in parsers only take HUAWEI MakerNotes, so add one for the
+	 * Canon test file */
+	exif_data_register_mnote_vendor (&canon);
+
+	for (i = 0; i < sizeof (files) / sizeof (files[0]); i++) {
+		snprintf (path, sizeof (path), "%s/testdata/%s", srcdir, files[i]);
+		ed = exif_data_new_from_file (path);
+		if (!ed || !exif_data_snapshot_save (ed, &d, &size)) {
+			fprintf (stderr, "%s: could not save snapshot\n", path);
+			exif_data_unref (ed);
+			ret = 1;
+			continue;
+		}
+
+		/* Offsets only, so it works from anywhere */
+		moved = malloc (size);
+		memcpy (moved, d, size);
+		free (d);
+		if (!exif_data_snapshot_view (&s, moved, size)) {
+			fprintf (stderr, "%s: snapshot not accepted\n", path);
+			ret = 1;
+		} else {
+			ret |= check_view (files[i], ed, &s);
+			if (!i && !exif_snapshot_get_mnote_count (&s)) {
+				fprintf (stderr, "%s: no MakerNote entries\n", path);
+				ret = 1;
+			}
+		}
+
+		/* Truncated or corrupt snapshots are refused */
+		if (exif_data_snapshot_view (&s, moved, size - 1)) {
+			fprintf (stderr, "%s: truncated snapshot accepted\n", path);
+			ret = 1;
+		}
+
+		back = exif_data_new_from_snapshot (moved, size);
+		if (!back) {
+			fprintf (stderr, "%s: no ExifData from snapshot\n", path);
+			ret = 1;
+		} else
+			ret |= compare_saved (files[i], ed, back);
+
+		exif_data_unref (back);
+		exif_data_unref (ed);
+		free (moved);
+	}
+
+	ret |= check_sub_ifds ();
+
+	if (exif_data_snapshot_view (&s, (const unsigned char *) "Exif\0\0MM", 8)) {
+		fprintf (stderr, "EXIF data accepted as snapshot\n");
+		ret = 1;
+	}
+	return ret;
+}
@@ -0,0 +1,235 @@
+/* test-source.c
+ *
+ * Check that a large TIFF-based file loaded through an ExifSource gives the
+ * same result as loading it from memory, while reading only the parts that
+ * hold metadata.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#include <libexif/exif-data.h>
+#include <libexif/exif-source.h>
+#include <libexif/exif-utils.h>
+#include <libexif/exif-system.h>
+
+#include "tiff-builder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define IMAGE_SIZE 200000
+#define THUMBNAIL_SIZE 6000
+
+/* Bytes passed through the read callback */
+static unsigned int bytes_read;
+
+/*
+ * Header, image data, thumbnail, values, SubIFD, EXIF IFD, IFD 0 and
+ * IFD 1 last.
+ */
+static void
+make_tiff (void)
+{
+	static const unsigned char rational[] = { 0, 0, 0, 1, 0, 0, 0, 250 };
+	unsigned int thumbnail, make, exposure, mnote, sub, exif, ifd0, i;
+
+	tiff_put ("MM\0\x2a\0\0\0\0", 8);
+	tiff_put (NULL, IMAGE_SIZE);
+	thumbnail = tiff_put (NULL, THUMBNAIL_SIZE);
+	for (i = 0; i < THUMBNAIL_SIZE; i++)
+		tiff[thumbnail + i] = i & 0xff;
+	make = tiff_put ("Source maker", 13);
+	tiff_put (NULL, 1);
+	exposure = tiff_put (rational, sizeof (rational));
+	mnote = tiff_put ("No parser knows this note", 26);
+
+	sub = tiff_size;
+	tiff_put_count (1);
+	tiff_put_entry (EXIF_TAG_IMAGE_WIDTH, EXIF_FORMAT_LONG, 1, 6000);
+	tiff_put (NULL, 4);
+
+	exif = tiff_size;
+	tiff_put_count (2);
+	tiff_put_entry (EXIF_TAG_EXPOSURE_TIME, EXIF_FORMAT_RATIONAL, 1,
+			exposure);
+	tiff_put_entry (EXIF_TAG_MAKER_NOTE, EXIF_FORMAT_UNDEFINED, 26, mnote);
+	tiff_put (NULL, 4);
+
+	ifd0 = tiff_size;
+	tiff_put_count (4);
+	tiff_put_entry (EXIF_TAG_MAKE, EXIF_FORMAT_ASCII, 13, make);
+	tiff_put_entry (EXIF_TAG_ORIENTATION, EXIF_FORMAT_SHORT, 1, 1);
+	tiff_put_entry (EXIF_TAG_SUB_IFDS, EXIF_FORMAT_LONG, 1, sub);
+	tiff_put_entry (EXIF_TAG_EXIF_IFD_POINTER, EXIF_FORMAT_LONG, 1, exif);
+	tiff_put (NULL, 4);
+	tiff_set_long (tiff_size - 4, tiff_size);
+	tiff_put_count (2);
+	tiff_put_entry (EXIF_TAG_JPEG_INTERCHANGE_FORMAT, EXIF_FORMAT_LONG, 1,
+			thumbnail);
+	tiff_put_entry (EXIF_TAG_JPEG_INTERCHANGE_FORMAT_LENGTH,
+			EXIF_FORMAT_LONG, 1, THUMBNAIL_SIZE);
+	tiff_put (NULL, 4);
+	tiff_set_long (4, ifd0);
+}
+
+static unsigned int
+read_at (void *UNUSED(user_data), unsigned int offset, unsigned char *buf,
+	 unsigned int size)
+{
+	if (offset >= tiff_size)
+		return 0;
+	if (size > tiff_size - offset)
+		size = tiff_size - offset;
+	memcpy (buf, tiff + offset, size);
+	bytes_read += size;
+	return size;
+}
+
+static int
+check (ExifData *ed, const char *what)
+{
+	ExifEntry *e;
+	ExifContent *c;
+	int ret = 0;
+
+	e = exif_content_get_entry (ed->ifd[EXIF_IFD_0], EXIF_TAG_MAKE);
+	if (!e || strcmp ((const char *) e->data, "Source maker")) {
+		fprintf (stderr, "%s: Make not loaded\n", what);
+		ret = 1;
+	}
+	e = exif_content_get_entry (ed->ifd[EXIF_IFD_EXIF], EXIF_TAG_EXPOSURE_TIME);
+	if (!e || e->size != 8 ||
+	    exif_get_rational (e->data, exif_data_get_byte_order (ed)).denominator != 250) {
+		fprintf (stderr, "%s: EXIF IFD not loaded\n", what);
+		ret = 1;
+	}
+	c = exif_data_get_sub_ifd (ed, 0);
+	e = c ? exif_content_get_entry (c, EXIF_TAG_IMAGE_WIDTH) : NULL;
+	if (exif_data_get_sub_ifd_count (ed) != 1 || !e ||
+	    exif_get_long (e->data, exif_data_get_byte_order (ed)) != 6000) {
+		fprintf (stderr, "%s: SubIFD not loaded\n", what);
+		ret = 1;
+	}
+	if (ed->size != THUMBNAIL_SIZE ||
+	    memcmp (ed->data, tiff + 8 + IMAGE_SIZE, THUMBNAIL_SIZE)) {
+		fprintf (stderr, "%s: thumbnail not loaded\n", what);
+		ret = 1;
+	}
+	return ret;
+}
+
+static int
+check_callback (void)
+{
+	ExifSource *src = exif_source_new (read_at, NULL, tiff_size);
+	ExifData *ed = exif_data_new ();
+	int ret;
+
+	bytes_read = 0;
+	exif_data_load_source (ed, src);
+	ret = check (ed, "callback");
+	/* The IFDs, their values and the thumbnail, not the image data. The
+	 * MakerNote is not recognized, so the data before it is not read. */
+	if (bytes_read > THUMBNAIL_SIZE + 8 * 4096) {
+		fprintf (stderr, "%u bytes read to load metadata\n", bytes_read);
+		ret = 1;
+	}
+	exif_data_unref (ed);
+	exif_source_unref (src);
+	return ret;
+}
+
+static int
+check_fd (void)
+{
+	char name[] = "/tmp/test-source-XXXXXX";
+	ExifSource *src;
+	ExifData *ed;
+	int fd, ret = 0;
+
+	fd = mkstemp (name);
+	if (fd < 0 || write (fd, tiff, tiff_size) != (ssize_t) tiff_size) {
+		fprintf (stderr, "Could not write %s\n", name);
+		ret = 1;
+	} else {
+		src = exif_source_new_from_fd (fd);
+		if (exif_source_get_size (src) != tiff_size) {
+			fprintf (stderr, "File source has the wrong size\n");
+			ret = 1;
+		}
+		ed = exif_data_new ();
+		exif_data_load_source (ed, src);
+		ret |= check (ed, "file");
+		exif_data_unref (ed);
+		exif_source_unref (src);
+	}
+	if (fd >= 0)
+		close (fd);
+	unlink (name);
+	return ret;
+}
+
+/* Reads outside the source fail; reads across pages are assembled */
+static int
+check_access (void)
+{
+	ExifSource *src = exif_source_new (read_at, NULL, tiff_size);
+	unsigned char buf[16];
+	const unsigned char *p;
+	int ret = 0;
+
+	if (exif_source_read (src, tiff_size - 8, buf, 16) ||
+	    exif_source_get (src, tiff_size, 1) ||
+	    exif_source_get (src, 0xfffffff0, 0x20)) {
+		fprintf (stderr, "Read beyond the end of the source\n");
+		ret = 1;
+	}
+	p = exif_source_get (src, 4096 - 2, 8);
+	if (!p || memcmp (p, tiff + 4096 - 2, 8)) {
+		fprintf (stderr, "Read across pages failed\n");
+		ret = 1;
+	}
+	if (!exif_source_read (src, tiff_size - 16, buf, 16) ||
+	    memcmp (buf, tiff + tiff_size - 16, 16)) {
+		fprintf (stderr, "Read at the end of the source failed\n");
+		ret = 1;
+	}
+	exif_source_unref (src);
+	return ret;
+}
+
+int
+main (void)
+{
+	ExifData *ed;
+	int ret;
+
+	make_tiff ();
+
+	ed = exif_data_new ();
+	exif_data_load_tiff (ed, tiff, tiff_size);
+	ret = check (ed, "memory");
+	exif_data_unref (ed);
+
+	ret |= check_callback () | check_fd () | check_access ();
+
+	free (tiff);
+	return ret;
+}
@@ -0,0 +1,154 @@
+/* test-take-data.c
+ *
+ * Check that exif_loader_take_data yields the same data as
+ * exif_loader_get_data while referencing the loader's buffer.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#include <libexif/exif-data.h>
+#include <libexif/exif-loader.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *files[] = {
+	"canon_makernote_variant_1.jpg",
+	"fuji_makernote_variant_1.jpg",
+	"olympus_makernote_variant_2.jpg",
+	"pentax_makernote_variant_2.jpg"
+};
+
+static int
+compare_saved (const char *fn, ExifData *a, ExifData *b)
+{
+	unsigned char *da = NULL, *db = NULL;
+	unsigned int sa = 0, sb = 0;
+	int ret = 0;
+
+	exif_data_save_data (a, &da, &sa);
+	exif_data_save_data (b, &db, &sb);
+	if (!da || sa != sb || memcmp (da, db, sa)) {
+		fprintf (stderr, "%s: saved data differs (%u vs %u bytes)\n",
+			 fn, sa, sb);
+		ret = 1;
+	}
+	free (da);
+	free (db);
+	return ret;
+}
+
+static int
+compare (const char *fn, ExifData *a, ExifData *b)
+{
+	unsigned int i, j, shared = 0;
+	const unsigned char *base = NULL;
+	int ret = 0;
+
+	for (i = 0; i < EXIF_IFD_COUNT; i++) {
+		if (a->ifd[i]->count != b->ifd[i]->count) {
+			fprintf (stderr, "%s: IFD '%s' has %u entries instead of %u\n",
+				 fn, exif_ifd_get_name (i), b->ifd[i]->count,
+				 a->ifd[i]->count);
+			return 1;
+		}
+		for (j = 0; j < a->ifd[i]->count; j++) {
+			ExifEntry *ea = a->ifd[i]->entries[j];
+			ExifEntry *eb = b->ifd[i]->entries[j];
+
+			if (ea->tag != eb->tag || ea->format != eb->format ||
+			    ea->components != eb->components ||
+			    ea->size != eb->size ||
+			    memcmp (ea->data, eb->data, ea->size)) {
+				fprintf (stderr, "%s: tag 0x%04x differs\n",
+					 fn, ea->tag);
+				ret = 1;
+			}
+
+			/* Borrowed values all sit at their offset from the TIFF header */
+			if (!base)
+				base = eb->data - eb->offset;
+			else if (eb->data - eb->offset == base)
+				shared++;
+		}
+	}
+	if (!shared) {
+		fprintf (stderr, "%s: values were copied out of the buffer\n", fn);
+		ret = 1;
+	}
+	if (a->size != b->size || (a->size && memcmp (a->data, b->data, a->size))) {
+		fprintf (stderr, "%s: thumbnail differs\n", fn);
+		ret = 1;
+	}
+	return ret;
+}
+
+int
+main (void)
+{
+	const char *srcdir = getenv ("srcdir");
+	char path[1024];
+	unsigned int i;
+	int ret = 0;
+
+	if (!srcdir)
+		srcdir = ".";
+
+	for (i = 0; i < sizeof (files) / sizeof (files[0]); i++) {
+		ExifLoader *l = exif_loader_new ();
+		ExifData *copied, *taken;
+		const unsigned char *buf;
+		unsigned int size;
+
+		snprintf (path, sizeof (path), "%s/testdata/%s", srcdir, files[i]);
+		exif_loader_write_file (l, path);
+		copied = exif_loader_get_data (l);
+		taken = exif_loader_take_data (l);
+		if (!copied || !taken) {
+			fprintf (stderr, "%s: could not load\n", path);
+			ret = 1;
+			exif_data_unref (copied);
+			exif_data_unref (taken);
+			exif_loader_unref (l);
+			continue;
+		}
+
+		/* The loader gave its buffer away */
+		exif_loader_get_buf (l, &buf, &size);
+		if (buf || size) {
+			fprintf (stderr, "%s: loader still holds data\n", path);
+			ret = 1;
+		}
+		exif_loader_unref (l);
+
+		ret |= compare (files[i], copied, taken);
+		ret |= compare_saved (files[i], copied, taken);
+
+		/* Swapping modifies the borrowed values in place */
+		exif_data_set_byte_order (copied, EXIF_BYTE_ORDER_MOTOROLA +
+			EXIF_BYTE_ORDER_INTEL - exif_data_get_byte_order (copied));
+		exif_data_set_byte_order (taken, exif_data_get_byte_order (copied));
+		ret |= compare_saved (files[i], copied, taken);
+
+		exif_data_unref (copied);
+		exif_data_unref (taken);
+	}
+
+	return ret;
+}
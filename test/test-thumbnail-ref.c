@@ -0,0 +1,121 @@
+/* test-thumbnail-ref.c
+ *
+ * Check that the thumbnail can be recorded by reference or ignored instead
+ * of being copied into ExifData::data.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#include <libexif/exif-data.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define THUMBNAIL_SIZE 3000
+
+static unsigned char thumbnail[THUMBNAIL_SIZE];
+
+/* JPEG file with an APP1 segment holding EXIF data and a thumbnail */
+static unsigned char *
+make_jpeg (unsigned int *size)
+{
+	ExifData *ed = exif_data_new ();
+	unsigned char *exif = NULL, *d;
+	unsigned int exif_size = 0, i;
+
+	for (i = 0; i < THUMBNAIL_SIZE; i++)
+		thumbnail[i] = (i * 7) & 0xff;
+	ed->data = malloc (THUMBNAIL_SIZE);
+	memcpy (ed->data, thumbnail, THUMBNAIL_SIZE);
+	ed->size = THUMBNAIL_SIZE;
+	exif_data_save_data (ed, &exif, &exif_size);
+	exif_data_unref (ed);
+
+	*size = 4 + 2 + exif_size;
+	d = malloc (*size);
+	memcpy (d, "\xff\xd8\xff\xe1", 4);
+	d[4] = ((exif_size + 2) >> 8) & 0xff;
+	d[5] = (exif_size + 2) & 0xff;
+	memcpy (d + 6, exif, exif_size);
+	free (exif);
+	return d;
+}
+
+static int
+check (const unsigned char *d, unsigned int size, ExifDataOption o,
+       const char *what)
+{
+	ExifData *ed = exif_data_new ();
+	unsigned int offset = 0, s = 0;
+	int found, ret = 0;
+
+	exif_data_set_option (ed, o);
+	exif_data_load_data (ed, d, size);
+	found = exif_data_get_thumbnail_ref (ed, &offset, &s);
+
+	if (o == EXIF_DATA_OPTION_IGNORE_THUMBNAIL) {
+		if (found || ed->data || ed->size) {
+			fprintf (stderr, "%s: thumbnail loaded\n", what);
+			ret = 1;
+		}
+	} else if (!found || s != THUMBNAIL_SIZE || offset > size - s ||
+		   memcmp (d + offset, thumbnail, s)) {
+		fprintf (stderr, "%s: wrong thumbnail reference\n", what);
+		ret = 1;
+	}
+
+	if (o == EXIF_DATA_OPTION_THUMBNAIL_BY_REFERENCE) {
+		if (ed->data || ed->size) {
+			fprintf (stderr, "%s: thumbnail copied\n", what);
+			ret = 1;
+		}
+		/* The entries describing the thumbnail are kept */
+		if (!ed->ifd[EXIF_IFD_1]->count) {
+			fprintf (stderr, "%s: IFD 1 removed\n", what);
+			ret = 1;
+		}
+	} else if (o != EXIF_DATA_OPTION_IGNORE_THUMBNAIL &&
+		   (ed->size != THUMBNAIL_SIZE ||
+		    memcmp (ed->data, thumbnail, THUMBNAIL_SIZE))) {
+		fprintf (stderr, "%s: thumbnail not copied\n", what);
+		ret = 1;
+	}
+	exif_data_unref (ed);
+	return ret;
+}
+
+int
+main (void)
+{
+	unsigned int size;
+	unsigned char *d = make_jpeg (&size);
+	int ret;
+
+	ret = check (d, size, 0, "default") |
+	      check (d, size, EXIF_DATA_OPTION_THUMBNAIL_BY_REFERENCE,
+		     "by reference") |
+	      check (d, size, EXIF_DATA_OPTION_IGNORE_THUMBNAIL, "ignored");
+	if (!exif_data_option_get_name (EXIF_DATA_OPTION_THUMBNAIL_BY_REFERENCE) ||
+	    !exif_data_option_get_name (EXIF_DATA_OPTION_IGNORE_THUMBNAIL)) {
+		fprintf (stderr, "Options have no name\n");
+		ret = 1;
+	}
+	free (d);
+	return ret;
+}
@@ -0,0 +1,160 @@
+/* test-tiff.c
+ *
+ * Check that TIFF-based raw files are loaded beyond 64 KiB, including the
+ * EXIF IFD and the SubIFDs.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#include <libexif/exif-data.h>
+#include <libexif/exif-utils.h>
+
+#include "tiff-builder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define IMAGE_SIZE 200000
+
+/*
+ * Header, image data, values, SubIFDs, EXIF IFD and IFD 0 last,
+ * so that everything lies beyond 64 KiB.
+ */
+static void
+make_tiff (void)
+{
+	static const unsigned char rational[] = { 0, 0, 0, 1, 0, 0, 0, 250 };
+	unsigned int make, exposure, sub[2], subs, exif, ifd0;
+
+	tiff_put ("MM\0\x2a\0\0\0\0", 8);
+	tiff_put (NULL, IMAGE_SIZE);
+	make = tiff_put ("Raw maker", 10);
+	tiff_put (NULL, 2);
+	exposure = tiff_put (rational, sizeof (rational));
+
+	sub[0] = tiff_size;
+	tiff_put_count (2);
+	tiff_put_entry (EXIF_TAG_IMAGE_WIDTH, EXIF_FORMAT_LONG, 1, 6000);
+	tiff_put_entry (EXIF_TAG_IMAGE_LENGTH, EXIF_FORMAT_LONG, 1, 4000);
+	tiff_put (NULL, 4);
+	sub[1] = tiff_size;
+	tiff_put_count (1);
+	tiff_put_entry (EXIF_TAG_IMAGE_WIDTH, EXIF_FORMAT_LONG, 1, 256);
+	tiff_put (NULL, 4);
+	subs = tiff_put (NULL, 8);
+	tiff_set_long (subs, sub[0]);
+	tiff_set_long (subs + 4, sub[1]);
+
+	exif = tiff_size;
+	tiff_put_count (1);
+	tiff_put_entry (EXIF_TAG_EXPOSURE_TIME, EXIF_FORMAT_RATIONAL, 1,
+			exposure);
+	tiff_put (NULL, 4);
+
+	ifd0 = tiff_size;
+	tiff_put_count (4);
+	tiff_put_entry (EXIF_TAG_MAKE, EXIF_FORMAT_ASCII, 10, make);
+	tiff_put_entry (EXIF_TAG_ORIENTATION, EXIF_FORMAT_SHORT, 1, 1);
+	tiff_put_entry (EXIF_TAG_SUB_IFDS, EXIF_FORMAT_LONG, 2, subs);
+	tiff_put_entry (EXIF_TAG_EXIF_IFD_POINTER, EXIF_FORMAT_LONG, 1, exif);
+	tiff_put (NULL, 4);
+	tiff_set_long (4, ifd0);
+}
+
+static int
+check (ExifData *ed, const char *what)
+{
+	ExifEntry *e;
+	ExifContent *c;
+	int ret = 0;
+
+	e = exif_content_get_entry (ed->ifd[EXIF_IFD_0], EXIF_TAG_MAKE);
+	if (!e || strcmp ((const char *) e->data, "Raw maker")) {
+		fprintf (stderr, "%s: Make not loaded\n", what);
+		ret = 1;
+	}
+	e = exif_content_get_entry (ed->ifd[EXIF_IFD_EXIF], EXIF_TAG_EXPOSURE_TIME);
+	if (!e || e->size != 8 ||
+	    exif_get_rational (e->data, exif_data_get_byte_order (ed)).denominator != 250) {
+		fprintf (stderr, "%s: EXIF IFD not loaded\n", what);
+		ret = 1;
+	}
+	if (exif_data_get_sub_ifd_count (ed) != 2 || exif_data_get_sub_ifd (ed, 2)) {
+		fprintf (stderr, "%s: %u SubIFDs instead of 2\n", what,
+			 exif_data_get_sub_ifd_count (ed));
+		return 1;
+	}
+	c = exif_data_get_sub_ifd (ed, 0);
+	e = exif_content_get_entry (c, EXIF_TAG_IMAGE_LENGTH);
+	if (c->count != 2 || !e ||
+	    exif_get_long (e->data, exif_data_get_byte_order (ed)) != 4000) {
+		fprintf (stderr, "%s: first SubIFD not loaded\n", what);
+		ret = 1;
+	}
+	c = exif_data_get_sub_ifd (ed, 1);
+	e = exif_content_get_entry (c, EXIF_TAG_IMAGE_WIDTH);
+	if (c->count != 1 || !e ||
+	    exif_get_long (e->data, exif_data_get_byte_order (ed)) != 256) {
+		fprintf (stderr, "%s: second SubIFD not loaded\n", what);
+		ret = 1;
+	}
+	return ret;
+}
+
+int
+main (void)
+{
+	ExifData *ed;
+	int ret = 0;
+
+	make_tiff ();
+
+	ed = exif_data_new ();
+	exif_data_load_tiff (ed, tiff, tiff_size);
+	ret |= check (ed, "exif_data_load_tiff");
+
+	/* Loading again replaces the SubIFDs */
+	exif_data_load_tiff (ed, tiff, tiff_size);
+	if (exif_data_get_sub_ifd_count (ed) != 2) {
+		fprintf (stderr, "SubIFDs not replaced\n");
+		ret = 1;
+	}
+
+	/* SubIFDs follow byte order changes */
+	exif_data_set_byte_order (ed, EXIF_BYTE_ORDER_INTEL);
+	ret |= check (ed, "Intel byte order");
+	exif_data_unref (ed);
+
+	/* Detected from the TIFF header */
+	ed = exif_data_new_from_data (tiff, tiff_size);
+	ret |= check (ed, "exif_data_load_data");
+	exif_data_unref (ed);
+
+	/* Truncated: the IFDs are at the end, so nothing is found */
+	ed = exif_data_new ();
+	exif_data_load_tiff (ed, tiff, tiff_size - 100);
+	if (ed->ifd[EXIF_IFD_0]->count || exif_data_get_sub_ifd_count (ed)) {
+		fprintf (stderr, "Data loaded from truncated file\n");
+		ret = 1;
+	}
+	exif_data_unref (ed);
+
+	free (tiff);
+	return ret;
+}
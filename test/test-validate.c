@@ -0,0 +1,178 @@
+/* test-validate.c
+ *
+ * Check that exif_data_validate agrees with exif_data_load_data on
+ * well-formed, truncated and corrupted data.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#include <libexif/exif-data.h>
+#include <libexif/exif-utils.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const unsigned char thumbnail[] = { 0xff, 0xd8, 0x00, 0x11, 0x22, 0xff, 0xd9 };
+
+static ExifData *
+create_data (void)
+{
+	static const ExifTag tags[] = {
+		EXIF_TAG_MAKE, EXIF_TAG_ORIENTATION, EXIF_TAG_X_RESOLUTION,
+		EXIF_TAG_DATE_TIME_ORIGINAL, EXIF_TAG_EXPOSURE_TIME,
+		EXIF_TAG_GPS_VERSION_ID, EXIF_TAG_GPS_LATITUDE
+	};
+	static const ExifIfd ifds[] = {
+		EXIF_IFD_0, EXIF_IFD_0, EXIF_IFD_0,
+		EXIF_IFD_EXIF, EXIF_IFD_EXIF,
+		EXIF_IFD_GPS, EXIF_IFD_GPS
+	};
+	ExifData *ed = exif_data_new ();
+	unsigned int i;
+
+	if (!ed)
+		return NULL;
+	for (i = 0; i < sizeof (tags) / sizeof (tags[0]); i++) {
+		ExifEntry *e = exif_entry_new ();
+		exif_content_add_entry (ed->ifd[ifds[i]], e);
+		exif_entry_initialize (e, tags[i]);
+		exif_entry_unref (e);
+	}
+	ed->data = malloc (sizeof (thumbnail));
+	memcpy (ed->data, thumbnail, sizeof (thumbnail));
+	ed->size = sizeof (thumbnail);
+	return ed;
+}
+
+/* Compare the report against what the full loader makes of the data */
+static int
+check_against_loader (const unsigned char *d, unsigned int size, int expect_valid)
+{
+	ExifValidateReport r;
+	ExifData *ed;
+	int valid, i, ret = 0;
+
+	valid = exif_data_validate (d, size, &r);
+	if (expect_valid >= 0 && valid != expect_valid) {
+		fprintf (stderr, "Size %u: validate returned %d (problems 0x%x)\n",
+			 size, valid, r.problems);
+		return 1;
+	}
+
+	ed = exif_data_new ();
+	exif_data_unset_option (ed, EXIF_DATA_OPTION_FOLLOW_SPECIFICATION);
+	exif_data_load_data (ed, d, size);
+	for (i = 0; i < EXIF_IFD_COUNT; i++) {
+		if (r.entries[i] != ed->ifd[i]->count) {
+			fprintf (stderr, "Size %u: IFD '%s' has %u entries, loader found %u\n",
+				 size, exif_ifd_get_name (i), r.entries[i],
+				 ed->ifd[i]->count);
+			ret = 1;
+		}
+	}
+	if (r.thumbnail_size != ed->size) {
+		fprintf (stderr, "Size %u: thumbnail size %u, loader found %u\n",
+			 size, r.thumbnail_size, ed->size);
+		ret = 1;
+	}
+	exif_data_unref (ed);
+	return ret;
+}
+
+int
+main (void)
+{
+	ExifData *ed;
+	ExifValidateReport r;
+	unsigned char *buf = NULL;
+	unsigned int size = 0, i, n;
+	unsigned char *ifd0;
+	ExifByteOrder order;
+	ExifLong exif_offset, ifd0_offset;
+	int ret = 0;
+
+	ed = create_data ();
+	if (!ed) {
+		fprintf (stderr, "Out of memory\n");
+		return 1;
+	}
+	exif_data_save_data (ed, &buf, &size);
+	exif_data_unref (ed);
+	if (!buf || !size) {
+		fprintf (stderr, "Could not save EXIF data\n");
+		return 1;
+	}
+
+	/* Well-formed data */
+	if (!exif_data_validate (buf, size, &r) || r.problems) {
+		fprintf (stderr, "Saved data reported as invalid (problems 0x%x)\n",
+			 r.problems);
+		ret = 1;
+	}
+	if (!r.ifd_offset[EXIF_IFD_EXIF] || !r.ifd_offset[EXIF_IFD_GPS] ||
+	    r.thumbnail_size != sizeof (thumbnail) ||
+	    memcmp (buf + 6 + r.thumbnail_offset, thumbnail, sizeof (thumbnail))) {
+		fprintf (stderr, "IFDs or thumbnail not located\n");
+		ret = 1;
+	}
+	ret |= check_against_loader (buf, size, 1);
+
+	/* Every truncation must be handled without reading past the end */
+	for (i = 0; i < size; i++)
+		ret |= check_against_loader (buf, i, 0);
+
+	/* Point the EXIF IFD past the end of the data */
+	order = r.order;
+	exif_offset = r.ifd_offset[EXIF_IFD_EXIF];
+	ifd0_offset = r.ifd_offset[EXIF_IFD_0];
+	ifd0 = buf + 6 + ifd0_offset;
+	n = exif_get_short (ifd0, order);
+	for (i = 0; i < n; i++) {
+		unsigned char *e = ifd0 + 2 + 12 * i;
+		if (exif_get_short (e, order) != EXIF_TAG_EXIF_IFD_POINTER)
+			continue;
+
+		exif_set_long (e + 8, order, 0xfffff);
+		ret |= check_against_loader (buf, size, 0);
+		exif_data_validate (buf, size, &r);
+		if (!(r.problems & EXIF_VALIDATE_IFD_OUT_OF_BOUNDS)) {
+			fprintf (stderr, "Bogus EXIF IFD offset not reported\n");
+			ret = 1;
+		}
+
+		/* Make the EXIF IFD a copy of IFD 0, which points to itself */
+		exif_set_long (e + 8, order, ifd0_offset);
+		ret |= check_against_loader (buf, size, 0);
+		exif_data_validate (buf, size, &r);
+		if (!(r.problems & EXIF_VALIDATE_IFD_LOOP)) {
+			fprintf (stderr, "IFD loop not reported\n");
+			ret = 1;
+		}
+		exif_set_long (e + 8, order, exif_offset);
+	}
+
+	if (exif_data_validate (NULL, 0, &r) ||
+	    !(r.problems & EXIF_VALIDATE_NO_EXIF_HEADER)) {
+		fprintf (stderr, "Missing data not reported\n");
+		ret = 1;
+	}
+
+	free (buf);
+	return ret;
+}
@@ -0,0 +1,73 @@
+/* tiff-builder.c
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#include "tiff-builder.h"
+
+#include <libexif/exif-utils.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+unsigned char *tiff;
+unsigned int tiff_size;
+
+unsigned int
+tiff_put (const void *p, unsigned int size)
+{
+	tiff = realloc (tiff, tiff_size + size);
+	if (p)
+		memcpy (tiff + tiff_size, p, size);
+	else
+		memset (tiff + tiff_size, 0, size);
+	tiff_size += size;
+	return tiff_size - size;
+}
+
+void
+tiff_put_count (unsigned int n)
+{
+	unsigned char c[2];
+
+	exif_set_short (c, EXIF_BYTE_ORDER_MOTOROLA, n);
+	tiff_put (c, 2);
+}
+
+void
+tiff_put_entry (ExifTag tag, ExifFormat format, unsigned int components,
+		unsigned int value)
+{
+	unsigned char e[12];
+
+	exif_set_short (e, EXIF_BYTE_ORDER_MOTOROLA, tag);
+	exif_set_short (e + 2, EXIF_BYTE_ORDER_MOTOROLA, format);
+	exif_set_long (e + 4, EXIF_BYTE_ORDER_MOTOROLA, components);
+	if ((format == EXIF_FORMAT_SHORT) && (components == 1)) {
+		exif_set_short (e + 8, EXIF_BYTE_ORDER_MOTOROLA, value);
+		exif_set_short (e + 10, EXIF_BYTE_ORDER_MOTOROLA, 0);
+	} else
+		exif_set_long (e + 8, EXIF_BYTE_ORDER_MOTOROLA, value);
+	tiff_put (e, 12);
+}
+
+void
+tiff_set_long (unsigned int o, unsigned int v)
+{
+	exif_set_long (tiff + o, EXIF_BYTE_ORDER_MOTOROLA, v);
+}
@@ -0,0 +1,49 @@
+/* tiff-builder.h
+ *
+ * Helpers for the tests that build TIFF files in memory, in big-endian
+ * byte order.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA.
+ *
+ * SPDX-License-Identifier: LGPL-2.0-or-later
+ */
+
+#ifndef TIFF_BUILDER_H
+#define TIFF_BUILDER_H
+
+#include <libexif/exif-format.h>
+#include <libexif/exif-tag.h>
+
+/* The file built so far */
+extern unsigned char *tiff;
+extern unsigned int tiff_size;
+
+/*! Append \a size bytes from \a p, or zeros if \a p is NULL
+ *
+ * \return the offset of the bytes appended */
+unsigned int tiff_put (const void *p, unsigned int size);
+
+/*! Append the number of entries of a directory */
+void tiff_put_count (unsigned int n);
+
+/*! Append one 12-byte directory entry */
+void tiff_put_entry (ExifTag tag, ExifFormat format, unsigned int components,
+		     unsigned int value);
+
+/*! Set the long at offset \a o */
+void tiff_set_long (unsigned int o, unsigned int v);
+
+#endif /* !defined(TIFF_BUILDER_H) */